@@ -0,0 +1,281 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+
+#include "ithread.h"
+#include "ithreadjson.h"
+#include "libjson.h"
+
+#define BENCH_THROUGHPUT_JOBS 1000000
+#define BENCH_BATCH_SIZE 1024
+#define BENCH_LATENCY_JOBS 50000
+#define BENCH_LATENCY_INTERVAL_NS 20000
+#define BENCH_FAIRNESS_WORKERS 4
+#define BENCH_FAIRNESS_SHORT_JOBS 20000
+#define BENCH_FAIRNESS_SHORT_RUN_NS 2000
+#define BENCH_FAIRNESS_LONG_EVERY 50
+#define BENCH_FAIRNESS_LONG_RUN_NS 2000000
+#define BENCH_WATCHDOG_JOBS 500000
+#define BENCH_WATCHDOG_RUN_NS 1000
+
+// A class of job: how long each job spins for, and what the jobs of the class experienced.
+typedef struct _bench_job_class {
+    uint64_t run_ns;
+    IThreadHistogram * wait_times;
+    _Atomic(uint64_t) turnaround_ns;
+    _Atomic(size_t) done_count;
+} BenchJobClass;
+
+/// @brief Reports a benchmark that couldn't be set up or whose results couldn't be recorded, and exits with a failure status
+///         rather than write results that can't be trusted.
+static void BenchFail(const char * what)
+{
+    fprintf(stderr, "iworkerthreadcontrollerbench: %s failed\n", what);
+    exit(EXIT_FAILURE);
+}
+
+/// @brief Spins for the given number of nanoseconds, standing in for a job that does some work.
+static void BenchSpin(uint64_t nanoseconds)
+{
+    if (nanoseconds == 0) return;
+    const uint64_t END = IThreadGetTimeNs() + nanoseconds;
+    while (IThreadGetTimeNs() < END);
+}
+
+/// @brief Main function for every benchmark job.  Records how long the job waited between being queued and starting, does the
+///         class's work, and then counts the job as done.
+static void BenchJobRun(IWorkerThreadJob * iwtj)
+{
+    BenchJobClass * bjc = (BenchJobClass *) IWorkerThreadJobGetData(iwtj);
+    if (bjc->wait_times && iwtj->enqueue_time_ns) IThreadHistogramRecordConcurrent(bjc->wait_times, iwtj->start_time_ns - iwtj->enqueue_time_ns);
+    BenchSpin(bjc->run_ns);
+    if (iwtj->enqueue_time_ns)
+        atomic_fetch_add_explicit(&bjc->turnaround_ns, IThreadGetTimeNs() - iwtj->enqueue_time_ns, memory_order_relaxed);
+    atomic_fetch_add_explicit(&bjc->done_count, 1, memory_order_release);
+}
+
+static void BenchJobClassInit(BenchJobClass * bjc, uint64_t run_ns, bool record_wait_times)
+{
+    bjc->run_ns = run_ns;
+    bjc->wait_times = record_wait_times ? IThreadHistogramCreate() : NULL;
+    if (record_wait_times && !bjc->wait_times) BenchFail("creating a histogram");
+    atomic_init(&bjc->turnaround_ns, 0);
+    atomic_init(&bjc->done_count, 0);
+}
+
+/// @brief Creates and starts a controller with the given number of worker threads, all running BenchJobRun().
+static IWorkerThreadController * BenchStartController(long workers, IThreadTimeout timeout)
+{
+    IWorkerThreadController * iwtc = IWorkerThreadControllerCreate();
+    if (!iwtc) BenchFail("creating a controller");
+    for (long w = 0; w < workers; w++)
+        if (!IWorkerThreadControllerAddWorkerThread(iwtc, BenchJobRun, NULL, NULL, timeout)) BenchFail("adding a worker thread");
+    if (!IWorkerThreadControllerStart(iwtc)) BenchFail("starting a controller");
+    return iwtc;
+}
+
+static void BenchStopController(IWorkerThreadController * iwtc)
+{
+    IWorkerThreadControllerStop(iwtc);
+    IWorkerThreadControllerFree(iwtc);
+}
+
+/// @brief Adds jobs_count jobs for a class in batches, waiting for room whenever the job queue is full.
+static void BenchAddJobs(IWorkerThreadController * iwtc, BenchJobClass * bjc, size_t jobs_count)
+{
+    void * job_data[BENCH_BATCH_SIZE];
+    for (size_t j = 0; j < BENCH_BATCH_SIZE; j++) job_data[j] = bjc;
+    while (jobs_count > 0) {
+        const size_t BATCH = jobs_count < BENCH_BATCH_SIZE ? jobs_count : BENCH_BATCH_SIZE;
+        size_t added = IWorkerThreadControllerAddJobs(iwtc, job_data, BATCH);
+        if (added == 0) sched_yield();
+        jobs_count -= added;
+    }
+}
+
+/// @brief Waits until jobs_count jobs of a class are done.
+static void BenchWaitForJobs(BenchJobClass * bjc, size_t jobs_count)
+{
+    while (atomic_load_explicit(&bjc->done_count, memory_order_acquire) < jobs_count) sched_yield();
+}
+
+/// @brief Adds a histogram's count, mean, percentiles and extremes (all in nanoseconds) to a JSON object element.
+/// @return True if every member was added, false otherwise.
+static bool BenchAddHistogram(JSONElement * object, IThreadHistogram * ith)
+{
+    return IThreadJSONAddNumber(object, "count", IThreadHistogramGetCount(ith)) &&
+        IThreadJSONAddNumber(object, "min_ns", IThreadHistogramGetMin(ith)) &&
+        IThreadJSONAddNumber(object, "mean_ns", IThreadHistogramGetMean(ith)) &&
+        IThreadJSONAddNumber(object, "p50_ns", IThreadHistogramGetPercentile(ith, 50.0)) &&
+        IThreadJSONAddNumber(object, "p90_ns", IThreadHistogramGetPercentile(ith, 90.0)) &&
+        IThreadJSONAddNumber(object, "p99_ns", IThreadHistogramGetPercentile(ith, 99.0)) &&
+        IThreadJSONAddNumber(object, "p999_ns", IThreadHistogramGetPercentile(ith, 99.9)) &&
+        IThreadJSONAddNumber(object, "max_ns", IThreadHistogramGetMax(ith));
+}
+
+/// @brief Empty-job throughput for a range of worker counts.  One producer adds the jobs in batches as fast as it can and the
+///         clock stops when the last job is done, so this measures the whole dispatch path (queueing, waking, taking, completing).
+static JSONElement * BenchThroughput(long max_threads)
+{
+    JSONElement * results = JSONCreateArrayElement();
+    if (!results) BenchFail("creating the results");
+    // Powers of two, finishing with max_threads itself.
+    for (long workers = 1; workers > 0; workers = workers == max_threads ? 0 : workers * 2 > max_threads ? max_threads : workers * 2) {
+        BenchJobClass empty;
+        BenchJobClassInit(&empty, 0, false);
+        IWorkerThreadController * iwtc = BenchStartController(workers, IThreadTimeoutNone);
+        const uint64_t START = IThreadGetTimeNs();
+        BenchAddJobs(iwtc, &empty, BENCH_THROUGHPUT_JOBS);
+        BenchWaitForJobs(&empty, BENCH_THROUGHPUT_JOBS);
+        const double ELAPSED_SEC = (double) (IThreadGetTimeNs() - START) / ITHREAD_NS_PER_SEC;
+        BenchStopController(iwtc);
+
+        JSONElement * result = JSONCreateObjectElement();
+        const bool RECORDED = IThreadJSONAddNumber(result, "workers", workers) &&
+            IThreadJSONAddNumber(result, "jobs", BENCH_THROUGHPUT_JOBS) &&
+            IThreadJSONAddNumber(result, "seconds", ELAPSED_SEC) &&
+            IThreadJSONAddNumber(result, "jobs_per_sec", BENCH_THROUGHPUT_JOBS / ELAPSED_SEC) &&
+            IThreadJSONAddNumber(result, "ns_per_job", ELAPSED_SEC * ITHREAD_NS_PER_SEC / BENCH_THROUGHPUT_JOBS) &&
+            JSONAddChildToElement(result, results);
+        if (!RECORDED) BenchFail("recording the throughput results");
+        fprintf(stderr, "throughput: %ld workers, %.0f jobs/s\n", workers, BENCH_THROUGHPUT_JOBS / ELAPSED_SEC);
+    }
+    return results;
+}
+
+/// @brief Submit-to-start latency.  Jobs are added one at a time at a steady rate well below the workers' capacity, so the
+///         distribution shows the cost of handing a job to an idle worker (including waking it) rather than time spent in a backlog.
+static JSONElement * BenchLatency(long workers)
+{
+    BenchJobClass empty;
+    BenchJobClassInit(&empty, 0, true);
+    IWorkerThreadController * iwtc = BenchStartController(workers, IThreadTimeoutNone);
+    uint64_t next_submit = IThreadGetTimeNs();
+    for (size_t j = 0; j < BENCH_LATENCY_JOBS; j++) {
+        while (IThreadGetTimeNs() < next_submit);
+        while (!IWorkerThreadControllerAddJob(iwtc, &empty)) sched_yield();
+        next_submit += BENCH_LATENCY_INTERVAL_NS;
+    }
+    BenchWaitForJobs(&empty, BENCH_LATENCY_JOBS);
+    BenchStopController(iwtc);
+
+    JSONElement * result = JSONCreateObjectElement();
+    const bool RECORDED = IThreadJSONAddNumber(result, "workers", workers) &&
+        IThreadJSONAddNumber(result, "interval_ns", BENCH_LATENCY_INTERVAL_NS) &&
+        BenchAddHistogram(result, empty.wait_times);
+    if (!RECORDED) BenchFail("recording the latency results");
+    fprintf(stderr, "latency: p50 %lu ns, p99 %lu ns\n", (unsigned long) IThreadHistogramGetPercentile(empty.wait_times, 50.0),
+            (unsigned long) IThreadHistogramGetPercentile(empty.wait_times, 99.0));
+    IThreadHistogramFree(empty.wait_times);
+    return result;
+}
+
+/// @brief Adds a job class's wait times and mean slowdown (turnaround time over run time, 1.0 being a job that never waited) to a
+///         JSON object element.
+static JSONElement * BenchJobClassToJSON(BenchJobClass * bjc)
+{
+    JSONElement * object = JSONCreateObjectElement();
+    const size_t DONE = atomic_load(&bjc->done_count);
+    const double MEAN_TURNAROUND_NS = DONE ? (double) atomic_load(&bjc->turnaround_ns) / DONE : 0.0;
+    const bool RECORDED = IThreadJSONAddNumber(object, "run_ns", bjc->run_ns) &&
+        IThreadJSONAddNumber(object, "mean_slowdown", bjc->run_ns ? MEAN_TURNAROUND_NS / bjc->run_ns : 0.0) &&
+        BenchAddHistogram(object, bjc->wait_times);
+    if (!RECORDED) BenchFail("recording a job class's results");
+    return object;
+}
+
+/// @brief Mixed short/long job fairness.  A backlog of short jobs with a long job every BENCH_FAIRNESS_LONG_EVERY jobs is added up
+///         front, and each class's wait times and slowdown are compared.  Ideally short jobs aren't held up behind the long ones
+///         for much longer than the long ones are held up behind them.
+static JSONElement * BenchFairness(long max_threads)
+{
+    const long WORKERS = max_threads < BENCH_FAIRNESS_WORKERS ? max_threads : BENCH_FAIRNESS_WORKERS;
+    const size_t LONG_JOBS = BENCH_FAIRNESS_SHORT_JOBS / BENCH_FAIRNESS_LONG_EVERY;
+    BenchJobClass short_jobs, long_jobs;
+    BenchJobClassInit(&short_jobs, BENCH_FAIRNESS_SHORT_RUN_NS, true);
+    BenchJobClassInit(&long_jobs, BENCH_FAIRNESS_LONG_RUN_NS, true);
+    IWorkerThreadController * iwtc = BenchStartController(WORKERS, IThreadTimeoutNone);
+    const uint64_t START = IThreadGetTimeNs();
+    for (size_t j = 0; j < BENCH_FAIRNESS_SHORT_JOBS; j++) {
+        while (!IWorkerThreadControllerAddJob(iwtc, &short_jobs)) sched_yield();
+        if ((j + 1) % BENCH_FAIRNESS_LONG_EVERY == 0) while (!IWorkerThreadControllerAddJob(iwtc, &long_jobs)) sched_yield();
+    }
+    BenchWaitForJobs(&short_jobs, BENCH_FAIRNESS_SHORT_JOBS);
+    BenchWaitForJobs(&long_jobs, LONG_JOBS);
+    const double ELAPSED_SEC = (double) (IThreadGetTimeNs() - START) / ITHREAD_NS_PER_SEC;
+    BenchStopController(iwtc);
+
+    const uint64_t SHORT_P99 = IThreadHistogramGetPercentile(short_jobs.wait_times, 99.0);
+    const uint64_t LONG_P99 = IThreadHistogramGetPercentile(long_jobs.wait_times, 99.0);
+    JSONElement * result = JSONCreateObjectElement();
+    const bool RECORDED = IThreadJSONAddNumber(result, "workers", WORKERS) &&
+        IThreadJSONAddNumber(result, "seconds", ELAPSED_SEC) &&
+        IThreadJSONAddNumber(result, "short_to_long_p99_wait_ratio", LONG_P99 ? (double) SHORT_P99 / LONG_P99 : 0.0) &&
+        IThreadJSONAddElement(result, "short", BenchJobClassToJSON(&short_jobs)) &&
+        IThreadJSONAddElement(result, "long", BenchJobClassToJSON(&long_jobs));
+    if (!RECORDED) BenchFail("recording the fairness results");
+    fprintf(stderr, "fairness: short p99 wait %lu ns, long p99 wait %lu ns\n", (unsigned long) SHORT_P99, (unsigned long) LONG_P99);
+    IThreadHistogramFree(short_jobs.wait_times);
+    IThreadHistogramFree(long_jobs.wait_times);
+    return result;
+}
+
+/// @brief Timeout watchdog overhead.  The same backlog of short jobs is run with each timeout method, and the throughput compared
+///         with no timeout (where the watchdog has nothing to check).
+static JSONElement * BenchWatchdog(long workers)
+{
+    const IThreadTimeout TIMEOUTS[] = { IThreadTimeoutNone, IThreadTimeoutSmart, 1 };
+    char * const NAMES[] = { "none", "smart", "fixed_1s" };
+    JSONElement * results = JSONCreateArrayElement();
+    if (!results) BenchFail("creating the results");
+    double baseline_jobs_per_sec = 0.0;
+    for (size_t t = 0; t < sizeof(TIMEOUTS) / sizeof(TIMEOUTS[0]); t++) {
+        BenchJobClass jobs;
+        BenchJobClassInit(&jobs, BENCH_WATCHDOG_RUN_NS, false);
+        IWorkerThreadController * iwtc = BenchStartController(workers, TIMEOUTS[t]);
+        const uint64_t START = IThreadGetTimeNs();
+        BenchAddJobs(iwtc, &jobs, BENCH_WATCHDOG_JOBS);
+        BenchWaitForJobs(&jobs, BENCH_WATCHDOG_JOBS);
+        const double ELAPSED_SEC = (double) (IThreadGetTimeNs() - START) / ITHREAD_NS_PER_SEC;
+        const size_t TIMEOUT_KILLS = atomic_load(&iwtc->timeout_kills);
+        BenchStopController(iwtc);
+
+        const double JOBS_PER_SEC = BENCH_WATCHDOG_JOBS / ELAPSED_SEC;
+        if (t == 0) baseline_jobs_per_sec = JOBS_PER_SEC;
+        JSONElement * result = JSONCreateObjectElement();
+        const bool RECORDED = IThreadJSONAddString(result, "timeout", NAMES[t]) &&
+            IThreadJSONAddNumber(result, "workers", workers) &&
+            IThreadJSONAddNumber(result, "jobs_per_sec", JOBS_PER_SEC) &&
+            IThreadJSONAddNumber(result, "overhead_percent", (baseline_jobs_per_sec / JOBS_PER_SEC - 1.0) * 100.0) &&
+            IThreadJSONAddNumber(result, "timeout_kills", TIMEOUT_KILLS) &&
+            JSONAddChildToElement(result, results);
+        if (!RECORDED) BenchFail("recording the watchdog results");
+        fprintf(stderr, "watchdog: %s, %.0f jobs/s\n", NAMES[t], JOBS_PER_SEC);
+    }
+    return results;
+}
+
+/// @brief Runs the controller benchmarks and writes the results as a single JSON object, so runs of different builds can be
+///         compared.  Progress goes to stderr.
+/// Usage: iworkerthreadcontrollerbench [max_threads] [output_file]  (defaults: online CPUs, /dev/stdout)
+int main(int argc, char ** argv)
+{
+    const long MAX_THREADS = argc > 1 && atol(argv[1]) > 0 ? atol(argv[1]) : sysconf(_SC_NPROCESSORS_ONLN);
+    char * filename = argc > 2 ? argv[2] : "/dev/stdout";
+
+    JSONElement * results = JSONCreateObjectElement();
+    const bool RECORDED = IThreadJSONAddString(results, "benchmark", "iworkerthreadcontroller") &&
+        IThreadJSONAddNumber(results, "timestamp", (double) time(NULL)) &&
+        IThreadJSONAddNumber(results, "cpus", sysconf(_SC_NPROCESSORS_ONLN)) &&
+        IThreadJSONAddNumber(results, "max_threads", MAX_THREADS) &&
+        IThreadJSONAddElement(results, "throughput", BenchThroughput(MAX_THREADS)) &&
+        IThreadJSONAddElement(results, "latency", BenchLatency(MAX_THREADS)) &&
+        IThreadJSONAddElement(results, "fairness", BenchFairness(MAX_THREADS)) &&
+        IThreadJSONAddElement(results, "watchdog", BenchWatchdog(MAX_THREADS));
+    if (!RECORDED) BenchFail("recording the results");
+
+    if (!JSONWriteElementToFile(results, filename)) BenchFail("writing the results");
+    JSONFreeElement(results);
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "ithread.h"
+#include "iworkerthreadjobqueue.h"
+
+#define BENCH_OPERATIONS_PER_THREAD 2000000
+#define BENCH_JOBS_PER_THREAD 64
+
+typedef struct _bench_thread_data {
+    IWorkerThreadJobQueue * queue;
+    IWorkerThreadJob * jobs[BENCH_JOBS_PER_THREAD];
+    pthread_barrier_t * barrier;
+} BenchThreadData;
+
+/// @brief Each benchmark thread is both a producer and a consumer.  It repeatedly enqueues one of its jobs and then dequeues
+///         whichever job is at the front of the shared queue, so every thread contends on both ends of the queue.
+static void * BenchThreadRun(void * data)
+{
+    BenchThreadData * btd = (BenchThreadData *) data;
+    pthread_barrier_wait(btd->barrier);
+    for (size_t o = 0; o < BENCH_OPERATIONS_PER_THREAD; o++) {
+        while (!IWorkerThreadJobQueueEnqueue(btd->queue, btd->jobs[o % BENCH_JOBS_PER_THREAD]));
+        while (!IWorkerThreadJobQueueDequeue(btd->queue));
+    }
+    return NULL;
+}
+
+static double BenchGetTimeSec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char ** argv)
+{
+    const long MAX_THREADS = argc > 1 ? atol(argv[1]) : sysconf(_SC_NPROCESSORS_ONLN);
+    void * job_data = &job_data;
+
+    printf("threads\tMops/s\tns/op\n");
+    for (long thread_count = 1; thread_count <= MAX_THREADS; thread_count++) {
+        IWorkerThreadJobQueue * iwtjq = IWorkerThreadJobQueueCreate(ITHREAD_DEFAULT_JOB_QUEUE_CAPACITY);
+        pthread_t handles[thread_count];
+        BenchThreadData thread_data[thread_count];
+        pthread_barrier_t barrier;
+        pthread_barrier_init(&barrier, NULL, thread_count + 1);
+
+        for (long t = 0; t < thread_count; t++) {
+            thread_data[t].queue = iwtjq;
+            thread_data[t].barrier = &barrier;
+            for (int j = 0; j < BENCH_JOBS_PER_THREAD; j++) thread_data[t].jobs[j] = IWorkerThreadJobCreate(job_data);
+            pthread_create(&handles[t], NULL, BenchThreadRun, &thread_data[t]);
+        }
+
+        // Release all threads at once and time how long it takes for every one of them to finish.
+        pthread_barrier_wait(&barrier);
+        const double START_TIME = BenchGetTimeSec();
+        for (long t = 0; t < thread_count; t++) pthread_join(handles[t], NULL);
+        const double ELAPSED_TIME = BenchGetTimeSec() - START_TIME;
+
+        // Each iteration is one enqueue and one dequeue.
+        const double OPERATIONS = 2.0 * BENCH_OPERATIONS_PER_THREAD * thread_count;
+        printf("%ld\t%.2f\t%.1f\n", thread_count, OPERATIONS / ELAPSED_TIME / 1e6, ELAPSED_TIME * 1e9 / OPERATIONS);
+
+        for (long t = 0; t < thread_count; t++) {
+            for (int j = 0; j < BENCH_JOBS_PER_THREAD; j++) IWorkerThreadJobFree(thread_data[t].jobs[j]);
+        }
+        pthread_barrier_destroy(&barrier);
+        IWorkerThreadJobQueueFree(iwtjq);
+    }
+    exit(EXIT_SUCCESS);
+}
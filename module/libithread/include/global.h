@@ -3,6 +3,7 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <time.h>
 
 #include "ithreadstate.h"
@@ -23,6 +24,11 @@ typedef struct _iworker_thread_job_provider IWorkerThreadJobProvider;
 #define IThreadTimeoutNone 0
 #define IThreadTimeoutSmart -1
 
+#define IThreadWaitForever -1
+
+#define ITHREAD_NS_PER_SEC 1000000000ULL
+
 void IThreadSleep(long milliseconds);
+uint64_t IThreadGetTimeNs();
 
 #endif
\ No newline at end of file
@@ -9,7 +9,21 @@
 #include "iworkerthreadcontroller.h"
 #include "iworkerthread.h"
 #include "iworkerthreadjob.h"
+#include "iworkerthreadjobfuture.h"
+#include "iworkerthreadjobgraph.h"
+#include "iworkerthreadnamedqueue.h"
+#include "ithreadparallel.h"
+#include "ithreadhistogram.h"
+#include "ithreadtopology.h"
+#include "ithreadtimerwheel.h"
+#include "ithreaddeadlineheap.h"
+#include "ithreadarena.h"
+#include "ithreadtrace.h"
+#include "iworkerthreadcompletionqueue.h"
+#include "iworkerthreadstrand.h"
+#include "iworkerthreadcontrollerstats.h"
 
 #define ITHREAD_DEFAULT_TIMEOUT_SEC 30
+#define ITHREAD_SMART_TIMEOUT_MIN_MS 100
 
 #endif
\ No newline at end of file
@@ -0,0 +1,37 @@
+#ifndef COM_PLUS_MEVANSPN_ITHREAD_ARENA
+#define COM_PLUS_MEVANSPN_ITHREAD_ARENA
+
+#include "global.h"
+
+#define ITHREAD_ARENA_DEFAULT_BLOCK_SIZE (64 * 1024)
+// Every allocation is aligned to this, which suits any standard type.
+#define ITHREAD_ARENA_ALIGNMENT 16
+
+// A worker thread empties its arena as soon as it finishes with a job, which with a completion queue is before the job's callback
+// has run, so nothing that outlives the job (such as its result) may be allocated from it.
+
+typedef struct _ithread_arena_block {
+    struct _ithread_arena_block * next;
+    size_t size;
+    size_t used;
+} IThreadArenaBlock;
+
+typedef struct _ithread_arena {
+    int struct_id;
+    IThreadArenaBlock * blocks;
+    size_t block_size;
+    size_t capacity;
+    size_t used;
+    size_t high_watermark;
+} IThreadArena;
+
+IThreadArena * IThreadArenaCreate(size_t block_size);
+bool IThreadArenaIsValid(IThreadArena * ita);
+void * IThreadArenaAlloc(IThreadArena * ita, size_t size);
+void * IThreadArenaCalloc(IThreadArena * ita, size_t count, size_t size);
+void IThreadArenaReset(IThreadArena * ita);
+size_t IThreadArenaGetUsed(IThreadArena * ita);
+size_t IThreadArenaGetCapacity(IThreadArena * ita);
+void IThreadArenaFree(IThreadArena * ita);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef COM_PLUS_MEVANSPN_ITHREAD_DEADLINE_HEAP
+#define COM_PLUS_MEVANSPN_ITHREAD_DEADLINE_HEAP
+
+#include "global.h"
+
+#define ITHREAD_DEADLINE_HEAP_INITIAL_CAPACITY 16
+
+typedef struct _ithread_deadline {
+    uint64_t deadline_ns;
+    void * data;
+} IThreadDeadline;
+
+typedef struct _ithread_deadline_heap {
+    int struct_id;
+    IThreadDeadline * deadlines;
+    size_t count;
+    size_t capacity;
+} IThreadDeadlineHeap;
+
+IThreadDeadlineHeap * IThreadDeadlineHeapCreate();
+bool IThreadDeadlineHeapIsValid(IThreadDeadlineHeap * itdh);
+bool IThreadDeadlineHeapPush(IThreadDeadlineHeap * itdh, uint64_t deadline_ns, void * data);
+uint64_t IThreadDeadlineHeapPeek(IThreadDeadlineHeap * itdh);
+bool IThreadDeadlineHeapPop(IThreadDeadlineHeap * itdh, IThreadDeadline * deadline);
+size_t IThreadDeadlineHeapGetCount(IThreadDeadlineHeap * itdh);
+void IThreadDeadlineHeapFree(IThreadDeadlineHeap * itdh);
+
+#endif
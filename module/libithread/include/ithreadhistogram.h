@@ -0,0 +1,36 @@
+#ifndef COM_PLUS_MEVANSPN_ITHREAD_HISTOGRAM
+#define COM_PLUS_MEVANSPN_ITHREAD_HISTOGRAM
+
+#include <stdatomic.h>
+
+#include "global.h"
+
+// Each power of two range of values is split into 2^ITHREAD_HISTOGRAM_SUB_BUCKET_BITS linear sub-buckets, so a recorded value is
+// reported to within 1/32 (~3%) of its true value, whatever its magnitude.
+#define ITHREAD_HISTOGRAM_SUB_BUCKET_BITS 5
+#define ITHREAD_HISTOGRAM_SUB_BUCKETS (1 << ITHREAD_HISTOGRAM_SUB_BUCKET_BITS)
+#define ITHREAD_HISTOGRAM_BUCKETS ((64 - ITHREAD_HISTOGRAM_SUB_BUCKET_BITS + 1) * ITHREAD_HISTOGRAM_SUB_BUCKETS)
+
+typedef struct _ithread_histogram {
+    int struct_id;
+    _Atomic(uint64_t) total_count;
+    _Atomic(uint64_t) total_value;
+    _Atomic(uint64_t) min_value;
+    _Atomic(uint64_t) max_value;
+    _Atomic(uint64_t) counts[ITHREAD_HISTOGRAM_BUCKETS];
+} IThreadHistogram;
+
+IThreadHistogram * IThreadHistogramCreate();
+bool IThreadHistogramIsValid(IThreadHistogram * ith);
+void IThreadHistogramRecord(IThreadHistogram * ith, uint64_t value);
+void IThreadHistogramRecordConcurrent(IThreadHistogram * ith, uint64_t value);
+bool IThreadHistogramMerge(IThreadHistogram * destination, IThreadHistogram * source);
+void IThreadHistogramReset(IThreadHistogram * ith);
+uint64_t IThreadHistogramGetPercentile(IThreadHistogram * ith, double percentile);
+uint64_t IThreadHistogramGetCount(IThreadHistogram * ith);
+uint64_t IThreadHistogramGetMean(IThreadHistogram * ith);
+uint64_t IThreadHistogramGetMin(IThreadHistogram * ith);
+uint64_t IThreadHistogramGetMax(IThreadHistogram * ith);
+void IThreadHistogramFree(IThreadHistogram * ith);
+
+#endif
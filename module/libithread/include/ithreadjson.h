@@ -0,0 +1,12 @@
+#ifndef COM_PLUS_MEVANSPN_ITHREAD_JSON
+#define COM_PLUS_MEVANSPN_ITHREAD_JSON
+
+#include "libjson.h"
+
+#include "global.h"
+
+bool IThreadJSONAddElement(JSONElement * object, char * name, JSONElement * element);
+bool IThreadJSONAddNumber(JSONElement * object, char * name, double value);
+bool IThreadJSONAddString(JSONElement * object, char * name, char * value);
+
+#endif
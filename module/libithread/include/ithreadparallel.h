@@ -0,0 +1,43 @@
+#ifndef COM_PLUS_MEVANSPN_ITHREAD_PARALLEL
+#define COM_PLUS_MEVANSPN_ITHREAD_PARALLEL
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "global.h"
+
+// Each participant takes 1/ITHREAD_PARALLEL_CHUNK_DIVISOR of its share of the remaining iterations at a time, so chunks start
+// large and shrink towards the grain size as the loop nears its end (guided scheduling).
+#define ITHREAD_PARALLEL_CHUNK_DIVISOR 2
+
+typedef void (* IThreadParallelForFunction)(size_t begin, size_t end, void * context);
+typedef void (* IThreadParallelReduceFunction)(size_t begin, size_t end, void * partial, void * context);
+typedef void (* IThreadParallelCombineFunction)(void * result, const void * partial, void * context);
+
+typedef struct _ithread_parallel_loop {
+    int struct_id;
+    _Atomic(size_t) next;
+    size_t end;
+    size_t grain;
+    size_t participants;
+    _Atomic(size_t) iterations_done;
+    size_t iterations_count;
+    IThreadParallelForFunction forFunction;
+    IThreadParallelReduceFunction reduceFunction;
+    IThreadParallelCombineFunction combineFunction;
+    void * context;
+    void * result;
+    size_t result_size;
+    const void * identity;
+    atomic_int references;
+    pthread_mutex_t lock;
+    pthread_cond_t done_condition;
+} IThreadParallelLoop;
+
+bool IThreadParallelFor(IWorkerThreadController * iwtc, size_t begin, size_t end, size_t grain, IThreadParallelForFunction function,
+                        void * context);
+bool IThreadParallelReduce(IWorkerThreadController * iwtc, size_t begin, size_t end, size_t grain, IThreadParallelReduceFunction function,
+                           IThreadParallelCombineFunction combine, const void * identity, void * result, size_t result_size,
+                           void * context);
+
+#endif
@@ -2,10 +2,14 @@
 #define COM_PLUS_MEVANSPN_ITHREAD_PRIORITY
 
 typedef enum _ithread_priority {
+    IThreadPriorityLow = 0,         // Bulk work, taken only when nothing else is waiting (or once it has aged).
     IThreadPriorityNormal = 1,
     IThreadPriorityHigh = 2,
     IThreadPriorityHighest = 3,
-    IThreadPriorityNone = 0
+    IThreadPriorityNone = -1
 } IThreadPriority;
 
+#define ITHREAD_PRIORITY_LEVELS 4
+#define ITHREAD_DEFAULT_PRIORITY_AGING_MS 100
+
 #endif
\ No newline at end of file
@@ -10,7 +10,8 @@ typedef enum _ithread_state {
     IThreadStateKillRequested, 
     IThreadStateKilled,
     IThreadStateKilledNoResponse,
-    IThreadStateDone
+    IThreadStateDone,
+    IThreadStateParked      // Not running, but able to be restarted by an autoscaling controller (so not done either).
 } IThreadState;
 
 #endif
\ No newline at end of file
@@ -0,0 +1,52 @@
+#ifndef COM_PLUS_MEVANSPN_ITHREAD_TIMER_WHEEL
+#define COM_PLUS_MEVANSPN_ITHREAD_TIMER_WHEEL
+
+#include <stdatomic.h>
+
+#include "global.h"
+
+// Timers fire on the first tick at or after their expiry time, so a tick is the timer resolution.
+#define ITHREAD_TIMER_WHEEL_TICK_MS 10
+// The root level has a slot for each of the next 2^ITHREAD_TIMER_WHEEL_ROOT_BITS ticks.  Each of the levels above it has
+// 2^ITHREAD_TIMER_WHEEL_LEVEL_BITS slots, each covering as many ticks as the whole of the level below.  With 10ms ticks, 8 + 4 * 6
+// bits covers about 497 days; timers further out than that are parked in the top level until they come into range.
+#define ITHREAD_TIMER_WHEEL_ROOT_BITS 8
+#define ITHREAD_TIMER_WHEEL_LEVEL_BITS 6
+#define ITHREAD_TIMER_WHEEL_LEVELS 4
+#define ITHREAD_TIMER_WHEEL_ROOT_SLOTS (1 << ITHREAD_TIMER_WHEEL_ROOT_BITS)
+#define ITHREAD_TIMER_WHEEL_LEVEL_SLOTS (1 << ITHREAD_TIMER_WHEEL_LEVEL_BITS)
+
+typedef struct _ithread_timer {
+    uint64_t expiry_ns;
+    uint64_t period_ns;
+    void * data;
+    IWorkerThreadJob * job;
+    atomic_bool cancelled;
+    uint64_t tick;
+    struct _ithread_timer * next;
+} IThreadTimer;
+
+typedef struct _ithread_timer_wheel {
+    int struct_id;
+    uint64_t start_ns;
+    uint64_t tick_ns;
+    uint64_t current_tick;
+    size_t timers_count;
+    IThreadTimer * root[ITHREAD_TIMER_WHEEL_ROOT_SLOTS];
+    IThreadTimer * levels[ITHREAD_TIMER_WHEEL_LEVELS][ITHREAD_TIMER_WHEEL_LEVEL_SLOTS];
+} IThreadTimerWheel;
+
+typedef void (* IThreadTimerExpiredFunction)(IThreadTimer * timer, void * context);
+
+IThreadTimer * IThreadTimerCreate(void * data, uint64_t expiry_ns, uint64_t period_ns);
+void IThreadTimerFree(IThreadTimer * itt);
+IThreadTimerWheel * IThreadTimerWheelCreate(uint64_t start_ns, long tick_ms);
+bool IThreadTimerWheelIsValid(IThreadTimerWheel * ittw);
+bool IThreadTimerWheelAdd(IThreadTimerWheel * ittw, IThreadTimer * itt);
+size_t IThreadTimerWheelAdvance(IThreadTimerWheel * ittw, uint64_t now_ns, IThreadTimerExpiredFunction expired, void * context);
+uint64_t IThreadTimerWheelGetNextExpiry(IThreadTimerWheel * ittw);
+size_t IThreadTimerWheelGetCount(IThreadTimerWheel * ittw);
+void IThreadTimerWheelClear(IThreadTimerWheel * ittw, IThreadTimerExpiredFunction discard, void * context);
+void IThreadTimerWheelFree(IThreadTimerWheel * ittw);
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef COM_PLUS_MEVANSPN_ITHREAD_TOPOLOGY
+#define COM_PLUS_MEVANSPN_ITHREAD_TOPOLOGY
+
+#include "global.h"
+
+typedef struct _ithread_cpu_topology {
+    int struct_id;
+    int cpus_count;
+    int * cpu_nodes;
+    int * cpu_cores;
+    int nodes_count;
+} IThreadCpuTopology;
+
+IThreadCpuTopology * IThreadCpuTopologyCreate();
+bool IThreadCpuTopologyIsValid(IThreadCpuTopology * itct);
+int IThreadCpuTopologyGetNode(IThreadCpuTopology * itct, int cpu);
+size_t IThreadCpuTopologyGetPhysicalCoreCpus(IThreadCpuTopology * itct, int * cpus, size_t cpus_size);
+int IThreadGetCurrentCpu();
+void IThreadCpuTopologyFree(IThreadCpuTopology * itct);
+
+#endif
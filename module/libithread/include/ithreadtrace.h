@@ -0,0 +1,35 @@
+#ifndef COM_PLUS_MEVANSPN_ITHREAD_TRACE
+#define COM_PLUS_MEVANSPN_ITHREAD_TRACE
+
+#include <stdatomic.h>
+
+#include "global.h"
+
+// Events each worker thread can record before further events are dropped (when tracing is enabled without a capacity).
+#define ITHREAD_TRACE_DEFAULT_CAPACITY 65536
+
+typedef struct _ithread_trace_event {
+    size_t job_id;
+    uint64_t enqueue_time_ns;
+    uint64_t start_time_ns;
+    uint64_t end_time_ns;
+    int attempt;
+    bool failed;
+} IThreadTraceEvent;
+
+typedef struct _ithread_trace_buffer {
+    int struct_id;
+    IThreadTraceEvent * events;
+    size_t capacity;
+    _Atomic(size_t) count;
+    _Atomic(size_t) dropped_count;
+} IThreadTraceBuffer;
+
+IThreadTraceBuffer * IThreadTraceBufferCreate(size_t capacity);
+bool IThreadTraceBufferIsValid(IThreadTraceBuffer * ittb);
+bool IThreadTraceBufferRecord(IThreadTraceBuffer * ittb, IWorkerThreadJob * iwtj);
+size_t IThreadTraceBufferGetCount(IThreadTraceBuffer * ittb);
+size_t IThreadTraceBufferGetDroppedCount(IThreadTraceBuffer * ittb);
+void IThreadTraceBufferFree(IThreadTraceBuffer * ittb);
+
+#endif
@@ -2,25 +2,58 @@
 #define COM_PLUS_MEVANSPN_ITHREAD_WORKER_THREAD
 
 #include <pthread.h>
+#include <stdatomic.h>
 
 #include "global.h"
+#include "iworkerthreadjobdeque.h"
+#include "ithreadhistogram.h"
+#include "ithreadtrace.h"
+#include "ithreadarena.h"
+
+// The job a worker thread is running, as its controller's watchdog sees it (see IWorkerThreadControllerWatchJob()): a number
+// that is different for each job the worker runs, shifted up past these flags.
+#define ITHREAD_WATCHDOG_JOB_DEADLINE 1     // The watchdog's deadline is the job's own (see IWorkerThreadJobSetDeadline()).
+#define ITHREAD_WATCHDOG_JOB_CANCELLED 2    // The watchdog has cancelled the job.
+#define ITHREAD_WATCHDOG_JOB_SHIFT 2
 
 typedef struct _iworker_thread {
     int struct_id;
     int id;
     pthread_t handle;
-    IThreadState state;
+    _Atomic(IThreadState) state;
     IThreadPriority priority;
     void (* threadMainFunction)(struct _iworker_thread_job *);
     void (*jobSuccessCallbackFunction)(struct _iworker_thread_job *);
     void (*jobFailureCallbackFunction)(struct _iworker_thread_job *);
     time_t start_time, end_time;
-    time_t job_run_time_history[10];
+    uint64_t job_run_time_history[10];
     IWorkerThreadJob * current_job;
-    size_t jobs_run;
+    _Atomic(size_t) jobs_run;
+    _Atomic(size_t) jobs_failed;
+    _Atomic(size_t) jobs_retried;
+    _Atomic(size_t) jobs_yielded;
+    _Atomic(uint64_t) busy_time_ns;
+    _Atomic(uint64_t) busy_since_ns;
+    _Atomic(uint64_t) idle_since_ns;
     bool flag_exit_on_no_jobs;
     struct _iworker_thread_controller * controller;
     IThreadTimeout timeout;
+    long timeout_ms;
+    IWorkerThreadJobDeque * deque;
+    unsigned int steal_seed;
+    int cpu;
+    int numa_node;
+    IThreadHistogram * wait_time_histogram;
+    IThreadHistogram * run_time_histogram;
+    _Atomic(IThreadTraceBuffer *) trace_buffer;
+    _Atomic(uint64_t) watchdog_deadline_ns;
+    _Atomic(uint64_t) watchdog_job;
+    uint64_t watchdog_jobs_count;
+    _Atomic(uint64_t) watchdog_known_ns;
+    atomic_bool watchdog_queued;
+    struct _iworker_thread * watchdog_next;
+    void * context;
+    IThreadArena * arena;
 } IWorkerThread;
 
 void * IWorkerThreadRun(void * data);
@@ -28,11 +61,21 @@ IWorkerThread * IWorkerThreadCreate(  void (* workFunction)(IWorkerThreadJob *),
                                 void (*successFunction)(IWorkerThreadJob *),
                                 void (*failureFunction)(IWorkerThreadJob *),
                                 IWorkerThreadController * itc);
-time_t IWorkerThreadGetAverageJobTime(IWorkerThread * itd);
+uint64_t IWorkerThreadGetAverageJobTime(IWorkerThread * itd);
+bool IWorkerThreadSetTimeoutMs(IWorkerThread * iwt, long timeout_ms);
+uint64_t IWorkerThreadGetWatchdogDeadline(IWorkerThread * iwt, IWorkerThreadJob * iwtj);
+const char * IWorkerThreadGetWatchdogCancelReason(IWorkerThread * iwt, IWorkerThreadJob * iwtj);
+uint64_t IWorkerThreadGetWaitTimePercentile(IWorkerThread * iwt, double percentile);
+uint64_t IWorkerThreadGetRunTimePercentile(IWorkerThread * iwt, double percentile);
 bool IWorkerThreadDone(IWorkerThread * iwt);
 bool IWorkerThreadFree(IWorkerThread * itd);
+void IWorkerThreadStop(IWorkerThread * iwt);
+void IWorkerThreadKill(IWorkerThread * iwt);
 void IWorkerThreadWaitForJobs(IWorkerThread * iwt, bool flag_wait_for_jobs);
 int IWorkerThreadGetId(IWorkerThread * iwt);
+IWorkerThread * IWorkerThreadGetCurrent();
+void * IWorkerThreadGetContext(IWorkerThread * iwt);
+IThreadArena * IWorkerThreadGetArena(IWorkerThread * iwt);
 bool IWorkerThreadIsValid(IWorkerThread * iwt);
 
 #endif
\ No newline at end of file
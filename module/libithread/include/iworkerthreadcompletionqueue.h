@@ -0,0 +1,26 @@
+#ifndef COM_PLUS_MEVANSPN_ITHREAD_WORKER_THREAD_COMPLETION_QUEUE
+#define COM_PLUS_MEVANSPN_ITHREAD_WORKER_THREAD_COMPLETION_QUEUE
+
+#include <stdatomic.h>
+
+#include "global.h"
+
+// Jobs are pushed after their worker has moved on and emptied its arena, so a queued job's result must not point into the arena.
+
+typedef struct _iworker_thread_completion_queue {
+    int struct_id;
+    _Atomic(IWorkerThreadJob *) inbox;
+    IWorkerThreadJob * drain_head;
+    _Atomic(size_t) count;
+    int event_fd;
+} IWorkerThreadCompletionQueue;
+
+IWorkerThreadCompletionQueue * IWorkerThreadCompletionQueueCreate();
+bool IWorkerThreadCompletionQueueIsValid(IWorkerThreadCompletionQueue * iwtcq);
+void IWorkerThreadCompletionQueuePush(IWorkerThreadCompletionQueue * iwtcq, IWorkerThreadJob * iwtj);
+size_t IWorkerThreadCompletionQueuePop(IWorkerThreadCompletionQueue * iwtcq, IWorkerThreadJob ** jobs, size_t max_jobs);
+size_t IWorkerThreadCompletionQueueGetCount(IWorkerThreadCompletionQueue * iwtcq);
+int IWorkerThreadCompletionQueueGetFd(IWorkerThreadCompletionQueue * iwtcq);
+void IWorkerThreadCompletionQueueFree(IWorkerThreadCompletionQueue * iwtcq);
+
+#endif
@@ -2,18 +2,59 @@
 #define COM_PLUS_MEVANSPN_ITHREAD_WORKER_THREAD_CONTROLLER
 
 #include <pthread.h>
+#include <stdatomic.h>
 
 #include "global.h"
 #include "iworkerthreadjobprovider.h"
+#include "iworkerthreadjobfuture.h"
+#include "ithreadtopology.h"
+#include "ithreadtimerwheel.h"
+#include "ithreaddeadlineheap.h"
+#include "iworkerthreadcompletionqueue.h"
+#include "iworkerthreadstrand.h"
+
+#define ITHREAD_AUTOSCALE_PERIOD_MS 50
+#define ITHREAD_CONTROLLER_PERIOD_MS 20
+// Longest the controller thread waits for its workers to exit when stopped (IWorkerThreadControllerStop() then waits as long again
+// for any it left behind).
+#define ITHREAD_CONTROLLER_STOP_TIMEOUT_SEC 5
+// Longest a caller outside the worker threads waits for room to hand the next job of a strand on to the job queues.  The job has
+// already been accepted, so it is failed if there is still no room by then (see IWorkerThreadControllerAddKeyedJob()).
+#define ITHREAD_CONTROLLER_STRAND_WAIT_MS 1000
 
 typedef struct _iworker_thread_controller {
     int struct_id;
     struct _iworker_thread ** threads;
     int threads_count;
     int threads_buffer_size;
-    bool stop, running;
+    atomic_bool stop, running;
+    atomic_bool started;
     pthread_t handle;
     IWorkerThreadJobProvider * job_provider;
+    uint64_t start_time_ns;
+    _Atomic(size_t) timeout_kills;
+    bool autoscale;
+    int min_threads, max_threads;
+    uint64_t autoscale_target_wait_ns;
+    uint64_t autoscale_idle_grace_ns;
+    uint64_t autoscale_last_change_ns;
+    IThreadCpuTopology * topology;
+    int * affinity_cpus;
+    size_t affinity_cpus_count;
+    IThreadTimerWheel * timer_wheel;
+    _Atomic(IThreadTimer *) timer_inbox;
+    _Atomic(size_t) paused_jobs;
+    atomic_bool tracing;
+    size_t trace_capacity;
+    _Atomic(IWorkerThreadCompletionQueue *) completion_queue;
+    atomic_bool completion_queue_enabled;
+    IThreadDeadlineHeap * watchdog_deadlines;
+    _Atomic(struct _iworker_thread *) watchdog_inbox;
+    int epoll_fd, timer_fd, wake_fd;
+    void * (* worker_init_function)(struct _iworker_thread *, void *);
+    void (* worker_teardown_function)(struct _iworker_thread *, void *);
+    void * worker_hook_data;
+    _Atomic(IWorkerThreadStrandSet *) strands;
 } IWorkerThreadController;
 
 IWorkerThreadController * IWorkerThreadControllerCreate();
@@ -26,8 +67,52 @@ IWorkerThread * IWorkerThreadControllerAddWorkerThread(IWorkerThreadController *
                                                     IThreadTimeout timeout);
 bool IWorkerThreadControllerChildThreadsDone(IWorkerThreadController * itc);
 bool IWorkerThreadControllerStart(IWorkerThreadController * itc);
-void IWorkerThreadControllerStop(IWorkerThreadController * itc);
+bool IWorkerThreadControllerStop(IWorkerThreadController * itc);
 bool IWorkerThreadControllerIsRunning(IWorkerThreadController * itc);
 bool IWorkerThreadControllerIsValid(IWorkerThreadController * iwtc);
+void IWorkerThreadControllerWake(IWorkerThreadController * iwtc);
+void IWorkerThreadControllerWatchJob(IWorkerThreadController * iwtc, IWorkerThread * iwt, IWorkerThreadJob * iwtj);
+bool IWorkerThreadControllerQueueJob(IWorkerThreadController * iwtc, IWorkerThreadJob * iwtj);
 bool IWorkerThreadControllerAddJob(IWorkerThreadController * iwtc, void * job_data);
+bool IWorkerThreadControllerTryAddJob(IWorkerThreadController * iwtc, void * job_data);
+bool IWorkerThreadControllerAddJobBlocking(IWorkerThreadController * iwtc, void * job_data);
+bool IWorkerThreadControllerAddJobTimed(IWorkerThreadController * iwtc, void * job_data, long timeout_ms);
+bool IWorkerThreadControllerAddJobWithRetry(IWorkerThreadController * iwtc, void * job_data, int max_attempts, long base_delay_ms,
+                                            double jitter);
+IWorkerThreadNamedQueue * IWorkerThreadControllerAddQueue(IWorkerThreadController * iwtc, const char * name, unsigned int weight);
+IWorkerThreadNamedQueue * IWorkerThreadControllerGetQueue(IWorkerThreadController * iwtc, const char * name);
+bool IWorkerThreadControllerAddQueueJob(IWorkerThreadController * iwtc, IWorkerThreadNamedQueue * queue, void * job_data);
+bool IWorkerThreadControllerAddKeyedJob(IWorkerThreadController * iwtc, uint64_t key, void * job_data);
+void IWorkerThreadControllerReleaseStrand(IWorkerThreadController * iwtc, IWorkerThreadStrand * strand);
+// AddJobs adds as much of the batch as fits within the capacity (see IWorkerThreadControllerSetCapacity()) and returns how many
+// it added, from the start of job_data; the rest still belongs to the caller.  AddJobsBlocking waits for room and adds them all.
+size_t IWorkerThreadControllerAddJobs(IWorkerThreadController * iwtc, void ** job_data, size_t jobs_count);
+size_t IWorkerThreadControllerAddJobsBlocking(IWorkerThreadController * iwtc, void ** job_data, size_t jobs_count);
+bool IWorkerThreadControllerAddJobWithPriority(IWorkerThreadController * iwtc, void * job_data, IThreadPriority priority);
+IWorkerThreadJobFuture * IWorkerThreadControllerSubmitJob(IWorkerThreadController * iwtc, void * job_data, IThreadPriority priority);
+bool IWorkerThreadControllerAddJobWithDeadline(IWorkerThreadController * iwtc, void * job_data, IThreadPriority priority, long timeout_ms);
+IWorkerThreadJobFuture * IWorkerThreadControllerSubmitJobWithDeadline(IWorkerThreadController * iwtc, void * job_data,
+                                                                    IThreadPriority priority, long timeout_ms);
+bool IWorkerThreadControllerScheduleJob(IWorkerThreadController * iwtc, void * job_data, long delay_ms);
+IThreadTimer * IWorkerThreadControllerScheduleRecurringJob(IWorkerThreadController * iwtc, void * job_data, long delay_ms, long period_ms);
+bool IWorkerThreadControllerCancelScheduledJob(IWorkerThreadController * iwtc, IThreadTimer * timer);
+bool IWorkerThreadControllerRetryJob(IWorkerThreadController * iwtc, IWorkerThreadJob * iwtj);
+bool IWorkerThreadControllerParkJob(IWorkerThreadController * iwtc, IWorkerThreadJob * iwtj);
+bool IWorkerThreadControllerResumeJob(IWorkerThreadController * iwtc, IWorkerThreadJob * iwtj);
+void IWorkerThreadControllerSetCapacity(IWorkerThreadController * iwtc, size_t capacity);
+bool IWorkerThreadControllerSetCompletionQueue(IWorkerThreadController * iwtc, bool enabled);
+int IWorkerThreadControllerGetCompletionFd(IWorkerThreadController * iwtc);
+size_t IWorkerThreadControllerDrainCompletedJobs(IWorkerThreadController * iwtc, size_t max_jobs);
+bool IWorkerThreadControllerSetWorkerHooks(IWorkerThreadController * iwtc, void * (* initFunction)(IWorkerThread *, void *),
+                                            void (* teardownFunction)(IWorkerThread *, void *), void * data);
+bool IWorkerThreadControllerSetTracing(IWorkerThreadController * iwtc, bool enabled, size_t events_per_worker);
+void IWorkerThreadControllerSetPriorityAging(IWorkerThreadController * iwtc, long milliseconds);
+bool IWorkerThreadControllerSetAutoscaling(IWorkerThreadController * iwtc, int min_threads, int max_threads, long target_wait_ms,
+                                            long idle_grace_ms);
+bool IWorkerThreadControllerSetCpuAffinity(IWorkerThreadController * iwtc, const int * cpus, size_t cpus_count);
+bool IWorkerThreadControllerSetCpuAffinityPerCore(IWorkerThreadController * iwtc);
+bool IWorkerThreadControllerSetNumaPartitioning(IWorkerThreadController * iwtc, bool enabled);
+int IWorkerThreadControllerGetWorkerCount(IWorkerThreadController * iwtc);
+uint64_t IWorkerThreadControllerGetWaitTimePercentile(IWorkerThreadController * iwtc, double percentile);
+uint64_t IWorkerThreadControllerGetRunTimePercentile(IWorkerThreadController * iwtc, double percentile);
 #endif
\ No newline at end of file
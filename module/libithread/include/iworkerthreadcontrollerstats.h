@@ -0,0 +1,69 @@
+#ifndef COM_PLUS_MEVANSPN_ITHREAD_WORKER_THREAD_CONTROLLER_STATS
+#define COM_PLUS_MEVANSPN_ITHREAD_WORKER_THREAD_CONTROLLER_STATS
+
+#include "global.h"
+#include "iworkerthreadcontroller.h"
+
+typedef struct _iworker_thread_stats {
+    int id;
+    IThreadState state;
+    bool busy;
+    size_t jobs_run;
+    size_t jobs_failed;
+    size_t jobs_retried;
+    size_t jobs_yielded;
+    uint64_t busy_time_ns;
+    double busy_ratio;
+    int cpu;
+    int numa_node;
+} IWorkerThreadStats;
+
+typedef struct _iworker_thread_queue_stats {
+    char name[ITHREAD_NAMED_QUEUE_NAME_LENGTH];
+    unsigned int weight;
+    size_t depth;
+    size_t enqueued;
+    size_t dequeued;
+    double dequeue_rate;
+    uint64_t wait_time_p50_ns, wait_time_p99_ns;
+} IWorkerThreadQueueStats;
+
+typedef struct _iworker_thread_controller_stats {
+    int struct_id;
+    uint64_t timestamp_ns;
+    uint64_t interval_ns;
+    size_t pending_jobs;
+    size_t running_jobs;
+    size_t done_jobs;
+    size_t failed_jobs;
+    size_t retried_jobs;
+    size_t yielded_jobs;
+    size_t paused_jobs;
+    size_t completed_jobs_pending;
+    size_t keyed_jobs_pending;
+    size_t enqueued_jobs;
+    size_t dequeued_jobs;
+    double enqueue_rate;
+    double dequeue_rate;
+    size_t timeout_kills;
+    size_t queue_capacity;
+    size_t queue_high_watermark;
+    size_t rejected_jobs;
+    uint64_t wait_time_p50_ns, wait_time_p99_ns, wait_time_p999_ns;
+    uint64_t run_time_p50_ns, run_time_p99_ns, run_time_p999_ns;
+    IWorkerThreadStats * workers;
+    size_t workers_count;
+    size_t workers_running;
+    size_t workers_buffer_size;
+    IWorkerThreadQueueStats * queues;
+    size_t queues_count;
+    size_t queues_buffer_size;
+    int numa_nodes;
+} IWorkerThreadControllerStats;
+
+IWorkerThreadControllerStats * IWorkerThreadControllerStatsCreate();
+bool IWorkerThreadControllerStatsIsValid(IWorkerThreadControllerStats * iwtcs);
+bool IWorkerThreadControllerGetStats(IWorkerThreadController * iwtc, IWorkerThreadControllerStats * iwtcs);
+void IWorkerThreadControllerStatsFree(IWorkerThreadControllerStats * iwtcs);
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef COM_PLUS_MEVANSPN_ITHREAD_WORKER_THREAD_CONTROLLER_STATS_JSON
+#define COM_PLUS_MEVANSPN_ITHREAD_WORKER_THREAD_CONTROLLER_STATS_JSON
+
+#include "libjson.h"
+
+#include "iworkerthreadcontrollerstats.h"
+
+JSONElement * IWorkerThreadControllerStatsToJSON(IWorkerThreadControllerStats * iwtcs);
+bool IWorkerThreadControllerStatsWriteJSON(IWorkerThreadControllerStats * iwtcs, char * filename);
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef COM_PLUS_MEVANSPN_ITHREAD_WORKER_THREAD_CONTROLLER_TRACE_JSON
+#define COM_PLUS_MEVANSPN_ITHREAD_WORKER_THREAD_CONTROLLER_TRACE_JSON
+
+#include "libjson.h"
+
+#include "iworkerthreadcontroller.h"
+
+JSONElement * IWorkerThreadControllerTraceToJSON(IWorkerThreadController * iwtc);
+bool IWorkerThreadControllerTraceWriteJSON(IWorkerThreadController * iwtc, char * filename);
+
+#endif
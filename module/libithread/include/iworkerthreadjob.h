@@ -1,26 +1,84 @@
 #ifndef COM_PLUS_MEVANSPN_ITHREAD_WORKER_THREAD_JOB
 #define COM_PLUS_MEVANSPN_ITHREAD_WORKER_THREAD_JOB
 
+#include <stdatomic.h>
+
 #include "global.h"
 #include "ithreadjobstate.h"
+#include "ithreadpriority.h"
+
+#define ITHREAD_JOB_CANCELLED_MESSAGE "Job cancelled."
+#define ITHREAD_JOB_DEADLINE_MESSAGE "Job deadline exceeded."
+#define ITHREAD_JOB_TIMEOUT_MESSAGE "Job cancelled due to timeout."
+
+// However many attempts a job has had, it never waits longer than this before its next one.
+#define ITHREAD_JOB_RETRY_MAX_DELAY_MS 60000
+
+// Where a yielding job is in the hand over between the worker thread parking it and whoever resumes it (see
+// IWorkerThreadControllerParkJob()).
+#define ITHREAD_JOB_PARK_NONE 0
+#define ITHREAD_JOB_PARK_PARKED 1
+#define ITHREAD_JOB_PARK_WAKE_PENDING 2
 
 typedef struct _iworker_thread_job {
     int struct_id;
     size_t id;
-    time_t start_time;
-    time_t end_time;
-    IThreadJobState state;
+    uint64_t enqueue_time_ns;
+    uint64_t start_time_ns;
+    uint64_t end_time_ns;
+    uint64_t deadline_ns;
+    int attempts;
+    int max_attempts;
+    uint64_t retry_delay_ns;
+    double retry_jitter;
+    int step;
+    bool yield_requested;
+    bool resuming;
+    _Atomic(int) park_state;
+    _Atomic(const char *) cancel_reason;
+    _Atomic(IThreadJobState) state;
+    IThreadPriority priority;
     void * data;
+    void * result;
+    void (* function)(struct _iworker_thread_job *);
+    struct _iworker_thread_job_future * future;
+    struct _iworker_thread_job_graph_node * graph_node;
+    struct _iworker_thread_named_queue * named_queue;
+    struct _iworker_thread_strand * strand;
     struct _iworker_thread_job * next_job;
     char * failure_message;
-    struct _iworker_thread * worker_thread;
+    _Atomic(struct _iworker_thread *) worker_thread;
+    struct _iworker_thread_job_pool * pool;
+    uint32_t pool_index;
+    _Atomic(uint32_t) pool_next;
 } IWorkerThreadJob;
 
 IWorkerThreadJob * IWorkerThreadJobCreate(void * data);
+void IWorkerThreadJobReset(IWorkerThreadJob * iwtj, void * data);
 void IWorkerThreadJobFailed(IWorkerThreadJob * iwtj, char * message);
+void IWorkerThreadJobComplete(IWorkerThreadJob * iwtj);
+void IWorkerThreadJobCompleteDeferred(IWorkerThreadJob * iwtj);
+void IWorkerThreadJobRunCallback(IWorkerThreadJob * iwtj);
+bool IWorkerThreadJobCancel(IWorkerThreadJob * iwtj, const char * reason);
+bool IWorkerThreadJobIsCancelled(IWorkerThreadJob * iwtj);
+const char * IWorkerThreadJobGetCancelReason(IWorkerThreadJob * iwtj);
+void IWorkerThreadJobSetDeadline(IWorkerThreadJob * iwtj, long timeout_ms);
+uint64_t IWorkerThreadJobGetDeadline(IWorkerThreadJob * iwtj);
+void IWorkerThreadJobSetRetryPolicy(IWorkerThreadJob * iwtj, int max_attempts, long base_delay_ms, double jitter);
+bool IWorkerThreadJobShouldRetry(IWorkerThreadJob * iwtj);
+uint64_t IWorkerThreadJobGetRetryDelay(IWorkerThreadJob * iwtj);
+int IWorkerThreadJobGetAttempts(IWorkerThreadJob * iwtj);
+void IWorkerThreadJobYield(IWorkerThreadJob * iwtj, int next_step);
+int IWorkerThreadJobGetStep(IWorkerThreadJob * iwtj);
+void IWorkerThreadJobSetFunction(IWorkerThreadJob * iwtj, void (* function)(IWorkerThreadJob *));
+void IWorkerThreadJobSetResult(IWorkerThreadJob * iwtj, void * result);
+void * IWorkerThreadJobGetResult(IWorkerThreadJob * iwtj);
 void IWorkerThreadJobFree(IWorkerThreadJob * itj);
 void * IWorkerThreadJobGetData(IWorkerThreadJob * iwj);
+void * IWorkerThreadJobGetWorkerContext(IWorkerThreadJob * iwtj);
+void * IWorkerThreadJobArenaAlloc(IWorkerThreadJob * iwtj, size_t size);
 size_t IWorkerThreadJobGetId(IWorkerThreadJob * iwtj);
+IThreadPriority IWorkerThreadJobGetPriority(IWorkerThreadJob * iwtj);
 struct _iworker_thread * IWorkerThreadJobGetParentThread(IWorkerThreadJob * iwtj);
 bool IWorkerThreadJobIsValid(IWorkerThreadJob * iwtj);
 
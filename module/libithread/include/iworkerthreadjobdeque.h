@@ -0,0 +1,34 @@
+#ifndef COM_PLUS_MEVANSPN_ITHREAD_WORKER_THREAD_JOB_DEQUE
+#define COM_PLUS_MEVANSPN_ITHREAD_WORKER_THREAD_JOB_DEQUE
+
+#include <stdatomic.h>
+
+#include "global.h"
+#include "iworkerthreadjobqueue.h"
+
+#define ITHREAD_DEFAULT_JOB_DEQUE_SIZE 256
+
+typedef struct _iworker_thread_job_deque_array {
+    long size;
+    struct _iworker_thread_job_deque_array * previous_array;
+    _Atomic(IWorkerThreadJob *) jobs[];
+} IWorkerThreadJobDequeArray;
+
+typedef struct _iworker_thread_job_deque {
+    int struct_id;
+    _Alignas(ITHREAD_CACHE_LINE_SIZE) atomic_long top;
+    _Alignas(ITHREAD_CACHE_LINE_SIZE) atomic_long bottom;
+    _Atomic(IWorkerThreadJobDequeArray *) array;
+} IWorkerThreadJobDeque;
+
+IWorkerThreadJobDeque * IWorkerThreadJobDequeCreate();
+bool IWorkerThreadJobDequeIsValid(IWorkerThreadJobDeque * iwtjd);
+bool IWorkerThreadJobDequePushBatch(IWorkerThreadJobDeque * iwtjd, IWorkerThreadJob ** jobs, size_t jobs_count);
+bool IWorkerThreadJobDequePush(IWorkerThreadJobDeque * iwtjd, IWorkerThreadJob * iwtj);
+IWorkerThreadJob * IWorkerThreadJobDequePop(IWorkerThreadJobDeque * iwtjd);
+IWorkerThreadJob * IWorkerThreadJobDequeSteal(IWorkerThreadJobDeque * iwtjd);
+bool IWorkerThreadJobDequeHasJobs(IWorkerThreadJobDeque * iwtjd);
+size_t IWorkerThreadJobDequeGetCount(IWorkerThreadJobDeque * iwtjd);
+bool IWorkerThreadJobDequeFree(IWorkerThreadJobDeque * iwtjd);
+
+#endif
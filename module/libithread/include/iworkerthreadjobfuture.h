@@ -0,0 +1,34 @@
+#ifndef COM_PLUS_MEVANSPN_ITHREAD_WORKER_THREAD_JOB_FUTURE
+#define COM_PLUS_MEVANSPN_ITHREAD_WORKER_THREAD_JOB_FUTURE
+
+#include <stdatomic.h>
+
+#include "global.h"
+#include "ithreadjobstate.h"
+
+typedef struct _iworker_thread_job_future {
+    int struct_id;
+    size_t job_id;
+    atomic_int state;
+    atomic_int references;
+    atomic_bool cancel_requested;
+    void * result;
+    char * failure_message;
+} IWorkerThreadJobFuture;
+
+IWorkerThreadJobFuture * IWorkerThreadJobFutureCreate(IWorkerThreadJob * iwtj);
+bool IWorkerThreadJobFutureIsValid(IWorkerThreadJobFuture * iwtjf);
+void IWorkerThreadJobFutureComplete(IWorkerThreadJobFuture * iwtjf, IWorkerThreadJob * iwtj);
+bool IWorkerThreadJobFutureIsDone(IWorkerThreadJobFuture * iwtjf);
+bool IWorkerThreadJobFutureCancel(IWorkerThreadJobFuture * iwtjf);
+bool IWorkerThreadJobFutureWait(IWorkerThreadJobFuture * iwtjf);
+bool IWorkerThreadJobFutureTimedWait(IWorkerThreadJobFuture * iwtjf, long timeout_ms);
+bool IWorkerThreadJobFutureWaitAll(IWorkerThreadJobFuture ** futures, size_t futures_count, long timeout_ms);
+long IWorkerThreadJobFutureWaitAny(IWorkerThreadJobFuture ** futures, size_t futures_count, long timeout_ms);
+IThreadJobState IWorkerThreadJobFutureGetState(IWorkerThreadJobFuture * iwtjf);
+void * IWorkerThreadJobFutureGetResult(IWorkerThreadJobFuture * iwtjf);
+char * IWorkerThreadJobFutureGetFailureMessage(IWorkerThreadJobFuture * iwtjf);
+size_t IWorkerThreadJobFutureGetJobId(IWorkerThreadJobFuture * iwtjf);
+bool IWorkerThreadJobFutureFree(IWorkerThreadJobFuture * iwtjf);
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef COM_PLUS_MEVANSPN_ITHREAD_WORKER_THREAD_JOB_GRAPH
+#define COM_PLUS_MEVANSPN_ITHREAD_WORKER_THREAD_JOB_GRAPH
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "global.h"
+#include "ithreadjobstate.h"
+#include "ithreadpriority.h"
+
+#define ITHREAD_JOB_GRAPH_UPSTREAM_FAILED_MESSAGE "Upstream job failed."
+#define ITHREAD_JOB_GRAPH_CANCELLED_MESSAGE "Job graph cancelled."
+#define ITHREAD_JOB_GRAPH_QUEUE_FULL_MESSAGE "Job queue full."
+
+typedef enum _iworker_thread_job_graph_failure_policy {
+    IWorkerThreadJobGraphFailureCancelDownstream,   // Jobs that depend (directly or not) on a failed job are not run.
+    IWorkerThreadJobGraphFailureCancelGraph,        // Every job in the graph that hasn't finished is cancelled.
+    IWorkerThreadJobGraphFailureContinue            // Failures are ignored; dependent jobs run as if the job succeeded.
+} IWorkerThreadJobGraphFailurePolicy;
+
+typedef struct _iworker_thread_job_graph_node {
+    struct _iworker_thread_job_graph * graph;
+    void * data;
+    IThreadPriority priority;
+    IThreadJobState state;
+    void * result;
+    char * failure_message;
+    size_t dependencies_count;
+    _Atomic(size_t) dependencies_remaining;
+    atomic_bool upstream_failed;
+    struct _iworker_thread_job_graph_node ** dependents;
+    size_t dependents_count;
+    size_t dependents_buffer_size;
+    struct _iworker_thread_job_graph_node * next_finished;
+} IWorkerThreadJobGraphNode;
+
+typedef struct _iworker_thread_job_graph {
+    int struct_id;
+    IWorkerThreadJobGraphNode ** nodes;
+    size_t nodes_count;
+    size_t nodes_buffer_size;
+    IWorkerThreadJobGraphFailurePolicy failure_policy;
+    IWorkerThreadController * controller;
+    bool submitted;
+    atomic_bool cancelled;
+    _Atomic(size_t) nodes_finished;
+    _Atomic(size_t) nodes_failed;
+    _Atomic(size_t) nodes_stopped;
+    bool finished;
+    pthread_mutex_t finished_lock;
+    pthread_cond_t finished_condition;
+} IWorkerThreadJobGraph;
+
+IWorkerThreadJobGraph * IWorkerThreadJobGraphCreate();
+bool IWorkerThreadJobGraphIsValid(IWorkerThreadJobGraph * iwtjg);
+IWorkerThreadJobGraphNode * IWorkerThreadJobGraphAddJob(IWorkerThreadJobGraph * iwtjg, void * job_data, IThreadPriority priority);
+bool IWorkerThreadJobGraphAddDependency(IWorkerThreadJobGraph * iwtjg, IWorkerThreadJobGraphNode * job,
+                                        IWorkerThreadJobGraphNode * depends_on);
+void IWorkerThreadJobGraphSetFailurePolicy(IWorkerThreadJobGraph * iwtjg, IWorkerThreadJobGraphFailurePolicy policy);
+bool IWorkerThreadJobGraphSubmit(IWorkerThreadJobGraph * iwtjg, IWorkerThreadController * iwtc);
+void IWorkerThreadJobGraphCancel(IWorkerThreadJobGraph * iwtjg);
+bool IWorkerThreadJobGraphIsCancelled(IWorkerThreadJobGraph * iwtjg);
+bool IWorkerThreadJobGraphIsDone(IWorkerThreadJobGraph * iwtjg);
+bool IWorkerThreadJobGraphWait(IWorkerThreadJobGraph * iwtjg, long timeout_ms);
+size_t IWorkerThreadJobGraphGetFailedCount(IWorkerThreadJobGraph * iwtjg);
+size_t IWorkerThreadJobGraphGetStoppedCount(IWorkerThreadJobGraph * iwtjg);
+IThreadJobState IWorkerThreadJobGraphNodeGetState(IWorkerThreadJobGraphNode * iwtjgn);
+void * IWorkerThreadJobGraphNodeGetResult(IWorkerThreadJobGraphNode * iwtjgn);
+char * IWorkerThreadJobGraphNodeGetFailureMessage(IWorkerThreadJobGraphNode * iwtjgn);
+void IWorkerThreadJobGraphNodeComplete(IWorkerThreadJob * iwtj);
+bool IWorkerThreadJobGraphFree(IWorkerThreadJobGraph * iwtjg);
+
+#endif
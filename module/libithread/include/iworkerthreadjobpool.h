@@ -0,0 +1,30 @@
+#ifndef COM_PLUS_MEVANSPN_ITHREAD_WORKER_THREAD_JOB_POOL
+#define COM_PLUS_MEVANSPN_ITHREAD_WORKER_THREAD_JOB_POOL
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "global.h"
+#include "iworkerthreadjobqueue.h"
+
+#define ITHREAD_JOB_POOL_SLAB_SHIFT 10
+#define ITHREAD_JOB_POOL_SLAB_SIZE (1 << ITHREAD_JOB_POOL_SLAB_SHIFT)
+#define ITHREAD_JOB_POOL_MAX_SLABS 4096
+
+typedef struct _iworker_thread_job_pool {
+    int struct_id;
+    IWorkerThreadJob ** slabs;
+    atomic_uint slabs_count;
+    pthread_mutex_t grow_lock;
+    _Alignas(ITHREAD_CACHE_LINE_SIZE) _Atomic(uint64_t) free_list_head;
+} IWorkerThreadJobPool;
+
+IWorkerThreadJobPool * IWorkerThreadJobPoolCreate();
+bool IWorkerThreadJobPoolIsValid(IWorkerThreadJobPool * iwtjpl);
+IWorkerThreadJob * IWorkerThreadJobPoolAcquire(IWorkerThreadJobPool * iwtjpl, void * data);
+size_t IWorkerThreadJobPoolAcquireBatch(IWorkerThreadJobPool * iwtjpl, IWorkerThreadJob ** jobs, void ** data, size_t jobs_count);
+void IWorkerThreadJobPoolRelease(IWorkerThreadJobPool * iwtjpl, IWorkerThreadJob * iwtj);
+size_t IWorkerThreadJobPoolGetCapacity(IWorkerThreadJobPool * iwtjpl);
+bool IWorkerThreadJobPoolFree(IWorkerThreadJobPool * iwtjpl);
+
+#endif
@@ -1,21 +1,87 @@
 #ifndef COM_PLUS_MEVANSPN_ITHREAD_WORKER_THREAD_JOB_PROVIDER
-#define COM_PLUS_MEVANSPN_ITHREAD_WORDER_THREAD_JOB_PROVIDER
+#define COM_PLUS_MEVANSPN_ITHREAD_WORKER_THREAD_JOB_PROVIDER
+
+#include <pthread.h>
+#include <stdatomic.h>
 
 #include "global.h"
+#include "ithreadpriority.h"
+#include "iworkerthreadjobqueue.h"
+#include "iworkerthreadjobdeque.h"
+#include "iworkerthreadjobpool.h"
+#include "ithreadtopology.h"
+#include "iworkerthreadnamedqueue.h"
+
+#define ITHREAD_JOB_BATCH_SIZE 256
+// Longest a blocked producer sleeps before re-checking for space, in case it missed a worker taking a job.
+#define ITHREAD_JOB_PROVIDER_SPACE_RECHECK_MS 10
 
 typedef struct _iworker_thread_job_provider {
     int struct_id;
-    IWorkerThreadJob ** jobs;
-    size_t jobs_count;
-    size_t next_job_index;
-    size_t jobs_array_size;
+    IWorkerThreadJobQueue * queues[ITHREAD_PRIORITY_LEVELS];
+    uint64_t aging_interval_ns;
+    IWorkerThreadJobDeque ** deques;
+    size_t deques_count;
+    size_t deques_buffer_size;
+    IWorkerThreadJobPool * job_pool;
+    IWorkerThreadJobQueue ** node_queues;
+    int nodes_count;
+    int * cpu_nodes;
+    int cpus_count;
+    atomic_int waiting_workers;
+    pthread_mutex_t wait_lock;
+    pthread_cond_t wait_condition;
+    size_t capacity;
+    _Atomic(size_t) queued_count;
+    _Atomic(size_t) high_watermark;
+    _Atomic(size_t) rejected_count;
+    atomic_int waiting_producers;
+    pthread_mutex_t space_lock;
+    pthread_cond_t space_condition;
+    IWorkerThreadNamedQueue * named_queues[ITHREAD_MAX_NAMED_QUEUES];
+    _Atomic(size_t) named_queues_count;
+    _Atomic(uint64_t) named_queues_pass;
+    pthread_mutex_t named_queues_lock;
 } IWorkerThreadJobProvider;
 
 IWorkerThreadJobProvider * IWorkerThreadJobProviderCreate();
 bool IWorkerThreadJobProviderIsValid(IWorkerThreadJobProvider * iwtjp);
 bool IWorkerThreadJobProviderAddJob(IWorkerThreadJobProvider * iwtjp, void * job_data);
+bool IWorkerThreadJobProviderAddPriorityJob(IWorkerThreadJobProvider * iwtjp, void * job_data, IThreadPriority priority);
+IWorkerThreadJob * IWorkerThreadJobProviderCreateJob(IWorkerThreadJobProvider * iwtjp, void * job_data);
+bool IWorkerThreadJobProviderEnqueueJob(IWorkerThreadJobProvider * iwtjp, IWorkerThreadJob * iwtj);
+bool IWorkerThreadJobProviderEnqueueJobTimed(IWorkerThreadJobProvider * iwtjp, IWorkerThreadJob * iwtj, long timeout_ms);
+bool IWorkerThreadJobProviderEnqueueWorkerJob(IWorkerThreadJobProvider * iwtjp, IWorkerThreadJob * iwtj);
+bool IWorkerThreadJobProviderPushLocalJob(IWorkerThreadJobProvider * iwtjp, IWorkerThreadJobDeque * iwtjd, IWorkerThreadJob * iwtj);
+// The batch functions add jobs from the start of job_data and return how many went in.  A short count means the capacity was
+// reached (or memory ran out) and job_data[count] onwards still belongs to the caller; only AddJobsTimed waits for room.
+size_t IWorkerThreadJobProviderAddJobs(IWorkerThreadJobProvider * iwtjp, IWorkerThreadJobDeque * iwtjd, void ** job_data,
+                                        size_t jobs_count, IThreadPriority priority);
+size_t IWorkerThreadJobProviderAddJobsTimed(IWorkerThreadJobProvider * iwtjp, IWorkerThreadJobDeque * iwtjd, void ** job_data,
+                                            size_t jobs_count, IThreadPriority priority, long timeout_ms);
+bool IWorkerThreadJobProviderAddDeque(IWorkerThreadJobProvider * iwtjp, IWorkerThreadJobDeque * iwtjd);
+IWorkerThreadJob * IWorkerThreadJobProviderStealJob(IWorkerThreadJobProvider * iwtjp, IWorkerThreadJobDeque * thief_deque, unsigned int * seed);
+void IWorkerThreadJobProviderJobTaken(IWorkerThreadJobProvider * iwtjp);
+void IWorkerThreadJobProviderSetCapacity(IWorkerThreadJobProvider * iwtjp, size_t capacity);
+size_t IWorkerThreadJobProviderGetCapacity(IWorkerThreadJobProvider * iwtjp);
+bool IWorkerThreadJobProviderIsFull(IWorkerThreadJobProvider * iwtjp);
+size_t IWorkerThreadJobProviderGetHighWatermark(IWorkerThreadJobProvider * iwtjp);
+size_t IWorkerThreadJobProviderGetRejectedCount(IWorkerThreadJobProvider * iwtjp);
 bool IWorkerThreadJobProviderHasJobs(IWorkerThreadJobProvider * iwtjp);
+size_t IWorkerThreadJobProviderGetPendingCount(IWorkerThreadJobProvider * iwtjp);
+uint64_t IWorkerThreadJobProviderGetOldestEnqueueTime(IWorkerThreadJobProvider * iwtjp);
 bool IWorkerThreadJobProviderFree(IWorkerThreadJobProvider * iwtjp);
 IWorkerThreadJob * IWorkerThreadJobProviderNextJob(IWorkerThreadJobProvider * iwtjp);
+IWorkerThreadJob * IWorkerThreadJobProviderNextPriorityJob(IWorkerThreadJobProvider * iwtjp, IThreadPriority minimum_priority);
+bool IWorkerThreadJobProviderSetNumaNodes(IWorkerThreadJobProvider * iwtjp, IThreadCpuTopology * itct);
+int IWorkerThreadJobProviderGetCurrentNode(IWorkerThreadJobProvider * iwtjp);
+IWorkerThreadJob * IWorkerThreadJobProviderNextNodeJob(IWorkerThreadJobProvider * iwtjp, int node);
+IWorkerThreadJob * IWorkerThreadJobProviderNextRemoteNodeJob(IWorkerThreadJobProvider * iwtjp, int node);
+IWorkerThreadNamedQueue * IWorkerThreadJobProviderAddNamedQueue(IWorkerThreadJobProvider * iwtjp, const char * name, unsigned int weight);
+IWorkerThreadNamedQueue * IWorkerThreadJobProviderGetNamedQueue(IWorkerThreadJobProvider * iwtjp, const char * name);
+IWorkerThreadJob * IWorkerThreadJobProviderNextNamedQueueJob(IWorkerThreadJobProvider * iwtjp);
+void IWorkerThreadJobProviderSetAgingInterval(IWorkerThreadJobProvider * iwtjp, long milliseconds);
+void IWorkerThreadJobProviderWaitForJobs(IWorkerThreadJobProvider * iwtjp, _Atomic(IThreadState) * waiter_state);
+void IWorkerThreadJobProviderWakeAll(IWorkerThreadJobProvider * iwtjp);
 
-#endif
\ No newline at end of file
+#endif
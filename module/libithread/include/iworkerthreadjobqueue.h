@@ -0,0 +1,42 @@
+#ifndef COM_PLUS_MEVANSPN_ITHREAD_WORKER_THREAD_JOB_QUEUE
+#define COM_PLUS_MEVANSPN_ITHREAD_WORKER_THREAD_JOB_QUEUE
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "global.h"
+
+// Number of jobs a job queue holds in its lock-free ring.  Jobs beyond that wait in the queue's overflow list, so this is not a
+// limit on the number of queued jobs (see IWorkerThreadJobProviderSetCapacity() for that).
+#define ITHREAD_DEFAULT_JOB_QUEUE_CAPACITY 65536
+#define ITHREAD_CACHE_LINE_SIZE 64
+
+typedef struct _iworker_thread_job_queue_cell {
+    atomic_size_t sequence;
+    IWorkerThreadJob * job;
+    _Atomic(uint64_t) enqueue_time_ns;
+} IWorkerThreadJobQueueCell;
+
+typedef struct _iworker_thread_job_queue {
+    int struct_id;
+    IWorkerThreadJobQueueCell * cells;
+    size_t capacity;
+    size_t mask;
+    _Alignas(ITHREAD_CACHE_LINE_SIZE) atomic_size_t enqueue_position;
+    _Alignas(ITHREAD_CACHE_LINE_SIZE) atomic_size_t dequeue_position;
+    _Alignas(ITHREAD_CACHE_LINE_SIZE) _Atomic(size_t) overflow_count;
+    IWorkerThreadJob * overflow_head;
+    IWorkerThreadJob * overflow_tail;
+    pthread_mutex_t overflow_lock;
+} IWorkerThreadJobQueue;
+
+IWorkerThreadJobQueue * IWorkerThreadJobQueueCreate(size_t capacity);
+bool IWorkerThreadJobQueueIsValid(IWorkerThreadJobQueue * iwtjq);
+bool IWorkerThreadJobQueueEnqueue(IWorkerThreadJobQueue * iwtjq, IWorkerThreadJob * iwtj);
+size_t IWorkerThreadJobQueueEnqueueBatch(IWorkerThreadJobQueue * iwtjq, IWorkerThreadJob ** jobs, size_t jobs_count);
+IWorkerThreadJob * IWorkerThreadJobQueueDequeue(IWorkerThreadJobQueue * iwtjq);
+bool IWorkerThreadJobQueuePeekEnqueueTime(IWorkerThreadJobQueue * iwtjq, uint64_t * enqueue_time_ns);
+size_t IWorkerThreadJobQueueGetCount(IWorkerThreadJobQueue * iwtjq);
+bool IWorkerThreadJobQueueFree(IWorkerThreadJobQueue * iwtjq);
+
+#endif
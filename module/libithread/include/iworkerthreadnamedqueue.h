@@ -0,0 +1,36 @@
+#ifndef COM_PLUS_MEVANSPN_ITHREAD_WORKER_THREAD_NAMED_QUEUE
+#define COM_PLUS_MEVANSPN_ITHREAD_WORKER_THREAD_NAMED_QUEUE
+
+#include <stdatomic.h>
+
+#include "global.h"
+#include "iworkerthreadjobqueue.h"
+#include "ithreadhistogram.h"
+
+#define ITHREAD_NAMED_QUEUE_NAME_LENGTH 64
+#define ITHREAD_MAX_NAMED_QUEUES 64
+// A queue's stride (how far its pass moves on each time a job is taken from it) is ITHREAD_NAMED_QUEUE_STRIDE_SCALE / weight.
+#define ITHREAD_NAMED_QUEUE_STRIDE_SCALE (1ULL << 20)
+#define ITHREAD_NAMED_QUEUE_MAX_WEIGHT 1000000
+
+typedef struct _iworker_thread_named_queue {
+    int struct_id;
+    char name[ITHREAD_NAMED_QUEUE_NAME_LENGTH];
+    _Atomic(unsigned int) weight;
+    _Atomic(uint64_t) stride;
+    _Atomic(uint64_t) pass;
+    IWorkerThreadJobQueue * queue;
+    _Atomic(size_t) enqueued_count;
+    _Atomic(size_t) dequeued_count;
+    IThreadHistogram * wait_time_histogram;
+} IWorkerThreadNamedQueue;
+
+IWorkerThreadNamedQueue * IWorkerThreadNamedQueueCreate(const char * name, unsigned int weight);
+bool IWorkerThreadNamedQueueIsValid(IWorkerThreadNamedQueue * iwtnq);
+void IWorkerThreadNamedQueueSetWeight(IWorkerThreadNamedQueue * iwtnq, unsigned int weight);
+unsigned int IWorkerThreadNamedQueueGetWeight(IWorkerThreadNamedQueue * iwtnq);
+const char * IWorkerThreadNamedQueueGetName(IWorkerThreadNamedQueue * iwtnq);
+size_t IWorkerThreadNamedQueueGetDepth(IWorkerThreadNamedQueue * iwtnq);
+bool IWorkerThreadNamedQueueFree(IWorkerThreadNamedQueue * iwtnq);
+
+#endif
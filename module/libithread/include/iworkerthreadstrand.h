@@ -0,0 +1,34 @@
+#ifndef COM_PLUS_MEVANSPN_ITHREAD_WORKER_THREAD_STRAND
+#define COM_PLUS_MEVANSPN_ITHREAD_WORKER_THREAD_STRAND
+
+#include <stdatomic.h>
+
+#include "global.h"
+#include "iworkerthreadjobqueue.h"
+
+// Keys are spread over this many strands (a power of 2).  Keys that land on the same strand are run one after another, so this
+// caps how many keys can make progress at once.
+#define ITHREAD_STRAND_COUNT 1024
+
+typedef struct _iworker_thread_strand {
+    _Alignas(ITHREAD_CACHE_LINE_SIZE) _Atomic(IWorkerThreadJob *) inbox;
+    IWorkerThreadJob * head;
+    _Atomic(size_t) count;
+} IWorkerThreadStrand;
+
+typedef struct _iworker_thread_strand_set {
+    int struct_id;
+    IWorkerThreadStrand * strands;
+    size_t strands_count;
+} IWorkerThreadStrandSet;
+
+IWorkerThreadStrandSet * IWorkerThreadStrandSetCreate(size_t strands_count);
+bool IWorkerThreadStrandSetIsValid(IWorkerThreadStrandSet * iwtss);
+IWorkerThreadStrand * IWorkerThreadStrandSetGetStrand(IWorkerThreadStrandSet * iwtss, uint64_t key);
+size_t IWorkerThreadStrandSetGetPendingCount(IWorkerThreadStrandSet * iwtss);
+void IWorkerThreadStrandSetFree(IWorkerThreadStrandSet * iwtss);
+bool IWorkerThreadStrandPush(IWorkerThreadStrand * iwts, IWorkerThreadJob * iwtj);
+IWorkerThreadJob * IWorkerThreadStrandPop(IWorkerThreadStrand * iwts);
+bool IWorkerThreadStrandRelease(IWorkerThreadStrand * iwts);
+
+#endif
@@ -24,4 +24,13 @@ void IThreadSleep(long milliseconds)
 
     // Cause the current exection thread to sleep for the required number of milliseconds.
     nanosleep(&ts, &rem);
+}
+
+/// @brief Gets the current value of the monotonic clock in nanoseconds.  Only useful for measuring intervals.
+/// @return Monotonic clock time in nanoseconds.
+uint64_t IThreadGetTimeNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
 }
\ No newline at end of file
@@ -0,0 +1,118 @@
+#include <string.h>
+
+#include "ithreadarena.h"
+
+// Block headers are padded so that the memory after them starts aligned.
+#define _ITHREAD_ARENA_HEADER_SIZE ((sizeof(IThreadArenaBlock) + ITHREAD_ARENA_ALIGNMENT - 1) & ~((size_t) ITHREAD_ARENA_ALIGNMENT - 1))
+
+/// @brief Creates an empty bump arena.  Allocating from an arena just moves a pointer along its current block, and nothing is freed
+///         on its own: the whole arena is emptied in one go by IThreadArenaReset().  Memory is reserved in blocks as it is needed,
+///         and a reset merges the blocks into one big enough for everything allocated so far, so an arena that is filled and reset
+///         over and over soon stops calling malloc() at all.  An arena must only be used by one thread.
+/// @param block_size Size of the first block in bytes (ITHREAD_ARENA_DEFAULT_BLOCK_SIZE if 0).  Nothing is reserved until the first
+///         allocation.
+/// @return Pointer to arena data structure, or NULL if memory could not be reserved for it.
+IThreadArena * IThreadArenaCreate(size_t block_size)
+{
+    IThreadArena * ita = (IThreadArena *) malloc(sizeof(IThreadArena));
+    if (!ita) return NULL;
+    ita->struct_id = ITHREAD_DATA_STRUCT_ID;
+    ita->blocks = NULL;
+    ita->block_size = block_size ? block_size : ITHREAD_ARENA_DEFAULT_BLOCK_SIZE;
+    ita->capacity = ita->used = ita->high_watermark = 0;
+    return ita;
+}
+
+bool IThreadArenaIsValid(IThreadArena * ita)
+{
+    return ita && ita->struct_id == ITHREAD_DATA_STRUCT_ID;
+}
+
+/// @brief Reserves a new block, at least size bytes and twice the size of the last, to allocate from.
+static IThreadArenaBlock * _IThreadArenaAddBlock(IThreadArena * ita, size_t size)
+{
+    size_t block_size = ita->blocks ? ita->blocks->size * 2 : ita->block_size;
+    if (block_size < size) block_size = size;
+    IThreadArenaBlock * itab = (IThreadArenaBlock *) malloc(_ITHREAD_ARENA_HEADER_SIZE + block_size);
+    if (!itab) return NULL;
+    itab->size = block_size;
+    itab->used = 0;
+    itab->next = ita->blocks;
+    ita->blocks = itab;
+    ita->capacity += block_size;
+    return itab;
+}
+
+/// @brief Allocates memory from an arena.  The memory stays valid until the arena is reset or freed.
+/// @param ita Pointer to arena data structure.
+/// @param size Number of bytes needed.
+/// @return Pointer to the memory (aligned to ITHREAD_ARENA_ALIGNMENT), or NULL if the arena is invalid, size is 0 or a new block
+///         could not be reserved.
+void * IThreadArenaAlloc(IThreadArena * ita, size_t size)
+{
+    if (!IThreadArenaIsValid(ita) || size == 0) return NULL;
+    const size_t ALIGNED_SIZE = (size + ITHREAD_ARENA_ALIGNMENT - 1) & ~((size_t) ITHREAD_ARENA_ALIGNMENT - 1);
+    if (ALIGNED_SIZE < size) return NULL;
+    IThreadArenaBlock * itab = ita->blocks;
+    if (!itab || itab->size - itab->used < ALIGNED_SIZE) itab = _IThreadArenaAddBlock(ita, ALIGNED_SIZE);
+    if (!itab) return NULL;
+    void * memory = (char *) itab + _ITHREAD_ARENA_HEADER_SIZE + itab->used;
+    itab->used += ALIGNED_SIZE;
+    ita->used += ALIGNED_SIZE;
+    if (ita->used > ita->high_watermark) ita->high_watermark = ita->used;
+    return memory;
+}
+
+/// @brief Allocates zeroed memory for count items of size bytes from an arena (see IThreadArenaAlloc()).
+void * IThreadArenaCalloc(IThreadArena * ita, size_t count, size_t size)
+{
+    if (size && count > SIZE_MAX / size) return NULL;
+    void * memory = IThreadArenaAlloc(ita, count * size);
+    if (memory) memset(memory, 0, count * size);
+    return memory;
+}
+
+/// @brief Empties an arena, invalidating everything allocated from it.  If the arena had grown past one block, its blocks are
+///         replaced with a single block as big as the most the arena has held, so it fits in one block from then on.
+/// @param ita Pointer to arena data structure.
+void IThreadArenaReset(IThreadArena * ita)
+{
+    if (!IThreadArenaIsValid(ita) || ita->used == 0) return;
+    if (ita->blocks->next) {
+        while (ita->blocks) {
+            IThreadArenaBlock * next = ita->blocks->next;
+            free(ita->blocks);
+            ita->blocks = next;
+        }
+        ita->capacity = 0;
+        if (ita->high_watermark > ita->block_size) ita->block_size = ita->high_watermark;
+        // If the merged block can't be reserved, the arena starts again from nothing on its next allocation.
+        _IThreadArenaAddBlock(ita, ita->block_size);
+    } else ita->blocks->used = 0;
+    ita->used = 0;
+}
+
+/// @brief Gets the number of bytes allocated from an arena since it was last reset.
+size_t IThreadArenaGetUsed(IThreadArena * ita)
+{
+    return IThreadArenaIsValid(ita) ? ita->used : 0;
+}
+
+/// @brief Gets the number of bytes an arena has reserved.
+size_t IThreadArenaGetCapacity(IThreadArena * ita)
+{
+    return IThreadArenaIsValid(ita) ? ita->capacity : 0;
+}
+
+/// @brief Frees an arena along with all its memory.
+void IThreadArenaFree(IThreadArena * ita)
+{
+    if (!IThreadArenaIsValid(ita)) return;
+    while (ita->blocks) {
+        IThreadArenaBlock * next = ita->blocks->next;
+        free(ita->blocks);
+        ita->blocks = next;
+    }
+    ita->struct_id = 0;
+    free(ita);
+}
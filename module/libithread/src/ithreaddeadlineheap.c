@@ -0,0 +1,93 @@
+#include "ithreaddeadlineheap.h"
+
+/// @brief Creates an empty deadline heap: a binary min-heap of deadlines, each with a pointer to whatever it is the deadline for,
+///         giving the earliest deadline in O(1) and adding or removing one in O(log n).  A deadline heap must only be used by one
+///         thread.
+/// @return Pointer to deadline heap data structure, or NULL if memory could not be reserved for it.
+IThreadDeadlineHeap * IThreadDeadlineHeapCreate()
+{
+    IThreadDeadlineHeap * itdh = (IThreadDeadlineHeap *) malloc(sizeof(IThreadDeadlineHeap));
+    if (!itdh) return NULL;
+    itdh->deadlines = (IThreadDeadline *) malloc(sizeof(IThreadDeadline) * ITHREAD_DEADLINE_HEAP_INITIAL_CAPACITY);
+    if (!itdh->deadlines) {
+        free(itdh);
+        return NULL;
+    }
+    itdh->struct_id = ITHREAD_DATA_STRUCT_ID;
+    itdh->count = 0;
+    itdh->capacity = ITHREAD_DEADLINE_HEAP_INITIAL_CAPACITY;
+    return itdh;
+}
+
+bool IThreadDeadlineHeapIsValid(IThreadDeadlineHeap * itdh)
+{
+    return itdh && itdh->struct_id == ITHREAD_DATA_STRUCT_ID;
+}
+
+/// @brief Adds a deadline to a deadline heap, growing it if it is full.
+/// @param itdh Pointer to deadline heap data structure.
+/// @param deadline_ns Deadline (see IThreadGetTimeNs()).
+/// @param data Pointer to whatever the deadline is for.
+/// @return True if the deadline was added, false if the pointer is invalid or memory could not be reserved.
+bool IThreadDeadlineHeapPush(IThreadDeadlineHeap * itdh, uint64_t deadline_ns, void * data)
+{
+    if (!IThreadDeadlineHeapIsValid(itdh)) return false;
+    if (itdh->count == itdh->capacity) {
+        IThreadDeadline * deadlines = (IThreadDeadline *) realloc(itdh->deadlines, sizeof(IThreadDeadline) * itdh->capacity * 2);
+        if (!deadlines) return false;
+        itdh->deadlines = deadlines;
+        itdh->capacity *= 2;
+    }
+    // Sift the new deadline up from the bottom until its parent is no later than it.
+    size_t i = itdh->count++;
+    while (i > 0 && itdh->deadlines[(i - 1) / 2].deadline_ns > deadline_ns) {
+        itdh->deadlines[i] = itdh->deadlines[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    itdh->deadlines[i].deadline_ns = deadline_ns;
+    itdh->deadlines[i].data = data;
+    return true;
+}
+
+/// @brief Gets the earliest deadline in a deadline heap without removing it.
+/// @return Deadline, or UINT64_MAX if the heap is empty.
+uint64_t IThreadDeadlineHeapPeek(IThreadDeadlineHeap * itdh)
+{
+    return IThreadDeadlineHeapIsValid(itdh) && itdh->count > 0 ? itdh->deadlines[0].deadline_ns : UINT64_MAX;
+}
+
+/// @brief Removes the earliest deadline from a deadline heap.
+/// @param itdh Pointer to deadline heap data structure.
+/// @param deadline Receives the deadline and its data.
+/// @return True if a deadline was removed, false if the heap is empty.
+bool IThreadDeadlineHeapPop(IThreadDeadlineHeap * itdh, IThreadDeadline * deadline)
+{
+    if (!IThreadDeadlineHeapIsValid(itdh) || itdh->count == 0 || !deadline) return false;
+    *deadline = itdh->deadlines[0];
+    // Sift the last deadline down from the top until neither child is earlier than it.
+    const IThreadDeadline LAST = itdh->deadlines[--itdh->count];
+    size_t i = 0;
+    for (;;) {
+        size_t child = i * 2 + 1;
+        if (child >= itdh->count) break;
+        if (child + 1 < itdh->count && itdh->deadlines[child + 1].deadline_ns < itdh->deadlines[child].deadline_ns) child++;
+        if (itdh->deadlines[child].deadline_ns >= LAST.deadline_ns) break;
+        itdh->deadlines[i] = itdh->deadlines[child];
+        i = child;
+    }
+    itdh->deadlines[i] = LAST;
+    return true;
+}
+
+size_t IThreadDeadlineHeapGetCount(IThreadDeadlineHeap * itdh)
+{
+    return IThreadDeadlineHeapIsValid(itdh) ? itdh->count : 0;
+}
+
+void IThreadDeadlineHeapFree(IThreadDeadlineHeap * itdh)
+{
+    if (!IThreadDeadlineHeapIsValid(itdh)) return;
+    free(itdh->deadlines);
+    itdh->struct_id = 0;
+    free(itdh);
+}
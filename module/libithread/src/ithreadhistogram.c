@@ -0,0 +1,181 @@
+#include "ithreadhistogram.h"
+
+/// @brief Gets the index of the bucket that a value is counted in.  Values below 2 * ITHREAD_HISTOGRAM_SUB_BUCKETS have a bucket
+///         each.  Above that, every power of two range is split into ITHREAD_HISTOGRAM_SUB_BUCKETS equal width buckets.
+/// @param value Value to find the bucket for.
+/// @return Bucket index in the range 0..ITHREAD_HISTOGRAM_BUCKETS - 1.
+static inline size_t _IThreadHistogramGetBucketIndex(uint64_t value)
+{
+    if (value < 2 * ITHREAD_HISTOGRAM_SUB_BUCKETS) return (size_t) value;
+    const int SHIFT = (63 - __builtin_clzll(value)) - ITHREAD_HISTOGRAM_SUB_BUCKET_BITS;
+    return (size_t) SHIFT * ITHREAD_HISTOGRAM_SUB_BUCKETS + (size_t) (value >> SHIFT);
+}
+
+/// @brief Gets the highest value that would be counted in a bucket.
+/// @param index Bucket index.
+/// @return Highest value counted in the bucket.
+static inline uint64_t _IThreadHistogramGetBucketMaxValue(size_t index)
+{
+    if (index < 2 * ITHREAD_HISTOGRAM_SUB_BUCKETS) return (uint64_t) index;
+    const int SHIFT = (int) (index / ITHREAD_HISTOGRAM_SUB_BUCKETS) - 1;
+    const uint64_t SUB_BUCKET = (uint64_t) (index - (size_t) SHIFT * ITHREAD_HISTOGRAM_SUB_BUCKETS);
+    return ((SUB_BUCKET + 1) << SHIFT) - 1;
+}
+
+/// @brief Adds to a counter that only one thread writes to.  A plain load and store is enough (and avoids a locked instruction),
+///         readers on other threads only ever need to see a recent value.
+static inline void _IThreadHistogramAdd(_Atomic(uint64_t) * counter, uint64_t value)
+{
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+/// @brief Creates an empty log-linear histogram.  Values are typically times in nanoseconds, but can be anything that fits in a
+///         uint64_t.  Percentiles can be read from any thread while values are being recorded.
+/// @return Pointer to histogram data structure, or NULL if memory could not be reserved for it.
+IThreadHistogram * IThreadHistogramCreate()
+{
+    IThreadHistogram * ith = (IThreadHistogram *) malloc(sizeof(IThreadHistogram));
+    if (!ith) return NULL;
+    ith->struct_id = ITHREAD_DATA_STRUCT_ID;
+    atomic_init(&ith->total_count, 0);
+    atomic_init(&ith->total_value, 0);
+    atomic_init(&ith->min_value, UINT64_MAX);
+    atomic_init(&ith->max_value, 0);
+    for (size_t b = 0; b < ITHREAD_HISTOGRAM_BUCKETS; b++) atomic_init(&ith->counts[b], 0);
+    return ith;
+}
+
+bool IThreadHistogramIsValid(IThreadHistogram * ith)
+{
+    return ith && ith->struct_id == ITHREAD_DATA_STRUCT_ID;
+}
+
+/// @brief Records a value.  Only one thread may record into a histogram (e.g. the worker thread that owns it).
+/// @param ith Pointer to histogram data structure.
+/// @param value Value to record.
+void IThreadHistogramRecord(IThreadHistogram * ith, uint64_t value)
+{
+    if (!IThreadHistogramIsValid(ith)) return;
+    _IThreadHistogramAdd(&ith->counts[_IThreadHistogramGetBucketIndex(value)], 1);
+    _IThreadHistogramAdd(&ith->total_value, value);
+    if (value < atomic_load_explicit(&ith->min_value, memory_order_relaxed)) atomic_store_explicit(&ith->min_value, value, memory_order_relaxed);
+    if (value > atomic_load_explicit(&ith->max_value, memory_order_relaxed)) atomic_store_explicit(&ith->max_value, value, memory_order_relaxed);
+    // The total is updated last, so a reader never sees more values counted than there are in the buckets.
+    atomic_store_explicit(&ith->total_count, atomic_load_explicit(&ith->total_count, memory_order_relaxed) + 1, memory_order_release);
+}
+
+/// @brief Records a value into a histogram that several threads record into at once (e.g. one shared by every worker thread).
+///         Slower than IThreadHistogramRecord(), as every counter is updated with a locked instruction.
+/// @param ith Pointer to histogram data structure.
+/// @param value Value to record.
+void IThreadHistogramRecordConcurrent(IThreadHistogram * ith, uint64_t value)
+{
+    if (!IThreadHistogramIsValid(ith)) return;
+    atomic_fetch_add_explicit(&ith->counts[_IThreadHistogramGetBucketIndex(value)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&ith->total_value, value, memory_order_relaxed);
+    uint64_t min = atomic_load_explicit(&ith->min_value, memory_order_relaxed);
+    while (value < min && !atomic_compare_exchange_weak_explicit(&ith->min_value, &min, value, memory_order_relaxed, memory_order_relaxed));
+    uint64_t max = atomic_load_explicit(&ith->max_value, memory_order_relaxed);
+    while (value > max && !atomic_compare_exchange_weak_explicit(&ith->max_value, &max, value, memory_order_relaxed, memory_order_relaxed));
+    atomic_fetch_add_explicit(&ith->total_count, 1, memory_order_release);
+}
+
+/// @brief Adds the values recorded in one histogram to another (e.g. to get percentiles across all of a controller's workers).
+///         The source histogram may still be being recorded into.
+/// @param destination Pointer to the histogram to add to.  Must not be recorded into by another thread.
+/// @param source Pointer to the histogram to add.
+/// @return True if both histograms are valid, false otherwise.
+bool IThreadHistogramMerge(IThreadHistogram * destination, IThreadHistogram * source)
+{
+    if (!IThreadHistogramIsValid(destination) || !IThreadHistogramIsValid(source)) return false;
+    atomic_load_explicit(&source->total_count, memory_order_acquire);
+    uint64_t count = 0;
+    for (size_t b = 0; b < ITHREAD_HISTOGRAM_BUCKETS; b++) {
+        const uint64_t BUCKET_COUNT = atomic_load_explicit(&source->counts[b], memory_order_relaxed);
+        if (BUCKET_COUNT == 0) continue;
+        _IThreadHistogramAdd(&destination->counts[b], BUCKET_COUNT);
+        count += BUCKET_COUNT;
+    }
+    if (count == 0) return true;
+    _IThreadHistogramAdd(&destination->total_value, atomic_load_explicit(&source->total_value, memory_order_relaxed));
+    const uint64_t MIN = atomic_load_explicit(&source->min_value, memory_order_relaxed);
+    const uint64_t MAX = atomic_load_explicit(&source->max_value, memory_order_relaxed);
+    if (MIN < atomic_load_explicit(&destination->min_value, memory_order_relaxed)) atomic_store_explicit(&destination->min_value, MIN, memory_order_relaxed);
+    if (MAX > atomic_load_explicit(&destination->max_value, memory_order_relaxed)) atomic_store_explicit(&destination->max_value, MAX, memory_order_relaxed);
+    _IThreadHistogramAdd(&destination->total_count, count);
+    return true;
+}
+
+/// @brief Empties a histogram.  Must not be called while another thread is recording into it.
+/// @param ith Pointer to histogram data structure.
+void IThreadHistogramReset(IThreadHistogram * ith)
+{
+    if (!IThreadHistogramIsValid(ith)) return;
+    for (size_t b = 0; b < ITHREAD_HISTOGRAM_BUCKETS; b++) atomic_store_explicit(&ith->counts[b], 0, memory_order_relaxed);
+    atomic_store_explicit(&ith->total_value, 0, memory_order_relaxed);
+    atomic_store_explicit(&ith->min_value, UINT64_MAX, memory_order_relaxed);
+    atomic_store_explicit(&ith->max_value, 0, memory_order_relaxed);
+    atomic_store_explicit(&ith->total_count, 0, memory_order_release);
+}
+
+/// @brief Gets the value below which the given percentage of recorded values fall.  The result is the highest value that would
+///         be counted in the same bucket, so it is never below the true percentile and within ~3% above it.
+/// @param ith Pointer to histogram data structure.
+/// @param percentile Percentile in the range 0..100 (e.g. 50.0, 99.0, 99.9).
+/// @return Value at the given percentile, or 0 if no values have been recorded.
+uint64_t IThreadHistogramGetPercentile(IThreadHistogram * ith, double percentile)
+{
+    if (!IThreadHistogramIsValid(ith)) return 0;
+    if (percentile < 0.0) percentile = 0.0;
+    else if (percentile > 100.0) percentile = 100.0;
+
+    // Counts are read in one pass, so a percentile is taken from the buckets as they were read rather than total_count (which
+    // may have moved on while the buckets were being read).
+    uint64_t counts[ITHREAD_HISTOGRAM_BUCKETS];
+    atomic_load_explicit(&ith->total_count, memory_order_acquire);
+    uint64_t total = 0;
+    for (size_t b = 0; b < ITHREAD_HISTOGRAM_BUCKETS; b++) total += counts[b] = atomic_load_explicit(&ith->counts[b], memory_order_relaxed);
+    if (total == 0) return 0;
+
+    const double RANK = percentile / 100.0 * (double) total;
+    uint64_t target = (uint64_t) RANK;
+    if ((double) target < RANK || target == 0) target++;
+    uint64_t cumulative = 0;
+    for (size_t b = 0; b < ITHREAD_HISTOGRAM_BUCKETS; b++) {
+        cumulative += counts[b];
+        if (cumulative >= target) {
+            const uint64_t VALUE = _IThreadHistogramGetBucketMaxValue(b);
+            const uint64_t MAX = atomic_load_explicit(&ith->max_value, memory_order_relaxed);
+            return VALUE > MAX && MAX > 0 ? MAX : VALUE;
+        }
+    }
+    return atomic_load_explicit(&ith->max_value, memory_order_relaxed);
+}
+
+uint64_t IThreadHistogramGetCount(IThreadHistogram * ith)
+{
+    return IThreadHistogramIsValid(ith) ? atomic_load_explicit(&ith->total_count, memory_order_acquire) : 0;
+}
+
+uint64_t IThreadHistogramGetMean(IThreadHistogram * ith)
+{
+    const uint64_t COUNT = IThreadHistogramGetCount(ith);
+    return COUNT ? atomic_load_explicit(&ith->total_value, memory_order_relaxed) / COUNT : 0;
+}
+
+uint64_t IThreadHistogramGetMin(IThreadHistogram * ith)
+{
+    return IThreadHistogramGetCount(ith) ? atomic_load_explicit(&ith->min_value, memory_order_relaxed) : 0;
+}
+
+uint64_t IThreadHistogramGetMax(IThreadHistogram * ith)
+{
+    return IThreadHistogramIsValid(ith) ? atomic_load_explicit(&ith->max_value, memory_order_relaxed) : 0;
+}
+
+void IThreadHistogramFree(IThreadHistogram * ith)
+{
+    if (!IThreadHistogramIsValid(ith)) return;
+    ith->struct_id = 0;
+    free(ith);
+}
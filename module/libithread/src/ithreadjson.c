@@ -0,0 +1,28 @@
+#include "ithreadjson.h"
+
+/// @brief Adds a "name": element member to a JSON object element.  The element belongs to the object once added, and is freed if
+///         it can't be added, so a caller never has anything left to free either way.
+/// @param object Pointer to a JSON object element.
+/// @param name Name of the member.
+/// @param element Pointer to the member's value, or NULL if creating it failed (in which case nothing is added).
+/// @return True if the member was added, false otherwise.
+bool IThreadJSONAddElement(JSONElement * object, char * name, JSONElement * element)
+{
+    JSONElement * member = element ? JSONCreateNameValuePairElement(name, element) : NULL;
+    if (!member || !JSONAddChildToElement(member, object)) {
+        if (member) JSONFreeElement(member);
+        else if (element) JSONFreeElement(element);
+        return false;
+    }
+    return true;
+}
+
+bool IThreadJSONAddNumber(JSONElement * object, char * name, double value)
+{
+    return IThreadJSONAddElement(object, name, JSONCreateNumberElement(value));
+}
+
+bool IThreadJSONAddString(JSONElement * object, char * name, char * value)
+{
+    return IThreadJSONAddElement(object, name, JSONCreateStringElement(value));
+}
@@ -0,0 +1,194 @@
+#include <string.h>
+
+#include "global.h"
+#include "ithreadparallel.h"
+#include "iworkerthread.h"
+#include "iworkerthreadjob.h"
+#include "iworkerthreadjobprovider.h"
+#include "iworkerthreadcontroller.h"
+
+/// @brief Drops a reference to a loop, freeing it once the caller and every helper job have finished with it.
+static void _IThreadParallelLoopRelease(IThreadParallelLoop * itpl)
+{
+    if (atomic_fetch_sub_explicit(&itpl->references, 1, memory_order_acq_rel) != 1) return;
+    itpl->struct_id = 0;
+    pthread_cond_destroy(&itpl->done_condition);
+    pthread_mutex_destroy(&itpl->lock);
+    free(itpl);
+}
+
+/// @brief Claims the next chunk of a loop's iterations.  The chunk is the participant's share of the remaining iterations divided
+///         by ITHREAD_PARALLEL_CHUNK_DIVISOR (but never less than the grain), so early chunks are big (fewer claims) and late ones
+///         small (participants finish at about the same time).
+/// @param itpl Pointer to loop data structure.
+/// @param begin Receives the first iteration of the chunk.
+/// @param end Receives one past the last iteration of the chunk.
+/// @return True if a chunk was claimed, false if every iteration has been claimed.
+static bool _IThreadParallelLoopClaimChunk(IThreadParallelLoop * itpl, size_t * begin, size_t * end)
+{
+    size_t next = atomic_load_explicit(&itpl->next, memory_order_relaxed);
+    size_t chunk;
+    do {
+        if (next >= itpl->end) return false;
+        const size_t REMAINING = itpl->end - next;
+        chunk = REMAINING / (itpl->participants * ITHREAD_PARALLEL_CHUNK_DIVISOR);
+        if (chunk < itpl->grain) chunk = itpl->grain;
+        if (chunk > REMAINING) chunk = REMAINING;
+    } while (!atomic_compare_exchange_weak_explicit(&itpl->next, &next, next + chunk, memory_order_relaxed, memory_order_relaxed));
+    *begin = next;
+    *end = next + chunk;
+    return true;
+}
+
+/// @brief Runs chunks of a loop until every iteration has been claimed.  For a reduction, the chunks are accumulated into a
+///         partial result that is combined into the loop's result at the end, so the lock is taken once per participant rather
+///         than once per chunk.  The iterations are only counted as done after that, so the caller can't return before the
+///         partial result has been combined.
+/// @param itpl Pointer to loop data structure.
+/// @param job Pointer to the helper job running the loop, or NULL if it is the calling thread (which never stops early).
+static void _IThreadParallelLoopRun(IThreadParallelLoop * itpl, IWorkerThreadJob * job)
+{
+    void * partial = NULL;
+    if (itpl->reduceFunction) {
+        partial = malloc(itpl->result_size);
+        if (!partial) {
+            // Leave the iterations to the other participants (the caller always manages, accumulating straight into the result under
+            // the lock, as helpers may be combining into it at the same time).
+            if (job) return;
+            partial = itpl->result;
+        } else memcpy(partial, itpl->identity, itpl->result_size);
+    }
+
+    size_t begin, end, iterations = 0;
+    while ((!job || !IWorkerThreadJobIsCancelled(job)) && _IThreadParallelLoopClaimChunk(itpl, &begin, &end)) {
+        if (partial && partial == itpl->result) {
+            pthread_mutex_lock(&itpl->lock);
+            itpl->reduceFunction(begin, end, partial, itpl->context);
+            pthread_mutex_unlock(&itpl->lock);
+        } else if (itpl->reduceFunction) itpl->reduceFunction(begin, end, partial, itpl->context);
+        else itpl->forFunction(begin, end, itpl->context);
+        iterations += end - begin;
+    }
+    if (iterations == 0) {
+        if (partial != itpl->result) free(partial);
+        return;
+    }
+
+    pthread_mutex_lock(&itpl->lock);
+    if (partial && partial != itpl->result) itpl->combineFunction(itpl->result, partial, itpl->context);
+    if (atomic_fetch_add_explicit(&itpl->iterations_done, iterations, memory_order_acq_rel) + iterations == itpl->iterations_count)
+        pthread_cond_broadcast(&itpl->done_condition);
+    pthread_mutex_unlock(&itpl->lock);
+    if (partial != itpl->result) free(partial);
+}
+
+/// @brief Main function for a parallel loop's helper jobs.
+static void _IThreadParallelHelperJob(IWorkerThreadJob * iwtj)
+{
+    IThreadParallelLoop * itpl = (IThreadParallelLoop *) IWorkerThreadJobGetData(iwtj);
+    _IThreadParallelLoopRun(itpl, iwtj);
+    _IThreadParallelLoopRelease(itpl);
+}
+
+/// @brief Runs a parallel loop: queues a helper job for each of the controller's running worker threads (any that find the loop
+///         already finished simply return), works on the loop on the calling thread too, and then waits for the chunks other
+///         participants are still running.  The caller never waits for a helper that hasn't started, so a worker thread can run
+///         a parallel loop without the risk of waiting on a job sitting in its own deque.
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param prototype Pointer to a loop set up by the caller, copied to the heap so that helpers that start late can still use it.  A
+///         reduction's identity is copied too (straight after the loop), as helpers read it before they know whether any
+///         iterations are left, possibly after the caller has returned.
+/// @return True once every iteration has run, false if memory could not be reserved.
+static bool _IThreadParallelRun(IWorkerThreadController * iwtc, IThreadParallelLoop * prototype)
+{
+    if (prototype->iterations_count == 0) return true;
+    const size_t IDENTITY_SIZE = prototype->identity ? prototype->result_size : 0;
+    IThreadParallelLoop * itpl = (IThreadParallelLoop *) malloc(sizeof(IThreadParallelLoop) + IDENTITY_SIZE);
+    if (!itpl) return false;
+    *itpl = *prototype;
+    if (IDENTITY_SIZE > 0) itpl->identity = memcpy(itpl + 1, prototype->identity, IDENTITY_SIZE);
+    if (itpl->grain == 0) itpl->grain = 1;
+    atomic_init(&itpl->next, itpl->end - itpl->iterations_count);
+    atomic_init(&itpl->iterations_done, 0);
+    pthread_mutex_init(&itpl->lock, NULL);
+    pthread_cond_init(&itpl->done_condition, NULL);
+
+    // One helper per worker thread (other than the caller, if it is one), but no more than there are chunks of work to hand out.
+    size_t helpers = IWorkerThreadControllerIsRunning(iwtc) ? (size_t) IWorkerThreadControllerGetWorkerCount(iwtc) : 0;
+    IWorkerThread * iwt = IWorkerThreadGetCurrent();
+    if (helpers > 0 && iwt && iwt->controller == iwtc) helpers--;
+    const size_t MAXIMUM_CHUNKS = (itpl->iterations_count + itpl->grain - 1) / itpl->grain;
+    if (helpers > MAXIMUM_CHUNKS - 1) helpers = MAXIMUM_CHUNKS - 1;
+    itpl->participants = helpers + 1;
+    atomic_init(&itpl->references, (int) helpers + 1);
+    for (size_t h = 0; h < helpers; h++) {
+        IWorkerThreadJob * iwtj = IWorkerThreadJobProviderCreateJob(iwtc->job_provider, itpl);
+        if (iwtj) IWorkerThreadJobSetFunction(iwtj, _IThreadParallelHelperJob);
+        if (!iwtj || !IWorkerThreadControllerQueueJob(iwtc, iwtj)) {
+            // Carry on with the helpers we have; the caller picks up whatever they don't.
+            IWorkerThreadJobFree(iwtj);
+            atomic_fetch_sub_explicit(&itpl->references, (int) (helpers - h), memory_order_relaxed);
+            break;
+        }
+    }
+
+    _IThreadParallelLoopRun(itpl, NULL);
+    pthread_mutex_lock(&itpl->lock);
+    while (atomic_load_explicit(&itpl->iterations_done, memory_order_acquire) < itpl->iterations_count)
+        pthread_cond_wait(&itpl->done_condition, &itpl->lock);
+    pthread_mutex_unlock(&itpl->lock);
+    _IThreadParallelLoopRelease(itpl);
+    return true;
+}
+
+/// @brief Calls function for every index in the range begin..end - 1, spreading the work over the controller's worker threads and
+///         the calling thread.  The range is handed out in chunks (of at least grain iterations) rather than one job per index,
+///         with chunks getting smaller as the loop nears its end so that everyone finishes at about the same time.  Returns once
+///         every iteration has run.  If the controller isn't running, the calling thread does all of the work.
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param begin First index.
+/// @param end One past the last index.
+/// @param grain Smallest number of iterations worth handing out at once (0 for 1).  Raise it if each iteration is very cheap.
+/// @param function Function called with each chunk as function(chunk_begin, chunk_end, context).  Chunks run concurrently.
+/// @param context Pointer passed to function.
+/// @return True once every iteration has run, false if the arguments are invalid or memory could not be reserved.
+bool IThreadParallelFor(IWorkerThreadController * iwtc, size_t begin, size_t end, size_t grain, IThreadParallelForFunction function,
+                        void * context)
+{
+    if (!IWorkerThreadControllerIsValid(iwtc) || !function) return false;
+    IThreadParallelLoop loop = {
+        .struct_id = ITHREAD_DATA_STRUCT_ID, .end = end, .grain = grain, .iterations_count = end > begin ? end - begin : 0,
+        .forFunction = function, .context = context
+    };
+    return _IThreadParallelRun(iwtc, &loop);
+}
+
+/// @brief Reduces the range begin..end - 1 to a single result, spreading the work in the same way as IThreadParallelFor().  Each
+///         participant starts a partial result from identity, accumulates its chunks into it with function, and combines it into
+///         the result when it runs out of chunks.  Partial results are combined in no particular order, so combine must be
+///         associative and commutative (e.g. a sum).
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param begin First index.
+/// @param end One past the last index.
+/// @param grain Smallest number of iterations worth handing out at once (0 for 1).
+/// @param function Function called with each chunk as function(chunk_begin, chunk_end, partial, context), accumulating into partial.
+/// @param combine Function called as combine(result, partial, context) to fold a partial result into the result.  Calls are
+///         serialised.
+/// @param identity Pointer to the starting value for the result and every partial result (e.g. 0 for a sum).
+/// @param result Pointer to the result, which is overwritten with the reduced value.
+/// @param result_size Size of the result in bytes.
+/// @param context Pointer passed to function and combine.
+/// @return True once every iteration has run and been combined, false if the arguments are invalid or memory could not be reserved.
+bool IThreadParallelReduce(IWorkerThreadController * iwtc, size_t begin, size_t end, size_t grain, IThreadParallelReduceFunction function,
+                           IThreadParallelCombineFunction combine, const void * identity, void * result, size_t result_size,
+                           void * context)
+{
+    if (!IWorkerThreadControllerIsValid(iwtc) || !function || !combine || !identity || !result || result_size == 0) return false;
+    memcpy(result, identity, result_size);
+    IThreadParallelLoop loop = {
+        .struct_id = ITHREAD_DATA_STRUCT_ID, .end = end, .grain = grain, .iterations_count = end > begin ? end - begin : 0,
+        .reduceFunction = function, .combineFunction = combine, .context = context,
+        .result = result, .result_size = result_size, .identity = identity
+    };
+    return _IThreadParallelRun(iwtc, &loop);
+}
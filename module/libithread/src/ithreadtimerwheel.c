@@ -0,0 +1,207 @@
+#include "ithreadtimerwheel.h"
+
+/// @brief Creates a timer.  A timer does nothing on its own; it is added to a timer wheel, which hands it back once it expires.
+/// @param data Pointer to whatever the timer is for.
+/// @param expiry_ns Time (see IThreadGetTimeNs()) the timer expires at.
+/// @param period_ns Time between expiries for a recurring timer, or 0 for a one-shot timer.  The timer wheel doesn't use this
+///         itself; whoever handles the expiry reschedules the timer.
+/// @return Pointer to timer data structure, or NULL if memory could not be reserved for it.
+IThreadTimer * IThreadTimerCreate(void * data, uint64_t expiry_ns, uint64_t period_ns)
+{
+    IThreadTimer * itt = (IThreadTimer *) malloc(sizeof(IThreadTimer));
+    if (!itt) return NULL;
+    itt->expiry_ns = expiry_ns;
+    itt->period_ns = period_ns;
+    itt->data = data;
+    itt->job = NULL;
+    atomic_init(&itt->cancelled, false);
+    itt->tick = 0;
+    itt->next = NULL;
+    return itt;
+}
+
+void IThreadTimerFree(IThreadTimer * itt)
+{
+    free(itt);
+}
+
+/// @brief Creates an empty hierarchical timer wheel.  Adding a timer and expiring one are both O(1), however many timers there
+///         are: a timer goes straight into the slot for its expiry tick (or, if that is far off, the slot of a coarser level that
+///         covers it), and the timers in a coarser slot are spread over the level below once time reaches the start of the slot.
+///         A timer wheel must only be used by one thread.
+/// @param start_ns Time (see IThreadGetTimeNs()) of tick 0.
+/// @param tick_ms Length of a tick in milliseconds (ITHREAD_TIMER_WHEEL_TICK_MS if 0 or less).
+/// @return Pointer to timer wheel data structure, or NULL if memory could not be reserved for it.
+IThreadTimerWheel * IThreadTimerWheelCreate(uint64_t start_ns, long tick_ms)
+{
+    IThreadTimerWheel * ittw = (IThreadTimerWheel *) calloc(1, sizeof(IThreadTimerWheel));
+    if (!ittw) return NULL;
+    ittw->struct_id = ITHREAD_DATA_STRUCT_ID;
+    ittw->start_ns = start_ns;
+    ittw->tick_ns = (uint64_t) (tick_ms > 0 ? tick_ms : ITHREAD_TIMER_WHEEL_TICK_MS) * 1000000ULL;
+    return ittw;
+}
+
+bool IThreadTimerWheelIsValid(IThreadTimerWheel * ittw)
+{
+    return ittw && ittw->struct_id == ITHREAD_DATA_STRUCT_ID;
+}
+
+/// @brief Puts a timer into the slot for its tick, which must not be before the current tick.  A timer due within the root level's
+///         range goes into the root slot for its tick.  Otherwise it goes into the first level whose range covers it, in the slot
+///         covering its tick, and is moved down a level each time that slot comes round.
+static void _IThreadTimerWheelPlace(IThreadTimerWheel * ittw, IThreadTimer * itt)
+{
+    const uint64_t MAXIMUM_TICKS = 1ULL << (ITHREAD_TIMER_WHEEL_ROOT_BITS + ITHREAD_TIMER_WHEEL_LEVELS * ITHREAD_TIMER_WHEEL_LEVEL_BITS);
+    if (itt->tick - ittw->current_tick >= MAXIMUM_TICKS) itt->tick = ittw->current_tick + MAXIMUM_TICKS - 1;
+    const uint64_t TICKS = itt->tick - ittw->current_tick;
+
+    IThreadTimer ** slot = &ittw->root[itt->tick & (ITHREAD_TIMER_WHEEL_ROOT_SLOTS - 1)];
+    for (int l = 0; l < ITHREAD_TIMER_WHEEL_LEVELS && TICKS >= (1ULL << (ITHREAD_TIMER_WHEEL_ROOT_BITS + l * ITHREAD_TIMER_WHEEL_LEVEL_BITS)); l++) {
+        const int SHIFT = ITHREAD_TIMER_WHEEL_ROOT_BITS + l * ITHREAD_TIMER_WHEEL_LEVEL_BITS;
+        slot = &ittw->levels[l][(itt->tick >> SHIFT) & (ITHREAD_TIMER_WHEEL_LEVEL_SLOTS - 1)];
+    }
+    itt->next = *slot;
+    *slot = itt;
+}
+
+/// @brief Adds a timer to a timer wheel.  A timer that has already expired fires on the next tick.
+/// @param ittw Pointer to timer wheel data structure.
+/// @param itt Pointer to a timer that isn't in a timer wheel.
+/// @return True if the timer was added, false if either pointer is invalid.
+bool IThreadTimerWheelAdd(IThreadTimerWheel * ittw, IThreadTimer * itt)
+{
+    if (!IThreadTimerWheelIsValid(ittw) || !itt) return false;
+    // Round up, so a timer never fires early.
+    itt->tick = itt->expiry_ns > ittw->start_ns ? (itt->expiry_ns - ittw->start_ns + ittw->tick_ns - 1) / ittw->tick_ns : 0;
+    if (itt->tick <= ittw->current_tick) itt->tick = ittw->current_tick + 1;
+    _IThreadTimerWheelPlace(ittw, itt);
+    ittw->timers_count++;
+    return true;
+}
+
+/// @brief Moves a timer wheel on to the given time, calling expired for each timer whose tick is passed.  The timer is out of the
+///         wheel by then, so expired can free it or add it back (with a later expiry time).
+/// @param ittw Pointer to timer wheel data structure.
+/// @param now_ns Current time (see IThreadGetTimeNs()).
+/// @param expired Function called as expired(timer, context) for each expired timer.
+/// @param context Pointer passed to expired.
+/// @return Number of timers that expired.
+size_t IThreadTimerWheelAdvance(IThreadTimerWheel * ittw, uint64_t now_ns, IThreadTimerExpiredFunction expired, void * context)
+{
+    if (!IThreadTimerWheelIsValid(ittw) || !expired) return 0;
+    const uint64_t TARGET_TICK = now_ns > ittw->start_ns ? (now_ns - ittw->start_ns) / ittw->tick_ns : 0;
+    size_t expired_count = 0;
+    while (ittw->current_tick < TARGET_TICK) {
+        // With nothing to fire, the wheel can jump straight to the target.
+        if (ittw->timers_count == 0) {
+            ittw->current_tick = TARGET_TICK;
+            break;
+        }
+        const uint64_t TICK = ++ittw->current_tick;
+
+        // At the start of each lap of the root level, bring the next slot of the level above down, and so on up the levels.
+        const size_t ROOT_SLOT = TICK & (ITHREAD_TIMER_WHEEL_ROOT_SLOTS - 1);
+        for (int l = 0; ROOT_SLOT == 0 && l < ITHREAD_TIMER_WHEEL_LEVELS; l++) {
+            const int SHIFT = ITHREAD_TIMER_WHEEL_ROOT_BITS + l * ITHREAD_TIMER_WHEEL_LEVEL_BITS;
+            const size_t SLOT = (TICK >> SHIFT) & (ITHREAD_TIMER_WHEEL_LEVEL_SLOTS - 1);
+            IThreadTimer * itt = ittw->levels[l][SLOT];
+            ittw->levels[l][SLOT] = NULL;
+            while (itt) {
+                IThreadTimer * next = itt->next;
+                _IThreadTimerWheelPlace(ittw, itt);
+                itt = next;
+            }
+            if (SLOT != 0) break;
+        }
+
+        IThreadTimer * itt = ittw->root[ROOT_SLOT];
+        ittw->root[ROOT_SLOT] = NULL;
+        while (itt) {
+            IThreadTimer * next = itt->next;
+            itt->next = NULL;
+            ittw->timers_count--;
+            // A timer beyond the wheel's range was parked early; put it back until its real expiry time.
+            if (itt->expiry_ns > ittw->start_ns + TICK * ittw->tick_ns) IThreadTimerWheelAdd(ittw, itt);
+            else {
+                expired(itt, context);
+                expired_count++;
+            }
+            itt = next;
+        }
+    }
+    return expired_count;
+}
+
+/// @brief Gets the time the wheel next has something to do, so that whoever drives it can sleep until then rather than advancing
+///         it every tick.  That is the first tick with a timer in its root slot or, if sooner, the first tick at which a coarser
+///         slot holding timers is spread over the level below (the timers may not expire then, but they have to be moved down
+///         before they can).
+/// @param ittw Pointer to timer wheel data structure.
+/// @return Time (see IThreadGetTimeNs()) to next advance the wheel to, or UINT64_MAX if it is empty or invalid.
+uint64_t IThreadTimerWheelGetNextExpiry(IThreadTimerWheel * ittw)
+{
+    if (!IThreadTimerWheelIsValid(ittw) || ittw->timers_count == 0) return UINT64_MAX;
+    uint64_t next_tick = UINT64_MAX;
+    // The root level only holds timers due within the current lap of it, so the first non-empty slot after the current tick is
+    // the soonest.
+    for (uint64_t t = 1; t < ITHREAD_TIMER_WHEEL_ROOT_SLOTS; t++) {
+        if (ittw->root[(ittw->current_tick + t) & (ITHREAD_TIMER_WHEEL_ROOT_SLOTS - 1)]) {
+            next_tick = ittw->current_tick + t;
+            break;
+        }
+    }
+    // A coarser slot is brought down at the start of its range, which can be a whole lap of the level away (it then shares an
+    // index with the slot that was brought down last).
+    for (int l = 0; l < ITHREAD_TIMER_WHEEL_LEVELS; l++) {
+        const int SHIFT = ITHREAD_TIMER_WHEEL_ROOT_BITS + l * ITHREAD_TIMER_WHEEL_LEVEL_BITS;
+        const uint64_t CURRENT_SLOT = ittw->current_tick >> SHIFT;
+        for (uint64_t s = 1; s <= ITHREAD_TIMER_WHEEL_LEVEL_SLOTS; s++) {
+            if (!ittw->levels[l][(CURRENT_SLOT + s) & (ITHREAD_TIMER_WHEEL_LEVEL_SLOTS - 1)]) continue;
+            if (((CURRENT_SLOT + s) << SHIFT) < next_tick) next_tick = (CURRENT_SLOT + s) << SHIFT;
+            break;
+        }
+    }
+    return next_tick == UINT64_MAX ? UINT64_MAX : ittw->start_ns + next_tick * ittw->tick_ns;
+}
+
+size_t IThreadTimerWheelGetCount(IThreadTimerWheel * ittw)
+{
+    return IThreadTimerWheelIsValid(ittw) ? ittw->timers_count : 0;
+}
+
+/// @brief Removes every timer from a slot, handing each to discard (or freeing it).
+static void _IThreadTimerWheelClearSlot(IThreadTimer ** slot, IThreadTimerExpiredFunction discard, void * context)
+{
+    while (*slot) {
+        IThreadTimer * itt = *slot;
+        *slot = itt->next;
+        itt->next = NULL;
+        if (discard) discard(itt, context);
+        else IThreadTimerFree(itt);
+    }
+}
+
+/// @brief Removes every timer from a timer wheel without waiting for them to expire.
+/// @param ittw Pointer to timer wheel data structure.
+/// @param discard Function called as discard(timer, context) for each timer, which is then the function's to free, or NULL to
+///         simply free the timers.
+/// @param context Pointer passed to discard.
+void IThreadTimerWheelClear(IThreadTimerWheel * ittw, IThreadTimerExpiredFunction discard, void * context)
+{
+    if (!IThreadTimerWheelIsValid(ittw)) return;
+    for (size_t s = 0; s < ITHREAD_TIMER_WHEEL_ROOT_SLOTS; s++) _IThreadTimerWheelClearSlot(&ittw->root[s], discard, context);
+    for (int l = 0; l < ITHREAD_TIMER_WHEEL_LEVELS; l++) {
+        for (size_t s = 0; s < ITHREAD_TIMER_WHEEL_LEVEL_SLOTS; s++) _IThreadTimerWheelClearSlot(&ittw->levels[l][s], discard, context);
+    }
+    ittw->timers_count = 0;
+}
+
+/// @brief Frees a timer wheel along with any timers still in it.
+void IThreadTimerWheelFree(IThreadTimerWheel * ittw)
+{
+    if (!IThreadTimerWheelIsValid(ittw)) return;
+    IThreadTimerWheelClear(ittw, NULL, NULL);
+    ittw->struct_id = 0;
+    free(ittw);
+}
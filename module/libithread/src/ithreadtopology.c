@@ -0,0 +1,124 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "ithreadtopology.h"
+
+#define ITHREAD_SYS_CPU_PATH "/sys/devices/system/cpu"
+
+/// @brief Reads a single integer from a sysfs file.
+/// @return The value read, or -1 if the file couldn't be read.
+static int _IThreadCpuTopologyReadInt(const char * path)
+{
+    FILE * file = fopen(path, "r");
+    if (!file) return -1;
+    int value;
+    if (fscanf(file, "%d", &value) != 1) value = -1;
+    fclose(file);
+    return value;
+}
+
+/// @brief Finds the NUMA node a CPU belongs to, from the "nodeN" link in the CPU's sysfs directory.
+/// @return The node, or -1 if the kernel doesn't report one.
+static int _IThreadCpuTopologyReadNode(int cpu)
+{
+    char path[128];
+    snprintf(path, sizeof(path), ITHREAD_SYS_CPU_PATH "/cpu%d", cpu);
+    DIR * directory = opendir(path);
+    if (!directory) return -1;
+    int node = -1;
+    struct dirent * entry;
+    while (node < 0 && (entry = readdir(directory))) {
+        if (strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9') node = atoi(entry->d_name + 4);
+    }
+    closedir(directory);
+    return node;
+}
+
+/// @brief Reads the machine's CPU topology (which NUMA node and physical core each CPU belongs to) from sysfs.  If sysfs isn't
+///         available, every configured CPU is treated as its own core on node 0.
+/// @return Pointer to topology data structure, or NULL if memory could not be reserved for it.
+IThreadCpuTopology * IThreadCpuTopologyCreate()
+{
+    IThreadCpuTopology * itct = (IThreadCpuTopology *) malloc(sizeof(IThreadCpuTopology));
+    if (!itct) return NULL;
+    long cpus_count = sysconf(_SC_NPROCESSORS_CONF);
+    if (cpus_count < 1) cpus_count = 1;
+    itct->struct_id = ITHREAD_DATA_STRUCT_ID;
+    itct->cpus_count = (int) cpus_count;
+    itct->cpu_nodes = (int *) malloc(sizeof(int) * cpus_count);
+    itct->cpu_cores = (int *) malloc(sizeof(int) * cpus_count);
+    if (!itct->cpu_nodes || !itct->cpu_cores) {
+        IThreadCpuTopologyFree(itct);
+        return NULL;
+    }
+    itct->nodes_count = 1;
+    for (int c = 0; c < itct->cpus_count; c++) {
+        char path[128];
+        snprintf(path, sizeof(path), ITHREAD_SYS_CPU_PATH "/cpu%d/topology/core_id", c);
+        const int CORE = _IThreadCpuTopologyReadInt(path);
+        snprintf(path, sizeof(path), ITHREAD_SYS_CPU_PATH "/cpu%d/topology/physical_package_id", c);
+        const int PACKAGE = _IThreadCpuTopologyReadInt(path);
+        const int NODE = _IThreadCpuTopologyReadNode(c);
+        itct->cpu_nodes[c] = NODE >= 0 ? NODE : 0;
+        // Core ids are only unique within a package, so combine the two.
+        itct->cpu_cores[c] = CORE >= 0 ? (PACKAGE >= 0 ? PACKAGE : 0) * 65536 + CORE : -1 - c;
+        if (itct->cpu_nodes[c] >= itct->nodes_count) itct->nodes_count = itct->cpu_nodes[c] + 1;
+    }
+    return itct;
+}
+
+bool IThreadCpuTopologyIsValid(IThreadCpuTopology * itct)
+{
+    return itct && itct->struct_id == ITHREAD_DATA_STRUCT_ID;
+}
+
+/// @brief Gets the NUMA node a CPU belongs to.
+/// @param itct Pointer to topology data structure.
+/// @param cpu CPU number.
+/// @return The CPU's node (0 if the topology or CPU number is invalid).
+int IThreadCpuTopologyGetNode(IThreadCpuTopology * itct, int cpu)
+{
+    if (!IThreadCpuTopologyIsValid(itct) || cpu < 0 || cpu >= itct->cpus_count) return 0;
+    return itct->cpu_nodes[cpu];
+}
+
+/// @brief Lists one CPU (the lowest numbered hardware thread) for each physical core, ordered by CPU number, which spreads workers
+///         across cores before using their hyper-threaded siblings.  Only CPUs the calling thread is allowed to run on are listed.
+/// @param itct Pointer to topology data structure.
+/// @param cpus Array that receives the CPU numbers.
+/// @param cpus_size Number of entries the array can hold.
+/// @return Number of CPUs written to the array.
+size_t IThreadCpuTopologyGetPhysicalCoreCpus(IThreadCpuTopology * itct, int * cpus, size_t cpus_size)
+{
+    if (!IThreadCpuTopologyIsValid(itct) || !cpus) return 0;
+    cpu_set_t allowed;
+    const bool HAVE_ALLOWED = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+    size_t count = 0;
+    for (int c = 0; c < itct->cpus_count && count < cpus_size; c++) {
+        if (HAVE_ALLOWED && c < CPU_SETSIZE && !CPU_ISSET(c, &allowed)) continue;
+        bool sibling_listed = false;
+        for (size_t l = 0; l < count && !sibling_listed; l++) sibling_listed = itct->cpu_cores[cpus[l]] == itct->cpu_cores[c];
+        if (!sibling_listed) cpus[count++] = c;
+    }
+    return count;
+}
+
+/// @brief Gets the CPU the calling thread is currently running on.
+/// @return CPU number, or -1 if it can't be determined.
+int IThreadGetCurrentCpu()
+{
+    return sched_getcpu();
+}
+
+void IThreadCpuTopologyFree(IThreadCpuTopology * itct)
+{
+    if (!IThreadCpuTopologyIsValid(itct)) return;
+    itct->struct_id = 0;
+    free(itct->cpu_nodes);
+    free(itct->cpu_cores);
+    free(itct);
+}
@@ -0,0 +1,71 @@
+#include "iworkerthreadjob.h"
+#include "ithreadtrace.h"
+
+/// @brief Creates a trace buffer, which holds a record of each job one worker thread has run (see
+///         IWorkerThreadControllerSetTracing()).  Only the worker thread adds to the buffer, so it needs no locks: an event is
+///         written first and then published by moving the count on, and readers only look at events below the count.  Once the
+///         buffer is full, further events are dropped (and counted) rather than overwriting events a reader could be looking at.
+/// @param capacity Number of events the buffer can hold (ITHREAD_TRACE_DEFAULT_CAPACITY if 0).
+/// @return Pointer to trace buffer data structure, or NULL if memory could not be reserved for it.
+IThreadTraceBuffer * IThreadTraceBufferCreate(size_t capacity)
+{
+    if (capacity == 0) capacity = ITHREAD_TRACE_DEFAULT_CAPACITY;
+    IThreadTraceBuffer * ittb = (IThreadTraceBuffer *) malloc(sizeof(IThreadTraceBuffer));
+    if (!ittb) return NULL;
+    ittb->events = (IThreadTraceEvent *) malloc(sizeof(IThreadTraceEvent) * capacity);
+    if (!ittb->events) {
+        free(ittb);
+        return NULL;
+    }
+    ittb->struct_id = ITHREAD_DATA_STRUCT_ID;
+    ittb->capacity = capacity;
+    atomic_init(&ittb->count, 0);
+    atomic_init(&ittb->dropped_count, 0);
+    return ittb;
+}
+
+bool IThreadTraceBufferIsValid(IThreadTraceBuffer * ittb)
+{
+    return ittb && ittb->struct_id == ITHREAD_DATA_STRUCT_ID;
+}
+
+/// @brief Records a job that has just finished running.  Must only be called by the thread that owns the buffer.
+/// @param ittb Pointer to trace buffer data structure.
+/// @param iwtj Pointer to the job, with its enqueue, start and end times set.
+/// @return True if the event was recorded, false if the buffer is full (or either pointer is invalid).
+bool IThreadTraceBufferRecord(IThreadTraceBuffer * ittb, IWorkerThreadJob * iwtj)
+{
+    if (!IThreadTraceBufferIsValid(ittb) || !iwtj) return false;
+    const size_t COUNT = atomic_load_explicit(&ittb->count, memory_order_relaxed);
+    if (COUNT == ittb->capacity) {
+        atomic_store_explicit(&ittb->dropped_count, atomic_load_explicit(&ittb->dropped_count, memory_order_relaxed) + 1, memory_order_relaxed);
+        return false;
+    }
+    ittb->events[COUNT] = (IThreadTraceEvent) {
+        .job_id = iwtj->id, .enqueue_time_ns = iwtj->enqueue_time_ns, .start_time_ns = iwtj->start_time_ns,
+        .end_time_ns = iwtj->end_time_ns, .attempt = iwtj->attempts,
+        .failed = atomic_load_explicit(&iwtj->state, memory_order_acquire) == IThreadJobStateFailed
+    };
+    atomic_store_explicit(&ittb->count, COUNT + 1, memory_order_release);
+    return true;
+}
+
+/// @brief Gets the number of events in a trace buffer.  Events below this count are complete and won't change, so a reader can
+///         safely copy them while the worker thread carries on recording.
+size_t IThreadTraceBufferGetCount(IThreadTraceBuffer * ittb)
+{
+    return IThreadTraceBufferIsValid(ittb) ? atomic_load_explicit(&ittb->count, memory_order_acquire) : 0;
+}
+
+size_t IThreadTraceBufferGetDroppedCount(IThreadTraceBuffer * ittb)
+{
+    return IThreadTraceBufferIsValid(ittb) ? atomic_load_explicit(&ittb->dropped_count, memory_order_relaxed) : 0;
+}
+
+void IThreadTraceBufferFree(IThreadTraceBuffer * ittb)
+{
+    if (!IThreadTraceBufferIsValid(ittb)) return;
+    ittb->struct_id = 0;
+    free(ittb->events);
+    free(ittb);
+}
@@ -1,58 +1,197 @@
+#include "ithread.h"
 #include "global.h"
 #include "iworkerthread.h"
 #include "iworkerthreadjob.h"
 #include "iworkerthreadcontroller.h"
 
+// The worker thread data structure of the worker running on the current thread (NULL on threads that aren't worker threads).
+static _Thread_local IWorkerThread * _iworker_thread_current = NULL;
+
+/// @brief Gets the next job for a worker thread to process.  Urgent jobs in the controller's shared job queues (those above normal
+///         priority, or that have aged) come first.  Then the worker's own deque is tried (most recently submitted job first,
+///         keeping fan-out work on the same core), then the job queue for the worker's NUMA node (if jobs are partitioned by node),
+///         then the named queues (shared between them by weight), then the remaining shared jobs.  Then the worker tries to steal
+///         the oldest job from another worker's deque, and then from another node's job queue.  Low priority jobs that haven't
+///         aged come last of all.
+/// @param itd Pointer to worker thread data structure.
+/// @return Pointer to a job or NULL if there's no work available.
+static IWorkerThreadJob * _IWorkerThreadGetNextJob(IWorkerThread * itd)
+{
+    IWorkerThreadJobProvider * iwtjp = itd->controller->job_provider;
+    IWorkerThreadJob * iwtj = IWorkerThreadJobProviderNextPriorityJob(iwtjp, IThreadPriorityHigh);
+    if (!iwtj) iwtj = IWorkerThreadJobDequePop(itd->deque);
+    if (!iwtj) iwtj = IWorkerThreadJobProviderNextNodeJob(iwtjp, itd->numa_node);
+    if (!iwtj) iwtj = IWorkerThreadJobProviderNextNamedQueueJob(iwtjp);
+    if (!iwtj) iwtj = IWorkerThreadJobProviderNextPriorityJob(iwtjp, IThreadPriorityNormal);
+    if (!iwtj) iwtj = IWorkerThreadJobProviderStealJob(iwtjp, itd->deque, &itd->steal_seed);
+    if (!iwtj) iwtj = IWorkerThreadJobProviderNextRemoteNodeJob(iwtjp, itd->numa_node);
+    if (!iwtj) iwtj = IWorkerThreadJobProviderNextJob(iwtjp);
+    // Taking a job makes room for a producer waiting on the provider's capacity.
+    if (iwtj) IWorkerThreadJobProviderJobTaken(iwtjp);
+    return iwtj;
+}
+
+/// @brief Gets the state a worker thread is left in when it exits, given the state it was in when it stopped processing work.
+static IThreadState _IWorkerThreadExitState(IThreadState state)
+{
+    switch (state) {
+        case IThreadStateStopRequested : return IThreadStateStopped;
+        case IThreadStateKillRequested : return IThreadStateKilled;
+        case IThreadStateRunning : return IThreadStateDone;
+        default: return state;
+    }
+}
+
 /// @brief This function defines how a worker thread is controlled.  If is passed to pthread_create then the 
 ///         worker thread is started (triggered by calling WorkerThreadControllerStart() ).
 /// @param data Pointer to a valid worker thread data structure.
 /// @return NULL.
 void * IWorkerThreadRun(void * data)
 {
-    // Make sure the worker thread data structure is valid and in its initialised state.
+    // Make sure the worker thread data structure is valid and in its initialised state.  If it is, set the worker thread state to
+    // running.
     IWorkerThread * itd = (IWorkerThread *) data;
-    if (!IWorkerThreadIsValid(itd) || itd->state != IThreadStateInitialised) return NULL; // It's not so exit immediately.
-    else itd->state = IThreadStateRunning; // It is, so set the worker thread state to running.
+    if (!IWorkerThreadIsValid(itd)) return NULL;
+    IThreadState state = IThreadStateInitialised;
+    if (!atomic_compare_exchange_strong_explicit(&itd->state, &state, IThreadStateRunning, memory_order_acq_rel, memory_order_acquire)) {
+        // A stop/kill request beat us to it, so settle the request and exit immediately.
+        while (!atomic_compare_exchange_weak_explicit(&itd->state, &state, _IWorkerThreadExitState(state), memory_order_acq_rel,
+                                                      memory_order_acquire));
+        return NULL;
+    }
+
+    // Remember which worker is running on this thread, so jobs submitted by our jobs can go on to our own deque.
+    _iworker_thread_current = itd;
 
     IWorkerThreadJobProvider * iwtjp = itd->controller->job_provider;
 
+    // Set up the worker's own resources (see IWorkerThreadControllerSetWorkerHooks()) on the thread that will use them.
+    IWorkerThreadController * iwtc = itd->controller;
+    if (iwtc->worker_init_function) itd->context = iwtc->worker_init_function(itd, iwtc->worker_hook_data);
+
     // Perform processing on any jobs that have been allocated to the thread until it should exit.
-    while (((itd->flag_exit_on_no_jobs && IWorkerThreadJobProviderHasJobs(iwtjp)) || !itd->flag_exit_on_no_jobs) && itd->state == IThreadStateRunning)
+    while (atomic_load_explicit(&itd->state, memory_order_acquire) == IThreadStateRunning)
     {
         // Depending on the priority of the worker thread it can process one or more jobs at a time.
-        for (int j = 0; j < itd->priority && IWorkerThreadJobProviderHasJobs(iwtjp) && itd->state == IThreadStateRunning; j++) {
-            itd->current_job = IWorkerThreadJobProviderNextJob(iwtjp);
-            if (!itd->current_job) continue;
-            // Record the job processing start time.
-            itd->current_job->start_time = time(NULL);
-            // Process the job.
-            itd->threadMainFunction(itd->current_job);
+        int jobs_processed = 0;
+        for (int j = 0; j < itd->priority && atomic_load_explicit(&itd->state, memory_order_acquire) == IThreadStateRunning; j++) {
+            itd->current_job = _IWorkerThreadGetNextJob(itd);
+            if (!itd->current_job) break;
+            jobs_processed++;
+            if (atomic_load_explicit(&itd->idle_since_ns, memory_order_relaxed)) atomic_store_explicit(&itd->idle_since_ns, 0, memory_order_relaxed);
+            // Record the job processing start time (and how long the job waited to be picked up) and mark the job as running on this thread.
+            atomic_store_explicit(&itd->current_job->worker_thread, itd, memory_order_release);
+            itd->current_job->start_time_ns = IThreadGetTimeNs();
+            atomic_store_explicit(&itd->current_job->state, IThreadJobStateRunning, memory_order_release);
+            atomic_store_explicit(&itd->busy_since_ns, itd->current_job->start_time_ns, memory_order_relaxed);
+            if (itd->current_job->enqueue_time_ns)
+                IThreadHistogramRecord(itd->wait_time_histogram, itd->current_job->start_time_ns - itd->current_job->enqueue_time_ns);
+            // A job that was cancelled, or whose deadline passed, while it was queued is not run at all.
+            if (itd->current_job->deadline_ns && itd->current_job->start_time_ns > itd->current_job->deadline_ns)
+                IWorkerThreadJobCancel(itd->current_job, ITHREAD_JOB_DEADLINE_MESSAGE);
+            const bool RUN_JOB = !IWorkerThreadJobIsCancelled(itd->current_job);
+            // Tell the controller's watchdog when the job has to be finished by.
+            if (RUN_JOB) IWorkerThreadControllerWatchJob(itd->controller, itd, itd->current_job);
+            // Process the job, using the job's own function if it has one.
+            // A resumed job (see IWorkerThreadJobYield()) is carrying on with the same attempt.
+            if (RUN_JOB && !itd->current_job->resuming) itd->current_job->attempts++;
+            itd->current_job->resuming = false;
+            if (RUN_JOB) (itd->current_job->function ? itd->current_job->function : itd->threadMainFunction)(itd->current_job);
+            // Take the job back from the watchdog.  If the watchdog cancelled it meanwhile, the job is cancelled here, on this
+            // thread, as the watchdog never touches the job data structure itself (see _IWorkerThreadControllerCheckJob()).
+            const uint64_t WATCHED_JOB = atomic_exchange(&itd->watchdog_job, 0);
+            atomic_store(&itd->watchdog_deadline_ns, 0);
+            if (WATCHED_JOB & ITHREAD_WATCHDOG_JOB_CANCELLED)
+                IWorkerThreadJobCancel(itd->current_job, WATCHED_JOB & ITHREAD_WATCHDOG_JOB_DEADLINE ? ITHREAD_JOB_DEADLINE_MESSAGE
+                                                                                                      : ITHREAD_JOB_TIMEOUT_MESSAGE);
             // Record the job processing end time.
-            itd->current_job->end_time = time(NULL);
-            // Make the job as done.
-            itd->current_job->state = IThreadJobStateDone;
-            // Record the total time it took to process the job in the thread's job run time history (this is used for smart thread killing).
-            itd->job_run_time_history[itd->jobs_run % 10] = itd->current_job->end_time - itd->current_job->start_time;
-            if (itd->jobSuccessCallbackFunction) {
-                itd->jobSuccessCallbackFunction(itd->current_job);
+            itd->current_job->end_time_ns = IThreadGetTimeNs();
+            // Record the total time it took to process the job in the thread's job run time history (this is used for smart thread killing)
+            // and run time histogram.
+            const uint64_t RUN_TIME = itd->current_job->end_time_ns - itd->current_job->start_time_ns;
+            if (RUN_JOB) {
+                itd->job_run_time_history[itd->jobs_run % 10] = RUN_TIME;
+                IThreadHistogramRecord(itd->run_time_histogram, RUN_TIME);
+            }
+            // A cancelled job that returned without failing itself is failed with the reason it was cancelled.  Either way the
+            // thread carries on with its next job.
+            if (IWorkerThreadJobIsCancelled(itd->current_job))
+                IWorkerThreadJobFailed(itd->current_job, (char *) IWorkerThreadJobGetCancelReason(itd->current_job));
+            // A job that yielded (and hasn't failed) is parked until it is resumed.  A failed job with attempts left is retried
+            // later.  Otherwise mark the job as done (unless the job failed itself), call the appropriate callback and complete the
+            // job's future.  With the completion queue on, the callback is left for the controller's owner to call (see
+            // IWorkerThreadControllerSetCompletionQueue()).
+            const bool PARK_JOB = itd->current_job->yield_requested &&
+                                  atomic_load_explicit(&itd->current_job->state, memory_order_acquire) == IThreadJobStateRunning;
+            itd->current_job->yield_requested = false;
+            const bool RETRY_JOB = !PARK_JOB && IWorkerThreadJobShouldRetry(itd->current_job);
+            IWorkerThreadCompletionQueue * completion_queue = atomic_load_explicit(&itd->controller->completion_queue_enabled, memory_order_acquire)
+                ? atomic_load_explicit(&itd->controller->completion_queue, memory_order_acquire) : NULL;
+            if (!PARK_JOB && !RETRY_JOB) {
+                if (completion_queue) IWorkerThreadJobCompleteDeferred(itd->current_job);
+                else IWorkerThreadJobComplete(itd->current_job);
             }
-            // Increment the number of jobs processed.
-            itd->jobs_run++;
+            // With tracing on, record when the job was queued, started and ended (see IWorkerThreadControllerSetTracing()).
+            if (atomic_load_explicit(&itd->controller->tracing, memory_order_relaxed))
+                IThreadTraceBufferRecord(atomic_load_explicit(&itd->trace_buffer, memory_order_acquire), itd->current_job);
+            // Update the thread's counters.  Only this thread writes to them, so plain stores are enough for readers (see
+            // IWorkerThreadControllerGetStats()) to see a recent value without a locked instruction on every job.  A failed attempt
+            // that will be retried counts as a failed run.
+            if (atomic_load_explicit(&itd->current_job->state, memory_order_acquire) == IThreadJobStateFailed)
+                atomic_store_explicit(&itd->jobs_failed, atomic_load_explicit(&itd->jobs_failed, memory_order_relaxed) + 1, memory_order_relaxed);
+            if (RETRY_JOB)
+                atomic_store_explicit(&itd->jobs_retried, atomic_load_explicit(&itd->jobs_retried, memory_order_relaxed) + 1, memory_order_relaxed);
+            atomic_store_explicit(&itd->busy_time_ns, atomic_load_explicit(&itd->busy_time_ns, memory_order_relaxed) + RUN_TIME, memory_order_relaxed);
+            atomic_store_explicit(&itd->busy_since_ns, 0, memory_order_relaxed);
+            if (PARK_JOB)
+                atomic_store_explicit(&itd->jobs_yielded, atomic_load_explicit(&itd->jobs_yielded, memory_order_relaxed) + 1, memory_order_release);
+            else atomic_store_explicit(&itd->jobs_run, atomic_load_explicit(&itd->jobs_run, memory_order_relaxed) + 1, memory_order_release);
+            // Return the job to the provider's job pool now that it has been dealt with, or hand it to the controller to retry.
+            // The job is detached from the worker first, as it may be handed out again straight away.
+            IWorkerThreadJob * finished_job = itd->current_job;
+            itd->current_job = NULL;
+            if (PARK_JOB) IWorkerThreadControllerParkJob(itd->controller, finished_job);
+            else if (!RETRY_JOB || !IWorkerThreadControllerRetryJob(itd->controller, finished_job)) {
+                // If the retry couldn't be scheduled, the failed attempt is the job's last.
+                if (RETRY_JOB && completion_queue) IWorkerThreadJobCompleteDeferred(finished_job);
+                else if (RETRY_JOB) IWorkerThreadJobComplete(finished_job);
+                IWorkerThreadStrand * strand = finished_job->strand;
+                if (completion_queue) IWorkerThreadCompletionQueuePush(completion_queue, finished_job);
+                else IWorkerThreadJobFree(finished_job);
+                // The next job with the same key can run now (see IWorkerThreadControllerAddKeyedJob()).
+                if (strand) IWorkerThreadControllerReleaseStrand(itd->controller, strand);
+            }
+            // Anything the job allocated from the worker's arena goes with it, even if its callback is still waiting in the
+            // completion queue (so results must not come from the arena; see IWorkerThreadJobArenaAlloc()).
+            IThreadArenaReset(itd->arena);
+        }
+        if (jobs_processed == 0 && !IWorkerThreadJobProviderHasJobs(iwtjp)) {
+            // There's no work available.  Either exit (if the thread has been asked to), or block until a job is added or the
+            // thread receives a stop/kill request.
+            if (itd->flag_exit_on_no_jobs) break;
+            // Record when the thread ran out of work, so an autoscaling controller can retire it if it stays idle.
+            if (!atomic_load_explicit(&itd->idle_since_ns, memory_order_relaxed))
+                atomic_store_explicit(&itd->idle_since_ns, IThreadGetTimeNs(), memory_order_relaxed);
+            IWorkerThreadJobProviderWaitForJobs(iwtjp, &itd->state);
         }
-        // have a little bit of a sleep to stop the thread hogging all the CPU core's processing time.
-        IThreadSleep(20);
     }
 
+    // Release the worker's own resources, again on the thread that set them up.
+    if (iwtc->worker_teardown_function) iwtc->worker_teardown_function(itd, itd->context);
+    itd->context = NULL;
+
     // Now the thread has done processing work (or a stop/kill request has been received), we can set it's state appropriately.
-    switch (itd->state) {
-        case IThreadStateStopRequested : itd->state = IThreadStateStopped; break;
-        case IThreadStateKillRequested : itd->state = IThreadStateKilled; break;
-        case IThreadStateRunning : itd->state = IThreadStateDone; break;
-        default: {}
-    }
+    // The state is swapped rather than stored, so a stop/kill request made while we're exiting isn't lost.
+    state = atomic_load_explicit(&itd->state, memory_order_acquire);
+    while (!atomic_compare_exchange_weak_explicit(&itd->state, &state, _IWorkerThreadExitState(state), memory_order_acq_rel,
+                                                  memory_order_acquire));
 
     // Record the time the thread exited.
     itd->end_time = time(NULL);
+    atomic_store_explicit(&itd->idle_since_ns, 0, memory_order_relaxed);
+    _iworker_thread_current = NULL;
+    // Let the controller know, in case this was the last of its worker threads.
+    IWorkerThreadControllerWake(itd->controller);
 
     // Exit the thread and return NULL.
     pthread_exit(NULL);
@@ -73,24 +212,59 @@ IWorkerThread * IWorkerThreadCreate(  void (* workFunction)(IWorkerThreadJob *),
     // Make sure the calling function has passed in a valid worker thread controller pointer.  If not, exit immediately.
     if (!IWorkerThreadControllerIsValid(itc)) return NULL;
 
-    // Try to reserve memory for a worker thread data structure.
+    // Try to reserve memory for a worker thread data structure and its deque.
     IWorkerThread * itd = (IWorkerThread *) malloc(sizeof(IWorkerThread));
-    if (itd) {
+    IWorkerThreadJobDeque * iwtjd = IWorkerThreadJobDequeCreate();
+    IThreadHistogram * wait_time_histogram = IThreadHistogramCreate();
+    IThreadHistogram * run_time_histogram = IThreadHistogramCreate();
+    IThreadArena * arena = IThreadArenaCreate(ITHREAD_ARENA_DEFAULT_BLOCK_SIZE);
+    if (!itd || !iwtjd || !wait_time_histogram || !run_time_histogram || !arena) {
+        free(itd);
+        IWorkerThreadJobDequeFree(iwtjd);
+        IThreadHistogramFree(wait_time_histogram);
+        IThreadHistogramFree(run_time_histogram);
+        IThreadArenaFree(arena);
+        return NULL;
+    } else {
         // We have managed to reserve memory, so initialise the data structure, recording the pointers to the
         // processing functions that have been passed in. 
         itd->struct_id = ITHREAD_DATA_STRUCT_ID;
         itd->start_time = itd->end_time = 0;
-        itd->state = IThreadStateInitialised;
+        atomic_init(&itd->state, IThreadStateInitialised);
         itd->priority = IThreadPriorityNormal;
         itd->handle = 0;
         itd->threadMainFunction = workFunction;
         itd->jobFailureCallbackFunction = failureFunction;
         itd->jobSuccessCallbackFunction = successFunction;
         itd->id = _ithread_current_id++;
-        itd->jobs_run = 0;
+        atomic_init(&itd->jobs_run, 0);
+        atomic_init(&itd->jobs_failed, 0);
+        atomic_init(&itd->jobs_retried, 0);
+        atomic_init(&itd->jobs_yielded, 0);
+        atomic_init(&itd->busy_time_ns, 0);
+        atomic_init(&itd->busy_since_ns, 0);
+        atomic_init(&itd->idle_since_ns, 0);
         itd->current_job = NULL;
         itd->controller = itc;
         itd->flag_exit_on_no_jobs = false;
+        itd->deque = iwtjd;
+        itd->steal_seed = (unsigned int) itd->id + 1;
+        // Worker threads aren't pinned to a CPU unless the controller is asked to (see IWorkerThreadControllerSetCpuAffinity()).
+        // An unpinned worker's NUMA node is looked up from whichever CPU it happens to be running on.
+        itd->cpu = itd->numa_node = -1;
+        atomic_init(&itd->trace_buffer, NULL);     // Only created if the controller's tracing is enabled.
+        itd->timeout = IThreadTimeoutNone;
+        itd->timeout_ms = 0;
+        atomic_init(&itd->watchdog_deadline_ns, 0); // No job running, so nothing for the controller's watchdog to check.
+        atomic_init(&itd->watchdog_job, 0);         // Only set while a job with a deadline is running.
+        itd->watchdog_jobs_count = 0;
+        atomic_init(&itd->watchdog_known_ns, UINT64_MAX);
+        atomic_init(&itd->watchdog_queued, false);
+        itd->watchdog_next = NULL;
+        itd->context = NULL;                        // Set by the controller's worker init hook, if it has one.
+        itd->arena = arena;                         // Scratch memory for jobs, emptied after each one.
+        itd->wait_time_histogram = wait_time_histogram;
+        itd->run_time_histogram = run_time_histogram;
     }
 
     // Return pointer to the worker thread data structure or NULL if we couldn't allocate memory for it.
@@ -100,16 +274,118 @@ IWorkerThread * IWorkerThreadCreate(  void (* workFunction)(IWorkerThreadJob *),
 /// @brief Gets the average time a job has taken to process.  The average is taken from the times accumulated over the past 'n'
 ///         jobs where 'n' is in the range 1..10.
 /// @param itd Pointer to worker thread data structure.
-/// @return time_t data structure holding the average processing time (or 0 if no jobs have been processed).
-time_t IWorkerThreadGetAverageJobTime(IWorkerThread * itd)
+/// @return Average processing time in nanoseconds (or 0 if no jobs have been processed).
+uint64_t IWorkerThreadGetAverageJobTime(IWorkerThread * itd)
 {
-    if (!IWorkerThreadIsValid(itd) || itd->state != IThreadStateRunning || itd->jobs_run == 0) return 0;
-    time_t total_jobs_time = 0;
+    if (!IWorkerThreadIsValid(itd) || atomic_load_explicit(&itd->state, memory_order_acquire) != IThreadStateRunning ||
+        itd->jobs_run == 0) return 0;
+    uint64_t total_jobs_time = 0;
     const size_t MAX_JOB_INDEX = itd->jobs_run <= 10 ? itd->jobs_run : 10;
     for (size_t j = 0; j < MAX_JOB_INDEX; j++) total_jobs_time += itd->job_run_time_history[j];
     return total_jobs_time / MAX_JOB_INDEX;
 }
 
+/// @brief Sets how long a worker thread may spend on a job before the controller's watchdog cancels it, to the millisecond.
+/// @param iwt Pointer to worker thread data structure.
+/// @param timeout_ms Time allowed per job in milliseconds, or IThreadTimeoutNone / IThreadTimeoutSmart (see
+///         IWorkerThreadGetWatchdogDeadline()).  Takes effect from the worker's next job.
+/// @return True if the timeout was set, false if the pointer is invalid.
+bool IWorkerThreadSetTimeoutMs(IWorkerThread * iwt, long timeout_ms)
+{
+    if (!IWorkerThreadIsValid(iwt)) return false;
+    if (timeout_ms > 0) {
+        iwt->timeout = (IThreadTimeout) ((timeout_ms + 999) / 1000);
+        iwt->timeout_ms = timeout_ms;
+    } else {
+        iwt->timeout = timeout_ms < 0 ? IThreadTimeoutSmart : IThreadTimeoutNone;
+        iwt->timeout_ms = 0;
+    }
+    return true;
+}
+
+/// @brief Works out when the job a worker thread is running has to be finished by, after which the controller's watchdog cancels
+///         it.  That is the job's own deadline (see IWorkerThreadJobSetDeadline()) or, if it comes sooner, the end of the time the
+///         worker allows per job, which depends on the worker's timeout:
+///         1) A timeout greater than 0 allows that long on each job (see IWorkerThreadSetTimeoutMs()).
+///         2) IThreadTimeoutSmart allows ITHREAD_DEFAULT_TIMEOUT_SEC until the worker has run a few jobs, then double the average
+///            time of its last 'n' jobs (where n can be up to 10).  Jobs are always given at least ITHREAD_SMART_TIMEOUT_MIN_MS, so
+///            very short jobs aren't cancelled over scheduling noise.
+///         3) IThreadTimeoutNone allows a job as long as it takes.
+///         NOTE:  This is time allocated PER JOB, not for all jobs.
+/// @param iwt Pointer to worker thread data structure.
+/// @param iwtj Pointer to the job the worker is running.
+/// @return Deadline (see IThreadGetTimeNs()), or 0 if the job can run for as long as it takes.
+uint64_t IWorkerThreadGetWatchdogDeadline(IWorkerThread * iwt, IWorkerThreadJob * iwtj)
+{
+    if (!IWorkerThreadIsValid(iwt) || !IWorkerThreadJobIsValid(iwtj)) return 0;
+    uint64_t allowed_ns = 0;
+    switch (iwt->timeout) {
+        case IThreadTimeoutSmart : {
+            if (atomic_load_explicit(&iwt->jobs_run, memory_order_relaxed) < 3) allowed_ns = ITHREAD_DEFAULT_TIMEOUT_SEC * ITHREAD_NS_PER_SEC;
+            else {
+                const uint64_t SMART_TIMEOUT = IWorkerThreadGetAverageJobTime(iwt) * 2;
+                const uint64_t MIN_TIMEOUT = ITHREAD_SMART_TIMEOUT_MIN_MS * 1000000ULL;
+                allowed_ns = SMART_TIMEOUT > MIN_TIMEOUT ? SMART_TIMEOUT : MIN_TIMEOUT;
+            }
+        } break;
+        case IThreadTimeoutNone : break;
+        default : allowed_ns = iwt->timeout_ms > 0 ? (uint64_t) iwt->timeout_ms * 1000000ULL : (uint64_t) iwt->timeout * ITHREAD_NS_PER_SEC;
+    }
+    uint64_t deadline_ns = allowed_ns ? iwtj->start_time_ns + allowed_ns : 0;
+    if (iwtj->deadline_ns && (!deadline_ns || iwtj->deadline_ns < deadline_ns)) deadline_ns = iwtj->deadline_ns;
+    return deadline_ns;
+}
+
+/// @brief Gets the reason the controller's watchdog has cancelled the job a worker thread is running, if it has.  The watchdog
+///         never writes to the job itself (see _IWorkerThreadControllerCheckJob()), so until the job returns its cancellation is
+///         only recorded against the worker.  Must be called on the worker's own thread, i.e. by the job.
+/// @param iwt Pointer to worker thread data structure.
+/// @param iwtj Pointer to the job the worker is running.
+/// @return ITHREAD_JOB_DEADLINE_MESSAGE or ITHREAD_JOB_TIMEOUT_MESSAGE, or NULL if the watchdog hasn't cancelled the job.
+const char * IWorkerThreadGetWatchdogCancelReason(IWorkerThread * iwt, IWorkerThreadJob * iwtj)
+{
+    if (!IWorkerThreadIsValid(iwt) || !iwtj || iwt->current_job != iwtj) return NULL;
+    const uint64_t WATCHED_JOB = atomic_load_explicit(&iwt->watchdog_job, memory_order_relaxed);
+    if (!(WATCHED_JOB & ITHREAD_WATCHDOG_JOB_CANCELLED)) return NULL;
+    return WATCHED_JOB & ITHREAD_WATCHDOG_JOB_DEADLINE ? ITHREAD_JOB_DEADLINE_MESSAGE : ITHREAD_JOB_TIMEOUT_MESSAGE;
+}
+
+/// @brief Gets the context a worker thread's init hook returned (see IWorkerThreadControllerSetWorkerHooks()).
+/// @param iwt Pointer to worker thread data structure.
+/// @return Pointer to the context, or NULL if there isn't one.
+void * IWorkerThreadGetContext(IWorkerThread * iwt)
+{
+    return IWorkerThreadIsValid(iwt) ? iwt->context : NULL;
+}
+
+/// @brief Gets a worker thread's scratch arena, which jobs running on the worker can allocate from without locking or freeing (see
+///         IWorkerThreadJobArenaAlloc()).  The arena is emptied each time the worker finishes with a job.
+/// @param iwt Pointer to worker thread data structure.
+/// @return Pointer to the arena, or NULL if the pointer is invalid.
+IThreadArena * IWorkerThreadGetArena(IWorkerThread * iwt)
+{
+    return IWorkerThreadIsValid(iwt) ? iwt->arena : NULL;
+}
+
+/// @brief Gets the time jobs have waited between being queued and this worker thread picking them up, at the given percentile.
+///         Can be called while the worker is running.
+/// @param iwt Pointer to worker thread data structure.
+/// @param percentile Percentile in the range 0..100 (e.g. 50.0, 99.0, 99.9).
+/// @return Wait time in nanoseconds (or 0 if no jobs have been processed).
+uint64_t IWorkerThreadGetWaitTimePercentile(IWorkerThread * iwt, double percentile)
+{
+    return IWorkerThreadIsValid(iwt) ? IThreadHistogramGetPercentile(iwt->wait_time_histogram, percentile) : 0;
+}
+
+/// @brief Gets the time this worker thread has taken to process jobs, at the given percentile.  Can be called while the worker is running.
+/// @param iwt Pointer to worker thread data structure.
+/// @param percentile Percentile in the range 0..100 (e.g. 50.0, 99.0, 99.9).
+/// @return Run time in nanoseconds (or 0 if no jobs have been processed).
+uint64_t IWorkerThreadGetRunTimePercentile(IWorkerThread * iwt, double percentile)
+{
+    return IWorkerThreadIsValid(iwt) ? IThreadHistogramGetPercentile(iwt->run_time_histogram, percentile) : 0;
+}
+
 /// @brief Indicates if a worker thread has finished.  At this stage, the thread can do no more work, either exiting naturally, or
 ///         having been stopped/killed by an external request.
 /// @param iwt Pointer to worker thread data structure.
@@ -120,8 +396,9 @@ bool IWorkerThreadDone(IWorkerThread * iwt)
     if (!IWorkerThreadIsValid(iwt)) return true;
 
     // CHeck the state of the thread and return true if the thread can no longer process any more work.
-    if (iwt->state == IThreadStateUnusable || iwt->state == IThreadStateDone ||
-        iwt->state == IThreadStateKilled || iwt->state == IThreadStateStopped) return true;
+    const IThreadState STATE = atomic_load_explicit(&iwt->state, memory_order_acquire);
+    if (STATE == IThreadStateUnusable || STATE == IThreadStateDone ||
+        STATE == IThreadStateKilled || STATE == IThreadStateStopped) return true;
 
     // Otherwise, return false, indicating the thread is still running.
     return false;
@@ -135,21 +412,67 @@ bool IWorkerThreadFree(IWorkerThread * itd)
     itd->threadMainFunction = NULL;
     itd->jobFailureCallbackFunction = NULL;
     itd->jobSuccessCallbackFunction = NULL;
-    itd->state = IThreadStateUnusable;
+    atomic_store_explicit(&itd->state, IThreadStateUnusable, memory_order_release);
     itd->id = 0;
     itd->flag_exit_on_no_jobs = false;
     itd->jobs_run = 0;
     itd->current_job = NULL;
     itd->priority = IThreadPriorityNone;
     itd->controller = NULL;
+    // Free any jobs that were pushed on to the worker's deque but never processed, then the deque itself.
+    IWorkerThreadJob * iwtj;
+    while ((iwtj = IWorkerThreadJobDequePop(itd->deque))) IWorkerThreadJobFree(iwtj);
+    IWorkerThreadJobDequeFree(itd->deque);
+    itd->deque = NULL;
+    IThreadHistogramFree(itd->wait_time_histogram);
+    IThreadHistogramFree(itd->run_time_histogram);
+    itd->wait_time_histogram = itd->run_time_histogram = NULL;
+    IThreadTraceBufferFree(atomic_exchange(&itd->trace_buffer, NULL));
+    IThreadArenaFree(itd->arena);
+    itd->arena = NULL;
     free(itd);
     return true;
 }
 
+/// @brief Asks a worker thread to stop once it has finished its current job.  If the thread is blocked waiting for work, it is woken
+///         so that it can exit straight away.
+/// @param iwt Pointer to worker thread data structure.
+void IWorkerThreadStop(IWorkerThread * iwt)
+{
+    if (!IWorkerThreadIsValid(iwt)) return;
+    // The request is swapped in, so it can't overwrite a state the worker (or a kill request) has just set.
+    IThreadState state = atomic_load_explicit(&iwt->state, memory_order_acquire), requested;
+    do {
+        // A parked worker has no thread to exit, so it is stopped straight away.
+        if (state == IThreadStateParked) requested = IThreadStateStopped;
+        else if (state == IThreadStateInitialised || state == IThreadStateRunning) requested = IThreadStateStopRequested;
+        else return;
+    } while (!atomic_compare_exchange_weak_explicit(&iwt->state, &state, requested, memory_order_acq_rel, memory_order_acquire));
+    if (requested == IThreadStateStopRequested) IWorkerThreadJobProviderWakeAll(iwt->controller->job_provider);
+}
+
+/// @brief Asks a worker thread to exit as soon as possible, abandoning any jobs it would otherwise have gone on to process.  If the
+///         thread is blocked waiting for work, it is woken so that it can exit straight away.
+/// @param iwt Pointer to worker thread data structure.
+void IWorkerThreadKill(IWorkerThread * iwt)
+{
+    if (!IWorkerThreadIsValid(iwt)) return;
+    IThreadState state = atomic_load_explicit(&iwt->state, memory_order_acquire), requested;
+    do {
+        if (state == IThreadStateParked) requested = IThreadStateKilled;
+        else if (state == IThreadStateInitialised || state == IThreadStateRunning || state == IThreadStateStopRequested)
+            requested = IThreadStateKillRequested;
+        else return;
+    } while (!atomic_compare_exchange_weak_explicit(&iwt->state, &state, requested, memory_order_acq_rel, memory_order_acquire));
+    if (requested == IThreadStateKillRequested) IWorkerThreadJobProviderWakeAll(iwt->controller->job_provider);
+}
+
 void IWorkerThreadWaitForJobs(IWorkerThread * iwt, bool flag_wait_for_jobs)
 {
     if (!IWorkerThreadIsValid(iwt)) return;
     iwt->flag_exit_on_no_jobs = !flag_wait_for_jobs;
+    // Wake the thread in case it is currently blocked waiting for jobs that it no longer needs to wait for.
+    if (iwt->flag_exit_on_no_jobs) IWorkerThreadJobProviderWakeAll(iwt->controller->job_provider);
 }
 
 int IWorkerThreadGetId(IWorkerThread * iwt)
@@ -157,7 +480,14 @@ int IWorkerThreadGetId(IWorkerThread * iwt)
     return (!IWorkerThreadIsValid(iwt)) ? -1 : iwt->id;
 }
 
+/// @brief Gets the worker thread data structure for the worker running on the calling thread.
+/// @return Pointer to worker thread data structure, or NULL if the calling thread isn't a worker thread.
+IWorkerThread * IWorkerThreadGetCurrent()
+{
+    return _iworker_thread_current;
+}
+
 bool IWorkerThreadIsValid(IWorkerThread * iwt)
 {
-    return iwt && iwt->struct_id == ITHREAD_DATA_STRUCT_ID && iwt->state != IThreadStateUnusable;
+    return iwt && iwt->struct_id == ITHREAD_DATA_STRUCT_ID && atomic_load_explicit(&iwt->state, memory_order_acquire) != IThreadStateUnusable;
 }
\ No newline at end of file
@@ -0,0 +1,117 @@
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "iworkerthreadjob.h"
+#include "iworkerthreadcompletionqueue.h"
+
+/// @brief Creates a completion queue, which hands finished jobs from the worker threads to one consuming thread (see
+///         IWorkerThreadControllerSetCompletionQueue()).  Worker threads push jobs on to a lock-free inbox (an intrusive stack
+///         linked through the jobs themselves, so pushing never allocates) and the consumer takes the whole inbox in one go,
+///         so a worker pays a single compare-and-swap per job whatever the consumer is doing.  An eventfd becomes readable
+///         whenever jobs arrive in an empty queue, so the consumer can wait for completions in an epoll/poll loop.
+/// @return Pointer to completion queue data structure, or NULL if memory or the eventfd could not be reserved.
+IWorkerThreadCompletionQueue * IWorkerThreadCompletionQueueCreate()
+{
+    IWorkerThreadCompletionQueue * iwtcq = (IWorkerThreadCompletionQueue *) malloc(sizeof(IWorkerThreadCompletionQueue));
+    if (!iwtcq) return NULL;
+    iwtcq->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (iwtcq->event_fd < 0) {
+        free(iwtcq);
+        return NULL;
+    }
+    iwtcq->struct_id = ITHREAD_DATA_STRUCT_ID;
+    atomic_init(&iwtcq->inbox, NULL);
+    iwtcq->drain_head = NULL;
+    atomic_init(&iwtcq->count, 0);
+    return iwtcq;
+}
+
+bool IWorkerThreadCompletionQueueIsValid(IWorkerThreadCompletionQueue * iwtcq)
+{
+    return iwtcq && iwtcq->struct_id == ITHREAD_DATA_STRUCT_ID;
+}
+
+/// @brief Makes the queue's eventfd readable.
+static void _IWorkerThreadCompletionQueueSignal(IWorkerThreadCompletionQueue * iwtcq)
+{
+    const uint64_t ONE = 1;
+    // The write can only fail if the counter would overflow, in which case the eventfd is readable anyway.
+    if (write(iwtcq->event_fd, &ONE, sizeof(ONE)) < 0) return;
+}
+
+/// @brief Adds a finished job to a completion queue.  Can be called by any number of threads at once.
+/// @param iwtcq Pointer to completion queue data structure.
+/// @param iwtj Pointer to a job that is in no other queue.
+void IWorkerThreadCompletionQueuePush(IWorkerThreadCompletionQueue * iwtcq, IWorkerThreadJob * iwtj)
+{
+    if (!IWorkerThreadCompletionQueueIsValid(iwtcq) || !iwtj) return;
+    atomic_fetch_add_explicit(&iwtcq->count, 1, memory_order_relaxed);
+    IWorkerThreadJob * head = atomic_load_explicit(&iwtcq->inbox, memory_order_relaxed);
+    do iwtj->next_job = head;
+    while (!atomic_compare_exchange_weak_explicit(&iwtcq->inbox, &head, iwtj, memory_order_release, memory_order_relaxed));
+    // Only the job that makes the inbox non-empty signals; the consumer takes every job in the inbox when it wakes.
+    if (!head) _IWorkerThreadCompletionQueueSignal(iwtcq);
+}
+
+/// @brief Takes up to max_jobs finished jobs from a completion queue, oldest first.  Must only be called by one thread (the
+///         consumer).  The eventfd is cleared before the inbox is emptied, so a job pushed after this call always signals again.  If
+///         jobs are left behind because max_jobs was reached, the eventfd is signalled again so that the consumer comes back for
+///         them.
+/// @param iwtcq Pointer to completion queue data structure.
+/// @param jobs Array to receive the jobs.
+/// @param max_jobs Size of jobs.
+/// @return Number of jobs put in jobs (0 if the queue is empty).
+size_t IWorkerThreadCompletionQueuePop(IWorkerThreadCompletionQueue * iwtcq, IWorkerThreadJob ** jobs, size_t max_jobs)
+{
+    if (!IWorkerThreadCompletionQueueIsValid(iwtcq) || !jobs || max_jobs == 0) return 0;
+    if (!iwtcq->drain_head) {
+        uint64_t signals;
+        if (read(iwtcq->event_fd, &signals, sizeof(signals)) < 0) signals = 0;
+        // The inbox is newest first, so reverse it.
+        IWorkerThreadJob * iwtj = atomic_exchange_explicit(&iwtcq->inbox, NULL, memory_order_acquire);
+        while (iwtj) {
+            IWorkerThreadJob * next = iwtj->next_job;
+            iwtj->next_job = iwtcq->drain_head;
+            iwtcq->drain_head = iwtj;
+            iwtj = next;
+        }
+    }
+    size_t popped = 0;
+    while (popped < max_jobs && iwtcq->drain_head) {
+        IWorkerThreadJob * iwtj = iwtcq->drain_head;
+        iwtcq->drain_head = iwtj->next_job;
+        iwtj->next_job = NULL;
+        jobs[popped++] = iwtj;
+    }
+    atomic_fetch_sub_explicit(&iwtcq->count, popped, memory_order_relaxed);
+    if (iwtcq->drain_head) _IWorkerThreadCompletionQueueSignal(iwtcq);
+    return popped;
+}
+
+/// @brief Gets the number of jobs waiting in a completion queue.
+size_t IWorkerThreadCompletionQueueGetCount(IWorkerThreadCompletionQueue * iwtcq)
+{
+    return IWorkerThreadCompletionQueueIsValid(iwtcq) ? atomic_load_explicit(&iwtcq->count, memory_order_relaxed) : 0;
+}
+
+/// @brief Gets a completion queue's eventfd, which is readable while there are jobs waiting.  The descriptor belongs to the queue:
+///         add it to an epoll/poll set, but don't read from or close it.
+int IWorkerThreadCompletionQueueGetFd(IWorkerThreadCompletionQueue * iwtcq)
+{
+    return IWorkerThreadCompletionQueueIsValid(iwtcq) ? iwtcq->event_fd : -1;
+}
+
+/// @brief Frees a completion queue, along with any jobs still waiting in it (whose callbacks are not called).
+void IWorkerThreadCompletionQueueFree(IWorkerThreadCompletionQueue * iwtcq)
+{
+    if (!IWorkerThreadCompletionQueueIsValid(iwtcq)) return;
+    IWorkerThreadJob * jobs[64];
+    size_t popped;
+    while ((popped = IWorkerThreadCompletionQueuePop(iwtcq, jobs, 64)) > 0) {
+        for (size_t j = 0; j < popped; j++) IWorkerThreadJobFree(jobs[j]);
+    }
+    close(iwtcq->event_fd);
+    iwtcq->struct_id = 0;
+    free(iwtcq);
+}
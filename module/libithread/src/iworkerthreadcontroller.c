@@ -1,8 +1,35 @@
+#define _GNU_SOURCE
+#include <sched.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
 #include "ithread.h"
 #include "iworkerthread.h"
 #include "iworkerthreadjob.h"
 #include "iworkerthreadcontroller.h"
 #include "iworkerthreadjobprovider.h"
+#include "iworkerthreadjobfuture.h"
+
+/// @brief Sets up what the controller thread sleeps on between rounds: a timerfd, armed for the next time it has something to do,
+///         and an eventfd other threads use to wake it early, both in an epoll set.  If any of them can't be created, the
+///         controller thread falls back to waking every ITHREAD_CONTROLLER_PERIOD_MS.
+static void _IWorkerThreadControllerCreateWaitSet(IWorkerThreadController * itc)
+{
+    itc->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    itc->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    itc->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    struct epoll_event timer_event = { .events = EPOLLIN, .data.fd = itc->timer_fd };
+    struct epoll_event wake_event = { .events = EPOLLIN, .data.fd = itc->wake_fd };
+    if (itc->epoll_fd >= 0 && itc->timer_fd >= 0 && itc->wake_fd >= 0 &&
+        epoll_ctl(itc->epoll_fd, EPOLL_CTL_ADD, itc->timer_fd, &timer_event) == 0 &&
+        epoll_ctl(itc->epoll_fd, EPOLL_CTL_ADD, itc->wake_fd, &wake_event) == 0) return;
+    if (itc->epoll_fd >= 0) close(itc->epoll_fd);
+    if (itc->timer_fd >= 0) close(itc->timer_fd);
+    if (itc->wake_fd >= 0) close(itc->wake_fd);
+    itc->epoll_fd = itc->timer_fd = itc->wake_fd = -1;
+}
 
 /// @brief Creates and initialises a worker thread controller data structure, then passes back a pointer to it's data.
 /// @return Pointer to the worker thread controller (IWorkerThreadController) data structure.
@@ -19,21 +46,56 @@ IWorkerThreadController * IWorkerThreadControllerCreate()
                                                     // list will be resized to allow more additions.
         itc->threads = (IWorkerThread **) malloc(sizeof(IWorkerThread *) * itc->threads_buffer_size); // List of threads allocated to data structure.
         itc->stop = itc->running = false;           // Initially the controller should do nothing until it is asked to start.
+        itc->handle = 0;                            // There is no controller thread to wait for until it is started.
+        atomic_init(&itc->started, false);          // Set by IWorkerThreadControllerStart(), before the controller thread runs.
         itc->job_provider = IWorkerThreadJobProviderCreate();  // Create a job provider and store a reference to it.
+        itc->start_time_ns = IThreadGetTimeNs();    // Statistics rates are measured from here until the first snapshot is taken.
+        atomic_init(&itc->timeout_kills, 0);        // Number of jobs the watchdog has cancelled for running past their timeout.
+        itc->autoscale = false;                     // By default every worker thread runs for the lifetime of the controller.
+        itc->min_threads = itc->max_threads = 0;
+        itc->autoscale_target_wait_ns = itc->autoscale_idle_grace_ns = itc->autoscale_last_change_ns = 0;
+        itc->topology = NULL;                       // The CPU topology is only read if worker threads are pinned or jobs partitioned.
+        itc->affinity_cpus = NULL;                  // By default worker threads can run on any CPU.
+        itc->affinity_cpus_count = 0;
+        itc->timer_wheel = IThreadTimerWheelCreate(itc->start_time_ns, ITHREAD_TIMER_WHEEL_TICK_MS); // Delayed and recurring jobs.
+        atomic_init(&itc->timer_inbox, NULL);       // Timers scheduled since the controller thread last looked.
+        atomic_init(&itc->paused_jobs, 0);         // Jobs that have yielded and are waiting to be resumed.
+        atomic_init(&itc->tracing, false);          // Job spans are only recorded once tracing is enabled.
+        itc->trace_capacity = 0;
+        atomic_init(&itc->completion_queue, NULL);  // Finished jobs' callbacks run on the worker threads until a completion queue is enabled.
+        atomic_init(&itc->completion_queue_enabled, false);
+        itc->watchdog_deadlines = IThreadDeadlineHeapCreate(); // Deadlines of the jobs the worker threads are running.
+        atomic_init(&itc->watchdog_inbox, NULL);    // Workers whose deadlines have come forward since the controller thread last looked.
+        itc->worker_init_function = NULL;           // Worker threads have no context of their own unless hooks are set.
+        itc->worker_teardown_function = NULL;
+        itc->worker_hook_data = NULL;
+        atomic_init(&itc->strands, NULL);           // Only created once a keyed job is added.
+        _IWorkerThreadControllerCreateWaitSet(itc);
     }
     return itc; // Return pointer to newly created IWorkerThreadController data structure or NULL if there was not enough memory.
 }
 
-/// @brief Frees any memory reserved for a worker thread controller data structure, if one can be found at the given pointer.
+/// @brief Throws away a timer that will never expire, along with the job waiting on it for a retry (if any).
+static void _IWorkerThreadControllerTimerDiscarded(IThreadTimer * itt, void * context)
+{
+    (void) context;
+    if (itt->job) IWorkerThreadJobFree(itt->job);
+    IThreadTimerFree(itt);
+}
+
+/// @brief Frees any memory reserved for a worker thread controller data structure, if one can be found at the given pointer.  A
+///         running controller is stopped first.  If a worker thread is stuck in a job and won't exit, nothing is freed: the memory
+///         is leaked rather than pulled from under the thread, unless this is called again once the thread has exited.
 /// @param itc Pointer to the worker thread controller (IWorkerThreadController) data structure.
-/// @return True if the pointer referenced a valid worker thread controller data structure or false otherwise.
+/// @return True if the data structure was freed, false if the pointer was invalid or a thread is still running.
 bool IWorkerThreadControllerFree(IWorkerThreadController * itc)
 {
     // Check to see if the given pointer references a valid worker thread controller data structure.  If not, return false.
     if (!IWorkerThreadControllerIsValid(itc)) return false;
 
-    // Check to se eif the worker thread controller is running.  if so, stop it.
-    if (itc->running) IWorkerThreadControllerStop(itc);
+    // If the worker thread controller was started, stop it.  This waits for the controller and worker threads to exit.  If one
+    // won't, nothing can be freed, as it may still be using any of it (the job provider, pools and worker arenas included).
+    if (!IWorkerThreadControllerStop(itc)) return false;
     
     // Reset any parameter values associated with the data structure to their defaults.
     itc->running = false;
@@ -52,16 +114,217 @@ bool IWorkerThreadControllerFree(IWorkerThreadController * itc)
         // remove pointer to the list of threads.
         itc->threads = NULL;
     }
+    // Keyed jobs still waiting their turn are dropped.
+    IWorkerThreadStrandSetFree(atomic_exchange(&itc->strands, NULL));
+    // Finished jobs that were never drained are thrown away without their callbacks being called.
+    IWorkerThreadCompletionQueueFree(atomic_exchange(&itc->completion_queue, NULL));
+    // Scheduled jobs that haven't come due are dropped, as are jobs waiting to be retried (which go back to the job provider's pool,
+    // so this has to happen before the provider is freed).
+    IThreadTimer * itt = atomic_exchange(&itc->timer_inbox, NULL);
+    while (itt) {
+        IThreadTimer * next = itt->next;
+        _IWorkerThreadControllerTimerDiscarded(itt, itc);
+        itt = next;
+    }
+    IThreadTimerWheelClear(itc->timer_wheel, _IWorkerThreadControllerTimerDiscarded, itc);
+    IThreadTimerWheelFree(itc->timer_wheel);
+    itc->timer_wheel = NULL;
+    IThreadDeadlineHeapFree(itc->watchdog_deadlines);
+    itc->watchdog_deadlines = NULL;
+    if (itc->epoll_fd >= 0) {
+        close(itc->epoll_fd);
+        close(itc->timer_fd);
+        close(itc->wake_fd);
+        itc->epoll_fd = itc->timer_fd = itc->wake_fd = -1;
+    }
     if (itc->job_provider) {
         IWorkerThreadJobProviderFree(itc->job_provider);
         itc->job_provider = NULL;
     }
+    IThreadCpuTopologyFree(itc->topology);
+    itc->topology = NULL;
+    free(itc->affinity_cpus);
+    itc->affinity_cpus = NULL;
     // Free any remaining memory allocated to the IWorkerThreadController data structure.
     free(itc);
     // Return true to indicate the memory allocated to the worker thread controller data structure.
     return true;
 }
 
+/// @brief Indicates if a worker thread is parked: not running, but able to be (re)started by an autoscaling controller.
+static bool _IWorkerThreadControllerWorkerIsParked(IWorkerThread * itd)
+{
+    return IWorkerThreadIsValid(itd) && !itd->handle && atomic_load_explicit(&itd->state, memory_order_acquire) == IThreadStateParked;
+}
+
+/// @brief Starts (or restarts) a worker thread on a new pthread.  If the worker has been given a CPU, the pthread is created pinned
+///         to it, so it never runs (or touches memory) anywhere else.  If the CPU can't be used (e.g. it has been taken out of the
+///         process's CPU set since the controller was set up), the worker runs unpinned instead.
+/// @return True if the pthread was created, false otherwise.
+static bool _IWorkerThreadControllerStartWorker(IWorkerThread * itd)
+{
+    atomic_store_explicit(&itd->state, IThreadStateInitialised, memory_order_release);
+    if (itd->cpu >= 0) {
+        pthread_attr_t attributes;
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        CPU_SET(itd->cpu, &cpu_set);
+        bool created = false;
+        if (pthread_attr_init(&attributes) == 0) {
+            created = pthread_attr_setaffinity_np(&attributes, sizeof(cpu_set), &cpu_set) == 0 &&
+                      pthread_create(&itd->handle, &attributes, IWorkerThreadRun, itd) == 0;
+            pthread_attr_destroy(&attributes);
+        }
+        if (created) return true;
+        itd->cpu = itd->numa_node = -1;
+    }
+    if (pthread_create(&itd->handle, NULL, IWorkerThreadRun, itd) == 0) return true;
+    itd->handle = 0;
+    atomic_store_explicit(&itd->state, IThreadStateStopped, memory_order_release);
+    return false;
+}
+
+/// @brief Grows or shrinks an autoscaling controller's pool of running worker threads.  Called from the controller's watchdog
+///         loop.  At most one worker thread is started or retired per call, and nothing changes for ITHREAD_AUTOSCALE_PERIOD_MS
+///         after a change, so that the effect of the previous change can be seen first.
+///         1) If the oldest job in the shared job queues has waited longer than the target wait time, a parked worker is started.
+///         2) If a worker has been idle for longer than the grace period and more than min_threads are running, it is asked to
+///            stop.  Once it has exited it is joined and parked, ready to be restarted.
+static void _IWorkerThreadControllerAutoscale(IWorkerThreadController * itc)
+{
+    // Join any workers that have exited since the last call, so they can be restarted.
+    int running = 0;
+    for (int t = 0; t < itc->threads_count; t++) {
+        IWorkerThread * itd = itc->threads[t];
+        if (!IWorkerThreadIsValid(itd)) continue;
+        if (itd->handle && IWorkerThreadDone(itd)) {
+            pthread_join(itd->handle, NULL);
+            itd->handle = 0;
+        }
+        // A worker that has exited (or couldn't be started) is parked rather than done, so the controller keeps running while
+        // it has workers to restart.
+        if (!itd->handle && IWorkerThreadDone(itd)) atomic_store_explicit(&itd->state, IThreadStateParked, memory_order_release);
+        if (itd->handle && atomic_load_explicit(&itd->state, memory_order_acquire) != IThreadStateStopRequested) running++;
+    }
+
+    const uint64_t NOW = IThreadGetTimeNs();
+    if (NOW - itc->autoscale_last_change_ns < ITHREAD_AUTOSCALE_PERIOD_MS * 1000000ULL) return;
+
+    const uint64_t OLDEST_ENQUEUE_TIME = IWorkerThreadJobProviderGetOldestEnqueueTime(itc->job_provider);
+    const bool BACKLOGGED = OLDEST_ENQUEUE_TIME && NOW > OLDEST_ENQUEUE_TIME && NOW - OLDEST_ENQUEUE_TIME > itc->autoscale_target_wait_ns;
+    if ((BACKLOGGED && running < itc->max_threads) || running < itc->min_threads) {
+        for (int t = 0; t < itc->threads_count; t++) {
+            if (_IWorkerThreadControllerWorkerIsParked(itc->threads[t]) && _IWorkerThreadControllerStartWorker(itc->threads[t])) {
+                itc->autoscale_last_change_ns = NOW;
+                break;
+            }
+        }
+    } else if (!BACKLOGGED && running > itc->min_threads) {
+        // Retire the idle worker with the highest index, keeping the running workers packed at the start of the list.
+        for (int t = itc->threads_count - 1; t >= 0; t--) {
+            IWorkerThread * itd = itc->threads[t];
+            if (!IWorkerThreadIsValid(itd) || !itd->handle ||
+                atomic_load_explicit(&itd->state, memory_order_acquire) != IThreadStateRunning) continue;
+            const uint64_t IDLE_SINCE = atomic_load_explicit(&itd->idle_since_ns, memory_order_relaxed);
+            if (IDLE_SINCE && NOW > IDLE_SINCE && NOW - IDLE_SINCE > itc->autoscale_idle_grace_ns) {
+                IWorkerThreadStop(itd);
+                itc->autoscale_last_change_ns = NOW;
+                break;
+            }
+        }
+    }
+}
+
+/// @brief Puts a worker thread's deadline on the watchdog's deadline heap, if it is earlier than the one the watchdog already has
+///         for the worker.  A worker has at most one live entry on the heap: the one whose deadline matches its watchdog_known_ns.
+///         Entries it had before are left to be skipped when they reach the top, rather than searched for.
+static void _IWorkerThreadControllerTrackDeadline(IWorkerThreadController * itc, IWorkerThread * itd, uint64_t deadline_ns)
+{
+    if (!deadline_ns || deadline_ns >= atomic_load(&itd->watchdog_known_ns)) return;
+    if (IThreadDeadlineHeapPush(itc->watchdog_deadlines, deadline_ns, itd)) atomic_store(&itd->watchdog_known_ns, deadline_ns);
+}
+
+/// @brief Cancels the job a worker thread is running if it has run past its deadline (see IWorkerThreadGetWatchdogDeadline()).
+///         The job is cancelled rather than the thread, which could leave locks held or the heap in an inconsistent state.  The
+///         job is expected to notice (see IWorkerThreadJobIsCancelled()) and return, after which the worker thread fails it and
+///         moves on to its next job.  The watchdog never touches the job data structure, which may be finished with and recycled
+///         for another job at any moment.  It only looks at the number and deadline the worker publishes for its running job (see
+///         IWorkerThreadControllerWatchJob()), and cancels by flagging that number, which only succeeds if the worker is still
+///         running the same job.  The worker passes the cancellation on to the job itself.
+static void _IWorkerThreadControllerCheckJob(IWorkerThreadController * itc, IWorkerThread * itd, uint64_t now_ns)
+{
+    uint64_t watched_job = atomic_load(&itd->watchdog_job);
+    if (!watched_job || (watched_job & ITHREAD_WATCHDOG_JOB_CANCELLED)) return;
+    // The worker publishes a job's deadline before its number and withdraws it after, so a deadline read here belongs to the
+    // job just read, unless the worker has moved on, in which case the number has changed and the exchange below fails.
+    const uint64_t DEADLINE = atomic_load(&itd->watchdog_deadline_ns);
+    if (!DEADLINE || now_ns < DEADLINE) return;
+    if (!atomic_compare_exchange_strong(&itd->watchdog_job, &watched_job, watched_job | ITHREAD_WATCHDOG_JOB_CANCELLED)) return;
+    // A job that has run past its own deadline is cancelled as such; otherwise it has used up the time its worker allows.
+    if (!(watched_job & ITHREAD_WATCHDOG_JOB_DEADLINE)) atomic_fetch_add(&itc->timeout_kills, 1);
+}
+
+/// @brief Checks the worker threads whose job deadlines have passed.  Rather than looking at every worker each time round, the
+///         watchdog keeps a min-heap of deadlines and only looks at the workers at the top of it.  A worker reports a new job's
+///         deadline only if it is earlier than the one the watchdog has for it (see IWorkerThreadControllerWatchJob()), which is
+///         rare as each job starts later than the last.  When a worker's entry comes due, the watchdog cancels the job if it is
+///         still running, then moves the entry on to whatever job the worker is running by then.
+static void _IWorkerThreadControllerRunWatchdog(IWorkerThreadController * itc, uint64_t now_ns)
+{
+    IWorkerThread * itd = atomic_exchange(&itc->watchdog_inbox, NULL);
+    while (itd) {
+        IWorkerThread * next = itd->watchdog_next;
+        atomic_store(&itd->watchdog_queued, false);
+        _IWorkerThreadControllerTrackDeadline(itc, itd, atomic_load(&itd->watchdog_deadline_ns));
+        itd = next;
+    }
+    IThreadDeadline deadline;
+    while (IThreadDeadlineHeapPeek(itc->watchdog_deadlines) <= now_ns && IThreadDeadlineHeapPop(itc->watchdog_deadlines, &deadline)) {
+        itd = (IWorkerThread *) deadline.data;
+        if (deadline.deadline_ns != atomic_load(&itd->watchdog_known_ns)) continue;
+        const uint64_t CHECKED = atomic_load(&itd->watchdog_deadline_ns);
+        _IWorkerThreadControllerCheckJob(itc, itd, now_ns);
+        // Forget the worker's deadline before looking at it again, so a deadline the worker publishes meanwhile is either seen
+        // here or reported by the worker (see IWorkerThreadControllerWatchJob()).  A deadline that was just dealt with is dropped.
+        atomic_store(&itd->watchdog_known_ns, UINT64_MAX);
+        const uint64_t NEXT = atomic_load(&itd->watchdog_deadline_ns);
+        if (NEXT != CHECKED || NEXT > now_ns) _IWorkerThreadControllerTrackDeadline(itc, itd, NEXT);
+    }
+}
+
+/// @brief Sleeps until the controller thread next has something to do: the earliest job deadline, the next tick at which the
+///         timer wheel has work (see IThreadTimerWheelGetNextExpiry()), or the next autoscaling check, whichever comes first.
+///         With none of those, it sleeps until woken (see IWorkerThreadControllerWake()), so an idle controller uses no CPU at all.
+static void _IWorkerThreadControllerWait(IWorkerThreadController * itc)
+{
+    const uint64_t NOW = IThreadGetTimeNs();
+    uint64_t wake_ns = IThreadDeadlineHeapPeek(itc->watchdog_deadlines);
+    const uint64_t NEXT_TIMER = IThreadTimerWheelGetNextExpiry(itc->timer_wheel);
+    if (NEXT_TIMER < wake_ns) wake_ns = NEXT_TIMER;
+    if (itc->autoscale && NOW + ITHREAD_CONTROLLER_PERIOD_MS * 1000000ULL < wake_ns) wake_ns = NOW + ITHREAD_CONTROLLER_PERIOD_MS * 1000000ULL;
+    if (wake_ns <= NOW) return;
+    if (itc->epoll_fd < 0) {
+        const uint64_t SLEEP_MS = (wake_ns - NOW + 999999) / 1000000;
+        IThreadSleep(SLEEP_MS < ITHREAD_CONTROLLER_PERIOD_MS ? (long) SLEEP_MS : ITHREAD_CONTROLLER_PERIOD_MS);
+        return;
+    }
+    // Disarm the timer if there's nothing to wake for (an all zero it_value disarms it).
+    struct itimerspec timer = { 0 };
+    if (wake_ns != UINT64_MAX) {
+        timer.it_value.tv_sec = (time_t) (wake_ns / ITHREAD_NS_PER_SEC);
+        timer.it_value.tv_nsec = (long) (wake_ns % ITHREAD_NS_PER_SEC);
+    }
+    timerfd_settime(itc->timer_fd, TFD_TIMER_ABSTIME, &timer, NULL);
+    struct epoll_event events[2];
+    const int READY = epoll_wait(itc->epoll_fd, events, 2, -1);
+    for (int e = 0; e < READY; e++) {
+        uint64_t count;
+        if (read(events[e].data.fd, &count, sizeof(count)) < 0) continue;
+    }
+}
+
+static void _IWorkerThreadControllerRunTimers(IWorkerThreadController * itc);
+
 /// @brief This function defines how a worker thread controller works.  Essentially, when a worker thread controller is started,
 ///         this function is passed to pthread_create, along with a pointer to the worker thread controller data structure.
 /// @param data Pointer to a valid worker thread controller (IWorkerThreadController) data structure.
@@ -82,49 +345,47 @@ void * IWorkerThreadControllerRun(void * data)
         for (int t = 0; t < itc->threads_count; t++) {
             IWorkerThread * itd = itc->threads[t];
             if (!IWorkerThreadIsValid(itd)) continue;
+            // If the worker threads are to be pinned, hand out the CPUs in turn (a worker keeps its CPU if it is parked and restarted).
+            if (itc->affinity_cpus_count > 0) {
+                itd->cpu = itc->affinity_cpus[t % itc->affinity_cpus_count];
+                itd->numa_node = IThreadCpuTopologyGetNode(itc->topology, itd->cpu);
+            }
             // Also, at this current point in time, the worker thread data structure should be in its initialised state.  If not, kill it.
-            if (itd->state != IThreadStateInitialised) itd->state = IThreadStateKilled;
-            else pthread_create(&itd->handle, NULL, IWorkerThreadRun, itd); // The worker thread state is good, so we can create a pthread that
-                                                                            // uses the worker thread data structure.
+            if (atomic_load_explicit(&itd->state, memory_order_acquire) != IThreadStateInitialised)
+                atomic_store_explicit(&itd->state, IThreadStateKilled, memory_order_release);
+            // An autoscaling controller only starts min_threads workers to begin with.  The rest are parked until they're needed.
+            else if (itc->autoscale && t >= itc->min_threads) atomic_store_explicit(&itd->state, IThreadStateParked, memory_order_release);
+            else _IWorkerThreadControllerStartWorker(itd); // The worker thread state is good, so we can create a pthread that uses the
+                                                           // worker thread data structure.
         }
+        itc->autoscale_last_change_ns = IThreadGetTimeNs();
     } else itc->running = false; // The controlling program has asked the worker thread controller to stop, so set a flag to indicate as such.
    
     // Whilst the worker thread controller isn't stopped and there's work to be done, we need to keep an eye on it's worker threads to make
     // sure they're behaving and not taking too long to do a job.
     while (!IWorkerThreadControllerChildThreadsDone(itc) && !itc->stop) {
-        for (int t = 0; t < itc->threads_count; t++) {
-            IWorkerThread * itd = itc->threads[t];
-            if (!itd) continue;
-            if (itd->current_job && itd->current_job->state == IThreadJobStateRunning) {
-                // The controller's current worker thread is running and has an active job.  Find out how long the job has taken so far (in secnods).
-                const time_t CURRENT_JOB_TIME = time(NULL) - itd->current_job->start_time;
-                // Depending on the configuration of the worker thread, it can either wait for a job to finish indefinitely - or wait for one of
-                // two time periods before the thread is killed (cancelled).  NOTE:  This is time allocated PER JOB, not for all jobs.
-                // 1) If a timeout value is given that is greater than 0 seconds, the thread will be allowed to work for that amount of time
-                //      on a job, before it is killed.
-                // 2) Depending on how many jobs have been completed the thread will timeout after ITHREAD_DEFAULT_TIMEOUT_SEC (if only one job has run)
-                //      or after double the average amount of time it has taken to run the last 'n' jobs (where n can be up to 10).
-                bool kill_thread = false;
-                switch (itd->timeout) {
-                    case IThreadTimeoutSmart : {
-                        if (itd->jobs_run < 3 && CURRENT_JOB_TIME > ITHREAD_DEFAULT_TIMEOUT_SEC) kill_thread = true;
-                        else if (CURRENT_JOB_TIME > IWorkerThreadGetAverageJobTime(itd) * 2) kill_thread = true;
-                    } break;
-                    case IThreadTimeoutNone : break;
-                    default : {
-                        if (CURRENT_JOB_TIME > itd->timeout) kill_thread = true;
-                    }
-                }
-                if (kill_thread) {
-                    pthread_cancel(itd->handle);
-                    IWorkerThreadJobFailed(itd->current_job, "Processing thread killed due to timeout.");
-                    itd->state = IThreadStateKilledNoResponse;
-                }
-            }
-        }
-        // Sleep for a short period of time to stop the worker thread controller thread hogging a CPU core's processing time.
-        IThreadSleep(20);
+        _IWorkerThreadControllerRunWatchdog(itc, IThreadGetTimeNs());
+        if (itc->autoscale) _IWorkerThreadControllerAutoscale(itc);
+        _IWorkerThreadControllerRunTimers(itc);
+        _IWorkerThreadControllerWait(itc);
+    }
+    // If the controller has been asked to stop, pass the request on to the worker threads.  Any that are blocked waiting for
+    // jobs will be woken so they can exit.
+    if (itc->stop) {
+        for (int t = 0; t < itc->threads_count; t++) IWorkerThreadStop(itc->threads[t]);
     }
+
+    // Wait for the worker threads to exit, but not forever: a worker stuck in a job is left for IWorkerThreadControllerStop() to
+    // report, so the controller thread itself always exits.
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += ITHREAD_CONTROLLER_STOP_TIMEOUT_SEC;
+    for (int t = 0; t < itc->threads_count; t++) {
+        IWorkerThread * itd = itc->threads[t];
+        if (!IWorkerThreadIsValid(itd) || !itd->handle) continue;
+        if (pthread_timedjoin_np(itd->handle, NULL, &deadline) == 0) itd->handle = 0;
+    }
+
     // If the controller has been stopped or there's no more work to do, flag the controller as no longer running.
     itc->running = false;
 
@@ -158,6 +419,14 @@ IWorkerThread * IWorkerThreadControllerAddWorkerThread(IWorkerThreadController *
         // We have created a worker thread data structure (and it has been initialised), so set it's timeout method and add it to the
         // worker thread controller list of worker threads.
         itd->timeout = timeout < 0 ? IThreadTimeoutSmart : timeout;
+        itd->timeout_ms = itd->timeout > 0 ? (long) itd->timeout * 1000 : 0;
+        // Register the worker thread's deque with the job provider so idle workers can steal from it.
+        if (!IWorkerThreadJobProviderAddDeque(itc->job_provider, itd->deque)) {
+            IWorkerThreadFree(itd);
+            return NULL;
+        }
+        // A worker added while tracing is enabled records its jobs too.  If its buffer can't be created, it simply isn't traced.
+        if (atomic_load(&itc->tracing)) atomic_store_explicit(&itd->trace_buffer, IThreadTraceBufferCreate(itc->trace_capacity), memory_order_release);
         itc->threads[itc->threads_count++] = itd;
         // Make sure the worker thread controller worker thrad list isn't full.  If it is resize it.
         if (itc->threads_count == itc->threads_buffer_size) {
@@ -186,38 +455,61 @@ bool IWorkerThreadControllerChildThreadsDone(IWorkerThreadController * itc)
 
 /// @brief Given a valid worker thread controller data structure, this function will start the worker thread controller on its own thread.
 /// @param itc Pointer to a worker thread controller data structure.
-/// @return True if the data structure was valid, false otherwise.
+/// @return True if the data structure was valid and the controller thread was started, false otherwise (including if the controller
+///         had already been started).
 bool IWorkerThreadControllerStart(IWorkerThreadController * itc)
 {
     if (!IWorkerThreadControllerIsValid(itc) || itc->threads_count == 0) return false;
-    pthread_create(&itc->handle, NULL, IWorkerThreadControllerRun, itc);
+    // Mark the controller as started here rather than in the controller thread, so settings that can only be changed before it
+    // starts are refused as soon as this returns.
+    if (atomic_exchange(&itc->started, true)) return false;
+    itc->start_time_ns = IThreadGetTimeNs();
+    if (pthread_create(&itc->handle, NULL, IWorkerThreadControllerRun, itc) != 0) {
+        atomic_store(&itc->started, false);
+        return false;
+    }
     return true;
 }
 
-/// @brief Requests that the worker thread controller stop.  If the controller thread does not stop in a sensible fashion, it will be killed.
+/// @brief Requests that the worker thread controller stop, and waits for the controller and worker threads to exit.  The controller
+///         thread gives its workers ITHREAD_CONTROLLER_STOP_TIMEOUT_SEC to finish their jobs, then any that are left are asked to
+///         exit as soon as they can and given as long again.  Threads are never killed: one that is stuck in a job that won't
+///         return is left running, and reported by returning false.  Can be called again later to wait for it some more.
 /// @param itc Pointer to worker thread controller data structure.
-void IWorkerThreadControllerStop(IWorkerThreadController * itc)
+/// @return True if no thread is left using the controller (including if it was never started), false if the pointer is invalid
+///         or a thread is still running, in which case the controller must not be freed yet (see IWorkerThreadControllerFree()).
+bool IWorkerThreadControllerStop(IWorkerThreadController * itc)
 {
     // Make sure the calling function has provided a sensible worker thread controller data structure.
-    if (!IWorkerThreadControllerIsValid(itc) || itc->threads_count == 0) return;
+    if (!IWorkerThreadControllerIsValid(itc)) return false;
+    if (itc->threads_count == 0) return true;
 
     // Set the stop flag for the controller thread.
     itc->stop = true;
+    IWorkerThreadControllerWake(itc);
 
-    // Record when the stop request was made.
-    const time_t REQUEST_CONTROLLER_STOP_TIME = time(NULL);
-
-    // Wait for five seconds or until the controller has stopped running.
-    while (itc->running && time(NULL) < REQUEST_CONTROLLER_STOP_TIME + 5) {
-        IThreadSleep(20);
-    }
+    // The controller thread waits up to ITHREAD_CONTROLLER_STOP_TIMEOUT_SEC for its workers, so allow for that before giving up
+    // on it.
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += 2 * ITHREAD_CONTROLLER_STOP_TIMEOUT_SEC;
+    if (itc->handle && pthread_timedjoin_np(itc->handle, NULL, &deadline) == 0) itc->handle = 0;
+    if (itc->handle) return false;
+    itc->running = false;
 
-    // Check to see if the controller is still running.
-    if (itc->running) {
-        // It is, so kill the controller thread.
-        itc->running = false;
-        pthread_cancel(itc->handle);
+    // Any worker the controller thread couldn't join is still busy with a job.  Ask it to exit as soon as the job returns, and
+    // wait a while longer for it.
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += ITHREAD_CONTROLLER_STOP_TIMEOUT_SEC;
+    int threads_running = 0;
+    for (int t = 0; t < itc->threads_count; t++) {
+        IWorkerThread * itd = itc->threads[t];
+        if (!IWorkerThreadIsValid(itd) || !itd->handle) continue;
+        IWorkerThreadKill(itd);
+        if (pthread_timedjoin_np(itd->handle, NULL, &deadline) == 0) itd->handle = 0;
+        else threads_running++;
     }
+    return threads_running == 0;
 }
 
 /// @brief Indicates if the worker thread controller is running.
@@ -230,6 +522,44 @@ bool IWorkerThreadControllerIsRunning(IWorkerThreadController * itc)
     return is_running;
 }
 
+/// @brief Wakes the controller thread, so it looks at its worker threads, timers and job deadlines straight away rather than when
+///         it next planned to.
+/// @param iwtc Pointer to worker thread controller data structure.
+void IWorkerThreadControllerWake(IWorkerThreadController * iwtc)
+{
+    if (!IWorkerThreadControllerIsValid(iwtc) || iwtc->wake_fd < 0) return;
+    const uint64_t ONE = 1;
+    // The write can only fail if the counter would overflow, in which case the controller is being woken anyway.
+    if (write(iwtc->wake_fd, &ONE, sizeof(ONE)) < 0) return;
+}
+
+/// @brief Tells the controller's watchdog when the job a worker thread has just started has to be finished by (see
+///         IWorkerThreadGetWatchdogDeadline()).  Called by the worker thread.  Usually this is just two stores: the controller is only
+///         woken if the deadline is earlier than any the watchdog has for the worker, e.g. the worker's first job after being idle.
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param iwt Pointer to the worker thread running the job.
+/// @param iwtj Pointer to the job.
+void IWorkerThreadControllerWatchJob(IWorkerThreadController * iwtc, IWorkerThread * iwt, IWorkerThreadJob * iwtj)
+{
+    if (!IWorkerThreadControllerIsValid(iwtc) || !IWorkerThreadIsValid(iwt)) return;
+    const uint64_t DEADLINE = IWorkerThreadGetWatchdogDeadline(iwt, iwtj);
+    if (!DEADLINE) {
+        atomic_store_explicit(&iwt->watchdog_deadline_ns, 0, memory_order_relaxed);
+        return;
+    }
+    // Publish the deadline before checking what the watchdog knows, so that if the watchdog is forgetting the worker's deadline
+    // at the same time (see _IWorkerThreadControllerRunWatchdog()), one side or the other sees the new one.  The job's number
+    // goes out after its deadline (see _IWorkerThreadControllerCheckJob()).
+    atomic_store(&iwt->watchdog_deadline_ns, DEADLINE);
+    const uint64_t JOB_FLAGS = iwtj->deadline_ns && iwtj->deadline_ns == DEADLINE ? ITHREAD_WATCHDOG_JOB_DEADLINE : 0;
+    atomic_store(&iwt->watchdog_job, (++iwt->watchdog_jobs_count << ITHREAD_WATCHDOG_JOB_SHIFT) | JOB_FLAGS);
+    if (DEADLINE >= atomic_load(&iwt->watchdog_known_ns) || atomic_exchange(&iwt->watchdog_queued, true)) return;
+    IWorkerThread * head = atomic_load_explicit(&iwtc->watchdog_inbox, memory_order_relaxed);
+    do iwt->watchdog_next = head;
+    while (!atomic_compare_exchange_weak_explicit(&iwtc->watchdog_inbox, &head, iwt, memory_order_release, memory_order_relaxed));
+    if (!head) IWorkerThreadControllerWake(iwtc);
+}
+
 /// @brief Indicates if the given pointer points to a valid worker thread controller data structure (IWorkerThreadController).
 /// @param iwtc Pointer to worker thread controller data structure.
 /// @return True if pointer points to valid worker thread controller data structure, false otherwise.
@@ -238,11 +568,806 @@ bool IWorkerThreadControllerIsValid(IWorkerThreadController * iwtc)
     return iwtc && iwtc->struct_id == ITHREAD_DATA_STRUCT_ID;
 }
 
-/// @brief Adds a new job to the worker thread controller provider's jobs list.
+/// @brief Queues a job, waiting up to wait_ms for room if the job provider is at capacity.  A worker thread never waits: jobs it
+///         queues go on to its own deque (see IWorkerThreadJobProviderPushLocalJob()) or, if they can't, on to the shared queues
+///         regardless of the capacity, since the workers being blocked on their own backlog would deadlock the pool.  Jobs for a
+///         named queue always go to that queue, so that they count towards its share.
+static bool _IWorkerThreadControllerQueueJob(IWorkerThreadController * iwtc, IWorkerThreadJob * iwtj, long wait_ms)
+{
+    if (!IWorkerThreadControllerIsValid(iwtc) || !IWorkerThreadJobIsValid(iwtj)) return false;
+    IWorkerThread * iwt = IWorkerThreadGetCurrent();
+    const bool ON_WORKER_THREAD = iwt && iwt->controller == iwtc;
+    const bool NORMAL_PRIORITY = iwtj->priority == IThreadPriorityNormal || iwtj->priority == IThreadPriorityNone;
+    if (!iwtj->named_queue && NORMAL_PRIORITY && ON_WORKER_THREAD) {
+        return IWorkerThreadJobProviderPushLocalJob(iwtc->job_provider, iwt->deque, iwtj);
+    }
+    if (ON_WORKER_THREAD && wait_ms != 0) return IWorkerThreadJobProviderEnqueueWorkerJob(iwtc->job_provider, iwtj);
+    return IWorkerThreadJobProviderEnqueueJobTimed(iwtc->job_provider, iwtj, wait_ms);
+}
+
+/// @brief Queues a job created by the controller's job provider.  If called by a job running on one of the controller's worker
+///         threads, a normal priority job is pushed on to that worker's own deque (other workers may steal it).  Otherwise the job
+///         goes on to the provider's shared job queue for its priority.
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param iwtj Pointer to a job created by IWorkerThreadJobProviderCreateJob() for the controller's job provider.
+/// @return True if the job was queued, false otherwise (in which case the job still belongs to the caller).
+bool IWorkerThreadControllerQueueJob(IWorkerThreadController * iwtc, IWorkerThreadJob * iwtj)
+{
+    return _IWorkerThreadControllerQueueJob(iwtc, iwtj, 0);
+}
+
+/// @brief Creates a job, optionally with a deadline (timeout_ms > 0) and a future, and queues it, waiting up to wait_ms for room.
+static IWorkerThreadJob * _IWorkerThreadControllerAddJob(IWorkerThreadController * iwtc, void * job_data, IThreadPriority priority,
+                                                        long timeout_ms, long wait_ms, IWorkerThreadJobFuture ** future_ptr)
+{
+    if (!IWorkerThreadControllerIsValid(iwtc) || !job_data) return NULL;
+    IWorkerThreadJob * iwtj = IWorkerThreadJobProviderCreateJob(iwtc->job_provider, job_data);
+    if (!iwtj) return NULL;
+    iwtj->priority = priority;
+    IWorkerThreadJobSetDeadline(iwtj, timeout_ms);
+    // The future has to be attached before the job is queued, as a worker could pick the job up straight away.
+    if (future_ptr && !(*future_ptr = IWorkerThreadJobFutureCreate(iwtj))) {
+        IWorkerThreadJobFree(iwtj);
+        return NULL;
+    }
+    if (!_IWorkerThreadControllerQueueJob(iwtc, iwtj, wait_ms)) {
+        // Freeing the job completes its future, so release the caller's reference as well before throwing both away.
+        if (future_ptr) {
+            IWorkerThreadJobFutureFree(*future_ptr);
+            *future_ptr = NULL;
+        }
+        IWorkerThreadJobFree(iwtj);
+        return NULL;
+    }
+    return iwtj;
+}
+
+/// @brief Adds a new job to the worker thread controller provider's jobs list.  If called by a job running on one of the
+///         controller's worker threads, the job is pushed on to that worker's own deque instead (other workers may steal it).
 /// @param iwtc Pointer to worker thread controller data structure. 
 /// @param job_data Pointer to job data.
 /// @return True if the job was successfully added, false otherwise.
 bool IWorkerThreadControllerAddJob(IWorkerThreadController * iwtc, void * job_data)
 {
-    return iwtc && iwtc->job_provider && job_data && IWorkerThreadJobProviderAddJob(iwtc->job_provider, job_data);
-}
\ No newline at end of file
+    return _IWorkerThreadControllerAddJob(iwtc, job_data, IThreadPriorityNormal, 0, 0, NULL) != NULL;
+}
+
+/// @brief Adds a new job if there is room for it straight away, never blocking the caller.  This is IWorkerThreadControllerAddJob()
+///         under a name that makes the contract explicit at the call site: if the controller is at capacity (see
+///         IWorkerThreadControllerSetCapacity()) it fails at once and the caller deals with the job itself, e.g. by shedding load,
+///         where IWorkerThreadControllerAddJobBlocking() would wait for a worker to make room.
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param job_data Pointer to job data.
+/// @return True if the job was added, false if the controller is at capacity (or the job couldn't be created).
+bool IWorkerThreadControllerTryAddJob(IWorkerThreadController * iwtc, void * job_data)
+{
+    return IWorkerThreadControllerAddJob(iwtc, job_data);
+}
+
+/// @brief Adds a new job, blocking the caller until there is room for it.  A producer that outruns the worker threads is slowed
+///         to their pace, so the number of queued jobs (and the memory they use) never goes over the controller's capacity.  Jobs
+///         added by a job running on one of the controller's worker threads never block: they go on to that worker's own deque, or
+///         (for other priorities and named queues) on to the shared queues regardless of the capacity.
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param job_data Pointer to job data.
+/// @return True if the job was added, false if the job couldn't be created.
+bool IWorkerThreadControllerAddJobBlocking(IWorkerThreadController * iwtc, void * job_data)
+{
+    return _IWorkerThreadControllerAddJob(iwtc, job_data, IThreadPriorityNormal, 0, IThreadWaitForever, NULL) != NULL;
+}
+
+/// @brief Adds a new job, waiting up to timeout_ms for room if the controller is at capacity.
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param job_data Pointer to job data.
+/// @param timeout_ms Longest to wait for room in milliseconds (0 behaves as IWorkerThreadControllerTryAddJob(), IThreadWaitForever
+///         as IWorkerThreadControllerAddJobBlocking()).
+/// @return True if the job was added, false if there was no room in time (or the job couldn't be created).
+bool IWorkerThreadControllerAddJobTimed(IWorkerThreadController * iwtc, void * job_data, long timeout_ms)
+{
+    return _IWorkerThreadControllerAddJob(iwtc, job_data, IThreadPriorityNormal, 0, timeout_ms, NULL) != NULL;
+}
+
+/// @brief Adds a new job that is retried with exponential backoff if it fails (see IWorkerThreadJobSetRetryPolicy()).
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param job_data Pointer to job data.
+/// @param max_attempts Most times to run the job, including the first.
+/// @param base_delay_ms Milliseconds to wait before the first retry, doubling for each retry after that.
+/// @param jitter Fraction of each delay (0.0 to 1.0) that is random.
+/// @return True if the job was successfully added, false otherwise.
+bool IWorkerThreadControllerAddJobWithRetry(IWorkerThreadController * iwtc, void * job_data, int max_attempts, long base_delay_ms,
+                                            double jitter)
+{
+    if (!IWorkerThreadControllerIsValid(iwtc) || !job_data) return false;
+    IWorkerThreadJob * iwtj = IWorkerThreadJobProviderCreateJob(iwtc->job_provider, job_data);
+    if (!iwtj) return false;
+    IWorkerThreadJobSetRetryPolicy(iwtj, max_attempts, base_delay_ms, jitter);
+    if (IWorkerThreadControllerQueueJob(iwtc, iwtj)) return true;
+    IWorkerThreadJobFree(iwtj);
+    return false;
+}
+
+/// @brief Adds a named job queue, e.g. one per tenant.  Worker threads share their time between the named queues that have jobs
+///         waiting in proportion to the queues' weights, so a queue with weight 3 gets three times the throughput of a queue with
+///         weight 1 however deep either backlog is.  Named queues are served after high priority jobs and before other jobs.
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param name Name of the queue.  Adding a queue that already exists changes its weight.
+/// @param weight Share of the throughput relative to the other named queues (at least 1).
+/// @return Pointer to the queue, or NULL if it could not be created (or there are already ITHREAD_MAX_NAMED_QUEUES).  The queue
+///         belongs to the controller.
+IWorkerThreadNamedQueue * IWorkerThreadControllerAddQueue(IWorkerThreadController * iwtc, const char * name, unsigned int weight)
+{
+    if (!IWorkerThreadControllerIsValid(iwtc)) return NULL;
+    return IWorkerThreadJobProviderAddNamedQueue(iwtc->job_provider, name, weight);
+}
+
+/// @brief Finds a named job queue added by IWorkerThreadControllerAddQueue().
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param name Name of the queue.
+/// @return Pointer to the queue, or NULL if there is no queue with that name.
+IWorkerThreadNamedQueue * IWorkerThreadControllerGetQueue(IWorkerThreadController * iwtc, const char * name)
+{
+    if (!IWorkerThreadControllerIsValid(iwtc)) return NULL;
+    return IWorkerThreadJobProviderGetNamedQueue(iwtc->job_provider, name);
+}
+
+/// @brief Adds a new job to a named job queue.  The job counts towards the controller's capacity like any other.
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param queue Pointer to a queue returned by IWorkerThreadControllerAddQueue().
+/// @param job_data Pointer to job data.
+/// @return True if the job was successfully added, false otherwise.
+bool IWorkerThreadControllerAddQueueJob(IWorkerThreadController * iwtc, IWorkerThreadNamedQueue * queue, void * job_data)
+{
+    if (!IWorkerThreadControllerIsValid(iwtc) || !IWorkerThreadNamedQueueIsValid(queue) || !job_data) return false;
+    IWorkerThreadJob * iwtj = IWorkerThreadJobProviderCreateJob(iwtc->job_provider, job_data);
+    if (!iwtj) return false;
+    iwtj->named_queue = queue;
+    if (IWorkerThreadControllerQueueJob(iwtc, iwtj)) return true;
+    IWorkerThreadJobFree(iwtj);
+    return false;
+}
+
+/// @brief Gets the controller's strands, creating them when the first keyed job is added.
+static IWorkerThreadStrandSet * _IWorkerThreadControllerGetStrands(IWorkerThreadController * iwtc)
+{
+    IWorkerThreadStrandSet * iwtss = atomic_load_explicit(&iwtc->strands, memory_order_acquire);
+    if (iwtss) return iwtss;
+    IWorkerThreadStrandSet * created = IWorkerThreadStrandSetCreate(ITHREAD_STRAND_COUNT);
+    if (!created) return NULL;
+    if (atomic_compare_exchange_strong_explicit(&iwtc->strands, &iwtss, created, memory_order_acq_rel, memory_order_acquire)) return created;
+    // Another thread got there first.
+    IWorkerThreadStrandSetFree(created);
+    return iwtss;
+}
+
+/// @brief Queues the next job of a strand the caller holds.  The job has already been accepted, so a worker thread queues it
+///         regardless of the capacity, and any other caller waits up to ITHREAD_CONTROLLER_STRAND_WAIT_MS for room (never
+///         without limit, as nothing may be taking jobs, e.g. once the controller has stopped).  If it can't be queued, it is
+///         failed without being run, so that the jobs behind it aren't held up for ever.
+static void _IWorkerThreadControllerRunStrand(IWorkerThreadController * iwtc, IWorkerThreadStrand * iwts)
+{
+    do {
+        IWorkerThreadJob * iwtj = IWorkerThreadStrandPop(iwts);
+        if (!iwtj) continue;
+        if (_IWorkerThreadControllerQueueJob(iwtc, iwtj, ITHREAD_CONTROLLER_STRAND_WAIT_MS)) return;
+        atomic_store_explicit(&iwtj->state, IThreadJobStateFailed, memory_order_release);
+        IWorkerThreadJobComplete(iwtj);
+        IWorkerThreadJobFree(iwtj);
+    } while (IWorkerThreadStrandRelease(iwts));
+}
+
+/// @brief Adds a new job that is run in order with the other jobs with the same key.  Jobs with the same key (e.g. events for one
+///         user or form) run strictly one after another, in the order they were added, and never at the same time; jobs with
+///         different keys run in parallel on any of the worker threads.  Keys are hashed on to ITHREAD_STRAND_COUNT strands, so
+///         there is no per-key state and no global lock: adding a job is a push on to its strand's inbox and an atomic increment,
+///         and the job only goes on to the job queues once the job before it has finished.  Two keys that share a strand are
+///         kept in order together, which costs some parallelism but never reorders either key.  A keyed job that yields (see
+///         IWorkerThreadJobYield()) or waits to be retried keeps its strand until it finishes.  Like
+///         IWorkerThreadControllerAddJob(), this fails at once if the controller is at capacity (see
+///         IWorkerThreadControllerSetCapacity()).  A job accepted while there was room can still find the queues full by the time
+///         its turn comes: the caller that hands it on then waits up to ITHREAD_CONTROLLER_STRAND_WAIT_MS for room (worker threads
+///         never wait) and, failing that, the job is completed as failed without being run.
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param key Key to order the job by.
+/// @param job_data Pointer to job data.
+/// @return True if the job was added, false if the controller is at capacity or the job or the strands could not be created.
+bool IWorkerThreadControllerAddKeyedJob(IWorkerThreadController * iwtc, uint64_t key, void * job_data)
+{
+    if (!IWorkerThreadControllerIsValid(iwtc) || !job_data) return false;
+    if (IWorkerThreadJobProviderIsFull(iwtc->job_provider)) return false;
+    IWorkerThreadStrandSet * iwtss = _IWorkerThreadControllerGetStrands(iwtc);
+    if (!iwtss) return false;
+    IWorkerThreadJob * iwtj = IWorkerThreadJobProviderCreateJob(iwtc->job_provider, job_data);
+    if (!iwtj) return false;
+    IWorkerThreadStrand * iwts = IWorkerThreadStrandSetGetStrand(iwtss, key);
+    iwtj->strand = iwts;
+    // Once pushed, the job may be run and freed by another thread at any moment, so only the strand is used from here on.
+    if (IWorkerThreadStrandPush(iwts, iwtj)) _IWorkerThreadControllerRunStrand(iwtc, iwts);
+    return true;
+}
+
+/// @brief Lets the next job with the same key run, now that a keyed job has finished (see IWorkerThreadControllerAddKeyedJob()).
+///         Called by worker threads.
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param strand Pointer to the finished job's strand.
+void IWorkerThreadControllerReleaseStrand(IWorkerThreadController * iwtc, IWorkerThreadStrand * strand)
+{
+    if (!IWorkerThreadControllerIsValid(iwtc) || !strand) return;
+    if (IWorkerThreadStrandRelease(strand)) _IWorkerThreadControllerRunStrand(iwtc, strand);
+}
+
+/// @brief Adds a batch of jobs, one for each entry in job_data.  This is much cheaper than calling IWorkerThreadControllerAddJob()
+///         for each job, as jobs are allocated and queued in bulk and waiting workers are woken once.  As with single jobs, a batch
+///         added by a job running on one of the controller's worker threads goes on to that worker's own deque.
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param job_data Array of job data pointers.  None of them may be NULL.
+/// @param jobs_count Number of entries in job_data.
+/// @return Number of jobs added (from the start of job_data).  This is less than jobs_count if the controller's capacity was reached
+///         (see IWorkerThreadControllerSetCapacity()) or memory ran out; job data from job_data[return value] onwards wasn't
+///         added and still belongs to the caller.  Use IWorkerThreadControllerAddJobsBlocking() to wait for room instead.
+size_t IWorkerThreadControllerAddJobs(IWorkerThreadController * iwtc, void ** job_data, size_t jobs_count)
+{
+    if (!IWorkerThreadControllerIsValid(iwtc) || !job_data) return 0;
+    IWorkerThread * iwt = IWorkerThreadGetCurrent();
+    IWorkerThreadJobDeque * iwtjd = iwt && iwt->controller == iwtc ? iwt->deque : NULL;
+    return IWorkerThreadJobProviderAddJobs(iwtc->job_provider, iwtjd, job_data, jobs_count, IThreadPriorityNormal);
+}
+
+/// @brief Adds a batch of jobs (exactly as IWorkerThreadControllerAddJobs() does), but waits for room whenever the controller is
+///         at capacity rather than stopping short, so the whole batch goes in as the workers make room for it.  Must not be called
+///         with a capacity set before the controller is started, as nothing would ever make room.
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param job_data Array of job data pointers.  None of them may be NULL.
+/// @param jobs_count Number of entries in job_data.
+/// @return Number of jobs added (from the start of job_data), which is jobs_count unless the arguments were invalid or memory
+///         ran out.
+size_t IWorkerThreadControllerAddJobsBlocking(IWorkerThreadController * iwtc, void ** job_data, size_t jobs_count)
+{
+    if (!IWorkerThreadControllerIsValid(iwtc) || !job_data) return 0;
+    IWorkerThread * iwt = IWorkerThreadGetCurrent();
+    IWorkerThreadJobDeque * iwtjd = iwt && iwt->controller == iwtc ? iwt->deque : NULL;
+    return IWorkerThreadJobProviderAddJobsTimed(iwtc->job_provider, iwtjd, job_data, jobs_count, IThreadPriorityNormal, IThreadWaitForever);
+}
+
+/// @brief Adds a new job with the given priority.  Jobs above normal priority are always placed in the controller's shared job
+///         queues (even when called from a worker thread) so that the next free worker picks them up ahead of normal work.  Low
+///         priority jobs also go on to a shared queue, which workers only turn to once they've run out of other work (or a job
+///         on it has aged).  Normal priority jobs behave exactly as if added with IWorkerThreadControllerAddJob().
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param job_data Pointer to job data.
+/// @param priority Job priority.
+/// @return True if the job was successfully added, false otherwise.
+bool IWorkerThreadControllerAddJobWithPriority(IWorkerThreadController * iwtc, void * job_data, IThreadPriority priority)
+{
+    return _IWorkerThreadControllerAddJob(iwtc, job_data, priority, 0, 0, NULL) != NULL;
+}
+
+/// @brief Adds a new job (exactly as IWorkerThreadControllerAddJobWithPriority() does) and returns a future that can be used to
+///         wait for the job to complete and collect its result (see IWorkerThreadJobSetResult()).  The future is completed after
+///         the job's success or failure callback has returned.
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param job_data Pointer to job data.
+/// @param priority Job priority.
+/// @return Pointer to the job's future, which must be released with IWorkerThreadJobFutureFree(), or NULL if the job couldn't be added.
+IWorkerThreadJobFuture * IWorkerThreadControllerSubmitJob(IWorkerThreadController * iwtc, void * job_data, IThreadPriority priority)
+{
+    IWorkerThreadJobFuture * iwtjf = NULL;
+    return _IWorkerThreadControllerAddJob(iwtc, job_data, priority, 0, 0, &iwtjf) ? iwtjf : NULL;
+}
+
+/// @brief Adds a new job (exactly as IWorkerThreadControllerAddJobWithPriority() does) that must finish within the given time.  If
+///         the job is still queued when the deadline passes it is failed without being run.  If it is still running, it is cancelled
+///         (see IWorkerThreadJobIsCancelled()) by the controller's watchdog, whose timerfd is armed for the deadline itself, so the
+///         cancellation is typically seen well under a millisecond late (scheduling allowing).  If the timerfd couldn't be set up,
+///         the watchdog checks every ITHREAD_CONTROLLER_PERIOD_MS instead.  Either way the job fails with ITHREAD_JOB_DEADLINE_MESSAGE.
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param job_data Pointer to job data.
+/// @param priority Job priority.
+/// @param timeout_ms Milliseconds from now until the job's deadline.  Zero or less means no deadline.
+/// @return True if the job was successfully added, false otherwise.
+bool IWorkerThreadControllerAddJobWithDeadline(IWorkerThreadController * iwtc, void * job_data, IThreadPriority priority, long timeout_ms)
+{
+    return _IWorkerThreadControllerAddJob(iwtc, job_data, priority, timeout_ms, 0, NULL) != NULL;
+}
+
+/// @brief Adds a new job with a deadline (see IWorkerThreadControllerAddJobWithDeadline()) and returns its future.  The job can
+///         also be cancelled through the future (see IWorkerThreadJobFutureCancel()).
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param job_data Pointer to job data.
+/// @param priority Job priority.
+/// @param timeout_ms Milliseconds from now until the job's deadline.  Zero or less means no deadline.
+/// @return Pointer to the job's future, which must be released with IWorkerThreadJobFutureFree(), or NULL if the job couldn't be added.
+IWorkerThreadJobFuture * IWorkerThreadControllerSubmitJobWithDeadline(IWorkerThreadController * iwtc, void * job_data,
+                                                                    IThreadPriority priority, long timeout_ms)
+{
+    IWorkerThreadJobFuture * iwtjf = NULL;
+    return _IWorkerThreadControllerAddJob(iwtc, job_data, priority, timeout_ms, 0, &iwtjf) ? iwtjf : NULL;
+}
+
+/// @brief Puts a job that is waiting to be retried back on to the job queues.  The job keeps its last failure (state and message)
+///         while it waits, in case it is thrown away, and is only reset here.
+/// @return True if the job was queued, false if the controller is at capacity (in which case the job is still waiting).
+static bool _IWorkerThreadControllerRequeueJob(IWorkerThreadController * itc, IWorkerThreadJob * iwtj)
+{
+    atomic_store_explicit(&iwtj->state, IThreadJobStateInitialised, memory_order_release);
+    atomic_store_explicit(&iwtj->worker_thread, NULL, memory_order_release);
+    if (iwtj->failure_message) iwtj->failure_message[0] = 0;
+    // A retried job starts again from the beginning, even if it had yielded.
+    iwtj->step = 0;
+    if (_IWorkerThreadControllerQueueJob(itc, iwtj, 0)) return true;
+    atomic_store_explicit(&iwtj->state, IThreadJobStateFailed, memory_order_release);
+    return false;
+}
+
+/// @brief Handles a timer that has expired on the controller's timer wheel by queuing its job.  A one-shot timer is freed.  A
+///         recurring timer is put back for its next expiry, which is a whole number of periods after the first (so it doesn't drift)
+///         and in the future (so if the controller thread falls behind, the missed runs are skipped rather than queued in a burst).
+///         A timer for a job being retried queues the job itself.
+static void _IWorkerThreadControllerTimerExpired(IThreadTimer * itt, void * context)
+{
+    IWorkerThreadController * itc = (IWorkerThreadController *) context;
+    if (atomic_load_explicit(&itt->cancelled, memory_order_acquire)) {
+        IThreadTimerFree(itt);
+        return;
+    }
+    const uint64_t NOW = IThreadGetTimeNs();
+    const bool QUEUED = itt->job ? _IWorkerThreadControllerRequeueJob(itc, itt->job)
+                                 : _IWorkerThreadControllerAddJob(itc, itt->data, IThreadPriorityNormal, 0, 0, NULL) != NULL;
+    if (itt->period_ns) {
+        itt->expiry_ns += itt->period_ns;
+        if (itt->expiry_ns <= NOW) itt->expiry_ns += ((NOW - itt->expiry_ns) / itt->period_ns + 1) * itt->period_ns;
+    } else if (QUEUED) {
+        IThreadTimerFree(itt);
+        return;
+    } else itt->expiry_ns = NOW; // The controller is at capacity, so try again on the next tick rather than lose the job.
+    IThreadTimerWheelAdd(itc->timer_wheel, itt);
+}
+
+/// @brief Moves timers scheduled since the last call on to the controller's timer wheel, then queues the jobs of any that have
+///         expired.  Only the controller thread touches the timer wheel, so other threads hand timers over through an inbox (a
+///         lock-free stack that is emptied in one go).
+static void _IWorkerThreadControllerRunTimers(IWorkerThreadController * itc)
+{
+    IThreadTimer * itt = atomic_exchange_explicit(&itc->timer_inbox, NULL, memory_order_acquire);
+    while (itt) {
+        IThreadTimer * next = itt->next;
+        if (atomic_load_explicit(&itt->cancelled, memory_order_acquire)) IThreadTimerFree(itt);
+        else IThreadTimerWheelAdd(itc->timer_wheel, itt);
+        itt = next;
+    }
+    IThreadTimerWheelAdvance(itc->timer_wheel, IThreadGetTimeNs(), _IWorkerThreadControllerTimerExpired, itc);
+}
+
+/// @brief Hands a timer over to the controller thread, which adds it to the timer wheel.
+static void _IWorkerThreadControllerPostTimer(IWorkerThreadController * iwtc, IThreadTimer * itt)
+{
+    IThreadTimer * head = atomic_load_explicit(&iwtc->timer_inbox, memory_order_relaxed);
+    do itt->next = head;
+    while (!atomic_compare_exchange_weak_explicit(&iwtc->timer_inbox, &head, itt, memory_order_release, memory_order_relaxed));
+    // The controller thread may be asleep with nothing scheduled, so make sure it sees the new timer.
+    if (!head) IWorkerThreadControllerWake(iwtc);
+}
+
+/// @brief Creates a timer for a scheduled job and hands it over to the controller thread.
+static IThreadTimer * _IWorkerThreadControllerSchedule(IWorkerThreadController * iwtc, void * job_data, long delay_ms, long period_ms)
+{
+    if (!IWorkerThreadControllerIsValid(iwtc) || !iwtc->timer_wheel || !job_data) return NULL;
+    const uint64_t DELAY = delay_ms > 0 ? (uint64_t) delay_ms * 1000000ULL : 0;
+    const uint64_t PERIOD = period_ms > 0 ? (uint64_t) period_ms * 1000000ULL : 0;
+    IThreadTimer * itt = IThreadTimerCreate(job_data, IThreadGetTimeNs() + DELAY, PERIOD);
+    if (itt) _IWorkerThreadControllerPostTimer(iwtc, itt);
+    return itt;
+}
+
+/// @brief Puts a failed job on the controller's timer wheel to be queued again once its retry delay has passed (see
+///         IWorkerThreadJobSetRetryPolicy()).  The job waits on the timer wheel rather than in a job queue, so it takes up neither
+///         a worker thread nor room in the queues while it waits.  Called by worker threads.
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param iwtj Pointer to a job that has failed and should be retried (see IWorkerThreadJobShouldRetry()).
+/// @return True if the job will be retried (and now belongs to the controller), false if memory could not be reserved.
+bool IWorkerThreadControllerRetryJob(IWorkerThreadController * iwtc, IWorkerThreadJob * iwtj)
+{
+    if (!IWorkerThreadControllerIsValid(iwtc) || !iwtc->timer_wheel || !IWorkerThreadJobIsValid(iwtj)) return false;
+    IThreadTimer * itt = IThreadTimerCreate(NULL, IThreadGetTimeNs() + IWorkerThreadJobGetRetryDelay(iwtj), 0);
+    if (!itt) return false;
+    itt->job = iwtj;
+    _IWorkerThreadControllerPostTimer(iwtc, itt);
+    return true;
+}
+
+/// @brief Queues a paused job again, to carry on from the step it yielded at.  A resumed job is always queued, as it has nowhere
+///         else to go: another thread waits for room if the controller is at capacity, while a worker thread (parking the job, or
+///         resuming it from inside a job) queues it regardless of the capacity rather than block.
+static bool _IWorkerThreadControllerQueueParkedJob(IWorkerThreadController * iwtc, IWorkerThreadJob * iwtj)
+{
+    atomic_fetch_sub_explicit(&iwtc->paused_jobs, 1, memory_order_relaxed);
+    atomic_store_explicit(&iwtj->state, IThreadJobStateInitialised, memory_order_release);
+    atomic_store_explicit(&iwtj->worker_thread, NULL, memory_order_release);
+    iwtj->resuming = true;
+    if (_IWorkerThreadControllerQueueJob(iwtc, iwtj, IThreadWaitForever)) return true;
+    // Leave the job paused, so it can be resumed again.
+    atomic_store_explicit(&iwtj->state, IThreadJobStatePaused, memory_order_release);
+    iwtj->resuming = false;
+    atomic_store_explicit(&iwtj->park_state, ITHREAD_JOB_PARK_PARKED, memory_order_release);
+    atomic_fetch_add_explicit(&iwtc->paused_jobs, 1, memory_order_relaxed);
+    return false;
+}
+
+/// @brief Parks a job that has yielded (see IWorkerThreadJobYield()) until it is resumed.  The job is paused and sits in no queue,
+///         so it takes up neither a worker thread nor room in the queues.  The job may have been resumed already (for example
+///         by whatever it started before yielding, finishing quickly), in which case it is queued again straight away.  Called
+///         by worker threads once the job's main function has returned.
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param iwtj Pointer to a job that has just yielded.
+/// @return True if the job was parked or queued again, false if either pointer is invalid.
+bool IWorkerThreadControllerParkJob(IWorkerThreadController * iwtc, IWorkerThreadJob * iwtj)
+{
+    if (!IWorkerThreadControllerIsValid(iwtc) || !IWorkerThreadJobIsValid(iwtj)) return false;
+    iwtj->yield_requested = false;
+    atomic_store_explicit(&iwtj->state, IThreadJobStatePaused, memory_order_release);
+    atomic_fetch_add_explicit(&iwtc->paused_jobs, 1, memory_order_relaxed);
+    // The exchange hands the job over: after it, a resume finds the job parked and queues it itself.
+    if (atomic_exchange_explicit(&iwtj->park_state, ITHREAD_JOB_PARK_PARKED, memory_order_acq_rel) == ITHREAD_JOB_PARK_WAKE_PENDING) {
+        atomic_store_explicit(&iwtj->park_state, ITHREAD_JOB_PARK_NONE, memory_order_relaxed);
+        _IWorkerThreadControllerQueueParkedJob(iwtc, iwtj);
+    }
+    return true;
+}
+
+/// @brief Resumes a job that has yielded (see IWorkerThreadJobYield()), queuing it to carry on from the step it yielded at.  This
+///         can be called from any thread, including while the job is still returning from the step that yielded: the job is then
+///         queued as soon as it has been parked.  Resuming a job that isn't paused or yielding (or that has already been resumed)
+///         has no effect other than the job not staying paused the next time it yields.  A paused job that is cancelled has to be
+///         resumed to be finished off (it then fails without running).
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param iwtj Pointer to a job created by the controller's job provider.
+/// @return True if the job was queued or will be, false if either pointer is invalid or the job could not be queued.
+bool IWorkerThreadControllerResumeJob(IWorkerThreadController * iwtc, IWorkerThreadJob * iwtj)
+{
+    if (!IWorkerThreadControllerIsValid(iwtc) || !IWorkerThreadJobIsValid(iwtj)) return false;
+    int park_state = atomic_load_explicit(&iwtj->park_state, memory_order_acquire);
+    while (true) {
+        if (park_state == ITHREAD_JOB_PARK_PARKED) {
+            if (atomic_compare_exchange_weak_explicit(&iwtj->park_state, &park_state, ITHREAD_JOB_PARK_NONE, memory_order_acq_rel,
+                                                      memory_order_acquire)) return _IWorkerThreadControllerQueueParkedJob(iwtc, iwtj);
+        } else if (park_state == ITHREAD_JOB_PARK_NONE) {
+            // Not parked yet, so leave a wake up for the worker thread to find when it parks the job.
+            if (atomic_compare_exchange_weak_explicit(&iwtj->park_state, &park_state, ITHREAD_JOB_PARK_WAKE_PENDING, memory_order_acq_rel,
+                                                      memory_order_acquire)) return true;
+        } else return true;
+    }
+}
+
+/// @brief Adds a new job once the given delay has passed.  The controller thread queues the job on the first tick (every
+///         ITHREAD_TIMER_WHEEL_TICK_MS) after the delay, so it is never early but may be up to a tick late.  Scheduling is O(1)
+///         whatever the number of scheduled jobs.  Jobs only come due while the controller is running, and any still waiting when
+///         the controller is freed are dropped.
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param job_data Pointer to job data.
+/// @param delay_ms Milliseconds to wait before adding the job.
+/// @return True if the job was scheduled, false otherwise.
+bool IWorkerThreadControllerScheduleJob(IWorkerThreadController * iwtc, void * job_data, long delay_ms)
+{
+    return _IWorkerThreadControllerSchedule(iwtc, job_data, delay_ms, 0) != NULL;
+}
+
+/// @brief Adds a new job with the same job data once the given delay has passed and then at a fixed rate, until cancelled with
+///         IWorkerThreadControllerCancelScheduledJob().  Runs are a whole number of periods apart (they don't drift by however long
+///         each run takes), so if a run takes longer than the period the next can start before it has finished.  Runs that are
+///         missed entirely (because the controller was at capacity or fell behind) are skipped.
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param job_data Pointer to job data, shared by every run.
+/// @param delay_ms Milliseconds to wait before the first run.
+/// @param period_ms Milliseconds between runs (at least one tick).
+/// @return Pointer to the scheduled job's timer, to pass to IWorkerThreadControllerCancelScheduledJob(), or NULL if the job could
+///         not be scheduled.
+IThreadTimer * IWorkerThreadControllerScheduleRecurringJob(IWorkerThreadController * iwtc, void * job_data, long delay_ms, long period_ms)
+{
+    if (period_ms < ITHREAD_TIMER_WHEEL_TICK_MS) period_ms = ITHREAD_TIMER_WHEEL_TICK_MS;
+    return _IWorkerThreadControllerSchedule(iwtc, job_data, delay_ms, period_ms);
+}
+
+/// @brief Stops a recurring job (see IWorkerThreadControllerScheduleRecurringJob()).  Runs that have already been queued still run.
+///         The timer is freed by the controller, so it must not be used again.
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param timer Pointer to the recurring job's timer.
+/// @return True if the job was cancelled, false if either pointer is invalid.
+bool IWorkerThreadControllerCancelScheduledJob(IWorkerThreadController * iwtc, IThreadTimer * timer)
+{
+    if (!IWorkerThreadControllerIsValid(iwtc) || !timer) return false;
+    atomic_store_explicit(&timer->cancelled, true, memory_order_release);
+    return true;
+}
+
+/// @brief Limits the number of jobs that can be queued at once (see IWorkerThreadJobProviderSetCapacity()).  Once the limit is
+///         reached, IWorkerThreadControllerAddJobBlocking() waits for room, IWorkerThreadControllerAddJobTimed() waits for a while
+///         and every other way of adding jobs from outside the worker threads fails.
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param capacity Maximum number of queued jobs, or 0 for no limit.
+void IWorkerThreadControllerSetCapacity(IWorkerThreadController * iwtc, size_t capacity)
+{
+    if (IWorkerThreadControllerIsValid(iwtc)) IWorkerThreadJobProviderSetCapacity(iwtc->job_provider, capacity);
+}
+
+/// @brief Sets functions to set up and release resources each worker thread keeps for its jobs (e.g. parse buffers, script
+///         interpreters or database handles), so jobs don't have to look them up through globals or create them every time.  Each
+///         worker thread calls initFunction(worker, data) when it starts, on its own thread, and keeps what it returns as its
+///         context, which its jobs get with IWorkerThreadJobGetWorkerContext().  When the worker thread exits it calls
+///         teardownFunction(worker, context), again on its own thread.  A worker retired and restarted by autoscaling calls both
+///         again.  Must be called before the controller is started.
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param initFunction Function returning a worker thread's context, or NULL for none.
+/// @param teardownFunction Function releasing a worker thread's context, or NULL for none.
+/// @param data Pointer passed to initFunction.
+/// @return True if the hooks were set, false if the pointer is invalid or the controller has been started.
+bool IWorkerThreadControllerSetWorkerHooks(IWorkerThreadController * iwtc, void * (* initFunction)(IWorkerThread *, void *),
+                                            void (* teardownFunction)(IWorkerThread *, void *), void * data)
+{
+    if (!IWorkerThreadControllerIsValid(iwtc) || atomic_load(&iwtc->started)) return false;
+    iwtc->worker_init_function = initFunction;
+    iwtc->worker_teardown_function = teardownFunction;
+    iwtc->worker_hook_data = data;
+    return true;
+}
+
+/// @brief Turns job tracing on or off.  While tracing is on, each worker thread records when every job it runs was queued, started
+///         and ended into its own buffer, without locks, so tracing costs a few stores per job.  A worker's buffer holds
+///         events_per_worker events, after which its events are dropped.  Buffers are kept when tracing is turned off, so a run can be
+///         exported afterwards with IWorkerThreadControllerTraceWriteJSON(), and are freed with the controller.
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param enabled True to record job spans, false to stop recording.
+/// @param events_per_worker Capacity of each worker's buffer (ITHREAD_TRACE_DEFAULT_CAPACITY if 0).  Only used for buffers created
+///         by this call, i.e. the first time tracing is enabled for a worker.
+/// @return True if tracing was turned on or off, false if the controller is invalid or a buffer could not be created.
+bool IWorkerThreadControllerSetTracing(IWorkerThreadController * iwtc, bool enabled, size_t events_per_worker)
+{
+    if (!IWorkerThreadControllerIsValid(iwtc)) return false;
+    if (enabled) {
+        iwtc->trace_capacity = events_per_worker;
+        for (int t = 0; t < iwtc->threads_count; t++) {
+            IWorkerThread * iwt = iwtc->threads[t];
+            if (!iwt || atomic_load(&iwt->trace_buffer)) continue;
+            IThreadTraceBuffer * ittb = IThreadTraceBufferCreate(events_per_worker);
+            if (!ittb) return false;
+            atomic_store_explicit(&iwt->trace_buffer, ittb, memory_order_release);
+        }
+    }
+    atomic_store(&iwtc->tracing, enabled);
+    return true;
+}
+
+/// @brief Switches a controller's completion queue on or off.  While it is on, worker threads don't call job callbacks
+///         themselves: they finish each job (completing its future and releasing any jobs that depend on it), push it on to the
+///         completion queue and go straight on to their next job.  The thread that owns the controller then calls
+///         IWorkerThreadControllerDrainCompletedJobs() to run the callbacks, so slow post-processing doesn't hold up the workers and
+///         the callbacks don't need locking against each other.  The queue's eventfd (see IWorkerThreadControllerGetCompletionFd())
+///         becomes readable when there are jobs to drain, so the owner can wait for them in its own epoll/poll loop.  Switching the
+///         queue off only affects jobs finished from then on; jobs already in the queue still need draining.  A worker empties its
+///         arena as soon as it has pushed a job, so the callbacks must not read anything the job allocated from it (see
+///         IWorkerThreadJobArenaAlloc()).
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param enabled True to queue finished jobs for the owning thread, false to call callbacks on the worker threads.
+/// @return True if the mode was changed, false if the pointer is invalid or the queue could not be created.
+bool IWorkerThreadControllerSetCompletionQueue(IWorkerThreadController * iwtc, bool enabled)
+{
+    if (!IWorkerThreadControllerIsValid(iwtc)) return false;
+    if (enabled && !atomic_load(&iwtc->completion_queue)) {
+        // The queue lives until the controller is freed, so workers that saw the mode switched on can always push to it.
+        IWorkerThreadCompletionQueue * iwtcq = IWorkerThreadCompletionQueueCreate();
+        if (!iwtcq) return false;
+        atomic_store_explicit(&iwtc->completion_queue, iwtcq, memory_order_release);
+    }
+    atomic_store_explicit(&iwtc->completion_queue_enabled, enabled, memory_order_release);
+    return true;
+}
+
+/// @brief Gets the file descriptor of a controller's completion queue, which is readable while there are finished jobs waiting to
+///         be drained.  Add it to an epoll/poll set for reading, but don't read from or close it.
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @return File descriptor, or -1 if the completion queue has never been enabled.
+int IWorkerThreadControllerGetCompletionFd(IWorkerThreadController * iwtc)
+{
+    if (!IWorkerThreadControllerIsValid(iwtc)) return -1;
+    return IWorkerThreadCompletionQueueGetFd(atomic_load_explicit(&iwtc->completion_queue, memory_order_acquire));
+}
+
+/// @brief Calls the callbacks of jobs in a controller's completion queue on the calling thread, oldest first, then frees the jobs.
+///         Must only be called by one thread at a time.
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param max_jobs Most jobs to drain, or 0 for every job in the queue.  If jobs are left behind, the completion queue's eventfd
+///         stays readable.
+/// @return Number of jobs drained.
+size_t IWorkerThreadControllerDrainCompletedJobs(IWorkerThreadController * iwtc, size_t max_jobs)
+{
+    if (!IWorkerThreadControllerIsValid(iwtc)) return 0;
+    IWorkerThreadCompletionQueue * iwtcq = atomic_load_explicit(&iwtc->completion_queue, memory_order_acquire);
+    if (!iwtcq) return 0;
+    IWorkerThreadJob * jobs[64];
+    size_t drained = 0;
+    while (max_jobs == 0 || drained < max_jobs) {
+        const size_t BATCH = max_jobs == 0 || max_jobs - drained > 64 ? 64 : max_jobs - drained;
+        const size_t POPPED = IWorkerThreadCompletionQueuePop(iwtcq, jobs, BATCH);
+        for (size_t j = 0; j < POPPED; j++) {
+            IWorkerThreadJobRunCallback(jobs[j]);
+            IWorkerThreadJobFree(jobs[j]);
+        }
+        drained += POPPED;
+        if (POPPED < BATCH) break;
+    }
+    return drained;
+}
+
+/// @brief Sets how long a queued job waits before it is treated as one priority level more urgent.  This stops a constant stream
+///         of high priority jobs from starving lower priority ones.
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param milliseconds Aging interval in milliseconds (ITHREAD_DEFAULT_PRIORITY_AGING_MS by default).  Zero disables aging.
+void IWorkerThreadControllerSetPriorityAging(IWorkerThreadController * iwtc, long milliseconds)
+{
+    if (!IWorkerThreadControllerIsValid(iwtc)) return;
+    IWorkerThreadJobProviderSetAgingInterval(iwtc->job_provider, milliseconds);
+}
+
+/// @brief Gets a latency percentile across all of a controller's worker threads by merging their histograms into a temporary one.
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param percentile Percentile in the range 0..100.
+/// @param run_time True for job run times, false for queue wait times.
+/// @return Time in nanoseconds, or 0 if no jobs have been processed.
+static uint64_t _IWorkerThreadControllerGetPercentile(IWorkerThreadController * iwtc, double percentile, bool run_time)
+{
+    if (!IWorkerThreadControllerIsValid(iwtc)) return 0;
+    IThreadHistogram * ith = IThreadHistogramCreate();
+    if (!ith) return 0;
+    for (int t = 0; t < iwtc->threads_count; t++) {
+        IWorkerThread * iwt = iwtc->threads[t];
+        if (!iwt) continue;
+        IThreadHistogramMerge(ith, run_time ? iwt->run_time_histogram : iwt->wait_time_histogram);
+    }
+    const uint64_t VALUE = IThreadHistogramGetPercentile(ith, percentile);
+    IThreadHistogramFree(ith);
+    return VALUE;
+}
+
+/// @brief Gets the time jobs have waited to be picked up by a worker, at the given percentile, across all worker threads.  Can be
+///         called while the controller is running.
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param percentile Percentile in the range 0..100 (e.g. 50.0, 99.0, 99.9).
+/// @return Wait time in nanoseconds, or 0 if no jobs have been processed.
+uint64_t IWorkerThreadControllerGetWaitTimePercentile(IWorkerThreadController * iwtc, double percentile)
+{
+    return _IWorkerThreadControllerGetPercentile(iwtc, percentile, false);
+}
+
+/// @brief Gets the time jobs have taken to process, at the given percentile, across all worker threads.  Can be called while the
+///         controller is running.
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param percentile Percentile in the range 0..100 (e.g. 50.0, 99.0, 99.9).
+/// @return Run time in nanoseconds, or 0 if no jobs have been processed.
+uint64_t IWorkerThreadControllerGetRunTimePercentile(IWorkerThreadController * iwtc, double percentile)
+{
+    return _IWorkerThreadControllerGetPercentile(iwtc, percentile, true);
+}
+
+/// @brief Turns on autoscaling, so the number of running worker threads follows the load.  Worker threads are started when the
+///         oldest job in the shared job queues has waited longer than target_wait_ms, and retired once they've been idle for
+///         idle_grace_ms, always keeping between min_threads and max_threads running.  Must be called before the controller is
+///         started, after at least one worker thread has been added.  Worker threads are added (copying the processing functions
+///         and timeout of the first one) until there are max_threads, so that no memory is allocated while the controller is
+///         running; retired workers are parked and restarted when needed.  As any worker may be retired or copied, every worker
+///         thread already added must have the same processing functions and timeout; a controller with different kinds of
+///         worker can't autoscale.
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param min_threads Minimum number of running worker threads (at least 1).  These are the ones started with the controller.
+/// @param max_threads Maximum number of running worker threads.  Must be at least min_threads and the number already added.
+/// @param target_wait_ms Longest a job should wait in the queue before another worker thread is started.
+/// @param idle_grace_ms How long a worker thread must be idle before it is retired.
+/// @return True if autoscaling was turned on, false if the arguments are invalid, the controller has been started, has no worker
+///         threads or has worker threads that differ, or worker threads couldn't be added.
+bool IWorkerThreadControllerSetAutoscaling(IWorkerThreadController * iwtc, int min_threads, int max_threads, long target_wait_ms,
+                                            long idle_grace_ms)
+{
+    if (!IWorkerThreadControllerIsValid(iwtc) || atomic_load(&iwtc->started) || iwtc->threads_count == 0) return false;
+    if (min_threads < 1 || max_threads < min_threads || max_threads < iwtc->threads_count) return false;
+    IWorkerThread * first = iwtc->threads[0];
+    for (int t = 1; t < iwtc->threads_count; t++) {
+        IWorkerThread * iwt = iwtc->threads[t];
+        if (iwt->threadMainFunction != first->threadMainFunction || iwt->jobSuccessCallbackFunction != first->jobSuccessCallbackFunction ||
+            iwt->jobFailureCallbackFunction != first->jobFailureCallbackFunction || iwt->timeout != first->timeout ||
+            iwt->timeout_ms != first->timeout_ms) return false;
+    }
+    while (iwtc->threads_count < max_threads) {
+        IWorkerThread * iwt = IWorkerThreadControllerAddWorkerThread(iwtc, first->threadMainFunction, first->jobSuccessCallbackFunction,
+                                                                    first->jobFailureCallbackFunction, first->timeout);
+        if (!iwt) return false;
+        iwt->timeout_ms = first->timeout_ms;
+    }
+    iwtc->min_threads = min_threads;
+    iwtc->max_threads = max_threads;
+    iwtc->autoscale_target_wait_ns = target_wait_ms > 0 ? (uint64_t) target_wait_ms * 1000000ULL : 0;
+    iwtc->autoscale_idle_grace_ns = idle_grace_ms > 0 ? (uint64_t) idle_grace_ms * 1000000ULL : 0;
+    iwtc->autoscale = true;
+    return true;
+}
+
+/// @brief Gets the controller's CPU topology, reading it the first time it is needed.
+/// @return Pointer to topology data structure, or NULL if it couldn't be read.
+static IThreadCpuTopology * _IWorkerThreadControllerGetTopology(IWorkerThreadController * iwtc)
+{
+    if (!iwtc->topology) iwtc->topology = IThreadCpuTopologyCreate();
+    return iwtc->topology;
+}
+
+/// @brief Pins the controller's worker threads to a set of CPUs.  The CPUs are handed out in turn, so the first worker thread runs
+///         on cpus[0], the second on cpus[1] and so on, wrapping round if there are more worker threads than CPUs.  Pinning keeps a
+///         worker's cache (and, on NUMA machines, its memory) local, at the cost of the scheduler no longer being able to move it.
+///         Must be called before the controller is started.
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param cpus Array of CPU numbers, or NULL to stop pinning worker threads.
+/// @param cpus_count Number of entries in cpus.
+/// @return True if the CPUs were set, false if the controller has been started or a CPU number is invalid.
+bool IWorkerThreadControllerSetCpuAffinity(IWorkerThreadController * iwtc, const int * cpus, size_t cpus_count)
+{
+    if (!IWorkerThreadControllerIsValid(iwtc) || atomic_load(&iwtc->started)) return false;
+    int * affinity_cpus = NULL;
+    if (cpus && cpus_count > 0) {
+        IThreadCpuTopology * itct = _IWorkerThreadControllerGetTopology(iwtc);
+        if (!itct) return false;
+        for (size_t c = 0; c < cpus_count; c++) if (cpus[c] < 0 || cpus[c] >= itct->cpus_count || cpus[c] >= CPU_SETSIZE) return false;
+        affinity_cpus = (int *) malloc(sizeof(int) * cpus_count);
+        if (!affinity_cpus) return false;
+        for (size_t c = 0; c < cpus_count; c++) affinity_cpus[c] = cpus[c];
+    } else cpus_count = 0;
+    free(iwtc->affinity_cpus);
+    iwtc->affinity_cpus = affinity_cpus;
+    iwtc->affinity_cpus_count = cpus_count;
+    // Workers that were pinned by an earlier call are unpinned, in case there are no longer any CPUs to hand out.
+    for (int t = 0; t < iwtc->threads_count; t++) {
+        if (IWorkerThreadIsValid(iwtc->threads[t])) iwtc->threads[t]->cpu = iwtc->threads[t]->numa_node = -1;
+    }
+    return true;
+}
+
+/// @brief Pins the controller's worker threads one per physical core (see IThreadCpuTopologyGetPhysicalCoreCpus()), so no two
+///         workers share a core's execution units until there are more workers than cores.  Must be called before the controller
+///         is started.
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @return True if the CPUs were set, false if the controller has been started or the CPU topology couldn't be read.
+bool IWorkerThreadControllerSetCpuAffinityPerCore(IWorkerThreadController * iwtc)
+{
+    if (!IWorkerThreadControllerIsValid(iwtc) || atomic_load(&iwtc->started)) return false;
+    IThreadCpuTopology * itct = _IWorkerThreadControllerGetTopology(iwtc);
+    if (!itct) return false;
+    int * cpus = (int *) malloc(sizeof(int) * itct->cpus_count);
+    if (!cpus) return false;
+    const size_t CPUS_COUNT = IThreadCpuTopologyGetPhysicalCoreCpus(itct, cpus, (size_t) itct->cpus_count);
+    const bool RESULT = CPUS_COUNT > 0 && IWorkerThreadControllerSetCpuAffinity(iwtc, cpus, CPUS_COUNT);
+    free(cpus);
+    return RESULT;
+}
+
+/// @brief Partitions the controller's normal priority job queue by NUMA node, so jobs added from a thread running on a node are
+///         taken by worker threads on the same node first (see IWorkerThreadJobProviderSetNumaNodes()).  This works best when the
+///         worker threads are pinned.  Must be called before the controller is started.
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param enabled True to partition the job queue, false to go back to a single shared queue.
+/// @return True if the partitioning was changed, false if the controller has been started or the CPU topology couldn't be read.
+bool IWorkerThreadControllerSetNumaPartitioning(IWorkerThreadController * iwtc, bool enabled)
+{
+    if (!IWorkerThreadControllerIsValid(iwtc) || atomic_load(&iwtc->started)) return false;
+    if (!enabled) return IWorkerThreadJobProviderSetNumaNodes(iwtc->job_provider, NULL);
+    IThreadCpuTopology * itct = _IWorkerThreadControllerGetTopology(iwtc);
+    return itct && IWorkerThreadJobProviderSetNumaNodes(iwtc->job_provider, itct);
+}
+
+/// @brief Gets the number of worker threads currently running (not including any that an autoscaling controller has parked or
+///         asked to stop).
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @return Number of running worker threads.
+int IWorkerThreadControllerGetWorkerCount(IWorkerThreadController * iwtc)
+{
+    if (!IWorkerThreadControllerIsValid(iwtc)) return 0;
+    int running = 0;
+    for (int t = 0; t < iwtc->threads_count; t++) {
+        IWorkerThread * iwt = iwtc->threads[t];
+        if (IWorkerThreadIsValid(iwt) && atomic_load_explicit(&iwt->state, memory_order_acquire) == IThreadStateRunning) running++;
+    }
+    return running;
+}
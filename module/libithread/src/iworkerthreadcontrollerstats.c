@@ -0,0 +1,182 @@
+#include "iworkerthread.h"
+#include "iworkerthreadcontroller.h"
+#include "iworkerthreadcontrollerstats.h"
+#include <string.h>
+
+#include "iworkerthreadjobprovider.h"
+#include "iworkerthreadnamedqueue.h"
+#include "ithreadhistogram.h"
+
+/// @brief Creates an empty statistics snapshot.  The same snapshot should be passed to IWorkerThreadControllerGetStats() each time
+///         a controller is sampled, as rates and busy ratios are measured from the previous sample held in it.
+/// @return Pointer to statistics snapshot data structure, or NULL if memory could not be reserved for it.
+IWorkerThreadControllerStats * IWorkerThreadControllerStatsCreate()
+{
+    IWorkerThreadControllerStats * iwtcs = (IWorkerThreadControllerStats *) calloc(1, sizeof(IWorkerThreadControllerStats));
+    if (iwtcs) iwtcs->struct_id = ITHREAD_DATA_STRUCT_ID;
+    return iwtcs;
+}
+
+bool IWorkerThreadControllerStatsIsValid(IWorkerThreadControllerStats * iwtcs)
+{
+    return iwtcs && iwtcs->struct_id == ITHREAD_DATA_STRUCT_ID;
+}
+
+/// @brief Gets the rate at which a counter has increased between two samples.
+/// @return Increase per second (0 if the counter didn't increase or no time has passed).
+static double _IWorkerThreadControllerStatsGetRate(size_t previous, size_t current, uint64_t interval_ns)
+{
+    if (current <= previous || interval_ns == 0) return 0.0;
+    return (double) (current - previous) * (double) ITHREAD_NS_PER_SEC / (double) interval_ns;
+}
+
+/// @brief Takes a snapshot of a controller's statistics.  Every counter is read in a single pass without taking any locks, using
+///         counters that each worker thread updates with plain stores, so sampling (even at a high frequency) doesn't slow the
+///         workers down.  Rates and busy ratios cover the time since the previous snapshot taken into the same data structure (or
+///         since the controller was started, for the first snapshot).
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param iwtcs Pointer to statistics snapshot data structure, updated with the new snapshot.
+/// @return True if the snapshot was taken, false if either pointer is invalid or memory could not be reserved.
+bool IWorkerThreadControllerGetStats(IWorkerThreadController * iwtc, IWorkerThreadControllerStats * iwtcs)
+{
+    if (!IWorkerThreadControllerIsValid(iwtc) || !IWorkerThreadControllerStatsIsValid(iwtcs)) return false;
+
+    // Make sure there's room for every worker thread.  Worker threads are only ever added to a controller, so a worker keeps its
+    // index (and its previous sample) from one snapshot to the next.
+    const size_t THREADS_COUNT = (size_t) iwtc->threads_count;
+    if (THREADS_COUNT > iwtcs->workers_buffer_size) {
+        IWorkerThreadStats * workers = (IWorkerThreadStats *) realloc(iwtcs->workers, sizeof(IWorkerThreadStats) * THREADS_COUNT);
+        if (!workers) return false;
+        for (size_t w = iwtcs->workers_buffer_size; w < THREADS_COUNT; w++) workers[w] = (IWorkerThreadStats) { 0 };
+        iwtcs->workers = workers;
+        iwtcs->workers_buffer_size = THREADS_COUNT;
+    }
+    // Likewise for the named queues, which are only ever added to a provider.
+    IWorkerThreadJobProvider * iwtjp = iwtc->job_provider;
+    const size_t QUEUES_COUNT = atomic_load_explicit(&iwtjp->named_queues_count, memory_order_acquire);
+    if (QUEUES_COUNT > iwtcs->queues_buffer_size) {
+        IWorkerThreadQueueStats * queues = (IWorkerThreadQueueStats *) realloc(iwtcs->queues, sizeof(IWorkerThreadQueueStats) * QUEUES_COUNT);
+        if (!queues) return false;
+        for (size_t q = iwtcs->queues_buffer_size; q < QUEUES_COUNT; q++) queues[q] = (IWorkerThreadQueueStats) { 0 };
+        iwtcs->queues = queues;
+        iwtcs->queues_buffer_size = QUEUES_COUNT;
+    }
+
+    const uint64_t NOW = IThreadGetTimeNs();
+    const uint64_t PREVIOUS_TIMESTAMP = iwtcs->timestamp_ns ? iwtcs->timestamp_ns : iwtc->start_time_ns;
+    const uint64_t INTERVAL = NOW > PREVIOUS_TIMESTAMP ? NOW - PREVIOUS_TIMESTAMP : 0;
+    const size_t PREVIOUS_ENQUEUED = iwtcs->timestamp_ns ? iwtcs->enqueued_jobs : 0;
+    const size_t PREVIOUS_DEQUEUED = iwtcs->timestamp_ns ? iwtcs->dequeued_jobs : 0;
+
+    // Read each worker's counters.  A worker's total busy time is read before the time its current job started, so a job that
+    // finishes in between is missed for this sample rather than counted twice.
+    size_t jobs_run = 0, jobs_failed = 0, jobs_retried = 0, jobs_yielded = 0, running = 0, workers_running = 0;
+    for (size_t t = 0; t < THREADS_COUNT; t++) {
+        IWorkerThread * iwt = iwtc->threads[t];
+        IWorkerThreadStats * iwts = &iwtcs->workers[t];
+        const uint64_t PREVIOUS_BUSY_TIME = iwtcs->timestamp_ns ? iwts->busy_time_ns : 0;
+        if (!iwt) {
+            *iwts = (IWorkerThreadStats) { .id = -1, .state = IThreadStateUnusable, .cpu = -1, .numa_node = -1 };
+            continue;
+        }
+        iwts->id = iwt->id;
+        iwts->state = atomic_load_explicit(&iwt->state, memory_order_acquire);
+        // Where the worker is placed: -1 if it isn't pinned to a CPU.
+        iwts->cpu = iwt->cpu;
+        iwts->numa_node = iwt->numa_node;
+        // A failure is counted before the job is counted as run, so failures are read first.
+        iwts->jobs_failed = atomic_load_explicit(&iwt->jobs_failed, memory_order_acquire);
+        iwts->jobs_run = atomic_load_explicit(&iwt->jobs_run, memory_order_acquire);
+        if (iwts->jobs_failed > iwts->jobs_run) iwts->jobs_failed = iwts->jobs_run;
+        // Failed attempts that were rescheduled (each is also counted as failed).
+        iwts->jobs_retried = atomic_load_explicit(&iwt->jobs_retried, memory_order_relaxed);
+        // Steps of resumable jobs that ended with the job yielding rather than finishing.
+        iwts->jobs_yielded = atomic_load_explicit(&iwt->jobs_yielded, memory_order_acquire);
+        iwts->busy_time_ns = atomic_load_explicit(&iwt->busy_time_ns, memory_order_relaxed);
+        const uint64_t BUSY_SINCE = atomic_load_explicit(&iwt->busy_since_ns, memory_order_relaxed);
+        iwts->busy = BUSY_SINCE != 0;
+        if (iwts->busy && NOW > BUSY_SINCE) iwts->busy_time_ns += NOW - BUSY_SINCE;
+        if (iwts->busy_time_ns < PREVIOUS_BUSY_TIME) iwts->busy_time_ns = PREVIOUS_BUSY_TIME;
+        iwts->busy_ratio = INTERVAL ? (double) (iwts->busy_time_ns - PREVIOUS_BUSY_TIME) / (double) INTERVAL : 0.0;
+        if (iwts->busy_ratio > 1.0) iwts->busy_ratio = 1.0;
+        jobs_run += iwts->jobs_run;
+        jobs_failed += iwts->jobs_failed;
+        jobs_retried += iwts->jobs_retried;
+        jobs_yielded += iwts->jobs_yielded;
+        if (iwts->busy) running++;
+        if (iwts->state == IThreadStateRunning) workers_running++;
+    }
+    iwtcs->workers_count = THREADS_COUNT;
+    iwtcs->workers_running = workers_running;
+    iwtcs->numa_nodes = iwtc->job_provider->nodes_count;
+
+    // Every job taken from a queue or deque has either been run, yielded or is running.  Jobs cancelled by the watchdog are counted
+    // as failed by their worker thread.  The pending count is read after the worker counters, so a job is never missing from both.
+    iwtcs->timestamp_ns = NOW;
+    iwtcs->interval_ns = INTERVAL;
+    iwtcs->timeout_kills = atomic_load(&iwtc->timeout_kills);
+    // Backpressure: how close producers have come to the capacity (0 for none), and how many jobs were turned away.
+    iwtcs->queue_capacity = IWorkerThreadJobProviderGetCapacity(iwtc->job_provider);
+    iwtcs->queue_high_watermark = IWorkerThreadJobProviderGetHighWatermark(iwtc->job_provider);
+    iwtcs->rejected_jobs = IWorkerThreadJobProviderGetRejectedCount(iwtc->job_provider);
+    iwtcs->running_jobs = running;
+    iwtcs->done_jobs = jobs_run - jobs_failed;
+    iwtcs->failed_jobs = jobs_failed;
+    iwtcs->retried_jobs = jobs_retried;
+    iwtcs->yielded_jobs = jobs_yielded;
+    iwtcs->paused_jobs = atomic_load_explicit(&iwtc->paused_jobs, memory_order_relaxed);
+    iwtcs->completed_jobs_pending = IWorkerThreadCompletionQueueGetCount(atomic_load_explicit(&iwtc->completion_queue, memory_order_acquire));
+    iwtcs->keyed_jobs_pending = IWorkerThreadStrandSetGetPendingCount(atomic_load_explicit(&iwtc->strands, memory_order_acquire));
+    iwtcs->dequeued_jobs = jobs_run + jobs_yielded + running;
+    iwtcs->pending_jobs = IWorkerThreadJobProviderGetPendingCount(iwtc->job_provider);
+    iwtcs->enqueued_jobs = iwtcs->dequeued_jobs + iwtcs->pending_jobs;
+    if (iwtcs->enqueued_jobs < PREVIOUS_ENQUEUED) iwtcs->enqueued_jobs = PREVIOUS_ENQUEUED;
+    iwtcs->enqueue_rate = _IWorkerThreadControllerStatsGetRate(PREVIOUS_ENQUEUED, iwtcs->enqueued_jobs, INTERVAL);
+    iwtcs->dequeue_rate = _IWorkerThreadControllerStatsGetRate(PREVIOUS_DEQUEUED, iwtcs->dequeued_jobs, INTERVAL);
+
+    // Per queue depth, throughput and time spent waiting, to check each tenant is getting its share.
+    for (size_t q = 0; q < QUEUES_COUNT; q++) {
+        IWorkerThreadNamedQueue * iwtnq = iwtjp->named_queues[q];
+        IWorkerThreadQueueStats * iwtqs = &iwtcs->queues[q];
+        const size_t PREVIOUS_QUEUE_DEQUEUED = q < iwtcs->queues_count ? iwtqs->dequeued : 0;
+        strncpy(iwtqs->name, iwtnq->name, ITHREAD_NAMED_QUEUE_NAME_LENGTH);
+        iwtqs->weight = IWorkerThreadNamedQueueGetWeight(iwtnq);
+        iwtqs->depth = IWorkerThreadNamedQueueGetDepth(iwtnq);
+        iwtqs->dequeued = atomic_load_explicit(&iwtnq->dequeued_count, memory_order_relaxed);
+        iwtqs->enqueued = atomic_load_explicit(&iwtnq->enqueued_count, memory_order_relaxed);
+        if (iwtqs->enqueued < iwtqs->dequeued) iwtqs->enqueued = iwtqs->dequeued;
+        iwtqs->dequeue_rate = _IWorkerThreadControllerStatsGetRate(PREVIOUS_QUEUE_DEQUEUED, iwtqs->dequeued, INTERVAL);
+        iwtqs->wait_time_p50_ns = IThreadHistogramGetPercentile(iwtnq->wait_time_histogram, 50.0);
+        iwtqs->wait_time_p99_ns = IThreadHistogramGetPercentile(iwtnq->wait_time_histogram, 99.0);
+    }
+    iwtcs->queues_count = QUEUES_COUNT;
+
+    // Latency percentiles across all of the worker threads.
+    IThreadHistogram * wait_times = IThreadHistogramCreate();
+    IThreadHistogram * run_times = IThreadHistogramCreate();
+    for (size_t t = 0; t < THREADS_COUNT && wait_times && run_times; t++) {
+        IWorkerThread * iwt = iwtc->threads[t];
+        if (!iwt) continue;
+        IThreadHistogramMerge(wait_times, iwt->wait_time_histogram);
+        IThreadHistogramMerge(run_times, iwt->run_time_histogram);
+    }
+    iwtcs->wait_time_p50_ns = IThreadHistogramGetPercentile(wait_times, 50.0);
+    iwtcs->wait_time_p99_ns = IThreadHistogramGetPercentile(wait_times, 99.0);
+    iwtcs->wait_time_p999_ns = IThreadHistogramGetPercentile(wait_times, 99.9);
+    iwtcs->run_time_p50_ns = IThreadHistogramGetPercentile(run_times, 50.0);
+    iwtcs->run_time_p99_ns = IThreadHistogramGetPercentile(run_times, 99.0);
+    iwtcs->run_time_p999_ns = IThreadHistogramGetPercentile(run_times, 99.9);
+    IThreadHistogramFree(wait_times);
+    IThreadHistogramFree(run_times);
+
+    return true;
+}
+
+void IWorkerThreadControllerStatsFree(IWorkerThreadControllerStats * iwtcs)
+{
+    if (!IWorkerThreadControllerStatsIsValid(iwtcs)) return;
+    iwtcs->struct_id = 0;
+    free(iwtcs->workers);
+    free(iwtcs->queues);
+    free(iwtcs);
+}
@@ -0,0 +1,130 @@
+#include "ithreadjson.h"
+#include "iworkerthreadcontrollerstatsjson.h"
+
+/// @brief Renders the JSON object for one worker thread's statistics.
+static JSONElement * _IWorkerThreadStatsToJSON(IWorkerThreadStats * iwts)
+{
+    JSONElement * object = JSONCreateObjectElement();
+    if (!object) return NULL;
+    bool ok = IThreadJSONAddNumber(object, "id", iwts->id) &&
+        IThreadJSONAddNumber(object, "state", iwts->state) &&
+        IThreadJSONAddElement(object, "busy", JSONCreateBooleanElement(iwts->busy)) &&
+        IThreadJSONAddNumber(object, "jobs_run", iwts->jobs_run) &&
+        IThreadJSONAddNumber(object, "jobs_failed", iwts->jobs_failed) &&
+        IThreadJSONAddNumber(object, "jobs_retried", iwts->jobs_retried) &&
+        IThreadJSONAddNumber(object, "jobs_yielded", iwts->jobs_yielded) &&
+        IThreadJSONAddNumber(object, "busy_time_ns", iwts->busy_time_ns) &&
+        IThreadJSONAddNumber(object, "busy_ratio", iwts->busy_ratio) &&
+        IThreadJSONAddNumber(object, "cpu", iwts->cpu) &&
+        IThreadJSONAddNumber(object, "numa_node", iwts->numa_node);
+    if (!ok) {
+        JSONFreeElement(object);
+        return NULL;
+    }
+    return object;
+}
+
+/// @brief Renders the JSON object for one named queue's statistics.
+static JSONElement * _IWorkerThreadQueueStatsToJSON(IWorkerThreadQueueStats * iwtqs)
+{
+    JSONElement * object = JSONCreateObjectElement();
+    if (!object) return NULL;
+    bool ok = IThreadJSONAddString(object, "name", iwtqs->name) &&
+        IThreadJSONAddNumber(object, "weight", iwtqs->weight) &&
+        IThreadJSONAddNumber(object, "depth", iwtqs->depth) &&
+        IThreadJSONAddNumber(object, "enqueued", iwtqs->enqueued) &&
+        IThreadJSONAddNumber(object, "dequeued", iwtqs->dequeued) &&
+        IThreadJSONAddNumber(object, "dequeue_rate", iwtqs->dequeue_rate) &&
+        IThreadJSONAddNumber(object, "wait_time_p50_ns", iwtqs->wait_time_p50_ns) &&
+        IThreadJSONAddNumber(object, "wait_time_p99_ns", iwtqs->wait_time_p99_ns);
+    if (!ok) {
+        JSONFreeElement(object);
+        return NULL;
+    }
+    return object;
+}
+
+/// @brief Renders a controller statistics snapshot (see IWorkerThreadControllerGetStats()) as a libjson object element.  Times
+///         are in nanoseconds and rates in jobs per second.  The caller is responsible for freeing the element (JSONFreeElement()).
+/// @param iwtcs Pointer to statistics snapshot data structure.
+/// @return Pointer to a JSON object element, or NULL if the snapshot is invalid or memory could not be reserved.
+JSONElement * IWorkerThreadControllerStatsToJSON(IWorkerThreadControllerStats * iwtcs)
+{
+    if (!IWorkerThreadControllerStatsIsValid(iwtcs)) return NULL;
+    JSONElement * object = JSONCreateObjectElement();
+    JSONElement * workers = JSONCreateArrayElement();
+    JSONElement * queues = JSONCreateArrayElement();
+    if (!object || !workers || !queues) {
+        if (object) JSONFreeElement(object);
+        if (workers) JSONFreeElement(workers);
+        if (queues) JSONFreeElement(queues);
+        return NULL;
+    }
+
+    bool ok = true;
+    for (size_t w = 0; ok && w < iwtcs->workers_count; w++) {
+        JSONElement * worker = _IWorkerThreadStatsToJSON(&iwtcs->workers[w]);
+        if (!worker || !JSONAddChildToElement(worker, workers)) {
+            if (worker) JSONFreeElement(worker);
+            ok = false;
+        }
+    }
+    for (size_t q = 0; ok && q < iwtcs->queues_count; q++) {
+        JSONElement * queue = _IWorkerThreadQueueStatsToJSON(&iwtcs->queues[q]);
+        if (!queue || !JSONAddChildToElement(queue, queues)) {
+            if (queue) JSONFreeElement(queue);
+            ok = false;
+        }
+    }
+
+    ok = ok && IThreadJSONAddNumber(object, "timestamp_ns", iwtcs->timestamp_ns) &&
+        IThreadJSONAddNumber(object, "interval_ns", iwtcs->interval_ns) &&
+        IThreadJSONAddNumber(object, "pending_jobs", iwtcs->pending_jobs) &&
+        IThreadJSONAddNumber(object, "running_jobs", iwtcs->running_jobs) &&
+        IThreadJSONAddNumber(object, "done_jobs", iwtcs->done_jobs) &&
+        IThreadJSONAddNumber(object, "failed_jobs", iwtcs->failed_jobs) &&
+        IThreadJSONAddNumber(object, "retried_jobs", iwtcs->retried_jobs) &&
+        IThreadJSONAddNumber(object, "yielded_jobs", iwtcs->yielded_jobs) &&
+        IThreadJSONAddNumber(object, "paused_jobs", iwtcs->paused_jobs) &&
+        IThreadJSONAddNumber(object, "completed_jobs_pending", iwtcs->completed_jobs_pending) &&
+        IThreadJSONAddNumber(object, "keyed_jobs_pending", iwtcs->keyed_jobs_pending) &&
+        IThreadJSONAddNumber(object, "enqueued_jobs", iwtcs->enqueued_jobs) &&
+        IThreadJSONAddNumber(object, "dequeued_jobs", iwtcs->dequeued_jobs) &&
+        IThreadJSONAddNumber(object, "enqueue_rate", iwtcs->enqueue_rate) &&
+        IThreadJSONAddNumber(object, "dequeue_rate", iwtcs->dequeue_rate) &&
+        IThreadJSONAddNumber(object, "timeout_kills", iwtcs->timeout_kills) &&
+        IThreadJSONAddNumber(object, "queue_capacity", iwtcs->queue_capacity) &&
+        IThreadJSONAddNumber(object, "queue_high_watermark", iwtcs->queue_high_watermark) &&
+        IThreadJSONAddNumber(object, "rejected_jobs", iwtcs->rejected_jobs) &&
+        IThreadJSONAddNumber(object, "workers_running", iwtcs->workers_running) &&
+        IThreadJSONAddNumber(object, "numa_nodes", iwtcs->numa_nodes) &&
+        IThreadJSONAddNumber(object, "wait_time_p50_ns", iwtcs->wait_time_p50_ns) &&
+        IThreadJSONAddNumber(object, "wait_time_p99_ns", iwtcs->wait_time_p99_ns) &&
+        IThreadJSONAddNumber(object, "wait_time_p999_ns", iwtcs->wait_time_p999_ns) &&
+        IThreadJSONAddNumber(object, "run_time_p50_ns", iwtcs->run_time_p50_ns) &&
+        IThreadJSONAddNumber(object, "run_time_p99_ns", iwtcs->run_time_p99_ns) &&
+        IThreadJSONAddNumber(object, "run_time_p999_ns", iwtcs->run_time_p999_ns);
+    // The arrays belong to the object once added (each is freed by IThreadJSONAddElement() if it can't be).
+    if (ok) ok = IThreadJSONAddElement(object, "workers", workers);
+    else JSONFreeElement(workers);
+    if (ok) ok = IThreadJSONAddElement(object, "queues", queues);
+    else JSONFreeElement(queues);
+    if (!ok) {
+        JSONFreeElement(object);
+        return NULL;
+    }
+    return object;
+}
+
+/// @brief Writes a controller statistics snapshot to a file as JSON.
+/// @param iwtcs Pointer to statistics snapshot data structure.
+/// @param filename Name of the file to write to (overwritten if it exists).
+/// @return True if the file was written, false otherwise.
+bool IWorkerThreadControllerStatsWriteJSON(IWorkerThreadControllerStats * iwtcs, char * filename)
+{
+    JSONElement * object = IWorkerThreadControllerStatsToJSON(iwtcs);
+    if (!object) return false;
+    const bool WRITTEN = JSONWriteElementToFile(object, filename);
+    JSONFreeElement(object);
+    return WRITTEN;
+}
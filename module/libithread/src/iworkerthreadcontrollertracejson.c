@@ -0,0 +1,163 @@
+#include <stdio.h>
+
+#include "ithreadjson.h"
+#include "iworkerthread.h"
+#include "iworkerthreadcontrollertracejson.h"
+
+// Everything in the trace belongs to one process.
+#define ITHREAD_TRACE_PID 1
+
+/// @brief Converts a time (see IThreadGetTimeNs()) to a trace timestamp: microseconds since the controller was created.
+static double _IWorkerThreadControllerTraceTimestamp(IWorkerThreadController * iwtc, uint64_t time_ns)
+{
+    return ((double) time_ns - (double) iwtc->start_time_ns) / 1000.0;
+}
+
+/// @brief Creates a trace event with the fields every event has.  ph is the event type: "X" for a complete span, "b"/"e" for the
+///         start/end of an asynchronous span and "M" for metadata.
+static JSONElement * _IWorkerThreadControllerTraceCreateEvent(char * name, char * category, char * ph, int tid, double ts)
+{
+    JSONElement * event = JSONCreateObjectElement();
+    if (!event) return NULL;
+    const bool OK = IThreadJSONAddString(event, "name", name) &&
+        (!category || IThreadJSONAddString(event, "cat", category)) &&
+        IThreadJSONAddString(event, "ph", ph) &&
+        IThreadJSONAddNumber(event, "pid", ITHREAD_TRACE_PID) &&
+        IThreadJSONAddNumber(event, "tid", tid) &&
+        IThreadJSONAddNumber(event, "ts", ts);
+    if (!OK) {
+        JSONFreeElement(event);
+        return NULL;
+    }
+    return event;
+}
+
+/// @brief Adds an event to the trace's event array.  The event is freed if it can't be added.
+static bool _IWorkerThreadControllerTraceAddEvent(JSONElement * events, JSONElement * event)
+{
+    if (event && JSONAddChildToElement(event, events)) return true;
+    if (event) JSONFreeElement(event);
+    return false;
+}
+
+/// @brief Adds a metadata event naming the process or a thread (name is "process_name" or "thread_name").
+static bool _IWorkerThreadControllerTraceAddName(JSONElement * events, char * name, int tid, char * value)
+{
+    JSONElement * event = _IWorkerThreadControllerTraceCreateEvent(name, NULL, "M", tid, 0.0);
+    JSONElement * args = JSONCreateObjectElement();
+    if (event && args && IThreadJSONAddString(args, "name", value)) {
+        // The arguments belong to the event once added (or have been freed if they couldn't be).
+        const bool ADDED = IThreadJSONAddElement(event, "args", args);
+        args = NULL;
+        if (ADDED) return _IWorkerThreadControllerTraceAddEvent(events, event);
+    }
+    if (args) JSONFreeElement(args);
+    if (event) JSONFreeElement(event);
+    return false;
+}
+
+/// @brief Adds the start ("b") or end ("e") of a job's asynchronous queueing span, keyed by the job id.  Once created, the event
+///         belongs to _IWorkerThreadControllerTraceAddEvent(), which frees it itself if it can't be added.
+static bool _IWorkerThreadControllerTraceAddQueued(JSONElement * events, char * ph, int tid, double ts, size_t job_id)
+{
+    JSONElement * queued = _IWorkerThreadControllerTraceCreateEvent("queued", "queue", ph, tid, ts);
+    if (!queued) return false;
+    if (!IThreadJSONAddNumber(queued, "id", job_id)) {
+        JSONFreeElement(queued);
+        return false;
+    }
+    return _IWorkerThreadControllerTraceAddEvent(events, queued);
+}
+
+/// @brief Adds the events for one traced job: the time it spent queued, as an asynchronous span keyed by the job id (so queueing
+///         gaps show up on their own track), and the time it ran, as a complete span on its worker's track.
+static bool _IWorkerThreadControllerTraceAddJob(JSONElement * events, IWorkerThreadController * iwtc, int tid, IThreadTraceEvent * itte)
+{
+    const double START = _IWorkerThreadControllerTraceTimestamp(iwtc, itte->start_time_ns);
+    if (itte->enqueue_time_ns && itte->enqueue_time_ns <= itte->start_time_ns &&
+        (!_IWorkerThreadControllerTraceAddQueued(events, "b", tid, _IWorkerThreadControllerTraceTimestamp(iwtc, itte->enqueue_time_ns),
+                                                 itte->job_id) ||
+         !_IWorkerThreadControllerTraceAddQueued(events, "e", tid, START, itte->job_id)))
+        return false;
+
+    JSONElement * run = _IWorkerThreadControllerTraceCreateEvent(itte->failed ? "job (failed)" : "job", "job", "X", tid, START);
+    JSONElement * args = JSONCreateObjectElement();
+    const bool OK = run && args &&
+        IThreadJSONAddNumber(run, "dur", (double) (itte->end_time_ns - itte->start_time_ns) / 1000.0) &&
+        IThreadJSONAddNumber(args, "job_id", itte->job_id) &&
+        IThreadJSONAddNumber(args, "attempt", itte->attempt) &&
+        IThreadJSONAddNumber(args, "wait_us", itte->enqueue_time_ns && itte->enqueue_time_ns <= itte->start_time_ns
+                                              ? (double) (itte->start_time_ns - itte->enqueue_time_ns) / 1000.0 : 0.0) &&
+        IThreadJSONAddElement(args, "failed", JSONCreateBooleanElement(itte->failed));
+    if (OK) {
+        const bool ADDED = IThreadJSONAddElement(run, "args", args);
+        args = NULL;
+        if (ADDED) return _IWorkerThreadControllerTraceAddEvent(events, run);
+    }
+    if (args) JSONFreeElement(args);
+    if (run) JSONFreeElement(run);
+    return false;
+}
+
+/// @brief Renders the jobs recorded by a controller's worker threads (see IWorkerThreadControllerSetTracing()) as a Chrome
+///         trace-event object (the format read by chrome://tracing and Perfetto).  Each worker thread is a track showing the jobs
+///         it ran, with idle time as gaps, and each job's time in the queue is an asynchronous span.  Timestamps are microseconds
+///         since the controller was created.  Can be called while the controller is running: only events already recorded are
+///         included.  The caller is responsible for freeing the element (JSONFreeElement()).
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @return Pointer to a JSON object element, or NULL if the controller is invalid or memory could not be reserved.
+JSONElement * IWorkerThreadControllerTraceToJSON(IWorkerThreadController * iwtc)
+{
+    if (!IWorkerThreadControllerIsValid(iwtc)) return NULL;
+    JSONElement * object = JSONCreateObjectElement();
+    JSONElement * events = JSONCreateArrayElement();
+    JSONElement * other = JSONCreateObjectElement();
+    if (!object || !events || !other) {
+        if (object) JSONFreeElement(object);
+        if (events) JSONFreeElement(events);
+        if (other) JSONFreeElement(other);
+        return NULL;
+    }
+
+    bool ok = _IWorkerThreadControllerTraceAddName(events, "process_name", 0, "libithread");
+    size_t dropped = 0;
+    for (int t = 0; ok && t < iwtc->threads_count; t++) {
+        IWorkerThread * iwt = iwtc->threads[t];
+        IThreadTraceBuffer * ittb = iwt ? atomic_load_explicit(&iwt->trace_buffer, memory_order_acquire) : NULL;
+        if (!ittb) continue;
+        char thread_name[32];
+        snprintf(thread_name, sizeof(thread_name), "worker %d", iwt->id);
+        ok = _IWorkerThreadControllerTraceAddName(events, "thread_name", iwt->id, thread_name);
+        const size_t COUNT = IThreadTraceBufferGetCount(ittb);
+        for (size_t e = 0; ok && e < COUNT; e++) ok = _IWorkerThreadControllerTraceAddJob(events, iwtc, iwt->id, &ittb->events[e]);
+        dropped += IThreadTraceBufferGetDroppedCount(ittb);
+    }
+
+    // Events dropped because a worker's buffer filled up are noted, so a trace that stops early isn't mistaken for idle workers.
+    ok = ok && IThreadJSONAddNumber(other, "dropped_events", dropped);
+    // The arrays and objects belong to the trace once added (each is freed by IThreadJSONAddElement() if it can't be).
+    if (ok) ok = IThreadJSONAddElement(object, "traceEvents", events);
+    else JSONFreeElement(events);
+    if (ok) ok = IThreadJSONAddString(object, "displayTimeUnit", "ns");
+    if (ok) ok = IThreadJSONAddElement(object, "otherData", other);
+    else JSONFreeElement(other);
+    if (!ok) {
+        JSONFreeElement(object);
+        return NULL;
+    }
+    return object;
+}
+
+/// @brief Writes the jobs recorded by a controller's worker threads to a file as Chrome trace-event JSON, ready to load into
+///         chrome://tracing or Perfetto.
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @param filename Name of the file to write to (overwritten if it exists).
+/// @return True if the file was written, false otherwise.
+bool IWorkerThreadControllerTraceWriteJSON(IWorkerThreadController * iwtc, char * filename)
+{
+    JSONElement * object = IWorkerThreadControllerTraceToJSON(iwtc);
+    if (!object) return false;
+    const bool WRITTEN = JSONWriteElementToFile(object, filename);
+    JSONFreeElement(object);
+    return WRITTEN;
+}
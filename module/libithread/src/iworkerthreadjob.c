@@ -3,31 +3,277 @@
 #include "global.h"
 #include "iworkerthread.h"
 #include "iworkerthreadjob.h"
+#include "iworkerthreadjobfuture.h"
+#include "iworkerthreadjobgraph.h"
+#include "iworkerthreadjobpool.h"
 
+/// @brief Marks a running job as failed.  This is normally called by a job's main function, which should then return; the worker
+///         thread calls the failure callback (instead of the success callback) once the main function has returned.
+/// @param iwtj Pointer to job data structure.
+/// @param message Message describing why the job failed (copied, up to 511 characters).
 void IWorkerThreadJobFailed(IWorkerThreadJob * iwtj, char * message)
 {
-    if (!IWorkerThreadJobIsValid(iwtj) || iwtj->state != IThreadJobStateRunning || iwtj->state != IThreadJobStatePaused) return;
-    iwtj->state = IThreadJobStateFailed;
-    iwtj->failure_message = (char *) malloc(512);
-    if (iwtj->failure_message) strncpy(iwtj->failure_message, message, 512);
-    IWorkerThread * iwt = IWorkerThreadJobGetParentThread(iwtj);
-    iwt->jobFailureCallbackFunction(iwtj);
+    if (!IWorkerThreadJobIsValid(iwtj)) return;
+    const IThreadJobState STATE = atomic_load_explicit(&iwtj->state, memory_order_acquire);
+    if (STATE != IThreadJobStateRunning && STATE != IThreadJobStatePaused) return;
+    atomic_store_explicit(&iwtj->state, IThreadJobStateFailed, memory_order_release);
+    if (!iwtj->failure_message) iwtj->failure_message = (char *) malloc(512);
+    if (iwtj->failure_message) {
+        strncpy(iwtj->failure_message, message ? message : "", 511);
+        iwtj->failure_message[511] = 0;
+    }
+}
+
+/// @brief Calls the parent worker thread's failure callback if a finished job failed, otherwise its success callback (jobs with
+///         their own function, see IWorkerThreadJobSetFunction(), don't use the worker thread's callbacks).
+static void _IWorkerThreadJobRunCallback(IWorkerThreadJob * iwtj)
+{
+    IWorkerThread * iwt = iwtj->function ? NULL : atomic_load_explicit(&iwtj->worker_thread, memory_order_acquire);
+    if (!iwt) return;
+    if (atomic_load_explicit(&iwtj->state, memory_order_acquire) == IThreadJobStateFailed) {
+        if (iwt->jobFailureCallbackFunction) iwt->jobFailureCallbackFunction(iwtj);
+    } else if (iwt->jobSuccessCallbackFunction) iwt->jobSuccessCallbackFunction(iwtj);
+}
+
+/// @brief Marks a processed job as done (unless it failed), optionally calls its callback, then completes the job's future (if
+///         it has one) and, if the job is part of a job graph, releases the jobs that depend on it.
+static void _IWorkerThreadJobComplete(IWorkerThreadJob * iwtj, bool run_callback)
+{
+    if (!IWorkerThreadJobIsValid(iwtj)) return;
+    if (atomic_load_explicit(&iwtj->state, memory_order_acquire) != IThreadJobStateFailed)
+        atomic_store_explicit(&iwtj->state, IThreadJobStateDone, memory_order_release);
+    if (run_callback) _IWorkerThreadJobRunCallback(iwtj);
+    if (iwtj->future) {
+        IWorkerThreadJobFutureComplete(iwtj->future, iwtj);
+        iwtj->future = NULL;
+    }
+    if (iwtj->graph_node) IWorkerThreadJobGraphNodeComplete(iwtj);
+}
+
+/// @brief Finishes off a job that has been processed.  The parent worker thread's failure callback is called if the job was marked
+///         as failed, otherwise the job is marked as done and the success callback is called (jobs with their own function, see
+///         IWorkerThreadJobSetFunction(), don't use the worker thread's callbacks).  Finally, the job's future (if it
+///         has one) is completed and, if the job is part of a job graph, the jobs that depend on it are released.
+/// @param iwtj Pointer to job data structure.
+void IWorkerThreadJobComplete(IWorkerThreadJob * iwtj)
+{
+    _IWorkerThreadJobComplete(iwtj, true);
+}
+
+/// @brief Finishes off a job that has been processed, as IWorkerThreadJobComplete() does, but leaves its callback to be called
+///         later by IWorkerThreadJobRunCallback() (see IWorkerThreadControllerSetCompletionQueue()).  The job's future and job graph
+///         node are still completed straight away, so anyone waiting on them isn't held up by the callback.
+/// @param iwtj Pointer to job data structure.
+void IWorkerThreadJobCompleteDeferred(IWorkerThreadJob * iwtj)
+{
+    _IWorkerThreadJobComplete(iwtj, false);
+}
+
+/// @brief Calls the callback of a job finished with IWorkerThreadJobCompleteDeferred().
+/// @param iwtj Pointer to job data structure.
+void IWorkerThreadJobRunCallback(IWorkerThreadJob * iwtj)
+{
+    if (!IWorkerThreadJobIsValid(iwtj)) return;
+    _IWorkerThreadJobRunCallback(iwtj);
+}
+
+/// @brief Asks a job to stop.  The job's main function is expected to check IWorkerThreadJobIsCancelled() at convenient points and
+///         return early once it is set.  A job that is cancelled before it starts is never run.  Either way the worker thread fails
+///         the job with the given reason (unless the job failed itself) and carries on with the next job.
+/// @param iwtj Pointer to job data structure.
+/// @param reason Failure message for the job.  Must remain valid for the lifetime of the job (typically a string literal).
+/// @return True if this call cancelled the job, false if the job is invalid or had already been cancelled.
+bool IWorkerThreadJobCancel(IWorkerThreadJob * iwtj, const char * reason)
+{
+    if (!IWorkerThreadJobIsValid(iwtj)) return false;
+    const char * expected = NULL;
+    return atomic_compare_exchange_strong(&iwtj->cancel_reason, &expected, reason ? reason : ITHREAD_JOB_CANCELLED_MESSAGE);
+}
+
+/// @brief Indicates if a job has been asked to stop (cancelled directly, through its future or its job graph, or because it ran past
+///         its deadline or its worker thread's timeout).  Cheap enough to call in a job's inner loop.  A job running on a worker
+///         thread must only check this on that thread.
+/// @param iwtj Pointer to job data structure.
+/// @return True if the job should stop, false otherwise.
+bool IWorkerThreadJobIsCancelled(IWorkerThreadJob * iwtj)
+{
+    if (!iwtj) return false;
+    if (atomic_load_explicit(&iwtj->cancel_reason, memory_order_relaxed)) return true;
+    if (atomic_load_explicit(&iwtj->state, memory_order_acquire) == IThreadJobStateRunning &&
+        IWorkerThreadGetWatchdogCancelReason(atomic_load_explicit(&iwtj->worker_thread, memory_order_acquire), iwtj)) return true;
+    if (iwtj->graph_node && atomic_load_explicit(&iwtj->graph_node->graph->cancelled, memory_order_relaxed)) return true;
+    return iwtj->future && atomic_load_explicit(&iwtj->future->cancel_requested, memory_order_relaxed);
+}
+
+/// @brief Gets the reason a job was cancelled.
+/// @param iwtj Pointer to job data structure.
+/// @return The reason passed to IWorkerThreadJobCancel(), ITHREAD_JOB_GRAPH_CANCELLED_MESSAGE if the job's graph was cancelled,
+///         ITHREAD_JOB_CANCELLED_MESSAGE if the job's future was cancelled, or NULL if the job hasn't been cancelled.
+const char * IWorkerThreadJobGetCancelReason(IWorkerThreadJob * iwtj)
+{
+    if (!IWorkerThreadJobIsValid(iwtj)) return NULL;
+    const char * reason = atomic_load_explicit(&iwtj->cancel_reason, memory_order_acquire);
+    if (!reason && atomic_load_explicit(&iwtj->state, memory_order_acquire) == IThreadJobStateRunning)
+        reason = IWorkerThreadGetWatchdogCancelReason(atomic_load_explicit(&iwtj->worker_thread, memory_order_acquire), iwtj);
+    if (!reason && iwtj->graph_node && atomic_load_explicit(&iwtj->graph_node->graph->cancelled, memory_order_acquire))
+        reason = ITHREAD_JOB_GRAPH_CANCELLED_MESSAGE;
+    if (!reason && iwtj->future && atomic_load_explicit(&iwtj->future->cancel_requested, memory_order_acquire))
+        reason = ITHREAD_JOB_CANCELLED_MESSAGE;
+    return reason;
+}
+
+/// @brief Gives a job a deadline, measured from now.  A job still queued at its deadline is failed without being run, and a job
+///         still running is cancelled (see IWorkerThreadJobCancel()) by the worker thread controller's watchdog.
+/// @param iwtj Pointer to job data structure.
+/// @param timeout_ms Milliseconds from now until the deadline.  Zero or less removes the deadline.
+void IWorkerThreadJobSetDeadline(IWorkerThreadJob * iwtj, long timeout_ms)
+{
+    if (!IWorkerThreadJobIsValid(iwtj)) return;
+    iwtj->deadline_ns = timeout_ms > 0 ? IThreadGetTimeNs() + (uint64_t) timeout_ms * 1000000ULL : 0;
+}
+
+/// @brief Gives a job a retry policy.  A job that fails (other than by being cancelled or running out of time) is run again after a
+///         delay, until it succeeds or has had max_attempts attempts.  The delay doubles with every attempt, starting from
+///         base_delay_ms and never going over ITHREAD_JOB_RETRY_MAX_DELAY_MS, and is then cut by a random fraction of up to jitter
+///         so that jobs that failed together (e.g. because a server was down) don't all retry at the same moment.  The worker
+///         thread's failure callback, the job's future and its job graph only hear about the final attempt.  This can be called
+///         by the job's main function, so a job can decide for itself whether a failure is worth retrying.
+/// @param iwtj Pointer to job data structure.
+/// @param max_attempts Most times to run the job, including the first (1 or less means the job isn't retried).
+/// @param base_delay_ms Milliseconds to wait before the first retry.
+/// @param jitter Fraction of each delay (0.0 to 1.0) that is random.
+void IWorkerThreadJobSetRetryPolicy(IWorkerThreadJob * iwtj, int max_attempts, long base_delay_ms, double jitter)
+{
+    if (!IWorkerThreadJobIsValid(iwtj)) return;
+    iwtj->max_attempts = max_attempts > 1 ? max_attempts : 1;
+    iwtj->retry_delay_ns = base_delay_ms > 0 ? (uint64_t) base_delay_ms * 1000000ULL : 0;
+    iwtj->retry_jitter = jitter < 0.0 ? 0.0 : jitter > 1.0 ? 1.0 : jitter;
+}
+
+/// @brief Indicates if a job that has just been run should be retried rather than completed: it failed, wasn't cancelled, has
+///         attempts left and would still be within its deadline (if it has one) after waiting for its retry delay.
+/// @param iwtj Pointer to job data structure.
+/// @return True if the job should be retried, false otherwise.
+bool IWorkerThreadJobShouldRetry(IWorkerThreadJob * iwtj)
+{
+    if (!IWorkerThreadJobIsValid(iwtj) || atomic_load_explicit(&iwtj->state, memory_order_acquire) != IThreadJobStateFailed ||
+        iwtj->attempts >= iwtj->max_attempts) return false;
+    if (IWorkerThreadJobIsCancelled(iwtj)) return false;
+    return !iwtj->deadline_ns || IThreadGetTimeNs() + IWorkerThreadJobGetRetryDelay(iwtj) < iwtj->deadline_ns;
+}
+
+/// @brief Gets how long a failed job waits before its next attempt (see IWorkerThreadJobSetRetryPolicy()).  The random part is
+///         derived from the job's id and attempt count, so it differs from job to job without any shared random number state.
+/// @param iwtj Pointer to job data structure.
+/// @return Delay in nanoseconds.
+uint64_t IWorkerThreadJobGetRetryDelay(IWorkerThreadJob * iwtj)
+{
+    if (!IWorkerThreadJobIsValid(iwtj) || iwtj->retry_delay_ns == 0) return 0;
+    const uint64_t MAXIMUM_DELAY = ITHREAD_JOB_RETRY_MAX_DELAY_MS * 1000000ULL;
+    uint64_t delay = iwtj->retry_delay_ns;
+    for (int a = 1; a < iwtj->attempts && delay < MAXIMUM_DELAY; a++) delay <<= 1;
+    if (delay > MAXIMUM_DELAY) delay = MAXIMUM_DELAY;
+    if (iwtj->retry_jitter > 0.0) {
+        // SplitMix64 finaliser, to turn the job id and attempt into a well mixed random number.
+        uint64_t random = ((uint64_t) iwtj->id << 8) + (uint64_t) iwtj->attempts + 0x9e3779b97f4a7c15ULL;
+        random = (random ^ (random >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        random = (random ^ (random >> 27)) * 0x94d049bb133111ebULL;
+        random ^= random >> 31;
+        delay -= (uint64_t) ((double) delay * iwtj->retry_jitter * ((double) (random >> 11) / (double) (1ULL << 53)));
+    }
+    return delay;
+}
+
+/// @brief Gets the number of times a job has been run, including the current attempt if it is running.
+int IWorkerThreadJobGetAttempts(IWorkerThreadJob * iwtj)
+{
+    return IWorkerThreadJobIsValid(iwtj) ? iwtj->attempts : 0;
 }
 
+/// @brief Asks for a running job to be paused once its main function returns, rather than completed.  This lets a job that has to
+///         wait (for I/O, another job, a message, ...) give its worker thread back instead of blocking it: the job records where
+///         it has got to, yields and returns, and is queued again (see IWorkerThreadControllerResumeJob()) when whatever it is
+///         waiting for happens.  The main function is then called again and carries on from IWorkerThreadJobGetStep(), e.g.
+///             switch (IWorkerThreadJobGetStep(iwtj)) {
+///                 case 0: start_read(iwtj); IWorkerThreadJobYield(iwtj, 1); return;
+///                 case 1: use_result(iwtj); break;
+///             }
+///         Anything else the job needs to keep between steps belongs in its data.  A job that fails or is cancelled after
+///         yielding is finished as usual instead of being paused.  Must only be called by the job's main function.
+/// @param iwtj Pointer to job data structure.
+/// @param next_step Step to carry on from when the job is resumed.
+void IWorkerThreadJobYield(IWorkerThreadJob * iwtj, int next_step)
+{
+    if (!IWorkerThreadJobIsValid(iwtj) || atomic_load_explicit(&iwtj->state, memory_order_acquire) != IThreadJobStateRunning) return;
+    iwtj->step = next_step;
+    iwtj->yield_requested = true;
+}
+
+/// @brief Gets the step a resumable job should carry on from (see IWorkerThreadJobYield()).  0 the first time a job runs.
+int IWorkerThreadJobGetStep(IWorkerThreadJob * iwtj)
+{
+    return IWorkerThreadJobIsValid(iwtj) ? iwtj->step : 0;
+}
+
+/// @brief Gets a job's deadline.
+/// @param iwtj Pointer to job data structure.
+/// @return Deadline on the IThreadGetTimeNs() clock, or 0 if the job has no deadline.
+uint64_t IWorkerThreadJobGetDeadline(IWorkerThreadJob * iwtj)
+{
+    return IWorkerThreadJobIsValid(iwtj) ? iwtj->deadline_ns : 0;
+}
+
+/// @brief Gives a job its own main function, which the worker thread runs instead of its usual one.  Used for library internal
+///         jobs (e.g. IThreadParallelFor()) that share a controller with the application's jobs.  The worker thread's success and
+///         failure callbacks aren't called for such jobs.  Must be set before the job is queued.
+/// @param iwtj Pointer to job data structure.
+/// @param function Pointer to the job's main function, or NULL to use the worker thread's.
+void IWorkerThreadJobSetFunction(IWorkerThreadJob * iwtj, void (* function)(IWorkerThreadJob *))
+{
+    if (IWorkerThreadJobIsValid(iwtj)) iwtj->function = function;
+}
+
+/// @brief Sets the result of a job, which is passed on to the job's future (see IWorkerThreadControllerSubmitJob()).
+/// @param iwtj Pointer to job data structure.
+/// @param result Pointer to the result.  The library never dereferences or frees it.
+void IWorkerThreadJobSetResult(IWorkerThreadJob * iwtj, void * result)
+{
+    if (IWorkerThreadJobIsValid(iwtj)) iwtj->result = result;
+}
+
+void * IWorkerThreadJobGetResult(IWorkerThreadJob * iwtj)
+{
+    return IWorkerThreadJobIsValid(iwtj) ? iwtj->result : NULL;
+}
+
+/// @brief Frees a job.  Jobs that came from a job pool are handed back to the pool rather than having their memory freed.
+/// @param itj Pointer to job data structure.
 void IWorkerThreadJobFree(IWorkerThreadJob * itj)
 {
     if (!IWorkerThreadJobIsValid(itj)) return;
+    // If the job is being thrown away without having been completed, let anyone waiting on its future know.
+    if (itj->future) {
+        IWorkerThreadJobFutureComplete(itj->future, itj);
+        itj->future = NULL;
+    }
+    // Likewise the job's graph, which won't run anything that depends on it.
+    if (itj->graph_node) IWorkerThreadJobGraphNodeComplete(itj);
+    if (itj->pool) {
+        IWorkerThreadJobPoolRelease(itj->pool, itj);
+        return;
+    }
     itj->data = NULL;
-    itj->start_time = itj->end_time = 0;
+    itj->result = NULL;
+    itj->start_time_ns = itj->end_time_ns = 0;
     if (itj->failure_message) {
         free(itj->failure_message);
         itj->failure_message = NULL;
     }
     itj->next_job = NULL;
-    itj->state = IThreadJobStateUnusuable;
+    atomic_store_explicit(&itj->state, IThreadJobStateUnusuable, memory_order_release);
     itj->struct_id = 0;
     itj->id = 0;
-    itj->worker_thread = NULL;
+    atomic_store_explicit(&itj->worker_thread, NULL, memory_order_release);
     free(itj);
 }
 
@@ -36,19 +282,50 @@ void * IWorkerThreadJobGetData(IWorkerThreadJob * iwj)
     return IWorkerThreadJobIsValid(iwj) ? iwj->data : NULL;
 }
 
+/// @brief Gets the context of the worker thread running a job (see IWorkerThreadControllerSetWorkerHooks()).
+/// @param iwtj Pointer to job data structure.
+/// @return Pointer to the worker thread's context, or NULL if it has none or the job isn't running.
+void * IWorkerThreadJobGetWorkerContext(IWorkerThreadJob * iwtj)
+{
+    if (!IWorkerThreadJobIsValid(iwtj)) return NULL;
+    return IWorkerThreadGetContext(atomic_load_explicit(&iwtj->worker_thread, memory_order_acquire));
+}
+
+/// @brief Allocates scratch memory for a job from the arena of the worker thread running it.  Nothing needs freeing: the arena is
+///         emptied once the worker has finished with the job, and a job that yields gets a fresh arena for each step.  Allocating
+///         is just a pointer bump, and once the arena has grown to fit a typical job, no memory is reserved or released from one
+///         job to the next.  The memory is for the job's own use only: with the controller's completion queue on, the arena is
+///         emptied before the job's callback runs on the draining thread, so a result (see IWorkerThreadJobSetResult()) or
+///         anything else read after the job has finished must never come from the arena.
+/// @param iwtj Pointer to a running job.
+/// @param size Number of bytes needed.
+/// @return Pointer to the memory, or NULL if the job isn't running on a worker thread or memory could not be reserved.
+void * IWorkerThreadJobArenaAlloc(IWorkerThreadJob * iwtj, size_t size)
+{
+    if (!IWorkerThreadJobIsValid(iwtj)) return NULL;
+    IWorkerThread * iwt = atomic_load_explicit(&iwtj->worker_thread, memory_order_acquire);
+    return IWorkerThreadIsValid(iwt) ? IThreadArenaAlloc(iwt->arena, size) : NULL;
+}
+
 size_t IWorkerThreadJobGetId(IWorkerThreadJob * iwtj)
 {
     return !IWorkerThreadJobIsValid(iwtj) ? 0 : iwtj->id;
 }
 
+IThreadPriority IWorkerThreadJobGetPriority(IWorkerThreadJob * iwtj)
+{
+    return !IWorkerThreadJobIsValid(iwtj) ? IThreadPriorityNone : iwtj->priority;
+}
+
 IWorkerThread * IWorkerThreadJobGetParentThread(IWorkerThreadJob * iwtj)
 {
-    return !IWorkerThreadJobIsValid(iwtj) ? NULL : iwtj->worker_thread;
+    return !IWorkerThreadJobIsValid(iwtj) ? NULL : atomic_load_explicit(&iwtj->worker_thread, memory_order_acquire);
 }
 
 bool IWorkerThreadJobIsValid(IWorkerThreadJob * iwtj)
 {
-    return iwtj && iwtj->struct_id == ITHREAD_DATA_STRUCT_ID && iwtj->state != IThreadJobStateUnusuable;
+    return iwtj && iwtj->struct_id == ITHREAD_DATA_STRUCT_ID &&
+           atomic_load_explicit(&iwtj->state, memory_order_acquire) != IThreadJobStateUnusuable;
 }
 
 IWorkerThreadJob * IWorkerThreadJobCreate(void * data)
@@ -57,12 +334,46 @@ IWorkerThreadJob * IWorkerThreadJobCreate(void * data)
     IWorkerThreadJob * itj = (IWorkerThreadJob *) malloc(sizeof(IWorkerThreadJob));
     if (itj) {
         // We've managed to allocate memory for the data structure, so initialise it.
-        itj->struct_id = ITHREAD_DATA_STRUCT_ID;
-        itj->state = IThreadJobStateInitialised;
-        itj->end_time = itj->start_time = 0;
         itj->failure_message = NULL;
-        itj->next_job = NULL;
-        itj->data = data;
+        itj->pool = NULL;
+        itj->pool_index = 0;
+        atomic_init(&itj->pool_next, 0);
+        atomic_init(&itj->cancel_reason, NULL);
+        IWorkerThreadJobReset(itj, data);
     }
     return itj;
+}
+
+/// @brief Puts a job data structure back into its freshly created state, ready to process the given data.  Any failure message
+///         buffer is kept (but emptied) so that a recycled job doesn't need to allocate a new one.
+/// @param iwtj Pointer to job data structure.
+/// @param data Pointer to job data.
+void IWorkerThreadJobReset(IWorkerThreadJob * iwtj, void * data)
+{
+    if (!iwtj) return;
+    iwtj->struct_id = ITHREAD_DATA_STRUCT_ID;
+    atomic_store_explicit(&iwtj->state, IThreadJobStateInitialised, memory_order_release);
+    iwtj->end_time_ns = iwtj->start_time_ns = 0;
+    iwtj->enqueue_time_ns = 0;
+    iwtj->deadline_ns = 0;
+    iwtj->attempts = 0;
+    iwtj->max_attempts = 1;
+    iwtj->retry_delay_ns = 0;
+    iwtj->retry_jitter = 0.0;
+    iwtj->step = 0;
+    iwtj->yield_requested = iwtj->resuming = false;
+    atomic_store_explicit(&iwtj->park_state, ITHREAD_JOB_PARK_NONE, memory_order_relaxed);
+    iwtj->named_queue = NULL;
+    iwtj->strand = NULL;
+    atomic_store_explicit(&iwtj->cancel_reason, NULL, memory_order_relaxed);
+    iwtj->priority = IThreadPriorityNormal;
+    if (iwtj->failure_message) iwtj->failure_message[0] = 0;
+    iwtj->next_job = NULL;
+    iwtj->data = data;
+    iwtj->result = NULL;
+    iwtj->function = NULL;
+    iwtj->future = NULL;
+    iwtj->graph_node = NULL;
+    atomic_store_explicit(&iwtj->worker_thread, NULL, memory_order_release);
+    iwtj->id = 0;
 }
\ No newline at end of file
@@ -0,0 +1,162 @@
+#include "global.h"
+#include "iworkerthreadjobdeque.h"
+
+/// @brief Allocates a circular array able to hold 'size' jobs.
+static IWorkerThreadJobDequeArray * _IWorkerThreadJobDequeArrayCreate(long size)
+{
+    IWorkerThreadJobDequeArray * array = (IWorkerThreadJobDequeArray *) malloc(sizeof(IWorkerThreadJobDequeArray) + sizeof(IWorkerThreadJob *) * size);
+    if (array) {
+        array->size = size;
+        array->previous_array = NULL;
+    }
+    return array;
+}
+
+/// @brief Creates a work-stealing deque (a Chase-Lev deque, using the C11 memory orderings given by Le et al.).  The owning worker
+///         thread pushes and pops jobs at the bottom of the deque without any atomic read-modify-write operations in the common
+///         case, whilst other worker threads steal jobs from the top.
+/// @return Pointer to the deque data structure or NULL if there is not enough memory.
+IWorkerThreadJobDeque * IWorkerThreadJobDequeCreate()
+{
+    IWorkerThreadJobDeque * iwtjd = (IWorkerThreadJobDeque *) aligned_alloc(ITHREAD_CACHE_LINE_SIZE, sizeof(IWorkerThreadJobDeque));
+    if (!iwtjd) return NULL;
+    IWorkerThreadJobDequeArray * array = _IWorkerThreadJobDequeArrayCreate(ITHREAD_DEFAULT_JOB_DEQUE_SIZE);
+    if (!array) {
+        free(iwtjd);
+        return NULL;
+    }
+    iwtjd->struct_id = ITHREAD_DATA_STRUCT_ID;
+    atomic_init(&iwtjd->top, 0);
+    atomic_init(&iwtjd->bottom, 0);
+    atomic_init(&iwtjd->array, array);
+    return iwtjd;
+}
+
+bool IWorkerThreadJobDequeIsValid(IWorkerThreadJobDeque * iwtjd)
+{
+    return iwtjd && iwtjd->struct_id == ITHREAD_DATA_STRUCT_ID;
+}
+
+/// @brief Pushes a batch of jobs on to the bottom of the deque, growing the deque at most once and publishing all of them with a
+///         single store.  Must only be called by the thread that owns the deque.
+/// @param iwtjd Pointer to deque data structure.
+/// @param jobs Array of pointers to jobs.  The last job in the array ends up at the bottom of the deque.
+/// @param jobs_count Number of jobs in the array.
+/// @return True if the jobs were added, false if the deque needed to grow and there was not enough memory.
+bool IWorkerThreadJobDequePushBatch(IWorkerThreadJobDeque * iwtjd, IWorkerThreadJob ** jobs, size_t jobs_count)
+{
+    if (!IWorkerThreadJobDequeIsValid(iwtjd) || !jobs) return false;
+    const long BOTTOM = atomic_load_explicit(&iwtjd->bottom, memory_order_relaxed);
+    const long TOP = atomic_load_explicit(&iwtjd->top, memory_order_acquire);
+    IWorkerThreadJobDequeArray * array = atomic_load_explicit(&iwtjd->array, memory_order_relaxed);
+    if (BOTTOM - TOP + (long) jobs_count > array->size) {
+        // There isn't room, so copy the jobs into an array big enough for the whole batch.  Thieves may still be reading the old
+        // array, so it is kept (linked from the new one) until the deque is freed.
+        long new_size = array->size * 2;
+        while (BOTTOM - TOP + (long) jobs_count > new_size) new_size *= 2;
+        IWorkerThreadJobDequeArray * new_array = _IWorkerThreadJobDequeArrayCreate(new_size);
+        if (!new_array) return false;
+        for (long i = TOP; i < BOTTOM; i++) {
+            IWorkerThreadJob * job = atomic_load_explicit(&array->jobs[i % array->size], memory_order_relaxed);
+            atomic_store_explicit(&new_array->jobs[i % new_array->size], job, memory_order_relaxed);
+        }
+        new_array->previous_array = array;
+        atomic_store_explicit(&iwtjd->array, new_array, memory_order_release);
+        array = new_array;
+    }
+    for (size_t j = 0; j < jobs_count; j++) {
+        atomic_store_explicit(&array->jobs[(BOTTOM + (long) j) % array->size], jobs[j], memory_order_relaxed);
+    }
+    // A release store (rather than a release fence and a relaxed store) publishes the jobs to thieves just the same, and is
+    // something ThreadSanitizer understands.
+    atomic_store_explicit(&iwtjd->bottom, BOTTOM + (long) jobs_count, memory_order_release);
+    return true;
+}
+
+/// @brief Pushes a job on to the bottom of the deque.  Must only be called by the thread that owns the deque.
+/// @param iwtjd Pointer to deque data structure.
+/// @param iwtj Pointer to job.
+/// @return True if the job was added, false if the deque needed to grow and there was not enough memory.
+bool IWorkerThreadJobDequePush(IWorkerThreadJobDeque * iwtjd, IWorkerThreadJob * iwtj)
+{
+    return iwtj && IWorkerThreadJobDequePushBatch(iwtjd, &iwtj, 1);
+}
+
+/// @brief Pops the most recently pushed job from the bottom of the deque.  Must only be called by the thread that owns the deque.
+/// @param iwtjd Pointer to deque data structure.
+/// @return Pointer to the job, or NULL if the deque is empty (or the last job was stolen).
+IWorkerThreadJob * IWorkerThreadJobDequePop(IWorkerThreadJobDeque * iwtjd)
+{
+    if (!IWorkerThreadJobDequeIsValid(iwtjd)) return NULL;
+    const long BOTTOM = atomic_load_explicit(&iwtjd->bottom, memory_order_relaxed) - 1;
+    IWorkerThreadJobDequeArray * array = atomic_load_explicit(&iwtjd->array, memory_order_relaxed);
+    atomic_store_explicit(&iwtjd->bottom, BOTTOM, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long top = atomic_load_explicit(&iwtjd->top, memory_order_relaxed);
+    IWorkerThreadJob * iwtj = NULL;
+    if (top <= BOTTOM) {
+        iwtj = atomic_load_explicit(&array->jobs[BOTTOM % array->size], memory_order_relaxed);
+        if (top == BOTTOM) {
+            // This is the last job in the deque, so race any thieves for it.
+            if (!atomic_compare_exchange_strong_explicit(&iwtjd->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed)) iwtj = NULL;
+            atomic_store_explicit(&iwtjd->bottom, BOTTOM + 1, memory_order_relaxed);
+        }
+    } else atomic_store_explicit(&iwtjd->bottom, BOTTOM + 1, memory_order_relaxed);
+    return iwtj;
+}
+
+/// @brief Steals the oldest job from the top of the deque.  May be called by any thread.
+/// @param iwtjd Pointer to deque data structure.
+/// @return Pointer to the job, or NULL if the deque is empty or another thread took the job first.
+IWorkerThreadJob * IWorkerThreadJobDequeSteal(IWorkerThreadJobDeque * iwtjd)
+{
+    if (!IWorkerThreadJobDequeIsValid(iwtjd)) return NULL;
+    long top = atomic_load_explicit(&iwtjd->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    const long BOTTOM = atomic_load_explicit(&iwtjd->bottom, memory_order_acquire);
+    if (top >= BOTTOM) return NULL;
+    IWorkerThreadJobDequeArray * array = atomic_load_explicit(&iwtjd->array, memory_order_acquire);
+    IWorkerThreadJob * iwtj = atomic_load_explicit(&array->jobs[top % array->size], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&iwtjd->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed)) return NULL;
+    return iwtj;
+}
+
+/// @brief Indicates if the deque appears to hold any jobs.  The answer may be out of date as soon as it is returned.
+/// @param iwtjd Pointer to deque data structure.
+/// @return True if there are jobs in the deque, false otherwise.
+bool IWorkerThreadJobDequeHasJobs(IWorkerThreadJobDeque * iwtjd)
+{
+    if (!IWorkerThreadJobDequeIsValid(iwtjd)) return false;
+    const long TOP = atomic_load(&iwtjd->top);
+    const long BOTTOM = atomic_load(&iwtjd->bottom);
+    return BOTTOM > TOP;
+}
+
+/// @brief Gets the number of jobs in the deque.  The answer may be out of date as soon as it is returned.
+/// @param iwtjd Pointer to deque data structure.
+/// @return Number of jobs in the deque.
+size_t IWorkerThreadJobDequeGetCount(IWorkerThreadJobDeque * iwtjd)
+{
+    if (!IWorkerThreadJobDequeIsValid(iwtjd)) return 0;
+    const long TOP = atomic_load(&iwtjd->top);
+    const long BOTTOM = atomic_load(&iwtjd->bottom);
+    return BOTTOM > TOP ? (size_t) (BOTTOM - TOP) : 0;
+}
+
+/// @brief Frees the memory used by the deque (including any arrays replaced when the deque grew).  Jobs still in the deque are
+///         not freed.
+/// @param iwtjd Pointer to deque data structure.
+/// @return True if the pointer referenced a valid deque, false otherwise.
+bool IWorkerThreadJobDequeFree(IWorkerThreadJobDeque * iwtjd)
+{
+    if (!IWorkerThreadJobDequeIsValid(iwtjd)) return false;
+    IWorkerThreadJobDequeArray * array = atomic_load(&iwtjd->array);
+    while (array) {
+        IWorkerThreadJobDequeArray * previous_array = array->previous_array;
+        free(array);
+        array = previous_array;
+    }
+    iwtjd->struct_id = 0;
+    free(iwtjd);
+    return true;
+}
@@ -0,0 +1,240 @@
+#include <string.h>
+#include <pthread.h>
+
+#include "global.h"
+#include "iworkerthreadjob.h"
+#include "iworkerthreadjobfuture.h"
+
+// All futures share one lock and condition variable, which is only used when a thread actually has to block.  This lets a thread
+// wait on any mix of futures (see IWorkerThreadJobFutureWaitAny()) without registering itself with each of them.
+static pthread_mutex_t _iworker_thread_job_future_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _iworker_thread_job_future_condition;
+static pthread_once_t _iworker_thread_job_future_once = PTHREAD_ONCE_INIT;
+static atomic_int _iworker_thread_job_future_waiters = 0;
+
+/// @brief Initialises the shared condition variable so that timed waits use the monotonic clock.
+static void _IWorkerThreadJobFutureInitCondition()
+{
+    pthread_condattr_t attributes;
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&_iworker_thread_job_future_condition, &attributes);
+    pthread_condattr_destroy(&attributes);
+}
+
+/// @brief Drops a reference to the future, freeing it once both the job and the caller have finished with it.
+static void _IWorkerThreadJobFutureRelease(IWorkerThreadJobFuture * iwtjf)
+{
+    if (atomic_fetch_sub_explicit(&iwtjf->references, 1, memory_order_acq_rel) != 1) return;
+    if (iwtjf->failure_message) free(iwtjf->failure_message);
+    iwtjf->failure_message = NULL;
+    iwtjf->result = NULL;
+    iwtjf->struct_id = 0;
+    free(iwtjf);
+}
+
+/// @brief Indicates if a future state means the job will never change again.
+static bool _IWorkerThreadJobFutureStateIsFinal(IThreadJobState state)
+{
+    return state == IThreadJobStateDone || state == IThreadJobStateFailed || state == IThreadJobStateStopped;
+}
+
+/// @brief Counts how many of the given futures have completed.
+static size_t _IWorkerThreadJobFutureCountDone(IWorkerThreadJobFuture ** futures, size_t futures_count, long * first_done_index)
+{
+    size_t done_count = 0;
+    for (size_t f = 0; f < futures_count; f++) {
+        if (!IWorkerThreadJobFutureIsValid(futures[f]) || IWorkerThreadJobFutureIsDone(futures[f])) {
+            if (done_count++ == 0 && first_done_index) *first_done_index = (long) f;
+        }
+    }
+    return done_count;
+}
+
+/// @brief Blocks until at least 'required_count' of the given futures have completed, or the timeout expires.
+static size_t _IWorkerThreadJobFutureWaitFor(IWorkerThreadJobFuture ** futures, size_t futures_count, size_t required_count,
+                                              long timeout_ms, long * first_done_index)
+{
+    size_t done_count = _IWorkerThreadJobFutureCountDone(futures, futures_count, first_done_index);
+    if (done_count >= required_count || timeout_ms == 0) return done_count;
+
+    pthread_once(&_iworker_thread_job_future_once, _IWorkerThreadJobFutureInitCondition);
+    struct timespec deadline;
+    if (timeout_ms > 0) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (timeout_ms % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+    }
+
+    // Register as a waiter before re-checking the futures, so a job completing in between is guaranteed to see us.  The futures'
+    // states are read with acquire loads, which could otherwise be reordered before the registration, so a fence keeps them after
+    // it (pairing with the completing job's sequentially consistent store and load).
+    pthread_mutex_lock(&_iworker_thread_job_future_lock);
+    atomic_fetch_add(&_iworker_thread_job_future_waiters, 1);
+    atomic_thread_fence(memory_order_seq_cst);
+    while ((done_count = _IWorkerThreadJobFutureCountDone(futures, futures_count, first_done_index)) < required_count) {
+        if (timeout_ms < 0) pthread_cond_wait(&_iworker_thread_job_future_condition, &_iworker_thread_job_future_lock);
+        else if (pthread_cond_timedwait(&_iworker_thread_job_future_condition, &_iworker_thread_job_future_lock, &deadline) != 0) {
+            done_count = _IWorkerThreadJobFutureCountDone(futures, futures_count, first_done_index);
+            break;
+        }
+    }
+    atomic_fetch_sub(&_iworker_thread_job_future_waiters, 1);
+    pthread_mutex_unlock(&_iworker_thread_job_future_lock);
+    return done_count;
+}
+
+/// @brief Creates a future (completion handle) for a job that has not yet been queued.  The future is shared between the job and
+///         the caller, and is only freed once the job has completed and the caller has called IWorkerThreadJobFutureFree().
+/// @param iwtj Pointer to the job.
+/// @return Pointer to the future or NULL if the job is invalid or there is not enough memory.
+IWorkerThreadJobFuture * IWorkerThreadJobFutureCreate(IWorkerThreadJob * iwtj)
+{
+    if (!IWorkerThreadJobIsValid(iwtj) || iwtj->future) return NULL;
+    IWorkerThreadJobFuture * iwtjf = (IWorkerThreadJobFuture *) malloc(sizeof(IWorkerThreadJobFuture));
+    if (iwtjf) {
+        iwtjf->struct_id = ITHREAD_DATA_STRUCT_ID;
+        iwtjf->job_id = iwtj->id;
+        iwtjf->result = NULL;
+        iwtjf->failure_message = NULL;
+        atomic_init(&iwtjf->state, IThreadJobStateInitialised);
+        atomic_init(&iwtjf->references, 2);
+        atomic_init(&iwtjf->cancel_requested, false);
+        iwtj->future = iwtjf;
+    }
+    return iwtjf;
+}
+
+bool IWorkerThreadJobFutureIsValid(IWorkerThreadJobFuture * iwtjf)
+{
+    return iwtjf && iwtjf->struct_id == ITHREAD_DATA_STRUCT_ID;
+}
+
+/// @brief Records the outcome of a job in its future and wakes any threads waiting on it.  Called once the job's success or
+///         failure callback has returned (or when a job is freed without being run).  The job's reference to the future is
+///         released, so the job must not use the future afterwards.
+/// @param iwtjf Pointer to the future.
+/// @param iwtj Pointer to the job.
+void IWorkerThreadJobFutureComplete(IWorkerThreadJobFuture * iwtjf, IWorkerThreadJob * iwtj)
+{
+    if (!IWorkerThreadJobFutureIsValid(iwtjf) || !iwtj) return;
+    IThreadJobState state = atomic_load_explicit(&iwtj->state, memory_order_acquire);
+    if (!_IWorkerThreadJobFutureStateIsFinal(state)) state = IThreadJobStateStopped;
+    iwtjf->result = iwtj->result;
+    if (state == IThreadJobStateFailed && iwtj->failure_message) iwtjf->failure_message = strdup(iwtj->failure_message);
+    // Publish the outcome, then wake any waiters.  The sequentially consistent store pairs with the waiter registering itself.
+    atomic_store(&iwtjf->state, state);
+    if (atomic_load(&_iworker_thread_job_future_waiters) > 0) {
+        pthread_mutex_lock(&_iworker_thread_job_future_lock);
+        pthread_cond_broadcast(&_iworker_thread_job_future_condition);
+        pthread_mutex_unlock(&_iworker_thread_job_future_lock);
+    }
+    _IWorkerThreadJobFutureRelease(iwtjf);
+}
+
+/// @brief Asks for a future's job to be cancelled.  A job that hasn't started yet is failed without being run.  A running job sees
+///         the request through IWorkerThreadJobIsCancelled() and is expected to return early, after which it is failed with the
+///         message ITHREAD_JOB_CANCELLED_MESSAGE (unless it failed itself).  Either way the future completes as usual.
+/// @param iwtjf Pointer to the future.
+/// @return True if the request was made, false if the future is invalid or its job has already completed.
+bool IWorkerThreadJobFutureCancel(IWorkerThreadJobFuture * iwtjf)
+{
+    if (!IWorkerThreadJobFutureIsValid(iwtjf) || IWorkerThreadJobFutureIsDone(iwtjf)) return false;
+    atomic_store_explicit(&iwtjf->cancel_requested, true, memory_order_release);
+    return true;
+}
+
+/// @brief Polls a future to see if its job has completed (successfully or not).
+/// @param iwtjf Pointer to the future.
+/// @return True if the job has completed, false if it is still waiting or running.
+bool IWorkerThreadJobFutureIsDone(IWorkerThreadJobFuture * iwtjf)
+{
+    return IWorkerThreadJobFutureIsValid(iwtjf) && _IWorkerThreadJobFutureStateIsFinal(atomic_load_explicit(&iwtjf->state, memory_order_acquire));
+}
+
+/// @brief Blocks until the future's job has completed.
+/// @param iwtjf Pointer to the future.
+/// @return True if the job completed successfully, false if it failed, was never run, or the pointer is invalid.
+bool IWorkerThreadJobFutureWait(IWorkerThreadJobFuture * iwtjf)
+{
+    return IWorkerThreadJobFutureTimedWait(iwtjf, IThreadWaitForever);
+}
+
+/// @brief Blocks until the future's job has completed or the timeout expires.
+/// @param iwtjf Pointer to the future.
+/// @param timeout_ms Maximum time to wait in milliseconds, or IThreadWaitForever.
+/// @return True if the job completed successfully, false if it failed, was never run, the timeout expired or the pointer is invalid.
+bool IWorkerThreadJobFutureTimedWait(IWorkerThreadJobFuture * iwtjf, long timeout_ms)
+{
+    if (!IWorkerThreadJobFutureIsValid(iwtjf)) return false;
+    _IWorkerThreadJobFutureWaitFor(&iwtjf, 1, 1, timeout_ms, NULL);
+    return IWorkerThreadJobFutureGetState(iwtjf) == IThreadJobStateDone;
+}
+
+/// @brief Blocks until every one of the given futures has completed, or the timeout expires.
+/// @param futures Array of future pointers.  Invalid (e.g. NULL) entries are treated as complete.
+/// @param futures_count Number of futures in the array.
+/// @param timeout_ms Maximum time to wait in milliseconds, or IThreadWaitForever.
+/// @return True if all of the futures completed, false if the timeout expired first.
+bool IWorkerThreadJobFutureWaitAll(IWorkerThreadJobFuture ** futures, size_t futures_count, long timeout_ms)
+{
+    if (!futures) return futures_count == 0;
+    return _IWorkerThreadJobFutureWaitFor(futures, futures_count, futures_count, timeout_ms, NULL) == futures_count;
+}
+
+/// @brief Blocks until at least one of the given futures has completed, or the timeout expires.
+/// @param futures Array of future pointers.  Invalid (e.g. NULL) entries are treated as complete.
+/// @param futures_count Number of futures in the array.
+/// @param timeout_ms Maximum time to wait in milliseconds, or IThreadWaitForever.
+/// @return Index of the first completed future in the array, or -1 if the timeout expired (or there are no futures).
+long IWorkerThreadJobFutureWaitAny(IWorkerThreadJobFuture ** futures, size_t futures_count, long timeout_ms)
+{
+    if (!futures || futures_count == 0) return -1;
+    long first_done_index = -1;
+    return _IWorkerThreadJobFutureWaitFor(futures, futures_count, 1, timeout_ms, &first_done_index) > 0 ? first_done_index : -1;
+}
+
+/// @brief Gets the state of the future's job.  IThreadJobStateInitialised means the job hasn't completed yet.  Jobs that were
+///         discarded without being run report IThreadJobStateStopped.
+/// @param iwtjf Pointer to the future.
+/// @return State of the job or IThreadJobStateUnusuable if the pointer is invalid.
+IThreadJobState IWorkerThreadJobFutureGetState(IWorkerThreadJobFuture * iwtjf)
+{
+    return IWorkerThreadJobFutureIsValid(iwtjf) ? atomic_load_explicit(&iwtjf->state, memory_order_acquire) : IThreadJobStateUnusuable;
+}
+
+/// @brief Gets the result set by the job with IWorkerThreadJobSetResult().
+/// @param iwtjf Pointer to the future.
+/// @return The job's result, or NULL if the job hasn't completed (or set a result).
+void * IWorkerThreadJobFutureGetResult(IWorkerThreadJobFuture * iwtjf)
+{
+    return IWorkerThreadJobFutureIsDone(iwtjf) ? iwtjf->result : NULL;
+}
+
+/// @brief Gets the message the job was failed with.
+/// @param iwtjf Pointer to the future.
+/// @return The failure message, or NULL if the job hasn't completed or didn't fail.  The string belongs to the future.
+char * IWorkerThreadJobFutureGetFailureMessage(IWorkerThreadJobFuture * iwtjf)
+{
+    return IWorkerThreadJobFutureIsDone(iwtjf) ? iwtjf->failure_message : NULL;
+}
+
+size_t IWorkerThreadJobFutureGetJobId(IWorkerThreadJobFuture * iwtjf)
+{
+    return IWorkerThreadJobFutureIsValid(iwtjf) ? iwtjf->job_id : 0;
+}
+
+/// @brief Releases the caller's hold on a future.  The future must not be used afterwards.  It is safe to free a future before
+///         its job has completed; the memory is released once the job has finished with it.
+/// @param iwtjf Pointer to the future.
+/// @return True if the pointer referenced a valid future, false otherwise.
+bool IWorkerThreadJobFutureFree(IWorkerThreadJobFuture * iwtjf)
+{
+    if (!IWorkerThreadJobFutureIsValid(iwtjf)) return false;
+    _IWorkerThreadJobFutureRelease(iwtjf);
+    return true;
+}
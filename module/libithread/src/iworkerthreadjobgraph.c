@@ -0,0 +1,409 @@
+#include <string.h>
+
+#include "global.h"
+#include "iworkerthreadjob.h"
+#include "iworkerthreadjobgraph.h"
+#include "iworkerthreadjobprovider.h"
+#include "iworkerthreadcontroller.h"
+
+/// @brief Creates an empty job graph.  Jobs are added with IWorkerThreadJobGraphAddJob(), linked with
+///         IWorkerThreadJobGraphAddDependency() and then the whole graph is run with IWorkerThreadJobGraphSubmit().
+/// @return Pointer to job graph data structure, or NULL if memory could not be reserved for it.
+IWorkerThreadJobGraph * IWorkerThreadJobGraphCreate()
+{
+    IWorkerThreadJobGraph * iwtjg = (IWorkerThreadJobGraph *) malloc(sizeof(IWorkerThreadJobGraph));
+    if (!iwtjg) return NULL;
+    iwtjg->nodes_buffer_size = 8;
+    iwtjg->nodes = (IWorkerThreadJobGraphNode **) malloc(sizeof(IWorkerThreadJobGraphNode *) * iwtjg->nodes_buffer_size);
+    if (!iwtjg->nodes) {
+        free(iwtjg);
+        return NULL;
+    }
+    iwtjg->struct_id = ITHREAD_DATA_STRUCT_ID;
+    iwtjg->nodes_count = 0;
+    iwtjg->failure_policy = IWorkerThreadJobGraphFailureCancelDownstream;
+    iwtjg->controller = NULL;
+    iwtjg->submitted = iwtjg->finished = false;
+    atomic_init(&iwtjg->cancelled, false);
+    atomic_init(&iwtjg->nodes_finished, 0);
+    atomic_init(&iwtjg->nodes_failed, 0);
+    atomic_init(&iwtjg->nodes_stopped, 0);
+    pthread_condattr_t attributes;
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&iwtjg->finished_condition, &attributes);
+    pthread_condattr_destroy(&attributes);
+    pthread_mutex_init(&iwtjg->finished_lock, NULL);
+    return iwtjg;
+}
+
+bool IWorkerThreadJobGraphIsValid(IWorkerThreadJobGraph * iwtjg)
+{
+    return iwtjg && iwtjg->struct_id == ITHREAD_DATA_STRUCT_ID;
+}
+
+/// @brief Indicates if a graph has been submitted and hasn't finished, in which case it can't be changed.  The finished flag is
+///         read under the lock, as the thread that finishes the last job still holds it while it wakes any waiters.
+static bool _IWorkerThreadJobGraphIsRunning(IWorkerThreadJobGraph * iwtjg)
+{
+    pthread_mutex_lock(&iwtjg->finished_lock);
+    const bool RUNNING = iwtjg->submitted && !iwtjg->finished;
+    pthread_mutex_unlock(&iwtjg->finished_lock);
+    return RUNNING;
+}
+
+/// @brief Adds a job to a graph.  The job is run by the worker threads of the controller the graph is submitted to, exactly as if
+///         it had been added to the controller directly, once every job it depends on has finished.
+/// @param iwtjg Pointer to job graph data structure.
+/// @param job_data Pointer to job data.
+/// @param priority Job priority.
+/// @return Pointer to the job's node in the graph (owned by the graph), or NULL if the job couldn't be added.
+IWorkerThreadJobGraphNode * IWorkerThreadJobGraphAddJob(IWorkerThreadJobGraph * iwtjg, void * job_data, IThreadPriority priority)
+{
+    if (!IWorkerThreadJobGraphIsValid(iwtjg) || !job_data || _IWorkerThreadJobGraphIsRunning(iwtjg)) return NULL;
+    if (iwtjg->nodes_count == iwtjg->nodes_buffer_size) {
+        IWorkerThreadJobGraphNode ** nodes = (IWorkerThreadJobGraphNode **) realloc(iwtjg->nodes, sizeof(IWorkerThreadJobGraphNode *) * iwtjg->nodes_buffer_size * 2);
+        if (!nodes) return NULL;
+        iwtjg->nodes = nodes;
+        iwtjg->nodes_buffer_size *= 2;
+    }
+    IWorkerThreadJobGraphNode * iwtjgn = (IWorkerThreadJobGraphNode *) malloc(sizeof(IWorkerThreadJobGraphNode));
+    if (!iwtjgn) return NULL;
+    iwtjgn->graph = iwtjg;
+    iwtjgn->data = job_data;
+    iwtjgn->priority = priority;
+    iwtjgn->state = IThreadJobStateInitialised;
+    iwtjgn->result = NULL;
+    iwtjgn->failure_message = NULL;
+    iwtjgn->dependencies_count = 0;
+    atomic_init(&iwtjgn->dependencies_remaining, 0);
+    atomic_init(&iwtjgn->upstream_failed, false);
+    iwtjgn->dependents = NULL;
+    iwtjgn->dependents_count = iwtjgn->dependents_buffer_size = 0;
+    iwtjgn->next_finished = NULL;
+    iwtjg->nodes[iwtjg->nodes_count++] = iwtjgn;
+    return iwtjgn;
+}
+
+/// @brief Makes one job in a graph wait for another to finish before it can run.
+/// @param iwtjg Pointer to job graph data structure.
+/// @param job Pointer to the node of the job that has to wait.
+/// @param depends_on Pointer to the node of the job it has to wait for.
+/// @return True if the dependency was added, false if either node isn't part of the graph, they're the same node, the graph is
+///         running or memory could not be reserved.  Cycles are only detected when the graph is submitted.
+bool IWorkerThreadJobGraphAddDependency(IWorkerThreadJobGraph * iwtjg, IWorkerThreadJobGraphNode * job,
+                                        IWorkerThreadJobGraphNode * depends_on)
+{
+    if (!IWorkerThreadJobGraphIsValid(iwtjg) || !job || !depends_on || job == depends_on) return false;
+    if (job->graph != iwtjg || depends_on->graph != iwtjg || _IWorkerThreadJobGraphIsRunning(iwtjg)) return false;
+    if (depends_on->dependents_count == depends_on->dependents_buffer_size) {
+        const size_t BUFFER_SIZE = depends_on->dependents_buffer_size ? depends_on->dependents_buffer_size * 2 : 4;
+        IWorkerThreadJobGraphNode ** dependents = (IWorkerThreadJobGraphNode **) realloc(depends_on->dependents, sizeof(IWorkerThreadJobGraphNode *) * BUFFER_SIZE);
+        if (!dependents) return false;
+        depends_on->dependents = dependents;
+        depends_on->dependents_buffer_size = BUFFER_SIZE;
+    }
+    depends_on->dependents[depends_on->dependents_count++] = job;
+    job->dependencies_count++;
+    return true;
+}
+
+/// @brief Sets what happens to the rest of a graph when one of its jobs fails (IWorkerThreadJobGraphFailureCancelDownstream by
+///         default).
+/// @param iwtjg Pointer to job graph data structure.
+/// @param policy Failure policy.
+void IWorkerThreadJobGraphSetFailurePolicy(IWorkerThreadJobGraph * iwtjg, IWorkerThreadJobGraphFailurePolicy policy)
+{
+    if (IWorkerThreadJobGraphIsValid(iwtjg) && !_IWorkerThreadJobGraphIsRunning(iwtjg)) iwtjg->failure_policy = policy;
+}
+
+/// @brief Records why a node finished without its job completing successfully.
+static void _IWorkerThreadJobGraphNodeSetFailureMessage(IWorkerThreadJobGraphNode * iwtjgn, const char * message)
+{
+    free(iwtjgn->failure_message);
+    iwtjgn->failure_message = message ? strdup(message) : NULL;
+}
+
+/// @brief Creates a job for a node whose dependencies have all finished and queues it on the graph's controller.  If called from
+///         one of the controller's worker threads (i.e. as an upstream job completes), the job goes on to that worker's own deque,
+///         so a chain of jobs tends to stay on the same core.
+/// @return True if the job was queued, false otherwise.
+static bool _IWorkerThreadJobGraphQueueNode(IWorkerThreadJobGraphNode * iwtjgn)
+{
+    IWorkerThreadController * iwtc = iwtjgn->graph->controller;
+    IWorkerThreadJob * iwtj = IWorkerThreadJobProviderCreateJob(iwtc->job_provider, iwtjgn->data);
+    if (!iwtj) return false;
+    iwtj->priority = iwtjgn->priority;
+    iwtj->graph_node = iwtjgn;
+    iwtjgn->state = IThreadJobStateRunning;
+    if (IWorkerThreadControllerQueueJob(iwtc, iwtj)) return true;
+    // The job is thrown away without the graph being told.
+    iwtj->graph_node = NULL;
+    IWorkerThreadJobFree(iwtj);
+    return false;
+}
+
+/// @brief Passes on the outcome of a finished node to the jobs that depend on it.  Each dependent's counter of unfinished
+///         dependencies is decremented, and whichever thread takes it to zero queues the dependent's job straight away.  Dependents
+///         that won't be run (because of the failure policy, or because their job couldn't be queued) finish immediately, and
+///         their own dependents are dealt with in the same pass, using the nodes' next_finished links as a stack rather than
+///         recursion, so a long chain can't overflow the stack.
+/// @param iwtjgn Pointer to the node that has finished.  Its state must already have been set.
+/// @param discarded True if the node's job was thrown away without being run, in which case its dependents are never run.
+static void _IWorkerThreadJobGraphNodeFinished(IWorkerThreadJobGraphNode * iwtjgn, bool discarded)
+{
+    IWorkerThreadJobGraph * iwtjg = iwtjgn->graph;
+    // Read up front: once another thread finishes the last node the graph may be freed, even while this one is still counting.
+    const size_t NODES_COUNT = iwtjg->nodes_count;
+    iwtjgn->next_finished = NULL;
+    IWorkerThreadJobGraphNode * finished = iwtjgn;
+    while (finished) {
+        IWorkerThreadJobGraphNode * node = finished;
+        finished = node->next_finished;
+        const bool SUCCEEDED = node->state == IThreadJobStateDone;
+        if (node->state == IThreadJobStateFailed) {
+            atomic_fetch_add_explicit(&iwtjg->nodes_failed, 1, memory_order_relaxed);
+            if (iwtjg->failure_policy == IWorkerThreadJobGraphFailureCancelGraph) IWorkerThreadJobGraphCancel(iwtjg);
+        } else if (!SUCCEEDED) atomic_fetch_add_explicit(&iwtjg->nodes_stopped, 1, memory_order_relaxed);
+        const bool CANCEL_DEPENDENTS = discarded || (!SUCCEEDED && (node->state != IThreadJobStateFailed ||
+                                                                  iwtjg->failure_policy != IWorkerThreadJobGraphFailureContinue));
+        for (size_t d = 0; d < node->dependents_count; d++) {
+            IWorkerThreadJobGraphNode * dependent = node->dependents[d];
+            if (CANCEL_DEPENDENTS) atomic_store_explicit(&dependent->upstream_failed, true, memory_order_relaxed);
+            if (atomic_fetch_sub_explicit(&dependent->dependencies_remaining, 1, memory_order_acq_rel) != 1) continue;
+            // This was the dependent's last unfinished dependency, so it's ours to start (or to finish, if it can't be run).
+            if (atomic_load_explicit(&dependent->upstream_failed, memory_order_relaxed)) {
+                dependent->state = IThreadJobStateStopped;
+                _IWorkerThreadJobGraphNodeSetFailureMessage(dependent, ITHREAD_JOB_GRAPH_UPSTREAM_FAILED_MESSAGE);
+            } else if (IWorkerThreadJobGraphIsCancelled(iwtjg)) {
+                dependent->state = IThreadJobStateStopped;
+                _IWorkerThreadJobGraphNodeSetFailureMessage(dependent, ITHREAD_JOB_GRAPH_CANCELLED_MESSAGE);
+            } else if (!_IWorkerThreadJobGraphQueueNode(dependent)) {
+                dependent->state = IThreadJobStateFailed;
+                _IWorkerThreadJobGraphNodeSetFailureMessage(dependent, ITHREAD_JOB_GRAPH_QUEUE_FULL_MESSAGE);
+            } else continue;
+            dependent->next_finished = finished;
+            finished = dependent;
+        }
+        // Once the last node has finished the graph may be freed by a waiting thread, so nothing is touched after this.
+        if (atomic_fetch_add_explicit(&iwtjg->nodes_finished, 1, memory_order_acq_rel) + 1 == NODES_COUNT) {
+            pthread_mutex_lock(&iwtjg->finished_lock);
+            iwtjg->finished = true;
+            pthread_cond_broadcast(&iwtjg->finished_condition);
+            pthread_mutex_unlock(&iwtjg->finished_lock);
+        }
+    }
+}
+
+/// @brief Records the outcome of a graph job in its node and releases any jobs that were waiting for it.  Called by
+///         IWorkerThreadJobComplete() once the job's callbacks have run and its future has been completed, or by
+///         IWorkerThreadJobFree() if the job is thrown away without being run.
+/// @param iwtj Pointer to a job created for a graph node.
+void IWorkerThreadJobGraphNodeComplete(IWorkerThreadJob * iwtj)
+{
+    if (!iwtj || !iwtj->graph_node) return;
+    IWorkerThreadJobGraphNode * iwtjgn = iwtj->graph_node;
+    const IThreadJobState STATE = atomic_load_explicit(&iwtj->state, memory_order_acquire);
+    const bool DISCARDED = STATE != IThreadJobStateDone && STATE != IThreadJobStateFailed;
+    iwtjgn->result = iwtj->result;
+    if (DISCARDED) {
+        iwtjgn->state = IThreadJobStateStopped;
+        _IWorkerThreadJobGraphNodeSetFailureMessage(iwtjgn, ITHREAD_JOB_CANCELLED_MESSAGE);
+    } else if (STATE == IThreadJobStateFailed) {
+        // A job failed only because the graph was cancelled is counted as stopped rather than failed.
+        const char * reason = IWorkerThreadJobGetCancelReason(iwtj);
+        iwtjgn->state = reason && strcmp(reason, ITHREAD_JOB_GRAPH_CANCELLED_MESSAGE) == 0 ? IThreadJobStateStopped : IThreadJobStateFailed;
+        _IWorkerThreadJobGraphNodeSetFailureMessage(iwtjgn, iwtj->failure_message ? iwtj->failure_message : "");
+    } else iwtjgn->state = IThreadJobStateDone;
+    iwtj->graph_node = NULL;
+    _IWorkerThreadJobGraphNodeFinished(iwtjgn, DISCARDED);
+}
+
+/// @brief Checks that a graph has no cycles (which would leave jobs waiting on each other forever), by repeatedly removing jobs
+///         with no remaining dependencies (Kahn's algorithm).  Uses the nodes' dependency counters, which are reset afterwards.
+/// @return True if every job can eventually run, false if there is a cycle or memory could not be reserved.
+static bool _IWorkerThreadJobGraphIsAcyclic(IWorkerThreadJobGraph * iwtjg)
+{
+    IWorkerThreadJobGraphNode ** ready = (IWorkerThreadJobGraphNode **) malloc(sizeof(IWorkerThreadJobGraphNode *) * (iwtjg->nodes_count + 1));
+    if (!ready) return false;
+    size_t ready_count = 0, visited = 0;
+    for (size_t n = 0; n < iwtjg->nodes_count; n++) {
+        IWorkerThreadJobGraphNode * node = iwtjg->nodes[n];
+        atomic_store_explicit(&node->dependencies_remaining, node->dependencies_count, memory_order_relaxed);
+        if (node->dependencies_count == 0) ready[ready_count++] = node;
+    }
+    while (ready_count > 0) {
+        IWorkerThreadJobGraphNode * node = ready[--ready_count];
+        visited++;
+        for (size_t d = 0; d < node->dependents_count; d++) {
+            if (atomic_fetch_sub_explicit(&node->dependents[d]->dependencies_remaining, 1, memory_order_relaxed) == 1)
+                ready[ready_count++] = node->dependents[d];
+        }
+    }
+    free(ready);
+    return visited == iwtjg->nodes_count;
+}
+
+/// @brief Runs a graph's jobs on a controller.  Jobs with no dependencies are queued straight away, and every other job is queued
+///         the moment the last job it depends on finishes, by the worker thread that finished it.  There's no polling: each job
+///         has an atomic counter of unfinished dependencies, which the finishing jobs count down.  A graph can be submitted again
+///         once it has finished.
+/// @param iwtjg Pointer to job graph data structure.
+/// @param iwtc Pointer to worker thread controller data structure.
+/// @return True if the graph was submitted, false if either pointer is invalid, the graph is already running or it has a cycle.
+bool IWorkerThreadJobGraphSubmit(IWorkerThreadJobGraph * iwtjg, IWorkerThreadController * iwtc)
+{
+    if (!IWorkerThreadJobGraphIsValid(iwtjg) || !IWorkerThreadControllerIsValid(iwtc) || _IWorkerThreadJobGraphIsRunning(iwtjg)) return false;
+    if (!_IWorkerThreadJobGraphIsAcyclic(iwtjg)) return false;
+
+    // The jobs with no dependencies are picked out first: once the first is queued, the whole graph may finish (and be freed by
+    // its owner) while the rest are still being queued, so the graph itself can't be read from then on.
+    IWorkerThreadJobGraphNode ** roots = (IWorkerThreadJobGraphNode **) malloc(sizeof(IWorkerThreadJobGraphNode *) * (iwtjg->nodes_count + 1));
+    if (!roots) return false;
+    size_t roots_count = 0;
+    for (size_t n = 0; n < iwtjg->nodes_count; n++) {
+        if (iwtjg->nodes[n]->dependencies_count == 0) roots[roots_count++] = iwtjg->nodes[n];
+    }
+
+    // Every counter is set before any job is queued, as a job may finish (and count down its dependents) straight away.
+    iwtjg->controller = iwtc;
+    atomic_store(&iwtjg->cancelled, false);
+    atomic_store(&iwtjg->nodes_finished, 0);
+    atomic_store(&iwtjg->nodes_failed, 0);
+    atomic_store(&iwtjg->nodes_stopped, 0);
+    for (size_t n = 0; n < iwtjg->nodes_count; n++) {
+        IWorkerThreadJobGraphNode * node = iwtjg->nodes[n];
+        node->state = IThreadJobStateInitialised;
+        node->result = NULL;
+        _IWorkerThreadJobGraphNodeSetFailureMessage(node, NULL);
+        atomic_store_explicit(&node->dependencies_remaining, node->dependencies_count, memory_order_relaxed);
+        atomic_store_explicit(&node->upstream_failed, false, memory_order_relaxed);
+    }
+    pthread_mutex_lock(&iwtjg->finished_lock);
+    iwtjg->finished = iwtjg->nodes_count == 0;
+    iwtjg->submitted = true;
+    pthread_mutex_unlock(&iwtjg->finished_lock);
+
+    // Each root is only used until it has been queued (or has failed), and one that hasn't been yet keeps the graph from finishing.
+    for (size_t r = 0; r < roots_count; r++) {
+        IWorkerThreadJobGraphNode * root = roots[r];
+        if (_IWorkerThreadJobGraphQueueNode(root)) continue;
+        root->state = IThreadJobStateFailed;
+        _IWorkerThreadJobGraphNodeSetFailureMessage(root, ITHREAD_JOB_GRAPH_QUEUE_FULL_MESSAGE);
+        _IWorkerThreadJobGraphNodeFinished(root, false);
+    }
+    free(roots);
+    return true;
+}
+
+/// @brief Cancels a running graph.  Jobs that haven't been queued yet are never run, and queued or running jobs see the request
+///         through IWorkerThreadJobIsCancelled() (and fail with ITHREAD_JOB_GRAPH_CANCELLED_MESSAGE).  The graph still has to be
+///         waited for before it is freed.
+/// @param iwtjg Pointer to job graph data structure.
+void IWorkerThreadJobGraphCancel(IWorkerThreadJobGraph * iwtjg)
+{
+    if (IWorkerThreadJobGraphIsValid(iwtjg)) atomic_store_explicit(&iwtjg->cancelled, true, memory_order_release);
+}
+
+bool IWorkerThreadJobGraphIsCancelled(IWorkerThreadJobGraph * iwtjg)
+{
+    return IWorkerThreadJobGraphIsValid(iwtjg) && atomic_load_explicit(&iwtjg->cancelled, memory_order_relaxed);
+}
+
+/// @brief Indicates if every job in a submitted graph has finished (successfully or not).
+/// @param iwtjg Pointer to job graph data structure.
+/// @return True if the graph has been submitted and has finished, false otherwise.
+bool IWorkerThreadJobGraphIsDone(IWorkerThreadJobGraph * iwtjg)
+{
+    if (!IWorkerThreadJobGraphIsValid(iwtjg)) return false;
+    pthread_mutex_lock(&iwtjg->finished_lock);
+    const bool DONE = iwtjg->submitted && iwtjg->finished;
+    pthread_mutex_unlock(&iwtjg->finished_lock);
+    return DONE;
+}
+
+/// @brief Blocks until every job in a submitted graph has finished, or the timeout expires.
+/// @param iwtjg Pointer to job graph data structure.
+/// @param timeout_ms Maximum time to wait in milliseconds, or IThreadWaitForever.
+/// @return True if the graph has finished, false if it hasn't been submitted or the timeout expired.
+bool IWorkerThreadJobGraphWait(IWorkerThreadJobGraph * iwtjg, long timeout_ms)
+{
+    if (!IWorkerThreadJobGraphIsValid(iwtjg)) return false;
+    struct timespec deadline;
+    if (timeout_ms > 0) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+    // The submitted flag is read under the lock too, as Submit sets it (and clears the finished flag) from another thread.
+    pthread_mutex_lock(&iwtjg->finished_lock);
+    if (!iwtjg->submitted) {
+        pthread_mutex_unlock(&iwtjg->finished_lock);
+        return false;
+    }
+    while (!iwtjg->finished && timeout_ms != 0) {
+        if (timeout_ms < 0) pthread_cond_wait(&iwtjg->finished_condition, &iwtjg->finished_lock);
+        else if (pthread_cond_timedwait(&iwtjg->finished_condition, &iwtjg->finished_lock, &deadline) != 0) break;
+    }
+    const bool FINISHED = iwtjg->finished;
+    pthread_mutex_unlock(&iwtjg->finished_lock);
+    return FINISHED;
+}
+
+/// @brief Gets the number of jobs in the last run of a graph whose main function failed.
+size_t IWorkerThreadJobGraphGetFailedCount(IWorkerThreadJobGraph * iwtjg)
+{
+    return IWorkerThreadJobGraphIsValid(iwtjg) ? atomic_load(&iwtjg->nodes_failed) : 0;
+}
+
+/// @brief Gets the number of jobs in the last run of a graph that weren't run (or were cancelled) because of an upstream failure
+///         or the graph being cancelled.
+size_t IWorkerThreadJobGraphGetStoppedCount(IWorkerThreadJobGraph * iwtjg)
+{
+    return IWorkerThreadJobGraphIsValid(iwtjg) ? atomic_load(&iwtjg->nodes_stopped) : 0;
+}
+
+/// @brief Gets the outcome of a graph job.  Only meaningful once the graph has finished (see IWorkerThreadJobGraphWait()).
+/// @param iwtjgn Pointer to graph node.
+/// @return IThreadJobStateDone or IThreadJobStateFailed for a job that ran, IThreadJobStateStopped for one that was skipped or
+///         cancelled, IThreadJobStateInitialised/Running while the graph is still running.
+IThreadJobState IWorkerThreadJobGraphNodeGetState(IWorkerThreadJobGraphNode * iwtjgn)
+{
+    return iwtjgn ? iwtjgn->state : IThreadJobStateUnusuable;
+}
+
+/// @brief Gets the result a graph job set (see IWorkerThreadJobSetResult()).
+void * IWorkerThreadJobGraphNodeGetResult(IWorkerThreadJobGraphNode * iwtjgn)
+{
+    return iwtjgn ? iwtjgn->result : NULL;
+}
+
+/// @brief Gets the reason a graph job failed or was stopped.
+/// @return Failure message (owned by the graph), or NULL if the job succeeded or hasn't finished.
+char * IWorkerThreadJobGraphNodeGetFailureMessage(IWorkerThreadJobGraphNode * iwtjgn)
+{
+    return iwtjgn ? iwtjgn->failure_message : NULL;
+}
+
+/// @brief Frees a job graph and all of its nodes.
+/// @param iwtjg Pointer to job graph data structure.
+/// @return True if the graph was freed, false if it is invalid or still running (wait for it to finish first).
+bool IWorkerThreadJobGraphFree(IWorkerThreadJobGraph * iwtjg)
+{
+    if (!IWorkerThreadJobGraphIsValid(iwtjg) || _IWorkerThreadJobGraphIsRunning(iwtjg)) return false;
+    iwtjg->struct_id = 0;
+    for (size_t n = 0; n < iwtjg->nodes_count; n++) {
+        free(iwtjg->nodes[n]->dependents);
+        free(iwtjg->nodes[n]->failure_message);
+        free(iwtjg->nodes[n]);
+    }
+    free(iwtjg->nodes);
+    pthread_cond_destroy(&iwtjg->finished_condition);
+    pthread_mutex_destroy(&iwtjg->finished_lock);
+    free(iwtjg);
+    return true;
+}
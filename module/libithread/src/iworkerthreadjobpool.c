@@ -0,0 +1,192 @@
+#include "global.h"
+#include "iworkerthreadjob.h"
+#include "iworkerthreadjobpool.h"
+
+// The free list head packs a job's pool index (plus one, so that zero means "empty") into the low 32 bits and a modification
+// counter into the high 32 bits.  The counter changes on every push and pop, which stops a stale compare-and-swap from succeeding
+// after the same job has been popped and pushed back in the meantime (the ABA problem).
+#define ITHREAD_JOB_POOL_INDEX_MASK 0xFFFFFFFFULL
+#define ITHREAD_JOB_POOL_TAG_INCREMENT (1ULL << 32)
+
+/// @brief Gets the job at the given pool index.
+static IWorkerThreadJob * _IWorkerThreadJobPoolGetJob(IWorkerThreadJobPool * iwtjpl, uint32_t index)
+{
+    return &iwtjpl->slabs[index >> ITHREAD_JOB_POOL_SLAB_SHIFT][index & (ITHREAD_JOB_POOL_SLAB_SIZE - 1)];
+}
+
+/// @brief Pushes a chain of jobs (already linked together through pool_next) on to the free list.
+static void _IWorkerThreadJobPoolPushChain(IWorkerThreadJobPool * iwtjpl, IWorkerThreadJob * first_job, IWorkerThreadJob * last_job)
+{
+    uint64_t head = atomic_load_explicit(&iwtjpl->free_list_head, memory_order_relaxed);
+    uint64_t new_head;
+    do {
+        atomic_store_explicit(&last_job->pool_next, (uint32_t) (head & ITHREAD_JOB_POOL_INDEX_MASK), memory_order_relaxed);
+        new_head = ((head & ~ITHREAD_JOB_POOL_INDEX_MASK) + ITHREAD_JOB_POOL_TAG_INCREMENT) | (first_job->pool_index + 1);
+    } while (!atomic_compare_exchange_weak_explicit(&iwtjpl->free_list_head, &head, new_head, memory_order_release, memory_order_relaxed));
+}
+
+/// @brief Adds a new slab of jobs to the pool.  Only one thread grows the pool at a time; if another thread has already put jobs
+///         on the free list by the time the lock is taken, no slab is added.
+/// @return True if there are (or may be) free jobs, false if the pool has reached its maximum size or memory has run out.
+static bool _IWorkerThreadJobPoolGrow(IWorkerThreadJobPool * iwtjpl)
+{
+    bool has_free_jobs = true;
+    pthread_mutex_lock(&iwtjpl->grow_lock);
+    if ((atomic_load(&iwtjpl->free_list_head) & ITHREAD_JOB_POOL_INDEX_MASK) == 0) {
+        const unsigned int SLAB_INDEX = atomic_load_explicit(&iwtjpl->slabs_count, memory_order_relaxed);
+        IWorkerThreadJob * slab = SLAB_INDEX < ITHREAD_JOB_POOL_MAX_SLABS ?
+            (IWorkerThreadJob *) malloc(sizeof(IWorkerThreadJob) * ITHREAD_JOB_POOL_SLAB_SIZE) : NULL;
+        if (slab) {
+            // Link every job in the new slab together, then push the whole slab on to the free list in one go.
+            for (uint32_t j = 0; j < ITHREAD_JOB_POOL_SLAB_SIZE; j++) {
+                IWorkerThreadJob * iwtj = &slab[j];
+                iwtj->struct_id = ITHREAD_DATA_STRUCT_ID;
+                atomic_init(&iwtj->state, IThreadJobStateUnusuable);
+                iwtj->failure_message = NULL;
+                iwtj->future = NULL;
+                iwtj->pool = iwtjpl;
+                iwtj->pool_index = (SLAB_INDEX << ITHREAD_JOB_POOL_SLAB_SHIFT) + j;
+                atomic_init(&iwtj->pool_next, iwtj->pool_index + 2);
+            }
+            iwtjpl->slabs[SLAB_INDEX] = slab;
+            atomic_store_explicit(&iwtjpl->slabs_count, SLAB_INDEX + 1, memory_order_release);
+            _IWorkerThreadJobPoolPushChain(iwtjpl, &slab[0], &slab[ITHREAD_JOB_POOL_SLAB_SIZE - 1]);
+        } else has_free_jobs = false;
+    }
+    pthread_mutex_unlock(&iwtjpl->grow_lock);
+    return has_free_jobs;
+}
+
+/// @brief Creates a pool of recyclable job data structures.  Jobs are allocated in slabs of ITHREAD_JOB_POOL_SLAB_SIZE and kept on
+///         a lock-free free list, so once the pool has grown to the number of jobs in flight at the busiest moment, acquiring and
+///         releasing jobs never touches malloc/free.  Slabs are only freed along with the pool.
+/// @return Pointer to the job pool data structure or NULL if there is not enough memory.
+IWorkerThreadJobPool * IWorkerThreadJobPoolCreate()
+{
+    IWorkerThreadJobPool * iwtjpl = (IWorkerThreadJobPool *) aligned_alloc(ITHREAD_CACHE_LINE_SIZE, sizeof(IWorkerThreadJobPool));
+    if (!iwtjpl) return NULL;
+    iwtjpl->slabs = (IWorkerThreadJob **) calloc(ITHREAD_JOB_POOL_MAX_SLABS, sizeof(IWorkerThreadJob *));
+    if (!iwtjpl->slabs) {
+        free(iwtjpl);
+        return NULL;
+    }
+    iwtjpl->struct_id = ITHREAD_DATA_STRUCT_ID;
+    atomic_init(&iwtjpl->slabs_count, 0);
+    atomic_init(&iwtjpl->free_list_head, 0);
+    pthread_mutex_init(&iwtjpl->grow_lock, NULL);
+    return iwtjpl;
+}
+
+bool IWorkerThreadJobPoolIsValid(IWorkerThreadJobPool * iwtjpl)
+{
+    return iwtjpl && iwtjpl->struct_id == ITHREAD_DATA_STRUCT_ID;
+}
+
+/// @brief Takes a job from the pool (growing the pool if it's empty) and initialises it with the given data.  Safe to call from
+///         any number of threads.
+/// @param iwtjpl Pointer to job pool data structure.
+/// @param data Pointer to job data.
+/// @return Pointer to the job or NULL if the pool couldn't grow.
+IWorkerThreadJob * IWorkerThreadJobPoolAcquire(IWorkerThreadJobPool * iwtjpl, void * data)
+{
+    if (!IWorkerThreadJobPoolIsValid(iwtjpl)) return NULL;
+    uint64_t head = atomic_load_explicit(&iwtjpl->free_list_head, memory_order_acquire);
+    IWorkerThreadJob * iwtj;
+    for (;;) {
+        const uint32_t INDEX = (uint32_t) (head & ITHREAD_JOB_POOL_INDEX_MASK);
+        if (INDEX == 0) {
+            if (!_IWorkerThreadJobPoolGrow(iwtjpl)) return NULL;
+            head = atomic_load_explicit(&iwtjpl->free_list_head, memory_order_acquire);
+            continue;
+        }
+        // The job may be popped by another thread before our compare-and-swap, in which case pool_next could be stale.  The
+        // modification counter makes sure the swap then fails.
+        iwtj = _IWorkerThreadJobPoolGetJob(iwtjpl, INDEX - 1);
+        const uint64_t NEXT = atomic_load_explicit(&iwtj->pool_next, memory_order_relaxed);
+        const uint64_t NEW_HEAD = ((head & ~ITHREAD_JOB_POOL_INDEX_MASK) + ITHREAD_JOB_POOL_TAG_INCREMENT) | NEXT;
+        if (atomic_compare_exchange_weak_explicit(&iwtjpl->free_list_head, &head, NEW_HEAD, memory_order_acquire, memory_order_acquire)) break;
+    }
+    IWorkerThreadJobReset(iwtj, data);
+    return iwtj;
+}
+
+/// @brief Takes a batch of jobs from the pool, detaching a run of the free list with a single compare-and-swap rather than popping
+///         jobs one by one.  Safe to call from any number of threads.
+/// @param iwtjpl Pointer to job pool data structure.
+/// @param jobs Array that receives pointers to the jobs.
+/// @param data Array of job data pointers, one for each job.
+/// @param jobs_count Number of jobs to take.
+/// @return Number of jobs taken.  This is only less than jobs_count if the pool couldn't grow.
+size_t IWorkerThreadJobPoolAcquireBatch(IWorkerThreadJobPool * iwtjpl, IWorkerThreadJob ** jobs, void ** data, size_t jobs_count)
+{
+    if (!IWorkerThreadJobPoolIsValid(iwtjpl) || !jobs || !data) return 0;
+    size_t jobs_acquired = 0;
+    uint64_t head = atomic_load_explicit(&iwtjpl->free_list_head, memory_order_acquire);
+    while (jobs_acquired < jobs_count) {
+        uint32_t index = (uint32_t) (head & ITHREAD_JOB_POOL_INDEX_MASK);
+        if (index == 0) {
+            if (!_IWorkerThreadJobPoolGrow(iwtjpl)) break;
+            head = atomic_load_explicit(&iwtjpl->free_list_head, memory_order_acquire);
+            continue;
+        }
+        // Walk along the list to find where the run of jobs we want ends.  Other threads may change the list while we walk it, but
+        // any change also changes the modification counter in the head, so the compare-and-swap below fails and we start again.
+        const size_t WANTED = jobs_count - jobs_acquired;
+        size_t run_length = 0;
+        while (index != 0 && run_length < WANTED) {
+            jobs[jobs_acquired + run_length++] = _IWorkerThreadJobPoolGetJob(iwtjpl, index - 1);
+            index = atomic_load_explicit(&jobs[jobs_acquired + run_length - 1]->pool_next, memory_order_relaxed);
+        }
+        const uint64_t NEW_HEAD = ((head & ~ITHREAD_JOB_POOL_INDEX_MASK) + ITHREAD_JOB_POOL_TAG_INCREMENT) | index;
+        if (!atomic_compare_exchange_weak_explicit(&iwtjpl->free_list_head, &head, NEW_HEAD, memory_order_acquire, memory_order_acquire)) continue;
+        for (size_t j = 0; j < run_length; j++) IWorkerThreadJobReset(jobs[jobs_acquired + j], data[jobs_acquired + j]);
+        jobs_acquired += run_length;
+        head = NEW_HEAD;
+    }
+    return jobs_acquired;
+}
+
+/// @brief Returns a job to the pool.  The job must not be used afterwards.  Safe to call from any number of threads.
+/// @param iwtjpl Pointer to job pool data structure.
+/// @param iwtj Pointer to a job acquired from this pool.
+void IWorkerThreadJobPoolRelease(IWorkerThreadJobPool * iwtjpl, IWorkerThreadJob * iwtj)
+{
+    if (!IWorkerThreadJobPoolIsValid(iwtjpl) || !iwtj || iwtj->pool != iwtjpl ||
+        atomic_load_explicit(&iwtj->state, memory_order_acquire) == IThreadJobStateUnusuable) return;
+    atomic_store_explicit(&iwtj->state, IThreadJobStateUnusuable, memory_order_release);
+    iwtj->data = iwtj->result = NULL;
+    iwtj->future = NULL;
+    atomic_store_explicit(&iwtj->worker_thread, NULL, memory_order_release);
+    iwtj->next_job = NULL;
+    _IWorkerThreadJobPoolPushChain(iwtjpl, iwtj, iwtj);
+}
+
+/// @brief Gets the number of jobs the pool has allocated so far (whether in use or free).
+/// @param iwtjpl Pointer to job pool data structure.
+/// @return Number of jobs allocated.
+size_t IWorkerThreadJobPoolGetCapacity(IWorkerThreadJobPool * iwtjpl)
+{
+    return IWorkerThreadJobPoolIsValid(iwtjpl) ? (size_t) atomic_load(&iwtjpl->slabs_count) * ITHREAD_JOB_POOL_SLAB_SIZE : 0;
+}
+
+/// @brief Frees every slab of jobs in the pool, then the pool itself.  No job from the pool may be in use.
+/// @param iwtjpl Pointer to job pool data structure.
+/// @return True if the pointer referenced a valid job pool, false otherwise.
+bool IWorkerThreadJobPoolFree(IWorkerThreadJobPool * iwtjpl)
+{
+    if (!IWorkerThreadJobPoolIsValid(iwtjpl)) return false;
+    const unsigned int SLABS_COUNT = atomic_load(&iwtjpl->slabs_count);
+    for (unsigned int s = 0; s < SLABS_COUNT; s++) {
+        for (int j = 0; j < ITHREAD_JOB_POOL_SLAB_SIZE; j++) {
+            if (iwtjpl->slabs[s][j].failure_message) free(iwtjpl->slabs[s][j].failure_message);
+        }
+        free(iwtjpl->slabs[s]);
+        iwtjpl->slabs[s] = NULL;
+    }
+    free(iwtjpl->slabs);
+    iwtjpl->slabs = NULL;
+    iwtjpl->struct_id = 0;
+    pthread_mutex_destroy(&iwtjpl->grow_lock);
+    free(iwtjpl);
+    return true;
+}
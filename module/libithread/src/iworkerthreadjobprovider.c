@@ -1,22 +1,58 @@
+#include <string.h>
+
 #include "global.h"
 #include "iworkerthreadjob.h"
 #include "iworkerthreadjobprovider.h"
 
-static size_t _iworker_thread_job_id = 0;
+static atomic_size_t _iworker_thread_job_id = 0;
 
 IWorkerThreadJobProvider * IWorkerThreadJobProviderCreate()
 {
     IWorkerThreadJobProvider * iwtjp = (IWorkerThreadJobProvider *) malloc(sizeof(IWorkerThreadJobProvider));
     if (iwtjp) {
-        iwtjp->jobs = (IWorkerThreadJob **) malloc(sizeof(IWorkerThreadJob *) * 256);
-        if (!iwtjp->jobs) {
+        // There is one job queue for each job priority level.
+        bool queues_created = true;
+        for (int l = 0; l < ITHREAD_PRIORITY_LEVELS; l++) {
+            iwtjp->queues[l] = IWorkerThreadJobQueueCreate(ITHREAD_DEFAULT_JOB_QUEUE_CAPACITY);
+            if (!iwtjp->queues[l]) queues_created = false;
+        }
+        iwtjp->deques = (IWorkerThreadJobDeque **) malloc(sizeof(IWorkerThreadJobDeque *) * 4);
+        iwtjp->job_pool = IWorkerThreadJobPoolCreate();
+        if (!queues_created || !iwtjp->deques || !iwtjp->job_pool) {
+            for (int l = 0; l < ITHREAD_PRIORITY_LEVELS; l++) IWorkerThreadJobQueueFree(iwtjp->queues[l]);
+            free(iwtjp->deques);
+            IWorkerThreadJobPoolFree(iwtjp->job_pool);
             free(iwtjp);
             return NULL;
         } else {
             iwtjp->struct_id = ITHREAD_DATA_STRUCT_ID;
-            iwtjp->jobs_array_size = 256;
-            iwtjp->jobs_count = 0;
-            iwtjp->next_job_index = 0;
+            iwtjp->aging_interval_ns = ITHREAD_DEFAULT_PRIORITY_AGING_MS * 1000000ULL;
+            iwtjp->deques_count = 0;
+            iwtjp->deques_buffer_size = 4;
+            iwtjp->node_queues = NULL;
+            iwtjp->nodes_count = 0;
+            iwtjp->cpu_nodes = NULL;
+            iwtjp->cpus_count = 0;
+            atomic_init(&iwtjp->waiting_workers, 0);
+            pthread_mutex_init(&iwtjp->wait_lock, NULL);
+            pthread_cond_init(&iwtjp->wait_condition, NULL);
+            // By default there is no limit on queued jobs (the job queues overflow rather than fill up).
+            iwtjp->capacity = 0;
+            atomic_init(&iwtjp->queued_count, 0);
+            atomic_init(&iwtjp->high_watermark, 0);
+            atomic_init(&iwtjp->rejected_count, 0);
+            atomic_init(&iwtjp->waiting_producers, 0);
+            pthread_mutex_init(&iwtjp->space_lock, NULL);
+            pthread_condattr_t attributes;
+            pthread_condattr_init(&attributes);
+            pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+            pthread_cond_init(&iwtjp->space_condition, &attributes);
+            pthread_condattr_destroy(&attributes);
+            // Named queues are added later, if at all.
+            for (size_t q = 0; q < ITHREAD_MAX_NAMED_QUEUES; q++) iwtjp->named_queues[q] = NULL;
+            atomic_init(&iwtjp->named_queues_count, 0);
+            atomic_init(&iwtjp->named_queues_pass, 0);
+            pthread_mutex_init(&iwtjp->named_queues_lock, NULL);
         }
     }
     return iwtjp;
@@ -27,53 +63,754 @@ bool IWorkerThreadJobProviderIsValid(IWorkerThreadJobProvider * iwtjp)
     return iwtjp && iwtjp->struct_id == ITHREAD_DATA_STRUCT_ID;
 }
 
+/// @brief Takes a job from the provider's job pool for the given data, giving it the next available job id.  The job is not
+///         queued; pass it to IWorkerThreadJobProviderEnqueueJob() or IWorkerThreadJobProviderPushLocalJob() once it has been set
+///         up.  IWorkerThreadJobFree() hands the job back to the pool.
+/// @param iwtjp Pointer to job provider data structure.
+/// @param job_data Pointer to job data.
+/// @return Pointer to the new job or NULL if it could not be created.
+IWorkerThreadJob * IWorkerThreadJobProviderCreateJob(IWorkerThreadJobProvider * iwtjp, void * job_data)
+{
+    if (!job_data || !IWorkerThreadJobProviderIsValid(iwtjp)) return NULL;
+    IWorkerThreadJob * iwtj = IWorkerThreadJobPoolAcquire(iwtjp->job_pool, job_data);
+    if (!iwtj) return NULL;
+    iwtj->id = atomic_fetch_add_explicit(&_iworker_thread_job_id, 1, memory_order_relaxed);
+    return iwtj;
+}
+
+/// @brief Wakes workers that are blocked waiting for work so they can pick up newly added jobs straight away.
+/// @param iwtjp Pointer to job provider data structure.
+/// @param wake_all If true, every waiting worker is woken (used when a batch of jobs has been added), otherwise just one is.
+static void _IWorkerThreadJobProviderWake(IWorkerThreadJobProvider * iwtjp, bool wake_all)
+{
+    // The fence pairs with the waiting worker incrementing waiting_workers before it checks for jobs, so either we see the
+    // waiter or it sees the job.
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&iwtjp->waiting_workers, memory_order_relaxed) > 0) {
+        pthread_mutex_lock(&iwtjp->wait_lock);
+        if (wake_all) pthread_cond_broadcast(&iwtjp->wait_condition);
+        else pthread_cond_signal(&iwtjp->wait_condition);
+        pthread_mutex_unlock(&iwtjp->wait_lock);
+    }
+}
+
+/// @brief Reserves room for jobs that are about to be queued, counting them against the provider's capacity.  The count of queued
+///         jobs is only ever raised with a compare-and-swap that checks the capacity, so it never goes over (except for forced
+///         reservations), and the high watermark is raised to match.
+/// @param iwtjp Pointer to job provider data structure.
+/// @param jobs_count Number of jobs to reserve room for.
+/// @param partial If true, reserve as many as will fit, otherwise all or nothing.
+/// @param force If true, ignore the capacity (used for jobs a worker thread pushes on to its own deque, which must never block).
+/// @return Number of jobs room was reserved for.
+static size_t _IWorkerThreadJobProviderReserve(IWorkerThreadJobProvider * iwtjp, size_t jobs_count, bool partial, bool force)
+{
+    size_t queued = atomic_load_explicit(&iwtjp->queued_count, memory_order_relaxed);
+    size_t reserved;
+    do {
+        reserved = jobs_count;
+        if (!force && iwtjp->capacity) {
+            const size_t SPACE = queued < iwtjp->capacity ? iwtjp->capacity - queued : 0;
+            if (SPACE < reserved) reserved = partial ? SPACE : 0;
+        }
+        if (reserved == 0) return 0;
+    } while (!atomic_compare_exchange_weak_explicit(&iwtjp->queued_count, &queued, queued + reserved, memory_order_relaxed,
+                                                    memory_order_relaxed));
+    const size_t QUEUED = queued + reserved;
+    size_t high_watermark = atomic_load_explicit(&iwtjp->high_watermark, memory_order_relaxed);
+    while (QUEUED > high_watermark && !atomic_compare_exchange_weak_explicit(&iwtjp->high_watermark, &high_watermark, QUEUED,
+                                                                             memory_order_relaxed, memory_order_relaxed));
+    return reserved;
+}
+
+/// @brief Hands back room for jobs (because they have been taken by a worker, or couldn't be queued after all) and wakes any
+///         producers blocked waiting for room.
+static void _IWorkerThreadJobProviderUnreserve(IWorkerThreadJobProvider * iwtjp, size_t jobs_count)
+{
+    atomic_fetch_sub_explicit(&iwtjp->queued_count, jobs_count, memory_order_relaxed);
+    // The fence pairs with a blocked producer incrementing waiting_producers before it re-checks for room.
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&iwtjp->waiting_producers, memory_order_relaxed) > 0) {
+        pthread_mutex_lock(&iwtjp->space_lock);
+        pthread_cond_broadcast(&iwtjp->space_condition);
+        pthread_mutex_unlock(&iwtjp->space_lock);
+    }
+}
+
+/// @brief Blocks a producer until there may be room for another job within the provider's capacity, or the deadline passes.  The
+///         producer sleeps until a worker takes a job, re-checking every ITHREAD_JOB_PROVIDER_SPACE_RECHECK_MS in case it missed it.
+/// @param iwtjp Pointer to job provider data structure.
+/// @param deadline_ns Time (see IThreadGetTimeNs()) to give up at, or 0 to wait for as long as it takes.
+/// @return True if the producer should try again, false if the deadline has passed.
+static bool _IWorkerThreadJobProviderWaitForSpace(IWorkerThreadJobProvider * iwtjp, uint64_t deadline_ns)
+{
+    uint64_t wake_ns = IThreadGetTimeNs();
+    if (deadline_ns && wake_ns >= deadline_ns) return false;
+    wake_ns += ITHREAD_JOB_PROVIDER_SPACE_RECHECK_MS * 1000000ULL;
+    if (deadline_ns && deadline_ns < wake_ns) wake_ns = deadline_ns;
+    const struct timespec WAKE_TIME = { .tv_sec = (time_t) (wake_ns / ITHREAD_NS_PER_SEC), .tv_nsec = (long) (wake_ns % ITHREAD_NS_PER_SEC) };
+
+    pthread_mutex_lock(&iwtjp->space_lock);
+    atomic_fetch_add(&iwtjp->waiting_producers, 1);
+    if (iwtjp->capacity && atomic_load(&iwtjp->queued_count) >= iwtjp->capacity)
+        pthread_cond_timedwait(&iwtjp->space_condition, &iwtjp->space_lock, &WAKE_TIME);
+    atomic_fetch_sub(&iwtjp->waiting_producers, 1);
+    pthread_mutex_unlock(&iwtjp->space_lock);
+    return !deadline_ns || IThreadGetTimeNs() < deadline_ns;
+}
+
+/// @brief Gets the job queue for the NUMA node the calling thread is running on, if the provider's normal priority jobs are
+///         partitioned by node (see IWorkerThreadJobProviderSetNumaNodes()).
+/// @return Pointer to the node's job queue, or NULL if jobs aren't partitioned or the node can't be found.
+static IWorkerThreadJobQueue * _IWorkerThreadJobProviderGetLocalQueue(IWorkerThreadJobProvider * iwtjp)
+{
+    if (!iwtjp->node_queues) return NULL;
+    const int NODE = IWorkerThreadJobProviderGetCurrentNode(iwtjp);
+    return NODE >= 0 ? iwtjp->node_queues[NODE] : NULL;
+}
+
+/// @brief Adds a job to the provider's job queue for the job's priority.  Higher priority jobs are handed to workers first,
+///         although jobs that have waited a long time are aged up (see IWorkerThreadJobProviderNextPriorityJob()).  If jobs are
+///         partitioned by NUMA node, a normal priority job goes on to the queue for the caller's node.  Safe to call from any number
+///         of threads.
+/// @param iwtjp Pointer to job provider data structure.
+/// @param iwtj Pointer to a job created by IWorkerThreadJobProviderCreateJob().
+/// @return True if the job was queued, false if the provider is at capacity (the job still belongs to the caller).
+bool IWorkerThreadJobProviderEnqueueJob(IWorkerThreadJobProvider * iwtjp, IWorkerThreadJob * iwtj)
+{
+    return IWorkerThreadJobProviderEnqueueJobTimed(iwtjp, iwtj, 0);
+}
+
+/// @brief Brings a named queue that is about to get a job up to date with the others.  A queue's pass only moves on while jobs are
+///         taken from it, so a queue that has been empty for a while would otherwise have a pass far behind the busy queues and be
+///         served exclusively until it caught up.  Instead it rejoins at the provider's current pass.
+static void _IWorkerThreadJobProviderActivateNamedQueue(IWorkerThreadJobProvider * iwtjp, IWorkerThreadNamedQueue * iwtnq)
+{
+    if (IWorkerThreadJobQueueGetCount(iwtnq->queue) > 0) return;
+    const uint64_t PASS = atomic_load_explicit(&iwtjp->named_queues_pass, memory_order_relaxed);
+    uint64_t pass = atomic_load_explicit(&iwtnq->pass, memory_order_relaxed);
+    while (pass < PASS && !atomic_compare_exchange_weak_explicit(&iwtnq->pass, &pass, PASS, memory_order_relaxed, memory_order_relaxed));
+}
+
+/// @brief Adds a job to the provider's job queues, waiting up to timeout_ms for room, or ignoring the capacity if forced.
+/// @return True if the job was queued, false if there was no room in time.
+static bool _IWorkerThreadJobProviderEnqueue(IWorkerThreadJobProvider * iwtjp, IWorkerThreadJob * iwtj, long timeout_ms, bool force)
+{
+    if (!IWorkerThreadJobProviderIsValid(iwtjp) || !IWorkerThreadJobIsValid(iwtj)) return false;
+    if (iwtj->priority < IThreadPriorityLow || iwtj->priority > IThreadPriorityHighest) iwtj->priority = IThreadPriorityNormal;
+    const uint64_t DEADLINE = timeout_ms > 0 ? IThreadGetTimeNs() + (uint64_t) timeout_ms * 1000000ULL : 0;
+    IWorkerThreadNamedQueue * named_queue = iwtj->named_queue;
+    IWorkerThreadJobQueue * local_queue = !named_queue && iwtj->priority == IThreadPriorityNormal ? _IWorkerThreadJobProviderGetLocalQueue(iwtjp) : NULL;
+    IWorkerThreadJobQueue * queue = named_queue ? named_queue->queue : iwtjp->queues[iwtj->priority - IThreadPriorityLow];
+    while (!_IWorkerThreadJobProviderReserve(iwtjp, 1, false, force)) {
+        if (timeout_ms == 0 || !_IWorkerThreadJobProviderWaitForSpace(iwtjp, DEADLINE)) {
+            atomic_fetch_add_explicit(&iwtjp->rejected_count, 1, memory_order_relaxed);
+            return false;
+        }
+    }
+    iwtj->enqueue_time_ns = IThreadGetTimeNs();
+    if (named_queue) _IWorkerThreadJobProviderActivateNamedQueue(iwtjp, named_queue);
+    IWorkerThreadJobQueueEnqueue(local_queue ? local_queue : queue, iwtj);
+    if (named_queue) atomic_fetch_add_explicit(&named_queue->enqueued_count, 1, memory_order_relaxed);
+    _IWorkerThreadJobProviderWake(iwtjp, false);
+    return true;
+}
+
+/// @brief Adds a job to the provider's job queues (see IWorkerThreadJobProviderEnqueueJob()), waiting for room if the provider is
+///         at capacity (see IWorkerThreadJobProviderSetCapacity()).  This gives producers backpressure: a producer that outruns the
+///         worker threads is slowed down to their pace instead of queuing jobs without limit.
+/// @param iwtjp Pointer to job provider data structure.
+/// @param iwtj Pointer to a job created by IWorkerThreadJobProviderCreateJob().
+/// @param timeout_ms Longest to wait for room in milliseconds, 0 to fail straight away or IThreadWaitForever to block until there
+///         is room.
+/// @return True if the job was queued, false if there was no room in time (the job still belongs to the caller).
+bool IWorkerThreadJobProviderEnqueueJobTimed(IWorkerThreadJobProvider * iwtjp, IWorkerThreadJob * iwtj, long timeout_ms)
+{
+    return _IWorkerThreadJobProviderEnqueue(iwtjp, iwtj, timeout_ms, false);
+}
+
+/// @brief Adds a job to the provider's job queues on behalf of a worker thread, for jobs that can't go on to the worker's own
+///         deque (those for a named queue or above or below normal priority).  As with IWorkerThreadJobProviderPushLocalJob(),
+///         the job counts towards the provider's capacity but is never refused or kept waiting because of it, as a worker thread
+///         waiting for its own backlog to clear would wait forever.
+/// @param iwtjp Pointer to job provider data structure.
+/// @param iwtj Pointer to a job created by IWorkerThreadJobProviderCreateJob().
+/// @return True if the job was queued, false if either pointer is invalid (the job still belongs to the caller).
+bool IWorkerThreadJobProviderEnqueueWorkerJob(IWorkerThreadJobProvider * iwtjp, IWorkerThreadJob * iwtj)
+{
+    return _IWorkerThreadJobProviderEnqueue(iwtjp, iwtj, 0, true);
+}
+
+/// @brief Pushes a job on to a worker thread's own deque.  This must only be called from the worker thread that owns the deque
+///         (i.e. by a job that is submitting more work).  Idle workers may steal the job.  The job counts towards the provider's
+///         capacity but is never refused because of it, as a worker thread waiting for its own backlog to clear would wait forever.
+/// @param iwtjp Pointer to job provider data structure.
+/// @param iwtjd Pointer to the calling worker thread's deque.
+/// @param iwtj Pointer to a job created by IWorkerThreadJobProviderCreateJob().
+/// @return True if the job was added, false otherwise (the job still belongs to the caller).
+bool IWorkerThreadJobProviderPushLocalJob(IWorkerThreadJobProvider * iwtjp, IWorkerThreadJobDeque * iwtjd, IWorkerThreadJob * iwtj)
+{
+    if (!IWorkerThreadJobProviderIsValid(iwtjp) || !IWorkerThreadJobIsValid(iwtj)) return false;
+    iwtj->enqueue_time_ns = IThreadGetTimeNs();
+    _IWorkerThreadJobProviderReserve(iwtjp, 1, false, true);
+    if (!IWorkerThreadJobDequePush(iwtjd, iwtj)) {
+        _IWorkerThreadJobProviderUnreserve(iwtjp, 1);
+        return false;
+    }
+    _IWorkerThreadJobProviderWake(iwtjp, false);
+    return true;
+}
+
+/// @brief Creates a job for the given data and adds it to the provider's job queue.  Safe to call from any number of threads.
+/// @param iwtjp Pointer to job provider data structure.
+/// @param job_data Pointer to job data.
+/// @return True if the job was added, false if the job could not be created or the provider is at capacity.
 bool IWorkerThreadJobProviderAddJob(IWorkerThreadJobProvider * iwtjp, void * job_data)
 {
-    if (!job_data || !IWorkerThreadJobProviderIsValid(iwtjp)) return false;
-    if (iwtjp->jobs_count == iwtjp->jobs_array_size) {
-        void ** new_job_array = (IWorkerThreadJob **) realloc(iwtjp->jobs, sizeof(IWorkerThreadJob *) * (iwtjp->jobs_count + 256));
-        if (!new_job_array) return false;
-        else {
-            iwtjp->jobs = new_job_array;
-            iwtjp->jobs_array_size += 256;
+    return IWorkerThreadJobProviderAddPriorityJob(iwtjp, job_data, IThreadPriorityNormal);
+}
+
+/// @brief Creates a job for the given data and adds it to the provider's job queue for the given priority.
+/// @param iwtjp Pointer to job provider data structure.
+/// @param job_data Pointer to job data.
+/// @param priority Job priority.  IThreadPriorityNone (or any unknown value) is treated as IThreadPriorityNormal.
+/// @return True if the job was added, false if the job could not be created or the provider is at capacity.
+bool IWorkerThreadJobProviderAddPriorityJob(IWorkerThreadJobProvider * iwtjp, void * job_data, IThreadPriority priority)
+{
+    IWorkerThreadJob * iwtj = IWorkerThreadJobProviderCreateJob(iwtjp, job_data);
+    if (!iwtj) return false;
+    iwtj->priority = priority;
+    if (!IWorkerThreadJobProviderEnqueueJob(iwtjp, iwtj)) {
+        IWorkerThreadJobFree(iwtj);
+        return false;
+    }
+    return true;
+}
+
+/// @brief Creates jobs for a batch of job data and queues them, either on the provider's shared job queue for the given priority
+///         or (if iwtjd is given) on the calling worker thread's own deque.  Jobs are taken from the pool, numbered, timestamped
+///         and queued in chunks rather than one at a time, and waiting workers are woken once at the end.  If jobs are partitioned
+///         by NUMA node, normal priority jobs go on to the queue for the caller's node first.  Jobs going on to the shared queues
+///         never wait for room: as many as fit within the provider's capacity are added (see IWorkerThreadJobProviderAddJobsTimed()
+///         to wait for it).
+/// @param iwtjp Pointer to job provider data structure.
+/// @param iwtjd Pointer to the calling worker thread's deque, or NULL to use the shared job queue.
+/// @param job_data Array of job data pointers.  None of them may be NULL.
+/// @param jobs_count Number of entries in job_data.
+/// @param priority Priority for the jobs (ignored when pushing on to a deque).
+/// @return Number of jobs added, taken from the start of job_data.  This is less than jobs_count if the provider's capacity was
+///         reached (see IWorkerThreadJobProviderSetCapacity()) or memory ran out, in which case job_data[return value] onwards
+///         weren't added and still belong to the caller.
+size_t IWorkerThreadJobProviderAddJobs(IWorkerThreadJobProvider * iwtjp, IWorkerThreadJobDeque * iwtjd, void ** job_data,
+                                        size_t jobs_count, IThreadPriority priority)
+{
+    return IWorkerThreadJobProviderAddJobsTimed(iwtjp, iwtjd, job_data, jobs_count, priority, 0);
+}
+
+/// @brief Creates and queues jobs for a batch of job data (see IWorkerThreadJobProviderAddJobs()), waiting for room whenever the
+///         provider is at capacity, so that a batch larger than the capacity goes in as workers make room for it.  Jobs pushed on
+///         to a worker thread's own deque never wait.
+/// @param iwtjp Pointer to job provider data structure.
+/// @param iwtjd Pointer to the calling worker thread's deque, or NULL to use the shared job queue.
+/// @param job_data Array of job data pointers.  None of them may be NULL.
+/// @param jobs_count Number of entries in job_data.
+/// @param priority Priority for the jobs (ignored when pushing on to a deque).
+/// @param timeout_ms Longest to wait for room in milliseconds (over the whole batch), 0 to add only what fits straight away or
+///         IThreadWaitForever to wait until every job is added.
+/// @return Number of jobs added, taken from the start of job_data.  With IThreadWaitForever this is jobs_count unless memory ran
+///         out.  Job data from job_data[return value] onwards wasn't added and still belongs to the caller.
+size_t IWorkerThreadJobProviderAddJobsTimed(IWorkerThreadJobProvider * iwtjp, IWorkerThreadJobDeque * iwtjd, void ** job_data,
+                                            size_t jobs_count, IThreadPriority priority, long timeout_ms)
+{
+    if (!IWorkerThreadJobProviderIsValid(iwtjp) || !job_data) return 0;
+    for (size_t j = 0; j < jobs_count; j++) if (!job_data[j]) return 0;
+    if (priority < IThreadPriorityLow || priority > IThreadPriorityHighest) priority = IThreadPriorityNormal;
+    const uint64_t DEADLINE = timeout_ms > 0 ? IThreadGetTimeNs() + (uint64_t) timeout_ms * 1000000ULL : 0;
+
+    IWorkerThreadJobQueue * local_queue = !iwtjd && priority == IThreadPriorityNormal ? _IWorkerThreadJobProviderGetLocalQueue(iwtjp) : NULL;
+    IWorkerThreadJob * jobs[ITHREAD_JOB_BATCH_SIZE];
+    size_t jobs_added = 0;
+    while (jobs_added < jobs_count) {
+        const size_t WANTED = jobs_count - jobs_added < ITHREAD_JOB_BATCH_SIZE ? jobs_count - jobs_added : ITHREAD_JOB_BATCH_SIZE;
+        const size_t CHUNK_SIZE = _IWorkerThreadJobProviderReserve(iwtjp, WANTED, true, iwtjd != NULL);
+        if (CHUNK_SIZE == 0) {
+            // The jobs added so far may be what is holding the room, so let the workers at them before waiting.
+            if (jobs_added > 0) _IWorkerThreadJobProviderWake(iwtjp, true);
+            if (timeout_ms == 0 || !_IWorkerThreadJobProviderWaitForSpace(iwtjp, DEADLINE)) break;
+            continue;
+        }
+        const size_t JOBS_ACQUIRED = IWorkerThreadJobPoolAcquireBatch(iwtjp->job_pool, jobs, &job_data[jobs_added], CHUNK_SIZE);
+        if (JOBS_ACQUIRED < CHUNK_SIZE) _IWorkerThreadJobProviderUnreserve(iwtjp, CHUNK_SIZE - JOBS_ACQUIRED);
+        if (JOBS_ACQUIRED == 0) break;
+        const size_t FIRST_ID = atomic_fetch_add_explicit(&_iworker_thread_job_id, JOBS_ACQUIRED, memory_order_relaxed);
+        const uint64_t ENQUEUE_TIME = IThreadGetTimeNs();
+        for (size_t j = 0; j < JOBS_ACQUIRED; j++) {
+            jobs[j]->id = FIRST_ID + j;
+            jobs[j]->priority = priority;
+            jobs[j]->enqueue_time_ns = ENQUEUE_TIME;
         }
+        size_t jobs_queued = 0;
+        if (iwtjd) jobs_queued = IWorkerThreadJobDequePushBatch(iwtjd, jobs, JOBS_ACQUIRED) ? JOBS_ACQUIRED : 0;
+        else jobs_queued = IWorkerThreadJobQueueEnqueueBatch(local_queue ? local_queue : iwtjp->queues[priority - IThreadPriorityLow],
+                                                             jobs, JOBS_ACQUIRED);
+        jobs_added += jobs_queued;
+        if (jobs_queued < JOBS_ACQUIRED) {
+            // The deque couldn't grow, so hand the jobs we couldn't queue back to the pool and give up.
+            for (size_t j = jobs_queued; j < JOBS_ACQUIRED; j++) IWorkerThreadJobFree(jobs[j]);
+            _IWorkerThreadJobProviderUnreserve(iwtjp, JOBS_ACQUIRED - jobs_queued);
+            break;
+        }
+        if (JOBS_ACQUIRED < CHUNK_SIZE) break;
     }
-    IWorkerThreadJob * iwtj = IWorkerThreadJobCreate(job_data);
-    if (IWorkerThreadJobIsValid(iwtj)) {
-        iwtj->id = _iworker_thread_job_id++;
-        iwtjp->jobs[iwtjp->jobs_count++] = iwtj;
-        return true;
+    if (jobs_added < jobs_count) atomic_fetch_add_explicit(&iwtjp->rejected_count, jobs_count - jobs_added, memory_order_relaxed);
+    if (jobs_added > 0) _IWorkerThreadJobProviderWake(iwtjp, jobs_added > 1);
+    return jobs_added;
+}
+
+/// @brief Registers a worker thread's deque with the provider so that other workers can steal from it.  Deques must be registered
+///         before the worker threads are started.
+/// @param iwtjp Pointer to job provider data structure.
+/// @param iwtjd Pointer to deque data structure.
+/// @return True if the deque was registered, false otherwise.
+bool IWorkerThreadJobProviderAddDeque(IWorkerThreadJobProvider * iwtjp, IWorkerThreadJobDeque * iwtjd)
+{
+    if (!IWorkerThreadJobProviderIsValid(iwtjp) || !IWorkerThreadJobDequeIsValid(iwtjd)) return false;
+    if (iwtjp->deques_count == iwtjp->deques_buffer_size) {
+        IWorkerThreadJobDeque ** new_deques = (IWorkerThreadJobDeque **) realloc(iwtjp->deques, sizeof(IWorkerThreadJobDeque *) * (iwtjp->deques_buffer_size + 4));
+        if (!new_deques) return false;
+        iwtjp->deques = new_deques;
+        iwtjp->deques_buffer_size += 4;
     }
+    iwtjp->deques[iwtjp->deques_count++] = iwtjd;
+    return true;
+}
 
-    return false;
+/// @brief Tries to steal a job from another worker thread's deque.  Victims are visited in turn starting from a random deque so
+///         that thieves spread out rather than all hitting the same worker.
+/// @param iwtjp Pointer to job provider data structure.
+/// @param thief_deque Pointer to the calling worker thread's own deque (which is skipped).
+/// @param seed Pointer to the calling worker thread's random number seed.
+/// @return Pointer to the stolen job or NULL if no job could be stolen.
+IWorkerThreadJob * IWorkerThreadJobProviderStealJob(IWorkerThreadJobProvider * iwtjp, IWorkerThreadJobDeque * thief_deque, unsigned int * seed)
+{
+    if (!IWorkerThreadJobProviderIsValid(iwtjp) || iwtjp->deques_count == 0) return NULL;
+    const size_t START_INDEX = rand_r(seed) % iwtjp->deques_count;
+    for (size_t d = 0; d < iwtjp->deques_count; d++) {
+        IWorkerThreadJobDeque * victim_deque = iwtjp->deques[(START_INDEX + d) % iwtjp->deques_count];
+        if (victim_deque == thief_deque) continue;
+        IWorkerThreadJob * iwtj = IWorkerThreadJobDequeSteal(victim_deque);
+        if (iwtj) return iwtj;
+    }
+    return NULL;
 }
 
 bool IWorkerThreadJobProviderFree(IWorkerThreadJobProvider * iwtjp)
 {
     if (!IWorkerThreadJobProviderIsValid(iwtjp)) return false;
-    if (iwtjp->jobs_count > 0) {
-        for (size_t i = 0; i < iwtjp->jobs_count; i++) {
-            if (iwtjp->jobs[i]) {
-                IWorkerThreadJobFree(iwtjp->jobs[i]);
-                iwtjp->jobs[i] = NULL;
-            }
-        }
-        free(iwtjp->jobs);
-        iwtjp->jobs = NULL;
-        iwtjp->jobs_count = 0;
+    // Hand any jobs that were never taken from the queues back to the pool, then free the pool (and with it, every job).
+    IWorkerThreadJob * iwtj;
+    for (int l = 0; l < ITHREAD_PRIORITY_LEVELS; l++) {
+        while ((iwtj = IWorkerThreadJobQueueDequeue(iwtjp->queues[l]))) IWorkerThreadJobFree(iwtj);
+        IWorkerThreadJobQueueFree(iwtjp->queues[l]);
+        iwtjp->queues[l] = NULL;
     }
-    iwtjp->jobs_array_size = 0;
-    iwtjp->next_job_index = 0;
+    IWorkerThreadJobProviderSetNumaNodes(iwtjp, NULL);
+    const size_t NAMED_QUEUES_COUNT = atomic_load(&iwtjp->named_queues_count);
+    for (size_t q = 0; q < NAMED_QUEUES_COUNT; q++) {
+        IWorkerThreadNamedQueueFree(iwtjp->named_queues[q]);
+        iwtjp->named_queues[q] = NULL;
+    }
+    atomic_store(&iwtjp->named_queues_count, 0);
+    pthread_mutex_destroy(&iwtjp->named_queues_lock);
+    // The deques belong to the worker threads, which free them (and any jobs left in them).
+    free(iwtjp->deques);
+    iwtjp->deques = NULL;
+    iwtjp->deques_count = iwtjp->deques_buffer_size = 0;
+    IWorkerThreadJobPoolFree(iwtjp->job_pool);
+    iwtjp->job_pool = NULL;
     iwtjp->struct_id = 0;
+    pthread_cond_destroy(&iwtjp->wait_condition);
+    pthread_mutex_destroy(&iwtjp->wait_lock);
+    pthread_cond_destroy(&iwtjp->space_condition);
+    pthread_mutex_destroy(&iwtjp->space_lock);
     free(iwtjp);
+    return true;
+}
+
+/// @brief Tells the provider a worker thread has taken a job (from any queue or deque), making room for another.  Called by the
+///         worker thread for every job it takes.
+/// @param iwtjp Pointer to job provider data structure.
+void IWorkerThreadJobProviderJobTaken(IWorkerThreadJobProvider * iwtjp)
+{
+    if (IWorkerThreadJobProviderIsValid(iwtjp)) _IWorkerThreadJobProviderUnreserve(iwtjp, 1);
+}
+
+/// @brief Limits the number of jobs that can be queued (across every queue and deque) at once.  Once the limit is reached, adding a
+///         job fails or waits (see IWorkerThreadJobProviderEnqueueJobTimed()) until a worker thread takes one, so memory stays flat
+///         however far producers get ahead.  Can be changed at any time.
+/// @param iwtjp Pointer to job provider data structure.
+/// @param capacity Maximum number of queued jobs, or 0 for no limit.
+void IWorkerThreadJobProviderSetCapacity(IWorkerThreadJobProvider * iwtjp, size_t capacity)
+{
+    if (!IWorkerThreadJobProviderIsValid(iwtjp)) return;
+    iwtjp->capacity = capacity;
+    // Producers waiting on the old capacity may now have room.
+    _IWorkerThreadJobProviderUnreserve(iwtjp, 0);
+}
+
+size_t IWorkerThreadJobProviderGetCapacity(IWorkerThreadJobProvider * iwtjp)
+{
+    return IWorkerThreadJobProviderIsValid(iwtjp) ? iwtjp->capacity : 0;
+}
+
+/// @brief Indicates if the provider is at its capacity, so that a job added now would fail (or wait) for want of room.  Nothing is
+///         reserved, so another producer may fill the last place (or a worker free one) straight afterwards.
+/// @param iwtjp Pointer to job provider data structure.
+/// @return True if the provider has a capacity and it has been reached, false otherwise.
+bool IWorkerThreadJobProviderIsFull(IWorkerThreadJobProvider * iwtjp)
+{
+    return IWorkerThreadJobProviderIsValid(iwtjp) && iwtjp->capacity &&
+        atomic_load_explicit(&iwtjp->queued_count, memory_order_relaxed) >= iwtjp->capacity;
+}
+
+/// @brief Gets the largest number of jobs that have been queued at once, which shows how close the provider has come to its
+///         capacity (and how far producers have got ahead of the worker threads).
+size_t IWorkerThreadJobProviderGetHighWatermark(IWorkerThreadJobProvider * iwtjp)
+{
+    return IWorkerThreadJobProviderIsValid(iwtjp) ? atomic_load_explicit(&iwtjp->high_watermark, memory_order_relaxed) : 0;
 }
 
+/// @brief Gets the number of jobs that couldn't be added because there was no room (in time).
+size_t IWorkerThreadJobProviderGetRejectedCount(IWorkerThreadJobProvider * iwtjp)
+{
+    return IWorkerThreadJobProviderIsValid(iwtjp) ? atomic_load_explicit(&iwtjp->rejected_count, memory_order_relaxed) : 0;
+}
+
+/// @brief Indicates if there are any jobs available, either in the provider's job queue or in any worker thread's deque.
+/// @param iwtjp Pointer to job provider data structure.
+/// @return True if there are jobs waiting to be processed, false otherwise.
 bool IWorkerThreadJobProviderHasJobs(IWorkerThreadJobProvider * iwtjp)
 {
-    return IWorkerThreadJobProviderIsValid(iwtjp) && iwtjp->next_job_index < iwtjp->jobs_count - 1;
+    if (!IWorkerThreadJobProviderIsValid(iwtjp)) return false;
+    for (int l = 0; l < ITHREAD_PRIORITY_LEVELS; l++) {
+        if (IWorkerThreadJobQueueGetCount(iwtjp->queues[l]) > 0) return true;
+    }
+    for (int n = 0; n < iwtjp->nodes_count; n++) {
+        if (IWorkerThreadJobQueueGetCount(iwtjp->node_queues[n]) > 0) return true;
+    }
+    const size_t NAMED_QUEUES_COUNT = atomic_load_explicit(&iwtjp->named_queues_count, memory_order_acquire);
+    for (size_t q = 0; q < NAMED_QUEUES_COUNT; q++) {
+        if (IWorkerThreadJobQueueGetCount(iwtjp->named_queues[q]->queue) > 0) return true;
+    }
+    for (size_t d = 0; d < iwtjp->deques_count; d++) {
+        if (IWorkerThreadJobDequeHasJobs(iwtjp->deques[d])) return true;
+    }
+    return false;
+}
+
+/// @brief Gets the number of jobs waiting to be processed, across the provider's job queues and every worker thread's deque.
+///         Each queue and deque is read without locking, so the total is approximate while jobs are being added and taken.
+/// @param iwtjp Pointer to job provider data structure.
+/// @return Number of jobs waiting to be processed.
+size_t IWorkerThreadJobProviderGetPendingCount(IWorkerThreadJobProvider * iwtjp)
+{
+    if (!IWorkerThreadJobProviderIsValid(iwtjp)) return 0;
+    size_t pending = 0;
+    for (int l = 0; l < ITHREAD_PRIORITY_LEVELS; l++) pending += IWorkerThreadJobQueueGetCount(iwtjp->queues[l]);
+    for (int n = 0; n < iwtjp->nodes_count; n++) pending += IWorkerThreadJobQueueGetCount(iwtjp->node_queues[n]);
+    const size_t NAMED_QUEUES_COUNT = atomic_load_explicit(&iwtjp->named_queues_count, memory_order_acquire);
+    for (size_t q = 0; q < NAMED_QUEUES_COUNT; q++) pending += IWorkerThreadJobQueueGetCount(iwtjp->named_queues[q]->queue);
+    for (size_t d = 0; d < iwtjp->deques_count; d++) pending += IWorkerThreadJobDequeGetCount(iwtjp->deques[d]);
+    return pending;
 }
 
+/// @brief Gets the time the longest waiting job at the front of the provider's job queues was enqueued.  Jobs in worker threads'
+///         deques aren't included, as they can't safely be looked at by other threads.
+/// @param iwtjp Pointer to job provider data structure.
+/// @return Enqueue time (see IThreadGetTimeNs()) of the oldest queued job, or 0 if the queues appear empty.
+uint64_t IWorkerThreadJobProviderGetOldestEnqueueTime(IWorkerThreadJobProvider * iwtjp)
+{
+    if (!IWorkerThreadJobProviderIsValid(iwtjp)) return 0;
+    uint64_t oldest = 0;
+    const int NAMED_QUEUES_COUNT = (int) atomic_load_explicit(&iwtjp->named_queues_count, memory_order_acquire);
+    for (int q = 0; q < ITHREAD_PRIORITY_LEVELS + iwtjp->nodes_count + NAMED_QUEUES_COUNT; q++) {
+        IWorkerThreadJobQueue * iwtjq = q < ITHREAD_PRIORITY_LEVELS ? iwtjp->queues[q]
+                                      : q < ITHREAD_PRIORITY_LEVELS + iwtjp->nodes_count ? iwtjp->node_queues[q - ITHREAD_PRIORITY_LEVELS]
+                                      : iwtjp->named_queues[q - ITHREAD_PRIORITY_LEVELS - iwtjp->nodes_count]->queue;
+        uint64_t enqueue_time;
+        if (IWorkerThreadJobQueuePeekEnqueueTime(iwtjq, &enqueue_time) && enqueue_time && (!oldest || enqueue_time < oldest))
+            oldest = enqueue_time;
+    }
+    return oldest;
+}
+
+/// @brief Adds a named job queue to the provider.  Named queues share the worker threads in proportion to their weights, however
+///         many jobs each has waiting, so one tenant's backlog can't starve the others (see
+///         IWorkerThreadJobProviderNextNamedQueueJob()).  Queues can be added while the worker threads are running, but are only
+///         freed with the provider.
+/// @param iwtjp Pointer to job provider data structure.
+/// @param name Name of the queue.
+/// @param weight Share of the throughput relative to the other named queues.
+/// @return Pointer to the new queue (or the existing queue with that name, given the new weight), or NULL if the queue could not be
+///         created or there are already ITHREAD_MAX_NAMED_QUEUES.
+IWorkerThreadNamedQueue * IWorkerThreadJobProviderAddNamedQueue(IWorkerThreadJobProvider * iwtjp, const char * name, unsigned int weight)
+{
+    if (!IWorkerThreadJobProviderIsValid(iwtjp) || !name) return NULL;
+    pthread_mutex_lock(&iwtjp->named_queues_lock);
+    IWorkerThreadNamedQueue * iwtnq = IWorkerThreadJobProviderGetNamedQueue(iwtjp, name);
+    if (iwtnq) IWorkerThreadNamedQueueSetWeight(iwtnq, weight);
+    else if (atomic_load(&iwtjp->named_queues_count) < ITHREAD_MAX_NAMED_QUEUES && (iwtnq = IWorkerThreadNamedQueueCreate(name, weight))) {
+        // A new queue joins at the current pass, like a queue that has been idle.  Publishing the count after the pointer means
+        // worker threads never see a slot that hasn't been filled in.
+        atomic_store(&iwtnq->pass, atomic_load(&iwtjp->named_queues_pass));
+        const size_t COUNT = atomic_load(&iwtjp->named_queues_count);
+        iwtjp->named_queues[COUNT] = iwtnq;
+        atomic_store_explicit(&iwtjp->named_queues_count, COUNT + 1, memory_order_release);
+    }
+    pthread_mutex_unlock(&iwtjp->named_queues_lock);
+    return iwtnq;
+}
+
+/// @brief Finds one of the provider's named job queues.
+/// @param iwtjp Pointer to job provider data structure.
+/// @param name Name of the queue.
+/// @return Pointer to the queue, or NULL if the provider has no queue with that name.
+IWorkerThreadNamedQueue * IWorkerThreadJobProviderGetNamedQueue(IWorkerThreadJobProvider * iwtjp, const char * name)
+{
+    if (!IWorkerThreadJobProviderIsValid(iwtjp) || !name) return NULL;
+    const size_t NAMED_QUEUES_COUNT = atomic_load_explicit(&iwtjp->named_queues_count, memory_order_acquire);
+    for (size_t q = 0; q < NAMED_QUEUES_COUNT; q++) {
+        if (strncmp(iwtjp->named_queues[q]->name, name, ITHREAD_NAMED_QUEUE_NAME_LENGTH - 1) == 0) return iwtjp->named_queues[q];
+    }
+    return NULL;
+}
+
+/// @brief Takes a job from the provider's named queues using stride scheduling.  Each queue has a pass, which moves on by the
+///         queue's stride (inversely proportional to its weight) every time a job is taken from it, and the job comes from the
+///         non-empty queue with the lowest pass.  Over any stretch of time in which queues have jobs waiting, each is served in
+///         proportion to its weight.  Passes are read and moved on without locking, so concurrent worker threads can occasionally
+///         pick the same queue; the shares even out over the following picks.
+/// @param iwtjp Pointer to job provider data structure.
+/// @return Pointer to the job or NULL if all of the named queues are empty.
+IWorkerThreadJob * IWorkerThreadJobProviderNextNamedQueueJob(IWorkerThreadJobProvider * iwtjp)
+{
+    if (!IWorkerThreadJobProviderIsValid(iwtjp)) return NULL;
+    const size_t NAMED_QUEUES_COUNT = atomic_load_explicit(&iwtjp->named_queues_count, memory_order_acquire);
+    uint64_t tried = 0;
+    for (size_t attempt = 0; attempt < NAMED_QUEUES_COUNT; attempt++) {
+        IWorkerThreadNamedQueue * best = NULL;
+        uint64_t best_pass = 0;
+        size_t best_index = 0;
+        for (size_t q = 0; q < NAMED_QUEUES_COUNT; q++) {
+            IWorkerThreadNamedQueue * iwtnq = iwtjp->named_queues[q];
+            if ((tried & (1ULL << q)) || IWorkerThreadJobQueueGetCount(iwtnq->queue) == 0) continue;
+            const uint64_t PASS = atomic_load_explicit(&iwtnq->pass, memory_order_relaxed);
+            if (!best || PASS < best_pass) {
+                best = iwtnq;
+                best_pass = PASS;
+                best_index = q;
+            }
+        }
+        if (!best) return NULL;
+        IWorkerThreadJob * iwtj = IWorkerThreadJobQueueDequeue(best->queue);
+        if (!iwtj) {
+            // Another worker thread emptied the queue first.
+            tried |= 1ULL << best_index;
+            continue;
+        }
+        atomic_fetch_add_explicit(&best->pass, atomic_load_explicit(&best->stride, memory_order_relaxed), memory_order_relaxed);
+        atomic_store_explicit(&iwtjp->named_queues_pass, best_pass, memory_order_relaxed);
+        atomic_fetch_add_explicit(&best->dequeued_count, 1, memory_order_relaxed);
+        const uint64_t NOW = IThreadGetTimeNs();
+        if (iwtj->enqueue_time_ns && NOW > iwtj->enqueue_time_ns)
+            IThreadHistogramRecordConcurrent(best->wait_time_histogram, NOW - iwtj->enqueue_time_ns);
+        return iwtj;
+    }
+    return NULL;
+}
+
+/// @brief Takes the most urgent job from the provider's job queues, including low priority jobs.
+/// @param iwtjp Pointer to job provider data structure.
+/// @return Pointer to the job or NULL if all of the queues are empty.
 IWorkerThreadJob * IWorkerThreadJobProviderNextJob(IWorkerThreadJobProvider * iwtjp)
 {
-    return IWorkerThreadJobProviderIsValid(iwtjp) && iwtjp->next_job_index < iwtjp->jobs_count ? iwtjp->jobs[iwtjp->next_job_index++] : NULL;
+    return IWorkerThreadJobProviderNextPriorityJob(iwtjp, IThreadPriorityLow);
+}
+
+/// @brief Takes the most urgent job from the provider's job queues, provided it is at least as urgent as minimum_priority.  A job's
+///         urgency is its priority plus one level for every aging interval it has spent waiting, so low priority jobs can't be
+///         starved by a constant stream of higher priority work.  Where urgencies are equal, the higher priority queue wins.
+/// @param iwtjp Pointer to job provider data structure.
+/// @param minimum_priority The lowest urgency that will be accepted.
+/// @return Pointer to the job or NULL if there are no jobs that are urgent enough.
+IWorkerThreadJob * IWorkerThreadJobProviderNextPriorityJob(IWorkerThreadJobProvider * iwtjp, IThreadPriority minimum_priority)
+{
+    if (!IWorkerThreadJobProviderIsValid(iwtjp)) return NULL;
+    if (minimum_priority < IThreadPriorityLow) minimum_priority = IThreadPriorityLow;
+
+    // Find out which queues have a job waiting at the front, and when they were added.
+    uint64_t enqueue_times[ITHREAD_PRIORITY_LEVELS];
+    bool has_job[ITHREAD_PRIORITY_LEVELS];
+    int levels_with_jobs = 0, top_level = -1;
+    for (int l = ITHREAD_PRIORITY_LEVELS - 1; l >= 0; l--) {
+        has_job[l] = IWorkerThreadJobQueuePeekEnqueueTime(iwtjp->queues[l], &enqueue_times[l]);
+        if (has_job[l]) {
+            levels_with_jobs++;
+            if (top_level < 0) top_level = l;
+        }
+    }
+    if (levels_with_jobs == 0) return NULL;
+
+    // Work out which queue's front job is the most urgent.  If only one queue has jobs, there's no need to read the clock.
+    int best_level = top_level;
+    uint64_t best_urgency = top_level + IThreadPriorityLow;
+    if (levels_with_jobs > 1 || best_urgency < minimum_priority) {
+        const uint64_t NOW = IThreadGetTimeNs();
+        best_urgency = 0;
+        for (int l = ITHREAD_PRIORITY_LEVELS - 1; l >= 0; l--) {
+            if (!has_job[l]) continue;
+            const uint64_t WAIT_TIME = NOW > enqueue_times[l] ? NOW - enqueue_times[l] : 0;
+            const uint64_t URGENCY = l + IThreadPriorityLow + (iwtjp->aging_interval_ns ? WAIT_TIME / iwtjp->aging_interval_ns : 0);
+            if (URGENCY > best_urgency) {
+                best_urgency = URGENCY;
+                best_level = l;
+            }
+        }
+    }
+    if (best_urgency < minimum_priority) return NULL;
+
+    // Another worker may have taken the job in the meantime, in which case fall back on the highest priority queue with a job.
+    IWorkerThreadJob * iwtj = IWorkerThreadJobQueueDequeue(iwtjp->queues[best_level]);
+    const int MINIMUM_LEVEL = (int) minimum_priority - IThreadPriorityLow;
+    for (int l = ITHREAD_PRIORITY_LEVELS - 1; !iwtj && l >= MINIMUM_LEVEL; l--) {
+        iwtj = IWorkerThreadJobQueueDequeue(iwtjp->queues[l]);
+    }
+    return iwtj;
+}
+
+/// @brief Partitions the provider's normal priority jobs by NUMA node.  Each node gets its own job queue, which jobs added by
+///         threads running on that node go on to, so worker threads on the same node can pick them up while their data is still in
+///         local memory (see IWorkerThreadJobProviderNextNodeJob()).  Higher priority jobs always use the shared queues.  This must
+///         be called before the worker threads are started.
+/// @param iwtjp Pointer to job provider data structure.
+/// @param itct Pointer to the machine's CPU topology, or NULL to remove the partitioning (any jobs waiting on a node's queue are
+///         moved to the shared queue).
+/// @return True if the partitioning was set up (or removed), false otherwise.
+bool IWorkerThreadJobProviderSetNumaNodes(IWorkerThreadJobProvider * iwtjp, IThreadCpuTopology * itct)
+{
+    if (!IWorkerThreadJobProviderIsValid(iwtjp) || (itct && !IThreadCpuTopologyIsValid(itct))) return false;
+
+    // Remove any existing partitioning first.
+    IWorkerThreadJob * iwtj;
+    for (int n = 0; n < iwtjp->nodes_count; n++) {
+        while ((iwtj = IWorkerThreadJobQueueDequeue(iwtjp->node_queues[n]))) {
+            if (!IWorkerThreadJobQueueEnqueue(iwtjp->queues[IThreadPriorityNormal - IThreadPriorityLow], iwtj)) {
+                IWorkerThreadJobFree(iwtj);
+                _IWorkerThreadJobProviderUnreserve(iwtjp, 1);
+            }
+        }
+        IWorkerThreadJobQueueFree(iwtjp->node_queues[n]);
+    }
+    free(iwtjp->node_queues);
+    free(iwtjp->cpu_nodes);
+    iwtjp->node_queues = NULL;
+    iwtjp->cpu_nodes = NULL;
+    iwtjp->nodes_count = iwtjp->cpus_count = 0;
+    if (!itct) return true;
+
+    IWorkerThreadJobQueue ** node_queues = (IWorkerThreadJobQueue **) calloc(itct->nodes_count, sizeof(IWorkerThreadJobQueue *));
+    int * cpu_nodes = (int *) malloc(sizeof(int) * itct->cpus_count);
+    bool queues_created = node_queues && cpu_nodes;
+    for (int n = 0; queues_created && n < itct->nodes_count; n++) {
+        node_queues[n] = IWorkerThreadJobQueueCreate(ITHREAD_DEFAULT_JOB_QUEUE_CAPACITY);
+        if (!node_queues[n]) queues_created = false;
+    }
+    if (!queues_created) {
+        for (int n = 0; node_queues && n < itct->nodes_count; n++) IWorkerThreadJobQueueFree(node_queues[n]);
+        free(node_queues);
+        free(cpu_nodes);
+        return false;
+    }
+    for (int c = 0; c < itct->cpus_count; c++) cpu_nodes[c] = IThreadCpuTopologyGetNode(itct, c);
+    iwtjp->cpu_nodes = cpu_nodes;
+    iwtjp->cpus_count = itct->cpus_count;
+    iwtjp->node_queues = node_queues;
+    iwtjp->nodes_count = itct->nodes_count;
+    return true;
+}
+
+/// @brief Gets the NUMA node the calling thread is currently running on.
+/// @param iwtjp Pointer to job provider data structure.
+/// @return Node number, or -1 if the provider's jobs aren't partitioned by node or the calling thread's CPU can't be found.
+int IWorkerThreadJobProviderGetCurrentNode(IWorkerThreadJobProvider * iwtjp)
+{
+    if (!IWorkerThreadJobProviderIsValid(iwtjp) || !iwtjp->cpu_nodes) return -1;
+    const int CPU = IThreadGetCurrentCpu();
+    return CPU >= 0 && CPU < iwtjp->cpus_count ? iwtjp->cpu_nodes[CPU] : -1;
+}
+
+/// @brief Takes the oldest job from the job queue for a NUMA node.
+/// @param iwtjp Pointer to job provider data structure.
+/// @param node Node number, or -1 for the node the calling thread is running on.
+/// @return Pointer to the job or NULL if jobs aren't partitioned by node or the node's queue is empty.
+IWorkerThreadJob * IWorkerThreadJobProviderNextNodeJob(IWorkerThreadJobProvider * iwtjp, int node)
+{
+    if (!IWorkerThreadJobProviderIsValid(iwtjp) || !iwtjp->node_queues) return NULL;
+    if (node < 0) node = IWorkerThreadJobProviderGetCurrentNode(iwtjp);
+    if (node < 0 || node >= iwtjp->nodes_count) return NULL;
+    return IWorkerThreadJobQueueDequeue(iwtjp->node_queues[node]);
+}
+
+/// @brief Takes the oldest job from another NUMA node's job queue, so that work queued on one node isn't left waiting while
+///         worker threads on other nodes are idle.  Nodes are visited in turn, starting with the one after the given node.
+/// @param iwtjp Pointer to job provider data structure.
+/// @param node The calling worker thread's node (which is skipped), or -1 for the node the calling thread is running on.
+/// @return Pointer to the job or NULL if jobs aren't partitioned by node or every other node's queue is empty.
+IWorkerThreadJob * IWorkerThreadJobProviderNextRemoteNodeJob(IWorkerThreadJobProvider * iwtjp, int node)
+{
+    if (!IWorkerThreadJobProviderIsValid(iwtjp) || !iwtjp->node_queues) return NULL;
+    if (node < 0) node = IWorkerThreadJobProviderGetCurrentNode(iwtjp);
+    for (int n = 1; n <= iwtjp->nodes_count; n++) {
+        // If the caller's node isn't known, every node's queue is tried.
+        const int REMOTE_NODE = (node + n) % iwtjp->nodes_count;
+        if (REMOTE_NODE == node) continue;
+        IWorkerThreadJob * iwtj = IWorkerThreadJobQueueDequeue(iwtjp->node_queues[REMOTE_NODE]);
+        if (iwtj) return iwtj;
+    }
+    return NULL;
+}
+
+/// @brief Sets how long a job has to wait before it is treated as being one priority level more urgent.
+/// @param iwtjp Pointer to job provider data structure.
+/// @param milliseconds Aging interval in milliseconds.  Zero disables aging, so jobs are taken in strict priority order.
+void IWorkerThreadJobProviderSetAgingInterval(IWorkerThreadJobProvider * iwtjp, long milliseconds)
+{
+    if (!IWorkerThreadJobProviderIsValid(iwtjp)) return;
+    iwtjp->aging_interval_ns = milliseconds > 0 ? (uint64_t) milliseconds * 1000000ULL : 0;
+}
+
+/// @brief Blocks the calling worker thread until the provider has a job available, or until the waiting worker thread's state
+///         is changed from IThreadStateRunning (i.e. a stop or kill request has been made).
+/// @param iwtjp Pointer to job provider data structure.
+/// @param waiter_state Pointer to the state of the waiting worker thread.  The state is re-checked every time the waiter is woken.
+void IWorkerThreadJobProviderWaitForJobs(IWorkerThreadJobProvider * iwtjp, _Atomic(IThreadState) * waiter_state)
+{
+    if (!IWorkerThreadJobProviderIsValid(iwtjp) || !waiter_state) return;
+    pthread_mutex_lock(&iwtjp->wait_lock);
+    atomic_fetch_add(&iwtjp->waiting_workers, 1);
+    while (!IWorkerThreadJobProviderHasJobs(iwtjp) && atomic_load_explicit(waiter_state, memory_order_acquire) == IThreadStateRunning) {
+        pthread_cond_wait(&iwtjp->wait_condition, &iwtjp->wait_lock);
+    }
+    atomic_fetch_sub(&iwtjp->waiting_workers, 1);
+    pthread_mutex_unlock(&iwtjp->wait_lock);
+}
+
+/// @brief Wakes every worker thread blocked in IWorkerThreadJobProviderWaitForJobs() so that they re-check their state.  This
+///         should be called after a worker thread's state has been changed by another thread.
+/// @param iwtjp Pointer to job provider data structure.
+void IWorkerThreadJobProviderWakeAll(IWorkerThreadJobProvider * iwtjp)
+{
+    if (!IWorkerThreadJobProviderIsValid(iwtjp)) return;
+    pthread_mutex_lock(&iwtjp->wait_lock);
+    pthread_cond_broadcast(&iwtjp->wait_condition);
+    pthread_mutex_unlock(&iwtjp->wait_lock);
 }
@@ -0,0 +1,257 @@
+#include <stdint.h>
+
+#include "global.h"
+#include "iworkerthreadjob.h"
+#include "iworkerthreadjobqueue.h"
+
+/// @brief Creates an unbounded, multi-producer/multi-consumer job queue.  Jobs normally go through a lock-free ring of cells, each
+///         carrying a sequence number that tells producers and consumers whether the cell is free to write or ready to read (this is
+///         Dmitry Vyukov's bounded MPMC queue), where producers and consumers only contend on their own position counter.  If the
+///         ring fills up, further jobs wait in an overflow list behind it, under a lock, until consumers have made room in the ring.
+/// @param capacity Number of jobs the ring can hold.  This is rounded up to the next power of two.
+/// @return Pointer to the job queue data structure or NULL if there is not enough memory.
+IWorkerThreadJobQueue * IWorkerThreadJobQueueCreate(size_t capacity)
+{
+    // The cell index is calculated by masking the position counters, so the capacity must be a power of two.
+    size_t rounded_capacity = 2;
+    while (rounded_capacity < capacity) rounded_capacity <<= 1;
+
+    IWorkerThreadJobQueue * iwtjq = (IWorkerThreadJobQueue *) aligned_alloc(ITHREAD_CACHE_LINE_SIZE, sizeof(IWorkerThreadJobQueue));
+    if (!iwtjq) return NULL;
+    iwtjq->cells = (IWorkerThreadJobQueueCell *) malloc(sizeof(IWorkerThreadJobQueueCell) * rounded_capacity);
+    if (!iwtjq->cells) {
+        free(iwtjq);
+        return NULL;
+    }
+    // Each cell starts with a sequence number equal to its index, which marks it as free for the producer at that position.
+    for (size_t c = 0; c < rounded_capacity; c++) {
+        atomic_init(&iwtjq->cells[c].sequence, c);
+        iwtjq->cells[c].job = NULL;
+        atomic_init(&iwtjq->cells[c].enqueue_time_ns, 0);
+    }
+    iwtjq->struct_id = ITHREAD_DATA_STRUCT_ID;
+    iwtjq->capacity = rounded_capacity;
+    iwtjq->mask = rounded_capacity - 1;
+    atomic_init(&iwtjq->enqueue_position, 0);
+    atomic_init(&iwtjq->dequeue_position, 0);
+    atomic_init(&iwtjq->overflow_count, 0);
+    iwtjq->overflow_head = iwtjq->overflow_tail = NULL;
+    pthread_mutex_init(&iwtjq->overflow_lock, NULL);
+    return iwtjq;
+}
+
+bool IWorkerThreadJobQueueIsValid(IWorkerThreadJobQueue * iwtjq)
+{
+    return iwtjq && iwtjq->struct_id == ITHREAD_DATA_STRUCT_ID;
+}
+
+/// @brief Adds a job to the back of the queue's ring.
+/// @return True if the job was added, false if the ring is full.
+static bool _IWorkerThreadJobQueueRingEnqueue(IWorkerThreadJobQueue * iwtjq, IWorkerThreadJob * iwtj)
+{
+    IWorkerThreadJobQueueCell * cell;
+    size_t position = atomic_load_explicit(&iwtjq->enqueue_position, memory_order_relaxed);
+    for (;;) {
+        cell = &iwtjq->cells[position & iwtjq->mask];
+        const size_t SEQUENCE = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        const intptr_t DIFFERENCE = (intptr_t) SEQUENCE - (intptr_t) position;
+        if (DIFFERENCE == 0) {
+            // The cell is free, so try to claim this position.  If another producer beats us to it, position is reloaded.
+            if (atomic_compare_exchange_weak(&iwtjq->enqueue_position, &position, position + 1)) break;
+        } else if (DIFFERENCE < 0) {
+            // The cell still holds a job from the previous lap, so the ring is full.
+            return false;
+        } else position = atomic_load_explicit(&iwtjq->enqueue_position, memory_order_relaxed);
+    }
+    // Store the job and publish it to consumers.  The enqueue time is copied into the cell so that consumers can see how long
+    // the front job has been waiting without touching the job itself.
+    cell->job = iwtj;
+    atomic_store_explicit(&cell->enqueue_time_ns, iwtj->enqueue_time_ns, memory_order_relaxed);
+    atomic_store_explicit(&cell->sequence, position + 1, memory_order_release);
+    return true;
+}
+
+/// @brief Adds jobs to the back of the queue's overflow list, for when the ring is full.
+static void _IWorkerThreadJobQueueOverflow(IWorkerThreadJobQueue * iwtjq, IWorkerThreadJob ** jobs, size_t jobs_count)
+{
+    if (jobs_count == 0) return;
+    for (size_t j = 0; j + 1 < jobs_count; j++) jobs[j]->next_job = jobs[j + 1];
+    jobs[jobs_count - 1]->next_job = NULL;
+    pthread_mutex_lock(&iwtjq->overflow_lock);
+    if (iwtjq->overflow_tail) iwtjq->overflow_tail->next_job = jobs[0];
+    else iwtjq->overflow_head = jobs[0];
+    iwtjq->overflow_tail = jobs[jobs_count - 1];
+    atomic_fetch_add_explicit(&iwtjq->overflow_count, jobs_count, memory_order_release);
+    pthread_mutex_unlock(&iwtjq->overflow_lock);
+}
+
+/// @brief Adds a job to the back of the queue.  Safe to call from any number of threads at once.  The job goes into the ring
+///         unless the ring is full or jobs are already waiting in the overflow list (which they have to leave first, to keep the
+///         queue in order).
+/// @param iwtjq Pointer to job queue data structure.
+/// @param iwtj Pointer to the job to add.
+/// @return True if the job was added, false if either pointer is invalid.
+bool IWorkerThreadJobQueueEnqueue(IWorkerThreadJobQueue * iwtjq, IWorkerThreadJob * iwtj)
+{
+    if (!IWorkerThreadJobQueueIsValid(iwtjq) || !iwtj) return false;
+    if (atomic_load_explicit(&iwtjq->overflow_count, memory_order_acquire) == 0 && _IWorkerThreadJobQueueRingEnqueue(iwtjq, iwtj)) return true;
+    _IWorkerThreadJobQueueOverflow(iwtjq, &iwtj, 1);
+    return true;
+}
+
+/// @brief Adds a batch of jobs to the back of the queue, claiming space in the ring for as many of them as possible with a single
+///         compare-and-swap.  Any that don't fit go on to the overflow list together.  Safe to call from any number of threads.
+/// @param iwtjq Pointer to job queue data structure.
+/// @param jobs Array of pointers to the jobs to add.
+/// @param jobs_count Number of jobs in the array.
+/// @return Number of jobs added: jobs_count, or 0 if either pointer is invalid.
+size_t IWorkerThreadJobQueueEnqueueBatch(IWorkerThreadJobQueue * iwtjq, IWorkerThreadJob ** jobs, size_t jobs_count)
+{
+    if (!IWorkerThreadJobQueueIsValid(iwtjq) || !jobs) return 0;
+    size_t jobs_enqueued = 0;
+    while (jobs_enqueued < jobs_count && atomic_load_explicit(&iwtjq->overflow_count, memory_order_acquire) == 0) {
+        size_t position = atomic_load_explicit(&iwtjq->enqueue_position, memory_order_relaxed);
+        // Count how many consecutive cells from this position are free.  A free cell can only be filled by a producer that owns
+        // its position, so the cells stay free until someone moves enqueue_position past them.
+        size_t free_cells = 0;
+        const size_t REQUIRED_CELLS = jobs_count - jobs_enqueued;
+        while (free_cells < REQUIRED_CELLS && free_cells <= iwtjq->mask) {
+            IWorkerThreadJobQueueCell * cell = &iwtjq->cells[(position + free_cells) & iwtjq->mask];
+            if (atomic_load_explicit(&cell->sequence, memory_order_acquire) != position + free_cells) break;
+            free_cells++;
+        }
+        if (free_cells == 0) {
+            // Either the ring is full, or another producer has moved on and our position is stale.
+            IWorkerThreadJobQueueCell * cell = &iwtjq->cells[position & iwtjq->mask];
+            const intptr_t DIFFERENCE = (intptr_t) atomic_load_explicit(&cell->sequence, memory_order_acquire) - (intptr_t) position;
+            if (DIFFERENCE < 0) break;
+            continue;
+        }
+        if (!atomic_compare_exchange_weak(&iwtjq->enqueue_position, &position, position + free_cells)) continue;
+        // The cells are ours, so fill them in and publish each one.
+        for (size_t c = 0; c < free_cells; c++) {
+            IWorkerThreadJobQueueCell * cell = &iwtjq->cells[(position + c) & iwtjq->mask];
+            IWorkerThreadJob * iwtj = jobs[jobs_enqueued + c];
+            cell->job = iwtj;
+            atomic_store_explicit(&cell->enqueue_time_ns, iwtj->enqueue_time_ns, memory_order_relaxed);
+            atomic_store_explicit(&cell->sequence, position + c + 1, memory_order_release);
+        }
+        jobs_enqueued += free_cells;
+    }
+    _IWorkerThreadJobQueueOverflow(iwtjq, &jobs[jobs_enqueued], jobs_count - jobs_enqueued);
+    return jobs_count;
+}
+
+/// @brief Removes the job at the front of the queue's ring.
+/// @return Pointer to the job or NULL if the ring is empty.
+static IWorkerThreadJob * _IWorkerThreadJobQueueRingDequeue(IWorkerThreadJobQueue * iwtjq)
+{
+    IWorkerThreadJobQueueCell * cell;
+    size_t position = atomic_load_explicit(&iwtjq->dequeue_position, memory_order_relaxed);
+    for (;;) {
+        cell = &iwtjq->cells[position & iwtjq->mask];
+        const size_t SEQUENCE = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        const intptr_t DIFFERENCE = (intptr_t) SEQUENCE - (intptr_t) (position + 1);
+        if (DIFFERENCE == 0) {
+            // The cell holds a published job, so try to claim it.  If another consumer beats us to it, position is reloaded.
+            if (atomic_compare_exchange_weak(&iwtjq->dequeue_position, &position, position + 1)) break;
+        } else if (DIFFERENCE < 0) {
+            // Nothing has been published at this position yet, so the ring is empty.
+            return NULL;
+        } else position = atomic_load_explicit(&iwtjq->dequeue_position, memory_order_relaxed);
+    }
+    // Take the job and mark the cell as free for the producer one lap ahead.
+    IWorkerThreadJob * iwtj = cell->job;
+    atomic_store_explicit(&cell->sequence, position + iwtjq->mask + 1, memory_order_release);
+    return iwtj;
+}
+
+/// @brief Removes the job at the front of the queue.  Safe to call from any number of threads at once.  Once the ring is empty,
+///         the oldest job in the overflow list is taken, and as many of the jobs behind it as fit are moved up into the ring, so
+///         that a backlog drains through the ring rather than one lock at a time.
+/// @param iwtjq Pointer to job queue data structure.
+/// @return Pointer to the job or NULL if the queue is empty.
+IWorkerThreadJob * IWorkerThreadJobQueueDequeue(IWorkerThreadJobQueue * iwtjq)
+{
+    if (!IWorkerThreadJobQueueIsValid(iwtjq)) return NULL;
+    IWorkerThreadJob * iwtj = _IWorkerThreadJobQueueRingDequeue(iwtjq);
+    if (iwtj || atomic_load_explicit(&iwtjq->overflow_count, memory_order_acquire) == 0) return iwtj;
+    pthread_mutex_lock(&iwtjq->overflow_lock);
+    // Another consumer may have moved the overflow into the ring while we waited for the lock.
+    iwtj = _IWorkerThreadJobQueueRingDequeue(iwtjq);
+    if (!iwtj && iwtjq->overflow_head) {
+        iwtj = iwtjq->overflow_head;
+        atomic_fetch_sub_explicit(&iwtjq->overflow_count, 1, memory_order_release);
+        IWorkerThreadJob * next = iwtj->next_job;
+        // Each job leaves the overflow count before it is claimed in the ring, so GetCount never sees it in both.  The link to
+        // the job behind it is read first too, as a published job can be taken (and freed) by another consumer straight away.
+        while (next) {
+            IWorkerThreadJob * after = next->next_job;
+            next->next_job = NULL;
+            atomic_fetch_sub_explicit(&iwtjq->overflow_count, 1, memory_order_release);
+            if (!_IWorkerThreadJobQueueRingEnqueue(iwtjq, next)) {
+                // The ring is full, so the job stays at the head of the overflow list.
+                next->next_job = after;
+                atomic_fetch_add_explicit(&iwtjq->overflow_count, 1, memory_order_release);
+                break;
+            }
+            next = after;
+        }
+        iwtjq->overflow_head = next;
+        if (!next) iwtjq->overflow_tail = NULL;
+        iwtj->next_job = NULL;
+    }
+    pthread_mutex_unlock(&iwtjq->overflow_lock);
+    return iwtj;
+}
+
+/// @brief Gets the time the job at the front of the queue was enqueued, without removing it.  Another consumer may take the job
+///         at any moment, so the value is only a hint (it is used to age waiting jobs).
+/// @param iwtjq Pointer to job queue data structure.
+/// @param enqueue_time_ns Pointer to where the enqueue time (see IThreadGetTimeNs()) of the front job is written.
+/// @return True if the queue had a published job at the front, false if it appeared empty.
+bool IWorkerThreadJobQueuePeekEnqueueTime(IWorkerThreadJobQueue * iwtjq, uint64_t * enqueue_time_ns)
+{
+    if (!IWorkerThreadJobQueueIsValid(iwtjq) || !enqueue_time_ns) return false;
+    const size_t POSITION = atomic_load_explicit(&iwtjq->dequeue_position, memory_order_relaxed);
+    IWorkerThreadJobQueueCell * cell = &iwtjq->cells[POSITION & iwtjq->mask];
+    if (atomic_load_explicit(&cell->sequence, memory_order_acquire) == POSITION + 1) {
+        *enqueue_time_ns = atomic_load_explicit(&cell->enqueue_time_ns, memory_order_relaxed);
+        return true;
+    }
+    if (atomic_load_explicit(&iwtjq->overflow_count, memory_order_acquire) == 0) return false;
+    pthread_mutex_lock(&iwtjq->overflow_lock);
+    const bool FOUND = iwtjq->overflow_head != NULL;
+    if (FOUND) *enqueue_time_ns = iwtjq->overflow_head->enqueue_time_ns;
+    pthread_mutex_unlock(&iwtjq->overflow_lock);
+    return FOUND;
+}
+
+/// @brief Gets the number of jobs in the queue.  Jobs that have been claimed by a producer but not yet published are included, so
+///         this value is only approximate while producers and consumers are active.
+/// @param iwtjq Pointer to job queue data structure.
+/// @return Number of jobs in the queue (or 0 if the pointer is invalid).
+size_t IWorkerThreadJobQueueGetCount(IWorkerThreadJobQueue * iwtjq)
+{
+    if (!IWorkerThreadJobQueueIsValid(iwtjq)) return 0;
+    const size_t DEQUEUE_POSITION = atomic_load(&iwtjq->dequeue_position);
+    const size_t ENQUEUE_POSITION = atomic_load(&iwtjq->enqueue_position);
+    const size_t OVERFLOW_COUNT = atomic_load_explicit(&iwtjq->overflow_count, memory_order_relaxed);
+    return (ENQUEUE_POSITION > DEQUEUE_POSITION ? ENQUEUE_POSITION - DEQUEUE_POSITION : 0) + OVERFLOW_COUNT;
+}
+
+/// @brief Frees the memory used by the queue.  Any jobs still held in the queue (in the ring or the overflow list) are not freed.
+/// @param iwtjq Pointer to job queue data structure.
+/// @return True if the pointer referenced a valid job queue, false otherwise.
+bool IWorkerThreadJobQueueFree(IWorkerThreadJobQueue * iwtjq)
+{
+    if (!IWorkerThreadJobQueueIsValid(iwtjq)) return false;
+    free(iwtjq->cells);
+    iwtjq->cells = NULL;
+    iwtjq->capacity = iwtjq->mask = 0;
+    iwtjq->overflow_head = iwtjq->overflow_tail = NULL;
+    pthread_mutex_destroy(&iwtjq->overflow_lock);
+    iwtjq->struct_id = 0;
+    free(iwtjq);
+    return true;
+}
@@ -0,0 +1,80 @@
+#include <string.h>
+
+#include "iworkerthreadjob.h"
+#include "iworkerthreadnamedqueue.h"
+
+/// @brief Creates a named job queue, one of several that share a controller's worker threads in proportion to their weights (see
+///         IWorkerThreadJobProviderAddNamedQueue()).  Typically there is one per tenant or class of work.
+/// @param name Name of the queue (copied, up to ITHREAD_NAMED_QUEUE_NAME_LENGTH - 1 characters).
+/// @param weight Share of the worker threads' throughput relative to the other named queues (at least 1).
+/// @return Pointer to named queue data structure, or NULL if memory could not be reserved for it.
+IWorkerThreadNamedQueue * IWorkerThreadNamedQueueCreate(const char * name, unsigned int weight)
+{
+    if (!name) return NULL;
+    IWorkerThreadNamedQueue * iwtnq = (IWorkerThreadNamedQueue *) malloc(sizeof(IWorkerThreadNamedQueue));
+    if (!iwtnq) return NULL;
+    iwtnq->queue = IWorkerThreadJobQueueCreate(ITHREAD_DEFAULT_JOB_QUEUE_CAPACITY);
+    iwtnq->wait_time_histogram = IThreadHistogramCreate();
+    if (!iwtnq->queue || !iwtnq->wait_time_histogram) {
+        IWorkerThreadJobQueueFree(iwtnq->queue);
+        IThreadHistogramFree(iwtnq->wait_time_histogram);
+        free(iwtnq);
+        return NULL;
+    }
+    iwtnq->struct_id = ITHREAD_DATA_STRUCT_ID;
+    strncpy(iwtnq->name, name, ITHREAD_NAMED_QUEUE_NAME_LENGTH - 1);
+    iwtnq->name[ITHREAD_NAMED_QUEUE_NAME_LENGTH - 1] = 0;
+    atomic_init(&iwtnq->weight, 1);
+    atomic_init(&iwtnq->stride, ITHREAD_NAMED_QUEUE_STRIDE_SCALE);
+    atomic_init(&iwtnq->pass, 0);
+    atomic_init(&iwtnq->enqueued_count, 0);
+    atomic_init(&iwtnq->dequeued_count, 0);
+    IWorkerThreadNamedQueueSetWeight(iwtnq, weight);
+    return iwtnq;
+}
+
+bool IWorkerThreadNamedQueueIsValid(IWorkerThreadNamedQueue * iwtnq)
+{
+    return iwtnq && iwtnq->struct_id == ITHREAD_DATA_STRUCT_ID;
+}
+
+/// @brief Changes a named queue's weight.  Takes effect from the next job taken from the queue.
+/// @param iwtnq Pointer to named queue data structure.
+/// @param weight Share of the worker threads' throughput relative to the other named queues (1 to ITHREAD_NAMED_QUEUE_MAX_WEIGHT).
+void IWorkerThreadNamedQueueSetWeight(IWorkerThreadNamedQueue * iwtnq, unsigned int weight)
+{
+    if (!IWorkerThreadNamedQueueIsValid(iwtnq)) return;
+    if (weight < 1) weight = 1;
+    if (weight > ITHREAD_NAMED_QUEUE_MAX_WEIGHT) weight = ITHREAD_NAMED_QUEUE_MAX_WEIGHT;
+    atomic_store_explicit(&iwtnq->weight, weight, memory_order_relaxed);
+    atomic_store_explicit(&iwtnq->stride, ITHREAD_NAMED_QUEUE_STRIDE_SCALE / weight, memory_order_relaxed);
+}
+
+unsigned int IWorkerThreadNamedQueueGetWeight(IWorkerThreadNamedQueue * iwtnq)
+{
+    return IWorkerThreadNamedQueueIsValid(iwtnq) ? atomic_load_explicit(&iwtnq->weight, memory_order_relaxed) : 0;
+}
+
+const char * IWorkerThreadNamedQueueGetName(IWorkerThreadNamedQueue * iwtnq)
+{
+    return IWorkerThreadNamedQueueIsValid(iwtnq) ? iwtnq->name : NULL;
+}
+
+/// @brief Gets the number of jobs waiting in a named queue.
+size_t IWorkerThreadNamedQueueGetDepth(IWorkerThreadNamedQueue * iwtnq)
+{
+    return IWorkerThreadNamedQueueIsValid(iwtnq) ? IWorkerThreadJobQueueGetCount(iwtnq->queue) : 0;
+}
+
+/// @brief Frees a named queue, along with any jobs still waiting in it.
+bool IWorkerThreadNamedQueueFree(IWorkerThreadNamedQueue * iwtnq)
+{
+    if (!IWorkerThreadNamedQueueIsValid(iwtnq)) return false;
+    IWorkerThreadJob * iwtj;
+    while ((iwtj = IWorkerThreadJobQueueDequeue(iwtnq->queue))) IWorkerThreadJobFree(iwtj);
+    IWorkerThreadJobQueueFree(iwtnq->queue);
+    IThreadHistogramFree(iwtnq->wait_time_histogram);
+    iwtnq->struct_id = 0;
+    free(iwtnq);
+    return true;
+}
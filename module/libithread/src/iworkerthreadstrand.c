@@ -0,0 +1,130 @@
+#include "iworkerthreadjob.h"
+#include "iworkerthreadstrand.h"
+
+/// @brief Creates a set of strands, which run jobs that share a key one at a time, in the order they were added, while jobs with
+///         different keys run in parallel (see IWorkerThreadControllerAddKeyedJob()).  Rather than a strand per key, keys are
+///         hashed on to a fixed number of strands, so there is nothing to look up or lock and no per-key memory to manage.
+/// @param strands_count Number of strands, rounded up to a power of 2 (ITHREAD_STRAND_COUNT if 0).
+/// @return Pointer to strand set data structure, or NULL if memory could not be reserved for it.
+IWorkerThreadStrandSet * IWorkerThreadStrandSetCreate(size_t strands_count)
+{
+    size_t count = 1;
+    while (count < (strands_count ? strands_count : ITHREAD_STRAND_COUNT)) count <<= 1;
+    IWorkerThreadStrandSet * iwtss = (IWorkerThreadStrandSet *) malloc(sizeof(IWorkerThreadStrandSet));
+    if (!iwtss) return NULL;
+    iwtss->strands = (IWorkerThreadStrand *) aligned_alloc(ITHREAD_CACHE_LINE_SIZE, sizeof(IWorkerThreadStrand) * count);
+    if (!iwtss->strands) {
+        free(iwtss);
+        return NULL;
+    }
+    for (size_t s = 0; s < count; s++) {
+        atomic_init(&iwtss->strands[s].inbox, NULL);
+        iwtss->strands[s].head = NULL;
+        atomic_init(&iwtss->strands[s].count, 0);
+    }
+    iwtss->struct_id = ITHREAD_DATA_STRUCT_ID;
+    iwtss->strands_count = count;
+    return iwtss;
+}
+
+bool IWorkerThreadStrandSetIsValid(IWorkerThreadStrandSet * iwtss)
+{
+    return iwtss && iwtss->struct_id == ITHREAD_DATA_STRUCT_ID;
+}
+
+/// @brief Gets the strand for a key.  Keys are mixed first, so that sequential ids are spread evenly over the strands.
+/// @param iwtss Pointer to strand set data structure.
+/// @param key Key the job is ordered by (e.g. a user or form id).
+/// @return Pointer to the key's strand, or NULL if the set is invalid.
+IWorkerThreadStrand * IWorkerThreadStrandSetGetStrand(IWorkerThreadStrandSet * iwtss, uint64_t key)
+{
+    if (!IWorkerThreadStrandSetIsValid(iwtss)) return NULL;
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ULL;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebULL;
+    key ^= key >> 31;
+    return &iwtss->strands[key & (iwtss->strands_count - 1)];
+}
+
+/// @brief Gets the number of keyed jobs that have been added but not finished, including those running or queued to run.
+size_t IWorkerThreadStrandSetGetPendingCount(IWorkerThreadStrandSet * iwtss)
+{
+    if (!IWorkerThreadStrandSetIsValid(iwtss)) return 0;
+    size_t pending = 0;
+    for (size_t s = 0; s < iwtss->strands_count; s++) pending += atomic_load_explicit(&iwtss->strands[s].count, memory_order_relaxed);
+    return pending;
+}
+
+/// @brief Frees a strand set, along with any jobs still waiting in its strands.  Jobs that were handed on to the job queues belong
+///         to them.
+void IWorkerThreadStrandSetFree(IWorkerThreadStrandSet * iwtss)
+{
+    if (!IWorkerThreadStrandSetIsValid(iwtss)) return;
+    for (size_t s = 0; s < iwtss->strands_count; s++) {
+        IWorkerThreadStrand * iwts = &iwtss->strands[s];
+        IWorkerThreadJob * iwtj = iwts->head;
+        while (iwtj) {
+            IWorkerThreadJob * next = iwtj->next_job;
+            IWorkerThreadJobFree(iwtj);
+            iwtj = next;
+        }
+        iwtj = atomic_exchange(&iwts->inbox, NULL);
+        while (iwtj) {
+            IWorkerThreadJob * next = iwtj->next_job;
+            IWorkerThreadJobFree(iwtj);
+            iwtj = next;
+        }
+    }
+    free(iwtss->strands);
+    iwtss->struct_id = 0;
+    free(iwtss);
+}
+
+/// @brief Adds a job to the end of a strand.  Can be called by any number of threads at once.  The strand is held by whoever has
+///         a job of it running: if the strand was idle, the caller now holds it and must take the job with IWorkerThreadStrandPop()
+///         and run it.  Otherwise the job waits for the jobs ahead of it.
+/// @param iwts Pointer to strand data structure.
+/// @param iwtj Pointer to a job that is in no other queue.
+/// @return True if the caller now holds the strand, false if the job is waiting.
+bool IWorkerThreadStrandPush(IWorkerThreadStrand * iwts, IWorkerThreadJob * iwtj)
+{
+    IWorkerThreadJob * head = atomic_load_explicit(&iwts->inbox, memory_order_relaxed);
+    do iwtj->next_job = head;
+    while (!atomic_compare_exchange_weak_explicit(&iwts->inbox, &head, iwtj, memory_order_release, memory_order_relaxed));
+    // The job is counted only once it is in the inbox, so a holder that sees the count never looks for a job that isn't there yet.
+    return atomic_fetch_add_explicit(&iwts->count, 1, memory_order_acq_rel) == 0;
+}
+
+/// @brief Takes the oldest job from a strand.  Must only be called by the thread holding the strand, which is the only one ever
+///         touching its head list.  When the head list runs out, the whole inbox is taken in one go and reversed (it is newest
+///         first) to refill it.
+/// @param iwts Pointer to strand data structure.
+/// @return Pointer to the job.
+IWorkerThreadJob * IWorkerThreadStrandPop(IWorkerThreadStrand * iwts)
+{
+    if (!iwts->head) {
+        IWorkerThreadJob * iwtj = atomic_exchange_explicit(&iwts->inbox, NULL, memory_order_acquire);
+        while (iwtj) {
+            IWorkerThreadJob * next = iwtj->next_job;
+            iwtj->next_job = iwts->head;
+            iwts->head = iwtj;
+            iwtj = next;
+        }
+    }
+    IWorkerThreadJob * iwtj = iwts->head;
+    if (iwtj) {
+        iwts->head = iwtj->next_job;
+        iwtj->next_job = NULL;
+    }
+    return iwtj;
+}
+
+/// @brief Called by the thread holding a strand once the strand's running job has finished.
+/// @param iwts Pointer to strand data structure.
+/// @return True if more jobs are waiting, in which case the caller still holds the strand and must take the next job with
+///         IWorkerThreadStrandPop() and run it.  False if the strand is now idle.
+bool IWorkerThreadStrandRelease(IWorkerThreadStrand * iwts)
+{
+    return atomic_fetch_sub_explicit(&iwts->count, 1, memory_order_acq_rel) > 1;
+}
@@ -0,0 +1,49 @@
+#include "ithread.h"
+#include "ithreadtest.h"
+
+#define TEST_DEADLINES 10000
+
+/// @brief Deadlines come out earliest first, whatever order they went in, with their data, and the heap grows as needed.
+static void TestDeadlineHeapOrder()
+{
+    IThreadDeadlineHeap * itdh = IThreadDeadlineHeapCreate();
+    ITHREAD_TEST_CHECK(IThreadDeadlineHeapIsValid(itdh));
+    IThreadDeadline deadline;
+    ITHREAD_TEST_CHECK(IThreadDeadlineHeapPeek(itdh) == UINT64_MAX);
+    ITHREAD_TEST_CHECK(!IThreadDeadlineHeapPop(itdh, &deadline));
+
+    // A fixed pseudo-random sequence, with repeats.
+    uint64_t state = 12345;
+    for (size_t d = 0; d < TEST_DEADLINES; d++) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        const uint64_t DEADLINE = (state >> 33) % (TEST_DEADLINES / 2);
+        ITHREAD_TEST_CHECK(IThreadDeadlineHeapPush(itdh, DEADLINE, (void *) (DEADLINE + 1)));
+    }
+    ITHREAD_TEST_CHECK(IThreadDeadlineHeapGetCount(itdh) == TEST_DEADLINES);
+
+    uint64_t previous = 0;
+    for (size_t d = 0; d < TEST_DEADLINES; d++) {
+        const uint64_t EARLIEST = IThreadDeadlineHeapPeek(itdh);
+        ITHREAD_TEST_CHECK(IThreadDeadlineHeapPop(itdh, &deadline));
+        ITHREAD_TEST_CHECK(deadline.deadline_ns == EARLIEST);
+        ITHREAD_TEST_CHECK(deadline.deadline_ns >= previous);
+        ITHREAD_TEST_CHECK(deadline.data == (void *) (deadline.deadline_ns + 1));
+        previous = deadline.deadline_ns;
+    }
+    ITHREAD_TEST_CHECK(IThreadDeadlineHeapGetCount(itdh) == 0);
+    ITHREAD_TEST_CHECK(!IThreadDeadlineHeapPop(itdh, &deadline));
+
+    // Pushes and pops can be mixed.
+    IThreadDeadlineHeapPush(itdh, 30, NULL);
+    IThreadDeadlineHeapPush(itdh, 10, NULL);
+    ITHREAD_TEST_CHECK(IThreadDeadlineHeapPop(itdh, &deadline) && deadline.deadline_ns == 10);
+    IThreadDeadlineHeapPush(itdh, 20, NULL);
+    ITHREAD_TEST_CHECK(IThreadDeadlineHeapPeek(itdh) == 20);
+    IThreadDeadlineHeapFree(itdh);
+}
+
+int main()
+{
+    ITHREAD_TEST_RUN(TestDeadlineHeapOrder);
+    ITHREAD_TEST_EXIT();
+}
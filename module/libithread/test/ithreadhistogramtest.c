@@ -0,0 +1,76 @@
+#include <pthread.h>
+
+#include "ithread.h"
+#include "ithreadtest.h"
+
+#define TEST_VALUES 100000
+#define TEST_THREADS 4
+
+/// @brief Checks that a percentile is never below the true value and no more than ~3% above it.
+static void TestHistogramCheckPercentile(IThreadHistogram * ith, double percentile, uint64_t expected)
+{
+    const uint64_t VALUE = IThreadHistogramGetPercentile(ith, percentile);
+    ITHREAD_TEST_CHECK(VALUE >= expected);
+    ITHREAD_TEST_CHECK(VALUE <= expected + expected * 3 / 100 + 1);
+}
+
+/// @brief Percentiles of 1..TEST_VALUES are within the histogram's precision, and the count, mean, minimum and maximum are exact.
+static void TestHistogramPercentiles()
+{
+    IThreadHistogram * ith = IThreadHistogramCreate();
+    ITHREAD_TEST_CHECK(IThreadHistogramIsValid(ith));
+    ITHREAD_TEST_CHECK(IThreadHistogramGetCount(ith) == 0);
+    ITHREAD_TEST_CHECK(IThreadHistogramGetPercentile(ith, 50.0) == 0);
+
+    for (uint64_t v = 1; v <= TEST_VALUES; v++) IThreadHistogramRecord(ith, v);
+    ITHREAD_TEST_CHECK(IThreadHistogramGetCount(ith) == TEST_VALUES);
+    ITHREAD_TEST_CHECK(IThreadHistogramGetMin(ith) == 1);
+    ITHREAD_TEST_CHECK(IThreadHistogramGetMax(ith) == TEST_VALUES);
+    ITHREAD_TEST_CHECK(IThreadHistogramGetMean(ith) == (TEST_VALUES + 1) / 2);
+    TestHistogramCheckPercentile(ith, 50.0, TEST_VALUES / 2);
+    TestHistogramCheckPercentile(ith, 99.0, TEST_VALUES * 99 / 100);
+    TestHistogramCheckPercentile(ith, 99.9, TEST_VALUES * 999 / 1000);
+
+    // Small values are counted exactly.
+    IThreadHistogramReset(ith);
+    ITHREAD_TEST_CHECK(IThreadHistogramGetCount(ith) == 0);
+    for (int r = 0; r < 10; r++) IThreadHistogramRecord(ith, 7);
+    ITHREAD_TEST_CHECK(IThreadHistogramGetPercentile(ith, 50.0) == 7);
+    ITHREAD_TEST_CHECK(IThreadHistogramGetMin(ith) == 7 && IThreadHistogramGetMax(ith) == 7);
+    IThreadHistogramFree(ith);
+}
+
+static void * TestHistogramRecord(void * data)
+{
+    for (uint64_t v = 1; v <= TEST_VALUES; v++) IThreadHistogramRecordConcurrent((IThreadHistogram *) data, v);
+    return NULL;
+}
+
+/// @brief Values recorded by several threads at once into one histogram are all counted, and merging histograms adds them up.
+static void TestHistogramConcurrent()
+{
+    IThreadHistogram * ith = IThreadHistogramCreate();
+    pthread_t handles[TEST_THREADS];
+    for (int t = 0; t < TEST_THREADS; t++) pthread_create(&handles[t], NULL, TestHistogramRecord, ith);
+    for (int t = 0; t < TEST_THREADS; t++) pthread_join(handles[t], NULL);
+    ITHREAD_TEST_CHECK(IThreadHistogramGetCount(ith) == TEST_THREADS * TEST_VALUES);
+    ITHREAD_TEST_CHECK(IThreadHistogramGetMean(ith) == (TEST_VALUES + 1) / 2);
+    TestHistogramCheckPercentile(ith, 50.0, TEST_VALUES / 2);
+
+    IThreadHistogram * total = IThreadHistogramCreate();
+    IThreadHistogramRecord(total, 2 * TEST_VALUES);
+    ITHREAD_TEST_CHECK(IThreadHistogramMerge(total, ith));
+    ITHREAD_TEST_CHECK(IThreadHistogramGetCount(total) == TEST_THREADS * TEST_VALUES + 1);
+    ITHREAD_TEST_CHECK(IThreadHistogramGetMin(total) == 1);
+    ITHREAD_TEST_CHECK(IThreadHistogramGetMax(total) == 2 * TEST_VALUES);
+    TestHistogramCheckPercentile(total, 50.0, TEST_VALUES / 2);
+    IThreadHistogramFree(total);
+    IThreadHistogramFree(ith);
+}
+
+int main()
+{
+    ITHREAD_TEST_RUN(TestHistogramPercentiles);
+    ITHREAD_TEST_RUN(TestHistogramConcurrent);
+    ITHREAD_TEST_EXIT();
+}
@@ -0,0 +1,124 @@
+#include "ithread.h"
+#include "ithreadtest.h"
+
+#define TEST_WORKERS 4
+#define TEST_ITERATIONS 1000000
+#define TEST_GRAIN 256
+#define TEST_NESTED_JOBS 8
+
+typedef struct _test_parallel_data {
+    atomic_int * seen;
+    atomic_int calls;
+} TestParallelData;
+
+static IWorkerThreadController * test_parallel_controller;
+
+static void TestParallelMark(size_t begin, size_t end, void * context)
+{
+    TestParallelData * tpd = (TestParallelData *) context;
+    atomic_fetch_add(&tpd->calls, 1);
+    for (size_t i = begin; i < end; i++) atomic_fetch_add(&tpd->seen[i], 1);
+}
+
+static void TestParallelSum(size_t begin, size_t end, void * partial, void * context)
+{
+    uint64_t sum = 0;
+    for (size_t i = begin; i < end; i++) sum += i;
+    *(uint64_t *) partial += sum;
+}
+
+static void TestParallelCombine(void * result, const void * partial, void * context)
+{
+    *(uint64_t *) result += *(const uint64_t *) partial;
+}
+
+/// @brief Worker function for controllers that only run parallel loops' helper jobs (which bring their own function).
+static void TestParallelIdleJob(IWorkerThreadJob * iwtj)
+{
+}
+
+/// @brief Worker function that runs a reduction of its own, so parallel loops are started from inside worker threads.
+static void TestParallelNestedJob(IWorkerThreadJob * iwtj)
+{
+    const uint64_t IDENTITY = 0;
+    uint64_t sum = 1;
+    IThreadParallelReduce(test_parallel_controller, 0, TEST_ITERATIONS, TEST_GRAIN, TestParallelSum, TestParallelCombine, &IDENTITY,
+                          &sum, sizeof(sum), NULL);
+    IWorkerThreadJobSetResult(iwtj, (void *) sum);
+}
+
+/// @brief Checks that a loop over 0..TEST_ITERATIONS - 1 called the function exactly once for every index.
+static void TestParallelCheckFor(IWorkerThreadController * iwtc)
+{
+    static atomic_int seen[TEST_ITERATIONS];
+    for (size_t i = 0; i < TEST_ITERATIONS; i++) atomic_init(&seen[i], 0);
+    TestParallelData data = { .seen = seen };
+    ITHREAD_TEST_CHECK(IThreadParallelFor(iwtc, 0, TEST_ITERATIONS, TEST_GRAIN, TestParallelMark, &data));
+    size_t once = 0;
+    for (size_t i = 0; i < TEST_ITERATIONS; i++) if (atomic_load(&seen[i]) == 1) once++;
+    ITHREAD_TEST_CHECK(once == TEST_ITERATIONS);
+    // Chunks are handed out rather than single indices.
+    ITHREAD_TEST_CHECK(atomic_load(&data.calls) <= TEST_ITERATIONS / TEST_GRAIN);
+}
+
+/// @brief Checks that a reduction over 0..TEST_ITERATIONS - 1 sums it, overwriting whatever was in the result.
+static void TestParallelCheckReduce(IWorkerThreadController * iwtc)
+{
+    const uint64_t IDENTITY = 0;
+    uint64_t sum = 1;
+    ITHREAD_TEST_CHECK(IThreadParallelReduce(iwtc, 0, TEST_ITERATIONS, TEST_GRAIN, TestParallelSum, TestParallelCombine, &IDENTITY, &sum,
+                                             sizeof(sum), NULL));
+    ITHREAD_TEST_CHECK(sum == (uint64_t) TEST_ITERATIONS * (TEST_ITERATIONS - 1) / 2);
+}
+
+/// @brief Loops run every index once and reductions give the exact result, both when the calling thread does all of the work
+///         (the controller isn't running) and when it is shared with the worker threads.  Empty ranges are fine.
+static void TestParallelLoops()
+{
+    IWorkerThreadController * iwtc = IWorkerThreadControllerCreate();
+    TestParallelCheckFor(iwtc);
+    TestParallelCheckReduce(iwtc);
+
+    for (int w = 0; w < TEST_WORKERS; w++) IWorkerThreadControllerAddWorkerThread(iwtc, TestParallelIdleJob, NULL, NULL, IThreadTimeoutNone);
+    ITHREAD_TEST_CHECK(IWorkerThreadControllerStart(iwtc));
+    for (int r = 0; r < 10; r++) {
+        TestParallelCheckFor(iwtc);
+        TestParallelCheckReduce(iwtc);
+    }
+    TestParallelData data = { .seen = NULL };
+    ITHREAD_TEST_CHECK(IThreadParallelFor(iwtc, 5, 5, 1, TestParallelMark, &data));
+    ITHREAD_TEST_CHECK(atomic_load(&data.calls) == 0);
+
+    IWorkerThreadControllerStop(iwtc);
+    IWorkerThreadControllerFree(iwtc);
+}
+
+/// @brief Worker threads can run parallel loops themselves, even with every worker doing so at once, without deadlocking.
+static void TestParallelNested()
+{
+    test_parallel_controller = IWorkerThreadControllerCreate();
+    for (int w = 0; w < TEST_WORKERS - 1; w++) {
+        IWorkerThreadControllerAddWorkerThread(test_parallel_controller, TestParallelNestedJob, NULL, NULL, IThreadTimeoutNone);
+    }
+    ITHREAD_TEST_CHECK(IWorkerThreadControllerStart(test_parallel_controller));
+
+    IWorkerThreadJobFuture * futures[TEST_NESTED_JOBS];
+    for (int f = 0; f < TEST_NESTED_JOBS; f++) {
+        futures[f] = IWorkerThreadControllerSubmitJob(test_parallel_controller, &futures[f], IThreadPriorityNormal);
+    }
+    for (int f = 0; f < TEST_NESTED_JOBS; f++) {
+        ITHREAD_TEST_CHECK(IWorkerThreadJobFutureWait(futures[f]));
+        ITHREAD_TEST_CHECK(IWorkerThreadJobFutureGetResult(futures[f]) == (void *) ((uint64_t) TEST_ITERATIONS * (TEST_ITERATIONS - 1) / 2));
+        IWorkerThreadJobFutureFree(futures[f]);
+    }
+
+    IWorkerThreadControllerStop(test_parallel_controller);
+    IWorkerThreadControllerFree(test_parallel_controller);
+}
+
+int main()
+{
+    ITHREAD_TEST_RUN(TestParallelLoops);
+    ITHREAD_TEST_RUN(TestParallelNested);
+    ITHREAD_TEST_EXIT();
+}
@@ -0,0 +1,39 @@
+#ifndef COM_PLUS_MEVANSPN_ITHREAD_TEST
+#define COM_PLUS_MEVANSPN_ITHREAD_TEST
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+
+// How many checks have failed in this test program.  Checks may be made on any thread.
+static atomic_int ithread_test_failures;
+
+// Checks that a condition holds, reporting where it didn't.  The test program carries on, so one run reports every failure.
+#define ITHREAD_TEST_CHECK(condition) do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            atomic_fetch_add(&ithread_test_failures, 1); \
+        } \
+    } while (0)
+
+// Waits for a condition that other threads will make hold, checking it every millisecond, then checks it.  Gives up after
+// timeout_ms, so a test that goes wrong fails rather than hanging.  Needs IThreadSleep() from ithread.h.
+#define ITHREAD_TEST_WAIT_FOR(condition, timeout_ms) do { \
+        for (long _waited_ms = 0; !(condition) && _waited_ms < (timeout_ms); _waited_ms++) IThreadSleep(1); \
+        ITHREAD_TEST_CHECK(condition); \
+    } while (0)
+
+// Runs one test function, naming it on stdout.
+#define ITHREAD_TEST_RUN(test) do { \
+        printf("%s\n", #test); \
+        test(); \
+    } while (0)
+
+// Exits the test program, with EXIT_FAILURE if any check failed.
+#define ITHREAD_TEST_EXIT() do { \
+        const int FAILURES = atomic_load(&ithread_test_failures); \
+        if (FAILURES) fprintf(stderr, "%d check(s) failed\n", FAILURES); \
+        exit(FAILURES ? EXIT_FAILURE : EXIT_SUCCESS); \
+    } while (0)
+
+#endif
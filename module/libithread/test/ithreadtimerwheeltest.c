@@ -0,0 +1,112 @@
+#include "ithread.h"
+#include "ithreadtest.h"
+
+// One millisecond ticks and timers up to ~17 minutes out, so every level of the wheel is used.
+#define TEST_TICK_MS 1
+#define TEST_TICK_NS 1000000ULL
+#define TEST_START_NS 5000000000ULL
+#define TEST_TIMERS 5000
+#define TEST_SPAN_NS ((1ULL << 20) * TEST_TICK_NS)
+#define TEST_STEP_NS 7777777ULL
+#define TEST_PERIOD_NS (3 * TEST_TICK_NS)
+#define TEST_PERIODS 10
+
+typedef struct _test_timer_wheel_data {
+    IThreadTimerWheel * wheel;
+    uint64_t previous_ns;
+    uint64_t now_ns;
+    size_t expired;
+    int * fired;
+} TestTimerWheelData;
+
+static void TestTimerWheelExpired(IThreadTimer * itt, void * context)
+{
+    TestTimerWheelData * ttwd = (TestTimerWheelData *) context;
+    // Never early, and no later than the tick after the one the wheel was last advanced to.
+    ITHREAD_TEST_CHECK(itt->expiry_ns <= ttwd->now_ns);
+    ITHREAD_TEST_CHECK(itt->expiry_ns + TEST_TICK_NS > ttwd->previous_ns);
+    ttwd->fired[(size_t) itt->data]++;
+    ttwd->expired++;
+    if (itt->period_ns && ttwd->fired[(size_t) itt->data] < TEST_PERIODS) {
+        itt->expiry_ns += itt->period_ns;
+        IThreadTimerWheelAdd(ttwd->wheel, itt);
+    } else {
+        IThreadTimerFree(itt);
+    }
+}
+
+/// @brief Timers spread over every level of the wheel each fire exactly once, never before their expiry time and within a tick
+///         of the wheel being advanced past it.  A recurring timer added back by its expiry handler fires once per period.
+static void TestTimerWheelExpiry()
+{
+    IThreadTimerWheel * ittw = IThreadTimerWheelCreate(TEST_START_NS, TEST_TICK_MS);
+    ITHREAD_TEST_CHECK(IThreadTimerWheelIsValid(ittw));
+    ITHREAD_TEST_CHECK(IThreadTimerWheelGetNextExpiry(ittw) == UINT64_MAX);
+
+    static int fired[TEST_TIMERS + 1];
+    uint64_t state = 54321;
+    for (size_t t = 0; t < TEST_TIMERS; t++) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        ITHREAD_TEST_CHECK(IThreadTimerWheelAdd(ittw, IThreadTimerCreate((void *) t, TEST_START_NS + (state >> 20) % TEST_SPAN_NS, 0)));
+    }
+    ITHREAD_TEST_CHECK(IThreadTimerWheelAdd(ittw, IThreadTimerCreate((void *) TEST_TIMERS, TEST_START_NS, TEST_PERIOD_NS)));
+    ITHREAD_TEST_CHECK(IThreadTimerWheelGetCount(ittw) == TEST_TIMERS + 1);
+
+    TestTimerWheelData data = { .wheel = ittw, .previous_ns = TEST_START_NS, .fired = fired };
+    for (uint64_t now = TEST_START_NS; now <= TEST_START_NS + TEST_SPAN_NS + TEST_STEP_NS; now += TEST_STEP_NS) {
+        data.now_ns = now;
+        // Nothing is due before the time the wheel was last advanced to.
+        ITHREAD_TEST_CHECK(IThreadTimerWheelGetNextExpiry(ittw) > data.previous_ns - TEST_TICK_NS);
+        IThreadTimerWheelAdvance(ittw, now, TestTimerWheelExpired, &data);
+        data.previous_ns = now;
+    }
+    ITHREAD_TEST_CHECK(data.expired == TEST_TIMERS + TEST_PERIODS);
+    ITHREAD_TEST_CHECK(IThreadTimerWheelGetCount(ittw) == 0);
+    size_t once = 0;
+    for (size_t t = 0; t < TEST_TIMERS; t++) if (fired[t] == 1) once++;
+    ITHREAD_TEST_CHECK(once == TEST_TIMERS);
+    ITHREAD_TEST_CHECK(fired[TEST_TIMERS] == TEST_PERIODS);
+    IThreadTimerWheelFree(ittw);
+}
+
+static void TestTimerWheelDiscard(IThreadTimer * itt, void * context)
+{
+    (*(size_t *) context)++;
+    IThreadTimerFree(itt);
+}
+
+/// @brief The next expiry is reported exactly for a timer on a tick boundary, a timer already due fires on the next tick, and
+///         clearing the wheel hands back every timer without firing it.
+static void TestTimerWheelNextExpiry()
+{
+    IThreadTimerWheel * ittw = IThreadTimerWheelCreate(TEST_START_NS, TEST_TICK_MS);
+    IThreadTimerWheelAdd(ittw, IThreadTimerCreate(NULL, TEST_START_NS + 5 * TEST_TICK_NS, 0));
+    IThreadTimerWheelAdd(ittw, IThreadTimerCreate(NULL, TEST_START_NS + 100 * TEST_TICK_NS, 0));
+    ITHREAD_TEST_CHECK(IThreadTimerWheelGetNextExpiry(ittw) == TEST_START_NS + 5 * TEST_TICK_NS);
+
+    static int fired[1];
+    TestTimerWheelData data = { .wheel = ittw, .previous_ns = TEST_START_NS, .now_ns = TEST_START_NS + 4 * TEST_TICK_NS, .fired = fired };
+    ITHREAD_TEST_CHECK(IThreadTimerWheelAdvance(ittw, data.now_ns, TestTimerWheelExpired, &data) == 0);
+    IThreadTimerWheelAdd(ittw, IThreadTimerCreate(NULL, TEST_START_NS, 0));
+    ITHREAD_TEST_CHECK(IThreadTimerWheelGetNextExpiry(ittw) == TEST_START_NS + 5 * TEST_TICK_NS);
+    data.now_ns = TEST_START_NS + 5 * TEST_TICK_NS;
+    ITHREAD_TEST_CHECK(IThreadTimerWheelAdvance(ittw, data.now_ns, TestTimerWheelExpired, &data) == 2);
+    ITHREAD_TEST_CHECK(IThreadTimerWheelGetCount(ittw) == 1);
+
+    size_t discarded = 0;
+    IThreadTimerWheelClear(ittw, TestTimerWheelDiscard, &discarded);
+    ITHREAD_TEST_CHECK(discarded == 1);
+    ITHREAD_TEST_CHECK(IThreadTimerWheelGetCount(ittw) == 0);
+    ITHREAD_TEST_CHECK(IThreadTimerWheelGetNextExpiry(ittw) == UINT64_MAX);
+
+    // Timers still in the wheel are freed with it.
+    IThreadTimerWheelAdd(ittw, IThreadTimerCreate(NULL, TEST_START_NS + TEST_SPAN_NS, 0));
+    IThreadTimerWheelFree(ittw);
+}
+
+int main()
+{
+    ITHREAD_TEST_RUN(TestTimerWheelExpiry);
+    ITHREAD_TEST_RUN(TestTimerWheelNextExpiry);
+    ITHREAD_TEST_EXIT();
+}
@@ -0,0 +1,73 @@
+#include "ithread.h"
+#include "ithreadtest.h"
+
+#define TEST_MIN_WORKERS 1
+#define TEST_MAX_WORKERS 4
+#define TEST_TARGET_WAIT_MS 5
+#define TEST_IDLE_GRACE_MS 100
+#define TEST_JOBS 400
+
+static atomic_int test_autoscale_done;
+
+static void TestAutoscaleJob(IWorkerThreadJob * iwtj)
+{
+    IThreadSleep(2);
+    atomic_fetch_add(&test_autoscale_done, 1);
+}
+
+/// @brief Returns how many of a controller's worker threads are parked.
+static int TestAutoscaleParkedCount(IWorkerThreadController * iwtc)
+{
+    int parked = 0;
+    for (int t = 0; t < iwtc->threads_count; t++) {
+        if (atomic_load(&iwtc->threads[t]->state) == IThreadStateParked) parked++;
+    }
+    return parked;
+}
+
+/// @brief Runs a burst of jobs, checking that workers are started while jobs are waiting (never more than the maximum).
+static int TestAutoscaleBurst(IWorkerThreadController * iwtc, int target)
+{
+    for (int j = 0; j < TEST_JOBS; j++) IWorkerThreadControllerAddJob(iwtc, &test_autoscale_done);
+    int peak = 0;
+    for (long waited_ms = 0; atomic_load(&test_autoscale_done) < target && waited_ms < 30000; waited_ms++) {
+        const int WORKERS = IWorkerThreadControllerGetWorkerCount(iwtc);
+        if (WORKERS > peak) peak = WORKERS;
+        IThreadSleep(1);
+    }
+    ITHREAD_TEST_CHECK(atomic_load(&test_autoscale_done) == target);
+    ITHREAD_TEST_CHECK(peak <= TEST_MAX_WORKERS);
+    return peak;
+}
+
+/// @brief An autoscaling controller starts with the minimum number of workers, starts more while jobs wait too long, parks them
+///         again once they have been idle for the grace period, and starts parked workers again for the next burst.
+static void TestAutoscaleLoad()
+{
+    IWorkerThreadController * iwtc = IWorkerThreadControllerCreate();
+    IWorkerThreadControllerAddWorkerThread(iwtc, TestAutoscaleJob, NULL, NULL, IThreadTimeoutNone);
+    ITHREAD_TEST_CHECK(IWorkerThreadControllerSetAutoscaling(iwtc, TEST_MIN_WORKERS, TEST_MAX_WORKERS, TEST_TARGET_WAIT_MS,
+                                                             TEST_IDLE_GRACE_MS));
+    ITHREAD_TEST_CHECK(iwtc->threads_count == TEST_MAX_WORKERS);
+    ITHREAD_TEST_CHECK(IWorkerThreadControllerStart(iwtc));
+    ITHREAD_TEST_WAIT_FOR(IWorkerThreadControllerGetWorkerCount(iwtc) == TEST_MIN_WORKERS, 1000);
+
+    ITHREAD_TEST_CHECK(TestAutoscaleBurst(iwtc, TEST_JOBS) > TEST_MIN_WORKERS);
+    ITHREAD_TEST_WAIT_FOR(IWorkerThreadControllerGetWorkerCount(iwtc) == TEST_MIN_WORKERS, 10000);
+    ITHREAD_TEST_WAIT_FOR(TestAutoscaleParkedCount(iwtc) == TEST_MAX_WORKERS - TEST_MIN_WORKERS, 10000);
+    ITHREAD_TEST_CHECK(IWorkerThreadControllerIsRunning(iwtc));
+
+    ITHREAD_TEST_CHECK(TestAutoscaleBurst(iwtc, 2 * TEST_JOBS) > TEST_MIN_WORKERS);
+
+    // Stopping the controller stops parked workers too.
+    ITHREAD_TEST_CHECK(IWorkerThreadControllerStop(iwtc));
+    ITHREAD_TEST_CHECK(TestAutoscaleParkedCount(iwtc) == 0);
+    ITHREAD_TEST_CHECK(IWorkerThreadControllerGetWorkerCount(iwtc) == 0);
+    IWorkerThreadControllerFree(iwtc);
+}
+
+int main()
+{
+    ITHREAD_TEST_RUN(TestAutoscaleLoad);
+    ITHREAD_TEST_EXIT();
+}
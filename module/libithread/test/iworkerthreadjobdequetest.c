@@ -0,0 +1,100 @@
+#include <pthread.h>
+
+#include "ithread.h"
+#include "iworkerthreadjobdeque.h"
+#include "ithreadtest.h"
+
+// More than ITHREAD_DEFAULT_JOB_DEQUE_SIZE, so the deque has to grow.
+#define TEST_JOBS 1000
+#define TEST_THIEVES 3
+#define TEST_CONCURRENT_JOBS 200000
+
+typedef struct _test_deque_data {
+    IWorkerThreadJobDeque * deque;
+    atomic_int * seen;
+    atomic_bool * pushing;
+} TestDequeData;
+
+/// @brief The owner pops the newest job first and thieves steal the oldest job first.
+static void TestDequeOrder()
+{
+    IWorkerThreadJobDeque * iwtjd = IWorkerThreadJobDequeCreate();
+    ITHREAD_TEST_CHECK(IWorkerThreadJobDequeIsValid(iwtjd));
+    ITHREAD_TEST_CHECK(!IWorkerThreadJobDequeHasJobs(iwtjd));
+    ITHREAD_TEST_CHECK(IWorkerThreadJobDequePop(iwtjd) == NULL);
+    ITHREAD_TEST_CHECK(IWorkerThreadJobDequeSteal(iwtjd) == NULL);
+
+    static IWorkerThreadJob * jobs[TEST_JOBS];
+    for (size_t j = 0; j < TEST_JOBS; j++) {
+        jobs[j] = IWorkerThreadJobCreate(NULL);
+        ITHREAD_TEST_CHECK(IWorkerThreadJobDequePush(iwtjd, jobs[j]));
+    }
+    ITHREAD_TEST_CHECK(IWorkerThreadJobDequeGetCount(iwtjd) == TEST_JOBS);
+    for (size_t j = 0; j < TEST_JOBS / 2; j++) ITHREAD_TEST_CHECK(IWorkerThreadJobDequeSteal(iwtjd) == jobs[j]);
+    for (size_t j = TEST_JOBS; j > TEST_JOBS / 2; j--) ITHREAD_TEST_CHECK(IWorkerThreadJobDequePop(iwtjd) == jobs[j - 1]);
+    ITHREAD_TEST_CHECK(!IWorkerThreadJobDequeHasJobs(iwtjd));
+
+    // A batch is pushed as if its jobs had been pushed one at a time.
+    ITHREAD_TEST_CHECK(IWorkerThreadJobDequePushBatch(iwtjd, jobs, TEST_JOBS));
+    ITHREAD_TEST_CHECK(IWorkerThreadJobDequeSteal(iwtjd) == jobs[0]);
+    ITHREAD_TEST_CHECK(IWorkerThreadJobDequePop(iwtjd) == jobs[TEST_JOBS - 1]);
+    ITHREAD_TEST_CHECK(IWorkerThreadJobDequeGetCount(iwtjd) == TEST_JOBS - 2);
+    while (IWorkerThreadJobDequePop(iwtjd));
+
+    for (size_t j = 0; j < TEST_JOBS; j++) IWorkerThreadJobFree(jobs[j]);
+    ITHREAD_TEST_CHECK(IWorkerThreadJobDequeFree(iwtjd));
+}
+
+static void * TestDequeSteal(void * data)
+{
+    TestDequeData * tdd = (TestDequeData *) data;
+    for (;;) {
+        const bool PUSHING = atomic_load(tdd->pushing);
+        IWorkerThreadJob * iwtj = IWorkerThreadJobDequeSteal(tdd->deque);
+        if (iwtj) atomic_fetch_add(&tdd->seen[(size_t) IWorkerThreadJobGetData(iwtj)], 1);
+        else if (!PUSHING && !IWorkerThreadJobDequeHasJobs(tdd->deque)) return NULL;
+    }
+}
+
+/// @brief While thieves steal, the owner pushes (growing the deque) and pops.  Every job is taken exactly once, whether by the
+///         owner or by a thief, including when both go for the last job.
+static void TestDequeConcurrent()
+{
+    static IWorkerThreadJob * jobs[TEST_CONCURRENT_JOBS];
+    static atomic_int seen[TEST_CONCURRENT_JOBS];
+    atomic_bool pushing = true;
+    IWorkerThreadJobDeque * iwtjd = IWorkerThreadJobDequeCreate();
+    for (size_t j = 0; j < TEST_CONCURRENT_JOBS; j++) {
+        jobs[j] = IWorkerThreadJobCreate((void *) j);
+        atomic_init(&seen[j], 0);
+    }
+
+    TestDequeData data = { .deque = iwtjd, .seen = seen, .pushing = &pushing };
+    pthread_t handles[TEST_THIEVES];
+    for (int t = 0; t < TEST_THIEVES; t++) pthread_create(&handles[t], NULL, TestDequeSteal, &data);
+    for (size_t j = 0; j < TEST_CONCURRENT_JOBS; j++) {
+        ITHREAD_TEST_CHECK(IWorkerThreadJobDequePush(iwtjd, jobs[j]));
+        // Pop now and then, so the owner and the thieves often race for the same job.
+        if (j % 3 == 0) {
+            IWorkerThreadJob * iwtj = IWorkerThreadJobDequePop(iwtjd);
+            if (iwtj) atomic_fetch_add(&seen[(size_t) IWorkerThreadJobGetData(iwtj)], 1);
+        }
+    }
+    atomic_store(&pushing, false);
+    for (int t = 0; t < TEST_THIEVES; t++) pthread_join(handles[t], NULL);
+
+    size_t once = 0;
+    for (size_t j = 0; j < TEST_CONCURRENT_JOBS; j++) {
+        if (atomic_load(&seen[j]) == 1) once++;
+        IWorkerThreadJobFree(jobs[j]);
+    }
+    ITHREAD_TEST_CHECK(once == TEST_CONCURRENT_JOBS);
+    IWorkerThreadJobDequeFree(iwtjd);
+}
+
+int main()
+{
+    ITHREAD_TEST_RUN(TestDequeOrder);
+    ITHREAD_TEST_RUN(TestDequeConcurrent);
+    ITHREAD_TEST_EXIT();
+}
@@ -0,0 +1,146 @@
+#include <string.h>
+
+#include "ithread.h"
+#include "ithreadtest.h"
+
+#define TEST_WORKERS 4
+#define TEST_FUTURES 64
+#define TEST_FAILURE_MESSAGE "test failure"
+
+typedef enum {
+    TestFutureSucceed,
+    TestFutureFail,
+    TestFutureBlock
+} TestFutureKind;
+
+typedef struct _test_future_data {
+    TestFutureKind kind;
+    long value;
+    atomic_bool * release;
+    atomic_int * ran;
+} TestFutureData;
+
+static void TestFutureJob(IWorkerThreadJob * iwtj)
+{
+    TestFutureData * tfd = (TestFutureData *) IWorkerThreadJobGetData(iwtj);
+    if (tfd->ran) atomic_fetch_add(tfd->ran, 1);
+    switch (tfd->kind) {
+        case TestFutureFail:
+            IWorkerThreadJobFailed(iwtj, TEST_FAILURE_MESSAGE);
+            return;
+        case TestFutureBlock:
+            while (!atomic_load(tfd->release) && !IWorkerThreadJobIsCancelled(iwtj)) IThreadSleep(1);
+            break;
+        default:
+            break;
+    }
+    IWorkerThreadJobSetResult(iwtj, (void *) tfd->value);
+}
+
+static IWorkerThreadController * TestFutureController()
+{
+    IWorkerThreadController * iwtc = IWorkerThreadControllerCreate();
+    for (int w = 0; w < TEST_WORKERS; w++) IWorkerThreadControllerAddWorkerThread(iwtc, TestFutureJob, NULL, NULL, IThreadTimeoutNone);
+    return iwtc;
+}
+
+/// @brief A future completes with its job's result on success, or with the job's failure message on failure.
+static void TestFutureResult()
+{
+    IWorkerThreadController * iwtc = TestFutureController();
+    ITHREAD_TEST_CHECK(IWorkerThreadControllerStart(iwtc));
+
+    static TestFutureData data[TEST_FUTURES];
+    IWorkerThreadJobFuture * futures[TEST_FUTURES];
+    for (long f = 0; f < TEST_FUTURES; f++) {
+        data[f] = (TestFutureData) { .kind = f % 4 == 0 ? TestFutureFail : TestFutureSucceed, .value = f + 1 };
+        futures[f] = IWorkerThreadControllerSubmitJob(iwtc, &data[f], IThreadPriorityNormal);
+        ITHREAD_TEST_CHECK(IWorkerThreadJobFutureIsValid(futures[f]));
+    }
+    ITHREAD_TEST_CHECK(IWorkerThreadJobFutureWaitAll(futures, TEST_FUTURES, IThreadWaitForever));
+    for (long f = 0; f < TEST_FUTURES; f++) {
+        ITHREAD_TEST_CHECK(IWorkerThreadJobFutureIsDone(futures[f]));
+        if (data[f].kind == TestFutureFail) {
+            ITHREAD_TEST_CHECK(!IWorkerThreadJobFutureWait(futures[f]));
+            ITHREAD_TEST_CHECK(IWorkerThreadJobFutureGetState(futures[f]) == IThreadJobStateFailed);
+            ITHREAD_TEST_CHECK(strcmp(IWorkerThreadJobFutureGetFailureMessage(futures[f]), TEST_FAILURE_MESSAGE) == 0);
+        } else {
+            ITHREAD_TEST_CHECK(IWorkerThreadJobFutureWait(futures[f]));
+            ITHREAD_TEST_CHECK(IWorkerThreadJobFutureGetState(futures[f]) == IThreadJobStateDone);
+            ITHREAD_TEST_CHECK(IWorkerThreadJobFutureGetResult(futures[f]) == (void *) (f + 1));
+        }
+        ITHREAD_TEST_CHECK(IWorkerThreadJobFutureFree(futures[f]));
+    }
+
+    IWorkerThreadControllerStop(iwtc);
+    IWorkerThreadControllerFree(iwtc);
+}
+
+/// @brief Timed waits give up while a job is still running, WaitAny() reports the future that completed, and a future may be freed
+///         before its job has finished.
+static void TestFutureWaits()
+{
+    IWorkerThreadController * iwtc = TestFutureController();
+    ITHREAD_TEST_CHECK(IWorkerThreadControllerStart(iwtc));
+
+    atomic_bool release = false;
+    TestFutureData blocked = { .kind = TestFutureBlock, .value = 1, .release = &release };
+    TestFutureData quick = { .kind = TestFutureSucceed, .value = 2 };
+    IWorkerThreadJobFuture * futures[2];
+    futures[0] = IWorkerThreadControllerSubmitJob(iwtc, &blocked, IThreadPriorityNormal);
+    ITHREAD_TEST_CHECK(!IWorkerThreadJobFutureTimedWait(futures[0], 20));
+    ITHREAD_TEST_CHECK(!IWorkerThreadJobFutureIsDone(futures[0]));
+    ITHREAD_TEST_CHECK(IWorkerThreadJobFutureGetState(futures[0]) == IThreadJobStateInitialised);
+    ITHREAD_TEST_CHECK(IWorkerThreadJobFutureWaitAny(futures, 1, 20) == -1);
+    ITHREAD_TEST_CHECK(!IWorkerThreadJobFutureWaitAll(futures, 1, 20));
+
+    futures[1] = IWorkerThreadControllerSubmitJob(iwtc, &quick, IThreadPriorityNormal);
+    ITHREAD_TEST_CHECK(IWorkerThreadJobFutureWaitAny(futures, 2, IThreadWaitForever) == 1);
+    ITHREAD_TEST_CHECK(IWorkerThreadJobFutureGetResult(futures[1]) == (void *) 2);
+
+    // The blocked job still holds its future, so freeing it here must not release the memory under the job.
+    ITHREAD_TEST_CHECK(IWorkerThreadJobFutureFree(futures[0]));
+    atomic_store(&release, true);
+    IWorkerThreadJobFutureFree(futures[1]);
+
+    IWorkerThreadControllerStop(iwtc);
+    IWorkerThreadControllerFree(iwtc);
+}
+
+/// @brief Cancelling a job that hasn't started fails it without running it, and cancelling a running job asks it to stop.
+static void TestFutureCancel()
+{
+    IWorkerThreadController * iwtc = TestFutureController();
+
+    // Jobs submitted before the controller starts are cancelled while still queued.
+    atomic_int ran = 0;
+    TestFutureData queued = { .kind = TestFutureSucceed, .value = 1, .ran = &ran };
+    IWorkerThreadJobFuture * iwtjf = IWorkerThreadControllerSubmitJob(iwtc, &queued, IThreadPriorityNormal);
+    ITHREAD_TEST_CHECK(IWorkerThreadJobFutureCancel(iwtjf));
+    ITHREAD_TEST_CHECK(IWorkerThreadControllerStart(iwtc));
+    ITHREAD_TEST_CHECK(!IWorkerThreadJobFutureWait(iwtjf));
+    ITHREAD_TEST_CHECK(IWorkerThreadJobFutureGetState(iwtjf) == IThreadJobStateFailed);
+    ITHREAD_TEST_CHECK(atomic_load(&ran) == 0);
+    ITHREAD_TEST_CHECK(!IWorkerThreadJobFutureCancel(iwtjf));
+    IWorkerThreadJobFutureFree(iwtjf);
+
+    atomic_bool release = false;
+    TestFutureData running = { .kind = TestFutureBlock, .value = 1, .release = &release, .ran = &ran };
+    iwtjf = IWorkerThreadControllerSubmitJob(iwtc, &running, IThreadPriorityNormal);
+    while (!atomic_load(&ran)) IThreadSleep(1);
+    ITHREAD_TEST_CHECK(IWorkerThreadJobFutureCancel(iwtjf));
+    ITHREAD_TEST_CHECK(!IWorkerThreadJobFutureWait(iwtjf));
+    ITHREAD_TEST_CHECK(strcmp(IWorkerThreadJobFutureGetFailureMessage(iwtjf), ITHREAD_JOB_CANCELLED_MESSAGE) == 0);
+    IWorkerThreadJobFutureFree(iwtjf);
+
+    IWorkerThreadControllerStop(iwtc);
+    IWorkerThreadControllerFree(iwtc);
+}
+
+int main()
+{
+    ITHREAD_TEST_RUN(TestFutureResult);
+    ITHREAD_TEST_RUN(TestFutureWaits);
+    ITHREAD_TEST_RUN(TestFutureCancel);
+    ITHREAD_TEST_EXIT();
+}
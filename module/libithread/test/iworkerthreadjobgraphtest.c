@@ -0,0 +1,158 @@
+#include <string.h>
+
+#include "ithread.h"
+#include "ithreadtest.h"
+
+#define TEST_WORKERS 4
+#define TEST_FAN_OUT 8
+#define TEST_CHAIN 10000
+#define TEST_FAILURE_MESSAGE "test failure"
+
+typedef enum {
+    TestGraphSucceed,
+    TestGraphFail,
+    TestGraphSpin
+} TestGraphKind;
+
+typedef struct _test_graph_data {
+    TestGraphKind kind;
+    long value;
+    long sequence;
+} TestGraphData;
+
+static atomic_long test_graph_sequence;
+static atomic_long test_graph_ran;
+
+static void TestGraphJob(IWorkerThreadJob * iwtj)
+{
+    TestGraphData * tgd = (TestGraphData *) IWorkerThreadJobGetData(iwtj);
+    atomic_fetch_add(&test_graph_ran, 1);
+    tgd->sequence = atomic_fetch_add(&test_graph_sequence, 1);
+    switch (tgd->kind) {
+        case TestGraphFail:
+            IWorkerThreadJobFailed(iwtj, TEST_FAILURE_MESSAGE);
+            return;
+        case TestGraphSpin:
+            while (!IWorkerThreadJobIsCancelled(iwtj)) IThreadSleep(1);
+            return;
+        default:
+            IWorkerThreadJobSetResult(iwtj, (void *) tgd->value);
+    }
+}
+
+/// @brief A diamond (one job, then a fan of jobs, then one job) is run in dependency order and resubmitted under each failure
+///         policy: by default a failure stops the jobs downstream of it, Continue runs them anyway and CancelGraph stops the rest
+///         of the graph, including jobs already running.
+static void TestGraphDiamond()
+{
+    IWorkerThreadController * iwtc = IWorkerThreadControllerCreate();
+    for (int w = 0; w < TEST_WORKERS; w++) IWorkerThreadControllerAddWorkerThread(iwtc, TestGraphJob, NULL, NULL, IThreadTimeoutNone);
+    ITHREAD_TEST_CHECK(IWorkerThreadControllerStart(iwtc));
+
+    TestGraphData first = { 0 }, last = { 0 }, fan[TEST_FAN_OUT];
+    IWorkerThreadJobGraph * iwtjg = IWorkerThreadJobGraphCreate();
+    IWorkerThreadJobGraphNode * first_node = IWorkerThreadJobGraphAddJob(iwtjg, &first, IThreadPriorityNormal);
+    IWorkerThreadJobGraphNode * last_node = IWorkerThreadJobGraphAddJob(iwtjg, &last, IThreadPriorityNormal);
+    IWorkerThreadJobGraphNode * fan_nodes[TEST_FAN_OUT];
+    for (int n = 0; n < TEST_FAN_OUT; n++) {
+        fan[n] = (TestGraphData) { .kind = TestGraphSucceed, .value = n + 1 };
+        fan_nodes[n] = IWorkerThreadJobGraphAddJob(iwtjg, &fan[n], IThreadPriorityNormal);
+        ITHREAD_TEST_CHECK(IWorkerThreadJobGraphAddDependency(iwtjg, fan_nodes[n], first_node));
+        ITHREAD_TEST_CHECK(IWorkerThreadJobGraphAddDependency(iwtjg, last_node, fan_nodes[n]));
+    }
+
+    ITHREAD_TEST_CHECK(IWorkerThreadJobGraphSubmit(iwtjg, iwtc));
+    ITHREAD_TEST_CHECK(IWorkerThreadJobGraphWait(iwtjg, IThreadWaitForever));
+    ITHREAD_TEST_CHECK(IWorkerThreadJobGraphGetFailedCount(iwtjg) == 0);
+    for (int n = 0; n < TEST_FAN_OUT; n++) {
+        ITHREAD_TEST_CHECK(first.sequence < fan[n].sequence && fan[n].sequence < last.sequence);
+        ITHREAD_TEST_CHECK(IWorkerThreadJobGraphNodeGetResult(fan_nodes[n]) == (void *) (long) (n + 1));
+    }
+    ITHREAD_TEST_CHECK(IWorkerThreadJobGraphNodeGetState(last_node) == IThreadJobStateDone);
+
+    fan[2].kind = TestGraphFail;
+    atomic_store(&test_graph_ran, 0);
+    ITHREAD_TEST_CHECK(IWorkerThreadJobGraphSubmit(iwtjg, iwtc));
+    ITHREAD_TEST_CHECK(IWorkerThreadJobGraphWait(iwtjg, IThreadWaitForever));
+    ITHREAD_TEST_CHECK(atomic_load(&test_graph_ran) == TEST_FAN_OUT + 1);
+    ITHREAD_TEST_CHECK(IWorkerThreadJobGraphGetFailedCount(iwtjg) == 1);
+    ITHREAD_TEST_CHECK(IWorkerThreadJobGraphGetStoppedCount(iwtjg) == 1);
+    ITHREAD_TEST_CHECK(strcmp(IWorkerThreadJobGraphNodeGetFailureMessage(fan_nodes[2]), TEST_FAILURE_MESSAGE) == 0);
+    ITHREAD_TEST_CHECK(IWorkerThreadJobGraphNodeGetState(last_node) == IThreadJobStateStopped);
+    ITHREAD_TEST_CHECK(strcmp(IWorkerThreadJobGraphNodeGetFailureMessage(last_node), ITHREAD_JOB_GRAPH_UPSTREAM_FAILED_MESSAGE) == 0);
+
+    IWorkerThreadJobGraphSetFailurePolicy(iwtjg, IWorkerThreadJobGraphFailureContinue);
+    atomic_store(&test_graph_ran, 0);
+    ITHREAD_TEST_CHECK(IWorkerThreadJobGraphSubmit(iwtjg, iwtc));
+    ITHREAD_TEST_CHECK(IWorkerThreadJobGraphWait(iwtjg, IThreadWaitForever));
+    ITHREAD_TEST_CHECK(atomic_load(&test_graph_ran) == TEST_FAN_OUT + 2);
+    ITHREAD_TEST_CHECK(IWorkerThreadJobGraphNodeGetState(last_node) == IThreadJobStateDone);
+
+    // One fan job spins until cancelled, so only the graph being cancelled lets it finish.
+    fan[5].kind = TestGraphSpin;
+    IWorkerThreadJobGraphSetFailurePolicy(iwtjg, IWorkerThreadJobGraphFailureCancelGraph);
+    ITHREAD_TEST_CHECK(IWorkerThreadJobGraphSubmit(iwtjg, iwtc));
+    ITHREAD_TEST_CHECK(IWorkerThreadJobGraphWait(iwtjg, 10000));
+    ITHREAD_TEST_CHECK(IWorkerThreadJobGraphGetFailedCount(iwtjg) == 1);
+    ITHREAD_TEST_CHECK(IWorkerThreadJobGraphNodeGetState(fan_nodes[5]) == IThreadJobStateStopped);
+    ITHREAD_TEST_CHECK(strcmp(IWorkerThreadJobGraphNodeGetFailureMessage(fan_nodes[5]), ITHREAD_JOB_GRAPH_CANCELLED_MESSAGE) == 0);
+    ITHREAD_TEST_CHECK(IWorkerThreadJobGraphNodeGetState(last_node) == IThreadJobStateStopped);
+
+    // A cycle is refused when the graph is submitted.
+    ITHREAD_TEST_CHECK(IWorkerThreadJobGraphAddDependency(iwtjg, first_node, last_node));
+    ITHREAD_TEST_CHECK(!IWorkerThreadJobGraphSubmit(iwtjg, iwtc));
+    ITHREAD_TEST_CHECK(IWorkerThreadJobGraphFree(iwtjg));
+
+    IWorkerThreadControllerStop(iwtc);
+    IWorkerThreadControllerFree(iwtc);
+}
+
+/// @brief A long chain runs every job in order, stops every job after the first when it fails, and Cancel() stops a running chain.
+static void TestGraphChain()
+{
+    IWorkerThreadController * iwtc = IWorkerThreadControllerCreate();
+    for (int w = 0; w < TEST_WORKERS; w++) IWorkerThreadControllerAddWorkerThread(iwtc, TestGraphJob, NULL, NULL, IThreadTimeoutNone);
+    ITHREAD_TEST_CHECK(IWorkerThreadControllerStart(iwtc));
+
+    static TestGraphData data[TEST_CHAIN];
+    IWorkerThreadJobGraph * iwtjg = IWorkerThreadJobGraphCreate();
+    IWorkerThreadJobGraphNode * previous = NULL;
+    for (int n = 0; n < TEST_CHAIN; n++) {
+        data[n] = (TestGraphData) { .kind = TestGraphSucceed, .value = n };
+        IWorkerThreadJobGraphNode * node = IWorkerThreadJobGraphAddJob(iwtjg, &data[n], IThreadPriorityNormal);
+        if (previous) IWorkerThreadJobGraphAddDependency(iwtjg, node, previous);
+        previous = node;
+    }
+
+    ITHREAD_TEST_CHECK(IWorkerThreadJobGraphSubmit(iwtjg, iwtc));
+    ITHREAD_TEST_CHECK(IWorkerThreadJobGraphWait(iwtjg, IThreadWaitForever));
+    bool ordered = true;
+    for (int n = 1; n < TEST_CHAIN; n++) ordered = ordered && data[n - 1].sequence < data[n].sequence;
+    ITHREAD_TEST_CHECK(ordered);
+
+    data[0].kind = TestGraphFail;
+    atomic_store(&test_graph_ran, 0);
+    ITHREAD_TEST_CHECK(IWorkerThreadJobGraphSubmit(iwtjg, iwtc));
+    ITHREAD_TEST_CHECK(IWorkerThreadJobGraphWait(iwtjg, IThreadWaitForever));
+    ITHREAD_TEST_CHECK(atomic_load(&test_graph_ran) == 1);
+    ITHREAD_TEST_CHECK(IWorkerThreadJobGraphGetStoppedCount(iwtjg) == TEST_CHAIN - 1);
+
+    data[0].kind = TestGraphSpin;
+    ITHREAD_TEST_CHECK(IWorkerThreadJobGraphSubmit(iwtjg, iwtc));
+    ITHREAD_TEST_CHECK(!IWorkerThreadJobGraphWait(iwtjg, 20));
+    IWorkerThreadJobGraphCancel(iwtjg);
+    ITHREAD_TEST_CHECK(IWorkerThreadJobGraphIsCancelled(iwtjg));
+    ITHREAD_TEST_CHECK(IWorkerThreadJobGraphWait(iwtjg, 10000));
+    ITHREAD_TEST_CHECK(IWorkerThreadJobGraphGetStoppedCount(iwtjg) == TEST_CHAIN);
+    IWorkerThreadJobGraphFree(iwtjg);
+
+    IWorkerThreadControllerStop(iwtc);
+    IWorkerThreadControllerFree(iwtc);
+}
+
+int main()
+{
+    ITHREAD_TEST_RUN(TestGraphDiamond);
+    ITHREAD_TEST_RUN(TestGraphChain);
+    ITHREAD_TEST_EXIT();
+}
@@ -0,0 +1,78 @@
+#include <pthread.h>
+
+#include "ithread.h"
+#include "iworkerthreadjobpool.h"
+#include "ithreadtest.h"
+
+#define TEST_JOBS (3 * ITHREAD_JOB_POOL_SLAB_SIZE + 1)
+#define TEST_THREADS 4
+#define TEST_ROUNDS 200
+#define TEST_JOBS_PER_ROUND 64
+
+/// @brief Jobs taken from the pool are initialised and distinct, the pool grows a slab at a time, and released jobs are reused
+///         rather than the pool growing again.
+static void TestPoolReuse()
+{
+    IWorkerThreadJobPool * iwtjpl = IWorkerThreadJobPoolCreate();
+    ITHREAD_TEST_CHECK(IWorkerThreadJobPoolIsValid(iwtjpl));
+
+    static IWorkerThreadJob * jobs[TEST_JOBS];
+    for (size_t j = 0; j < TEST_JOBS; j++) {
+        jobs[j] = IWorkerThreadJobPoolAcquire(iwtjpl, (void *) (j + 1));
+        ITHREAD_TEST_CHECK(IWorkerThreadJobIsValid(jobs[j]));
+        ITHREAD_TEST_CHECK(IWorkerThreadJobGetData(jobs[j]) == (void *) (j + 1));
+        ITHREAD_TEST_CHECK(atomic_load(&jobs[j]->state) == IThreadJobStateInitialised);
+    }
+    for (size_t j = 1; j < TEST_JOBS; j++) ITHREAD_TEST_CHECK(jobs[j] != jobs[j - 1]);
+    const size_t CAPACITY = IWorkerThreadJobPoolGetCapacity(iwtjpl);
+    ITHREAD_TEST_CHECK(CAPACITY >= TEST_JOBS && CAPACITY % ITHREAD_JOB_POOL_SLAB_SIZE == 0);
+
+    // Freeing a pool job hands it back to the pool.
+    for (size_t j = 0; j < TEST_JOBS; j++) IWorkerThreadJobFree(jobs[j]);
+    void * data[TEST_JOBS];
+    for (size_t j = 0; j < TEST_JOBS; j++) data[j] = (void *) j;
+    ITHREAD_TEST_CHECK(IWorkerThreadJobPoolAcquireBatch(iwtjpl, jobs, data, TEST_JOBS) == TEST_JOBS);
+    for (size_t j = 0; j < TEST_JOBS; j++) ITHREAD_TEST_CHECK(IWorkerThreadJobGetData(jobs[j]) == (void *) j);
+    ITHREAD_TEST_CHECK(IWorkerThreadJobPoolGetCapacity(iwtjpl) == CAPACITY);
+
+    for (size_t j = 0; j < TEST_JOBS; j++) IWorkerThreadJobPoolRelease(iwtjpl, jobs[j]);
+    ITHREAD_TEST_CHECK(IWorkerThreadJobPoolFree(iwtjpl));
+}
+
+static void * TestPoolChurn(void * data)
+{
+    IWorkerThreadJobPool * iwtjpl = (IWorkerThreadJobPool *) data;
+    IWorkerThreadJob * jobs[TEST_JOBS_PER_ROUND];
+    for (int r = 0; r < TEST_ROUNDS; r++) {
+        for (size_t j = 0; j < TEST_JOBS_PER_ROUND; j++) {
+            jobs[j] = IWorkerThreadJobPoolAcquire(iwtjpl, jobs);
+            // Mark the job, so a job handed to two threads at once is noticed.
+            IWorkerThreadJobSetResult(jobs[j], &jobs[j]);
+        }
+        for (size_t j = 0; j < TEST_JOBS_PER_ROUND; j++) {
+            ITHREAD_TEST_CHECK(IWorkerThreadJobGetData(jobs[j]) == jobs);
+            ITHREAD_TEST_CHECK(IWorkerThreadJobGetResult(jobs[j]) == &jobs[j]);
+            IWorkerThreadJobPoolRelease(iwtjpl, jobs[j]);
+        }
+    }
+    return NULL;
+}
+
+/// @brief Threads taking and returning jobs at the same time never get the same job, and the pool only grows as far as the most
+///         jobs ever in use at once.
+static void TestPoolConcurrent()
+{
+    IWorkerThreadJobPool * iwtjpl = IWorkerThreadJobPoolCreate();
+    pthread_t handles[TEST_THREADS];
+    for (int t = 0; t < TEST_THREADS; t++) pthread_create(&handles[t], NULL, TestPoolChurn, iwtjpl);
+    for (int t = 0; t < TEST_THREADS; t++) pthread_join(handles[t], NULL);
+    ITHREAD_TEST_CHECK(IWorkerThreadJobPoolGetCapacity(iwtjpl) <= ITHREAD_JOB_POOL_SLAB_SIZE * TEST_THREADS);
+    IWorkerThreadJobPoolFree(iwtjpl);
+}
+
+int main()
+{
+    ITHREAD_TEST_RUN(TestPoolReuse);
+    ITHREAD_TEST_RUN(TestPoolConcurrent);
+    ITHREAD_TEST_EXIT();
+}
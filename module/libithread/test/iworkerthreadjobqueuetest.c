@@ -0,0 +1,104 @@
+#include <pthread.h>
+
+#include "ithread.h"
+#include "iworkerthreadjobqueue.h"
+#include "ithreadtest.h"
+
+#define TEST_QUEUE_CAPACITY 16
+#define TEST_JOBS 1000
+#define TEST_PRODUCERS 4
+#define TEST_CONSUMERS 4
+#define TEST_JOBS_PER_PRODUCER 20000
+
+typedef struct _test_queue_data {
+    IWorkerThreadJobQueue * queue;
+    IWorkerThreadJob ** jobs;
+    atomic_int * seen;
+    atomic_int * producing;
+} TestQueueData;
+
+/// @brief Jobs come out in the order they went in, including once the ring is full and jobs wait in the overflow list.
+static void TestQueueFifo()
+{
+    IWorkerThreadJobQueue * iwtjq = IWorkerThreadJobQueueCreate(TEST_QUEUE_CAPACITY);
+    ITHREAD_TEST_CHECK(IWorkerThreadJobQueueIsValid(iwtjq));
+    ITHREAD_TEST_CHECK(IWorkerThreadJobQueueDequeue(iwtjq) == NULL);
+
+    static IWorkerThreadJob * jobs[TEST_JOBS];
+    for (size_t j = 0; j < TEST_JOBS; j++) {
+        jobs[j] = IWorkerThreadJobCreate((void *) (j + 1));
+        ITHREAD_TEST_CHECK(IWorkerThreadJobQueueEnqueue(iwtjq, jobs[j]));
+    }
+    ITHREAD_TEST_CHECK(IWorkerThreadJobQueueGetCount(iwtjq) == TEST_JOBS);
+    for (size_t j = 0; j < TEST_JOBS; j++) {
+        IWorkerThreadJob * iwtj = IWorkerThreadJobQueueDequeue(iwtjq);
+        ITHREAD_TEST_CHECK(iwtj == jobs[j]);
+        if (j % 100 == 0) ITHREAD_TEST_CHECK(IWorkerThreadJobQueueGetCount(iwtjq) == TEST_JOBS - j - 1);
+    }
+    ITHREAD_TEST_CHECK(IWorkerThreadJobQueueGetCount(iwtjq) == 0);
+    ITHREAD_TEST_CHECK(IWorkerThreadJobQueueDequeue(iwtjq) == NULL);
+
+    // A batch goes in whole, in order, even though it is bigger than the ring.
+    ITHREAD_TEST_CHECK(IWorkerThreadJobQueueEnqueueBatch(iwtjq, jobs, TEST_JOBS) == TEST_JOBS);
+    for (size_t j = 0; j < TEST_JOBS; j++) ITHREAD_TEST_CHECK(IWorkerThreadJobQueueDequeue(iwtjq) == jobs[j]);
+
+    for (size_t j = 0; j < TEST_JOBS; j++) IWorkerThreadJobFree(jobs[j]);
+    ITHREAD_TEST_CHECK(IWorkerThreadJobQueueFree(iwtjq));
+}
+
+static void * TestQueueProduce(void * data)
+{
+    TestQueueData * tqd = (TestQueueData *) data;
+    for (size_t j = 0; j < TEST_JOBS_PER_PRODUCER; j++) ITHREAD_TEST_CHECK(IWorkerThreadJobQueueEnqueue(tqd->queue, tqd->jobs[j]));
+    atomic_fetch_sub(tqd->producing, 1);
+    return NULL;
+}
+
+static void * TestQueueConsume(void * data)
+{
+    TestQueueData * tqd = (TestQueueData *) data;
+    for (;;) {
+        IWorkerThreadJob * iwtj = IWorkerThreadJobQueueDequeue(tqd->queue);
+        if (iwtj) atomic_fetch_add(&tqd->seen[(size_t) IWorkerThreadJobGetData(iwtj)], 1);
+        else if (!atomic_load(tqd->producing) && IWorkerThreadJobQueueGetCount(tqd->queue) == 0) return NULL;
+    }
+}
+
+/// @brief With several producers and consumers on a small ring (so the overflow list is used too), every job is dequeued exactly
+///         once.
+static void TestQueueConcurrent()
+{
+    static IWorkerThreadJob * jobs[TEST_PRODUCERS * TEST_JOBS_PER_PRODUCER];
+    static atomic_int seen[TEST_PRODUCERS * TEST_JOBS_PER_PRODUCER];
+    atomic_int producing = TEST_PRODUCERS;
+    IWorkerThreadJobQueue * iwtjq = IWorkerThreadJobQueueCreate(TEST_QUEUE_CAPACITY);
+    for (size_t j = 0; j < TEST_PRODUCERS * TEST_JOBS_PER_PRODUCER; j++) {
+        jobs[j] = IWorkerThreadJobCreate((void *) j);
+        atomic_init(&seen[j], 0);
+    }
+
+    pthread_t handles[TEST_PRODUCERS + TEST_CONSUMERS];
+    TestQueueData data[TEST_PRODUCERS + TEST_CONSUMERS];
+    for (int t = 0; t < TEST_PRODUCERS + TEST_CONSUMERS; t++) {
+        IWorkerThreadJob ** producer_jobs = t < TEST_PRODUCERS ? &jobs[t * TEST_JOBS_PER_PRODUCER] : NULL;
+        data[t] = (TestQueueData) { .queue = iwtjq, .jobs = producer_jobs, .seen = seen, .producing = &producing };
+        pthread_create(&handles[t], NULL, t < TEST_PRODUCERS ? TestQueueProduce : TestQueueConsume, &data[t]);
+    }
+    for (int t = 0; t < TEST_PRODUCERS + TEST_CONSUMERS; t++) pthread_join(handles[t], NULL);
+
+    size_t once = 0;
+    for (size_t j = 0; j < TEST_PRODUCERS * TEST_JOBS_PER_PRODUCER; j++) {
+        if (atomic_load(&seen[j]) == 1) once++;
+        IWorkerThreadJobFree(jobs[j]);
+    }
+    ITHREAD_TEST_CHECK(once == TEST_PRODUCERS * TEST_JOBS_PER_PRODUCER);
+    ITHREAD_TEST_CHECK(IWorkerThreadJobQueueGetCount(iwtjq) == 0);
+    IWorkerThreadJobQueueFree(iwtjq);
+}
+
+int main()
+{
+    ITHREAD_TEST_RUN(TestQueueFifo);
+    ITHREAD_TEST_RUN(TestQueueConcurrent);
+    ITHREAD_TEST_EXIT();
+}
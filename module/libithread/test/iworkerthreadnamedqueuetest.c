@@ -0,0 +1,71 @@
+#include <string.h>
+
+#include "ithread.h"
+#include "iworkerthreadcontrollerstats.h"
+#include "ithreadtest.h"
+
+#define TEST_WORKERS 4
+#define TEST_JOBS_PER_QUEUE 6000
+#define TEST_HEAVY_WEIGHT 3
+#define TEST_LIGHT_WEIGHT 1
+#define TEST_SNAPSHOT 4000
+
+static atomic_int test_named_queue_done[2];
+static atomic_int test_named_queue_snapshot[2];
+
+static void TestNamedQueueJob(IWorkerThreadJob * iwtj)
+{
+    const int QUEUE = *(int *) IWorkerThreadJobGetData(iwtj);
+    for (volatile int i = 0; i < 20000; i++);
+    atomic_fetch_add(&test_named_queue_done[QUEUE], 1);
+    // While both queues still have jobs, note how far each one has got.
+    if (atomic_load(&test_named_queue_done[0]) + atomic_load(&test_named_queue_done[1]) == TEST_SNAPSHOT) {
+        atomic_store(&test_named_queue_snapshot[0], atomic_load(&test_named_queue_done[0]));
+        atomic_store(&test_named_queue_snapshot[1], atomic_load(&test_named_queue_done[1]));
+    }
+}
+
+/// @brief Queues are found by name, jobs can be added to them before the controller starts, and while both queues are busy
+///         they are served in proportion to their weights.
+static void TestNamedQueueWeights()
+{
+    static const int HEAVY = 0, LIGHT = 1;
+    IWorkerThreadController * iwtc = IWorkerThreadControllerCreate();
+    IWorkerThreadNamedQueue * heavy = IWorkerThreadControllerAddQueue(iwtc, "heavy", TEST_HEAVY_WEIGHT);
+    IWorkerThreadNamedQueue * light = IWorkerThreadControllerAddQueue(iwtc, "light", TEST_LIGHT_WEIGHT);
+    ITHREAD_TEST_CHECK(heavy && light && heavy != light);
+    ITHREAD_TEST_CHECK(IWorkerThreadControllerAddQueue(iwtc, "heavy", TEST_HEAVY_WEIGHT) == heavy);
+    ITHREAD_TEST_CHECK(IWorkerThreadControllerGetQueue(iwtc, "light") == light);
+    ITHREAD_TEST_CHECK(IWorkerThreadControllerGetQueue(iwtc, "missing") == NULL);
+
+    for (int j = 0; j < TEST_JOBS_PER_QUEUE; j++) {
+        ITHREAD_TEST_CHECK(IWorkerThreadControllerAddQueueJob(iwtc, heavy, (void *) &HEAVY));
+        ITHREAD_TEST_CHECK(IWorkerThreadControllerAddQueueJob(iwtc, light, (void *) &LIGHT));
+    }
+    for (int w = 0; w < TEST_WORKERS; w++) IWorkerThreadControllerAddWorkerThread(iwtc, TestNamedQueueJob, NULL, NULL, IThreadTimeoutNone);
+    ITHREAD_TEST_CHECK(IWorkerThreadControllerStart(iwtc));
+    ITHREAD_TEST_WAIT_FOR(atomic_load(&test_named_queue_done[HEAVY]) + atomic_load(&test_named_queue_done[LIGHT]) == 2 * TEST_JOBS_PER_QUEUE,
+                          60000);
+
+    // 3:1 weights, so about 3000 heavy to 1000 light jobs.  Allow plenty of slack for scheduling noise.
+    const double RATIO = (double) atomic_load(&test_named_queue_snapshot[HEAVY]) / (double) atomic_load(&test_named_queue_snapshot[LIGHT]);
+    ITHREAD_TEST_CHECK(RATIO > 2.0 && RATIO < 4.5);
+
+    IWorkerThreadControllerStop(iwtc);
+    IWorkerThreadControllerStats * iwtcs = IWorkerThreadControllerStatsCreate();
+    IWorkerThreadControllerGetStats(iwtc, iwtcs);
+    ITHREAD_TEST_CHECK(iwtcs->queues_count == 2);
+    for (size_t q = 0; q < iwtcs->queues_count; q++) {
+        ITHREAD_TEST_CHECK(iwtcs->queues[q].enqueued == TEST_JOBS_PER_QUEUE && iwtcs->queues[q].dequeued == TEST_JOBS_PER_QUEUE);
+        ITHREAD_TEST_CHECK(iwtcs->queues[q].depth == 0);
+        ITHREAD_TEST_CHECK(iwtcs->queues[q].weight == (strcmp(iwtcs->queues[q].name, "heavy") == 0 ? TEST_HEAVY_WEIGHT : TEST_LIGHT_WEIGHT));
+    }
+    IWorkerThreadControllerStatsFree(iwtcs);
+    IWorkerThreadControllerFree(iwtc);
+}
+
+int main()
+{
+    ITHREAD_TEST_RUN(TestNamedQueueWeights);
+    ITHREAD_TEST_EXIT();
+}
@@ -0,0 +1,114 @@
+#include <string.h>
+
+#include "ithread.h"
+#include "iworkerthreadcontrollerstats.h"
+#include "ithreadtest.h"
+
+#define TEST_WORKERS 2
+#define TEST_BASE_DELAY_MS 20
+#define TEST_SUCCEED_ON 3
+#define TEST_MAX_ATTEMPTS 3
+#define TEST_FAILURE_MESSAGE "test failure"
+
+typedef enum {
+    TestRetryTransient,
+    TestRetryPermanent
+} TestRetryKind;
+
+typedef struct _test_retry_data {
+    TestRetryKind kind;
+    uint64_t started_ns[TEST_SUCCEED_ON];
+    atomic_int runs;
+} TestRetryData;
+
+static atomic_int test_retry_failures;
+static atomic_int test_retry_failed_attempts;
+
+static void TestRetryJob(IWorkerThreadJob * iwtj)
+{
+    TestRetryData * trd = (TestRetryData *) IWorkerThreadJobGetData(iwtj);
+    const int RUN = atomic_fetch_add(&trd->runs, 1);
+    ITHREAD_TEST_CHECK(IWorkerThreadJobGetAttempts(iwtj) == RUN + 1);
+    if (trd->kind == TestRetryPermanent) {
+        IWorkerThreadJobFailed(iwtj, TEST_FAILURE_MESSAGE);
+        return;
+    }
+    trd->started_ns[RUN] = IThreadGetTimeNs();
+    // The job sets its own policy the first time it runs.
+    if (RUN == 0) IWorkerThreadJobSetRetryPolicy(iwtj, TEST_SUCCEED_ON + 1, TEST_BASE_DELAY_MS, 0.0);
+    if (IWorkerThreadJobGetAttempts(iwtj) < TEST_SUCCEED_ON) IWorkerThreadJobFailed(iwtj, TEST_FAILURE_MESSAGE);
+    else IWorkerThreadJobSetResult(iwtj, trd);
+}
+
+static void TestRetryFailed(IWorkerThreadJob * iwtj)
+{
+    atomic_fetch_add(&test_retry_failures, 1);
+    atomic_store(&test_retry_failed_attempts, IWorkerThreadJobGetAttempts(iwtj));
+}
+
+/// @brief A job that fails is run again after its retry delay, which doubles each time, until it succeeds or runs out of attempts.
+///         Only the final attempt reaches the future or the failure callback.
+static void TestRetryAttempts()
+{
+    IWorkerThreadController * iwtc = IWorkerThreadControllerCreate();
+    for (int w = 0; w < TEST_WORKERS; w++) IWorkerThreadControllerAddWorkerThread(iwtc, TestRetryJob, NULL, TestRetryFailed, IThreadTimeoutNone);
+    ITHREAD_TEST_CHECK(IWorkerThreadControllerStart(iwtc));
+
+    TestRetryData transient = { .kind = TestRetryTransient };
+    IWorkerThreadJobFuture * iwtjf = IWorkerThreadControllerSubmitJob(iwtc, &transient, IThreadPriorityNormal);
+    ITHREAD_TEST_CHECK(IWorkerThreadJobFutureWait(iwtjf));
+    ITHREAD_TEST_CHECK(IWorkerThreadJobFutureGetResult(iwtjf) == &transient);
+    ITHREAD_TEST_CHECK(atomic_load(&transient.runs) == TEST_SUCCEED_ON);
+    ITHREAD_TEST_CHECK(transient.started_ns[1] - transient.started_ns[0] >= TEST_BASE_DELAY_MS * 1000000ULL);
+    ITHREAD_TEST_CHECK(transient.started_ns[2] - transient.started_ns[1] >= 2 * TEST_BASE_DELAY_MS * 1000000ULL);
+    IWorkerThreadJobFutureFree(iwtjf);
+
+    TestRetryData permanent = { .kind = TestRetryPermanent };
+    ITHREAD_TEST_CHECK(IWorkerThreadControllerAddJobWithRetry(iwtc, &permanent, TEST_MAX_ATTEMPTS, 1, 0.5));
+    ITHREAD_TEST_WAIT_FOR(atomic_load(&test_retry_failures) == 1, 5000);
+    ITHREAD_TEST_CHECK(atomic_load(&permanent.runs) == TEST_MAX_ATTEMPTS);
+    ITHREAD_TEST_CHECK(atomic_load(&test_retry_failed_attempts) == TEST_MAX_ATTEMPTS);
+
+    // Stopped first, so the workers have counted everything.
+    IWorkerThreadControllerStop(iwtc);
+    IWorkerThreadControllerStats * iwtcs = IWorkerThreadControllerStatsCreate();
+    IWorkerThreadControllerGetStats(iwtc, iwtcs);
+    ITHREAD_TEST_CHECK(iwtcs->retried_jobs == (TEST_SUCCEED_ON - 1) + (TEST_MAX_ATTEMPTS - 1));
+    // Every failed attempt counts as a failure, whether or not it was retried.
+    ITHREAD_TEST_CHECK(iwtcs->failed_jobs == iwtcs->retried_jobs + 1);
+    ITHREAD_TEST_CHECK(iwtcs->done_jobs == 1);
+    IWorkerThreadControllerStatsFree(iwtcs);
+    IWorkerThreadControllerFree(iwtc);
+}
+
+/// @brief The retry delay doubles with each attempt up to ITHREAD_JOB_RETRY_MAX_DELAY_MS, and jitter only ever shortens it, by no
+///         more than the jitter fraction.
+static void TestRetryDelay()
+{
+    IWorkerThreadJob * iwtj = IWorkerThreadJobCreate(&iwtj);
+    ITHREAD_TEST_CHECK(IWorkerThreadJobGetRetryDelay(iwtj) == 0);
+    IWorkerThreadJobSetRetryPolicy(iwtj, 100, TEST_BASE_DELAY_MS, 0.0);
+    uint64_t expected = TEST_BASE_DELAY_MS * 1000000ULL;
+    for (int a = 1; a < 30; a++) {
+        iwtj->attempts = a;
+        ITHREAD_TEST_CHECK(IWorkerThreadJobGetRetryDelay(iwtj) == expected);
+        expected *= 2;
+        if (expected > ITHREAD_JOB_RETRY_MAX_DELAY_MS * 1000000ULL) expected = ITHREAD_JOB_RETRY_MAX_DELAY_MS * 1000000ULL;
+    }
+
+    IWorkerThreadJobSetRetryPolicy(iwtj, 100, TEST_BASE_DELAY_MS, 0.5);
+    for (int a = 1; a < 5; a++) {
+        iwtj->attempts = a;
+        const uint64_t NOMINAL = (TEST_BASE_DELAY_MS * 1000000ULL) << (a - 1);
+        const uint64_t DELAY = IWorkerThreadJobGetRetryDelay(iwtj);
+        ITHREAD_TEST_CHECK(DELAY <= NOMINAL && DELAY >= NOMINAL / 2);
+    }
+    IWorkerThreadJobFree(iwtj);
+}
+
+int main()
+{
+    ITHREAD_TEST_RUN(TestRetryAttempts);
+    ITHREAD_TEST_RUN(TestRetryDelay);
+    ITHREAD_TEST_EXIT();
+}
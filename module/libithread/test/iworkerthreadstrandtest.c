@@ -0,0 +1,84 @@
+#include <pthread.h>
+
+#include "ithread.h"
+#include "ithreadtest.h"
+
+#define TEST_WORKERS 6
+#define TEST_PRODUCERS 3
+#define TEST_KEYS 60
+#define TEST_JOBS_PER_KEY 200
+#define TEST_YIELD_EVERY 50
+
+typedef struct _test_strand_event {
+    int key;
+    int sequence;
+} TestStrandEvent;
+
+static IWorkerThreadController * test_strand_controller;
+static TestStrandEvent test_strand_events[TEST_KEYS * TEST_JOBS_PER_KEY];
+static atomic_int test_strand_running[TEST_KEYS];
+static int test_strand_last[TEST_KEYS];
+static atomic_int test_strand_overlaps;
+static atomic_int test_strand_out_of_order;
+static atomic_int test_strand_done;
+
+static void TestStrandJob(IWorkerThreadJob * iwtj)
+{
+    TestStrandEvent * tse = (TestStrandEvent *) IWorkerThreadJobGetData(iwtj);
+    if (atomic_fetch_add(&test_strand_running[tse->key], 1) != 0) atomic_fetch_add(&test_strand_overlaps, 1);
+    // Now and then a job yields and is resumed straight away, which must not let the next job with its key overtake it.
+    if (tse->sequence % TEST_YIELD_EVERY == 1 && IWorkerThreadJobGetStep(iwtj) == 0) {
+        IWorkerThreadJobYield(iwtj, 1);
+        atomic_fetch_sub(&test_strand_running[tse->key], 1);
+        IWorkerThreadControllerResumeJob(test_strand_controller, iwtj);
+        return;
+    }
+    // Only ever touched by the job running for the key, so a plain int is enough if the strand does its job.
+    if (test_strand_last[tse->key] != tse->sequence - 1) atomic_fetch_add(&test_strand_out_of_order, 1);
+    test_strand_last[tse->key] = tse->sequence;
+    atomic_fetch_sub(&test_strand_running[tse->key], 1);
+    atomic_fetch_add(&test_strand_done, 1);
+}
+
+static void * TestStrandProduce(void * data)
+{
+    const int PRODUCER = (int) (intptr_t) data;
+    for (int s = 0; s < TEST_JOBS_PER_KEY; s++) {
+        for (int k = PRODUCER; k < TEST_KEYS; k += TEST_PRODUCERS) {
+            TestStrandEvent * tse = &test_strand_events[k * TEST_JOBS_PER_KEY + s];
+            *tse = (TestStrandEvent) { .key = k, .sequence = s };
+            ITHREAD_TEST_CHECK(IWorkerThreadControllerAddKeyedJob(test_strand_controller, (uint64_t) k * 1000003u, tse));
+        }
+    }
+    return NULL;
+}
+
+/// @brief Jobs with the same key run one at a time, in the order they were added, while jobs with different keys run side by side.
+static void TestStrandOrder()
+{
+    for (int k = 0; k < TEST_KEYS; k++) test_strand_last[k] = -1;
+    test_strand_controller = IWorkerThreadControllerCreate();
+    for (int w = 0; w < TEST_WORKERS; w++) {
+        IWorkerThreadControllerAddWorkerThread(test_strand_controller, TestStrandJob, NULL, NULL, IThreadTimeoutNone);
+    }
+    ITHREAD_TEST_CHECK(IWorkerThreadControllerStart(test_strand_controller));
+
+    pthread_t handles[TEST_PRODUCERS];
+    for (int p = 0; p < TEST_PRODUCERS; p++) pthread_create(&handles[p], NULL, TestStrandProduce, (void *) (intptr_t) p);
+    for (int p = 0; p < TEST_PRODUCERS; p++) pthread_join(handles[p], NULL);
+    ITHREAD_TEST_WAIT_FOR(atomic_load(&test_strand_done) == TEST_KEYS * TEST_JOBS_PER_KEY, 30000);
+    ITHREAD_TEST_CHECK(atomic_load(&test_strand_overlaps) == 0);
+    ITHREAD_TEST_CHECK(atomic_load(&test_strand_out_of_order) == 0);
+    for (int k = 0; k < TEST_KEYS; k++) ITHREAD_TEST_CHECK(test_strand_last[k] == TEST_JOBS_PER_KEY - 1);
+
+    // Keyed jobs still waiting their turn are freed with the controller.
+    for (int j = 0; j < 100; j++) IWorkerThreadControllerAddKeyedJob(test_strand_controller, 1, &test_strand_events[j]);
+    IWorkerThreadControllerStop(test_strand_controller);
+    IWorkerThreadControllerFree(test_strand_controller);
+}
+
+int main()
+{
+    ITHREAD_TEST_RUN(TestStrandOrder);
+    ITHREAD_TEST_EXIT();
+}
@@ -0,0 +1,128 @@
+#include <pthread.h>
+
+#include "ithread.h"
+#include "iworkerthreadcontrollerstats.h"
+#include "ithreadtest.h"
+
+#define TEST_WORKERS 3
+#define TEST_JOBS 2000
+#define TEST_FAIL_EVERY 10
+
+typedef struct _test_yield_data {
+    int id;
+    int next_step;
+} TestYieldData;
+
+static IWorkerThreadController * test_yield_controller;
+static IWorkerThreadJob * test_yield_parked[TEST_JOBS * 2];
+static atomic_int test_yield_parked_count;
+static atomic_bool test_yield_resuming;
+static atomic_int test_yield_wrong_step;
+static atomic_int test_yield_done;
+static atomic_int test_yield_failed;
+
+/// @brief Hands a yielded job to the resuming thread, standing in for whatever the job would wait for (I/O, a message, ...).
+static void TestYieldWait(IWorkerThreadJob * iwtj)
+{
+    const int SLOT = atomic_fetch_add(&test_yield_parked_count, 1);
+    atomic_store((_Atomic(IWorkerThreadJob *) *) &test_yield_parked[SLOT], iwtj);
+}
+
+static void * TestYieldResume(void * data)
+{
+    int resumed = 0;
+    while (atomic_load(&test_yield_resuming) || resumed < atomic_load(&test_yield_parked_count)) {
+        IWorkerThreadJob * iwtj = resumed < TEST_JOBS * 2 ? atomic_load((_Atomic(IWorkerThreadJob *) *) &test_yield_parked[resumed]) : NULL;
+        if (!iwtj) {
+            IThreadSleep(1);
+            continue;
+        }
+        // The job may not have been parked yet; resuming it first must still work.
+        ITHREAD_TEST_CHECK(IWorkerThreadControllerResumeJob(test_yield_controller, iwtj));
+        resumed++;
+    }
+    return NULL;
+}
+
+static void TestYieldJob(IWorkerThreadJob * iwtj)
+{
+    TestYieldData * tyd = (TestYieldData *) IWorkerThreadJobGetData(iwtj);
+    const int STEP = IWorkerThreadJobGetStep(iwtj);
+    if (STEP != tyd->next_step) atomic_fetch_add(&test_yield_wrong_step, 1);
+    // Yielding doesn't count as another attempt.
+    if (IWorkerThreadJobGetAttempts(iwtj) != 1) atomic_fetch_add(&test_yield_wrong_step, 1);
+    tyd->next_step = STEP + 1;
+    switch (STEP) {
+        case 0:
+            IWorkerThreadJobYield(iwtj, 1);
+            TestYieldWait(iwtj);
+            return;
+        case 1:
+            // Resumed by the job itself before its worker has parked it.
+            IWorkerThreadJobYield(iwtj, 2);
+            IWorkerThreadControllerResumeJob(test_yield_controller, iwtj);
+            return;
+        case 2:
+            IWorkerThreadJobYield(iwtj, 3);
+            // A job that fails after yielding finishes instead of being paused.
+            if (tyd->id % TEST_FAIL_EVERY == 0) IWorkerThreadJobFailed(iwtj, "test failure");
+            else TestYieldWait(iwtj);
+            return;
+        default:
+            break;
+    }
+}
+
+static void TestYieldDone(IWorkerThreadJob * iwtj)
+{
+    atomic_fetch_add(&test_yield_done, 1);
+}
+
+static void TestYieldFailed(IWorkerThreadJob * iwtj)
+{
+    TestYieldData * tyd = (TestYieldData *) IWorkerThreadJobGetData(iwtj);
+    if (tyd->id % TEST_FAIL_EVERY != 0) atomic_fetch_add(&test_yield_wrong_step, 1);
+    atomic_fetch_add(&test_yield_failed, 1);
+}
+
+/// @brief A job that yields gives its worker back, is parked, and carries on from the step it gave once resumed, whether it is
+///         resumed by another thread or by itself, before or after being parked.  Completion callbacks only run once it finishes.
+static void TestYieldSteps()
+{
+    test_yield_controller = IWorkerThreadControllerCreate();
+    for (int w = 0; w < TEST_WORKERS; w++) {
+        IWorkerThreadControllerAddWorkerThread(test_yield_controller, TestYieldJob, TestYieldDone, TestYieldFailed, IThreadTimeoutNone);
+    }
+    atomic_store(&test_yield_resuming, true);
+    pthread_t handle;
+    pthread_create(&handle, NULL, TestYieldResume, NULL);
+    ITHREAD_TEST_CHECK(IWorkerThreadControllerStart(test_yield_controller));
+
+    static TestYieldData data[TEST_JOBS];
+    for (int j = 0; j < TEST_JOBS; j++) {
+        data[j] = (TestYieldData) { .id = j };
+        ITHREAD_TEST_CHECK(IWorkerThreadControllerAddJob(test_yield_controller, &data[j]));
+    }
+    const int FAILURES = TEST_JOBS / TEST_FAIL_EVERY;
+    ITHREAD_TEST_WAIT_FOR(atomic_load(&test_yield_done) + atomic_load(&test_yield_failed) == TEST_JOBS, 30000);
+    ITHREAD_TEST_CHECK(atomic_load(&test_yield_failed) == FAILURES);
+    ITHREAD_TEST_CHECK(atomic_load(&test_yield_wrong_step) == 0);
+    for (int j = 0; j < TEST_JOBS; j++) ITHREAD_TEST_CHECK(data[j].next_step == (j % TEST_FAIL_EVERY == 0 ? 3 : 4));
+
+    atomic_store(&test_yield_resuming, false);
+    pthread_join(handle, NULL);
+    IWorkerThreadControllerStop(test_yield_controller);
+    IWorkerThreadControllerStats * iwtcs = IWorkerThreadControllerStatsCreate();
+    IWorkerThreadControllerGetStats(test_yield_controller, iwtcs);
+    ITHREAD_TEST_CHECK(iwtcs->paused_jobs == 0);
+    ITHREAD_TEST_CHECK(iwtcs->yielded_jobs == 3 * TEST_JOBS - FAILURES);
+    ITHREAD_TEST_CHECK(iwtcs->failed_jobs == (size_t) FAILURES);
+    IWorkerThreadControllerStatsFree(iwtcs);
+    IWorkerThreadControllerFree(test_yield_controller);
+}
+
+int main()
+{
+    ITHREAD_TEST_RUN(TestYieldSteps);
+    ITHREAD_TEST_EXIT();
+}
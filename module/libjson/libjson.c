@@ -66,7 +66,7 @@ bool JSONFreeElement(JSONElement * element)
         } break;
         case JSONValueType_Array :
         case JSONValueType_Object : {
-            if (element->length > 0 && element->data.array) {
+            if (element->data.array) {
                 for (size_t i = 0; i < element->length; i++) {
                     JSONFreeElement(element->data.array[i]);
                     element->data.array[i] = NULL;
@@ -114,6 +114,7 @@ char * _JSONCopyString(char * string, size_t * string_copy_length_ptr)
     char * string_copy = (char *) malloc(l + 1);
     if (string_copy) {
         strncpy(string_copy, string, l);
+        string_copy[l] = 0;
         if (string_copy_length_ptr) *string_copy_length_ptr = l;
     }
     return string_copy;
@@ -208,7 +209,7 @@ JSONElement ** _JSONCreateContainerArray()
 
 bool _JSONResizeContainerArray(JSONElement * container)
 {
-    JSONElement ** new_array = (JSONElement**) realloc(container->data.array, container->_size + JSON_ARRAY_BLOCK_SIZE);
+    JSONElement ** new_array = (JSONElement**) realloc(container->data.array, sizeof(JSONElement *) * (container->_size + JSON_ARRAY_BLOCK_SIZE));
     if (!new_array) return false;
     else {
         container->data.array = new_array;
@@ -386,6 +387,47 @@ void _JSONFreeBuffer(JSONOutputBuffer * buff)
     free(buff);
 }
 
+// Writes a string as a quoted JSON string, escaping quotes, backslashes and control characters, and returns the number of
+// characters written (not counting the terminator).  With no destination, only the length is worked out.
+size_t _JSONWriteEscapedString(char * destination, char * string)
+{
+    size_t length = 0;
+    if (destination) destination[length] = '"';
+    length++;
+    for (size_t i = 0; string[i] != 0; i++) {
+        const unsigned char C = (unsigned char) string[i];
+        char escape = 0;
+        switch (C) {
+            case '"' : escape = '"'; break;
+            case '\\' : escape = '\\'; break;
+            case '\b' : escape = 'b'; break;
+            case '\f' : escape = 'f'; break;
+            case '\n' : escape = 'n'; break;
+            case '\r' : escape = 'r'; break;
+            case '\t' : escape = 't'; break;
+            default:{}
+        }
+        if (escape) {
+            if (destination) {
+                destination[length] = '\\';
+                destination[length + 1] = escape;
+            }
+            length += 2;
+        } else if (C < 0x20) {
+            if (destination) sprintf(destination + length, "\\u%04x", C);
+            length += 6;
+        } else {
+            if (destination) destination[length] = (char) C;
+            length++;
+        }
+    }
+    if (destination) {
+        destination[length] = '"';
+        destination[length + 1] = 0;
+    }
+    return length + 1;
+}
+
 JSONOutputBuffer * _JSONWriteElementToBuffer(JSONElement * element, JSONOutputBuffer * existing_output_buffer_ptr, size_t start_tab_pos)
 {
     if (!_JSONElementIsValid(element)) return existing_output_buffer_ptr;
@@ -402,22 +444,29 @@ JSONOutputBuffer * _JSONWriteElementToBuffer(JSONElement * element, JSONOutputBu
     buff->reused = existing_output_buffer_ptr ? true : false;
     buff->tab_pos = existing_output_buffer_ptr ? existing_output_buffer_ptr->tab_pos : start_tab_pos >= 0 ? start_tab_pos : 0;
 
+    // Escaping can make a name or string up to six times as long, so the buffer is sized for the escaped versions if need be.
+    char * name = element->value_type == JSONValueType_NameValuePair ? (char *) element->data.namevaluepair[0] : NULL;
+    JSONElement * value = name ? element->data.namevaluepair[1] : element;
+    const size_t ESCAPED_LENGTH = (name ? _JSONWriteEscapedString(NULL, name) + 1 : 0) +
+                                  (value->value_type == JSONValueType_String ? _JSONWriteEscapedString(NULL, value->data.string) : 0) + 1;
     size_t temp_buffer_length = JSON_MAX_NAME_LENGTH + 2 + JSON_MAX_STRING_VALUE_LENGTH;
+    if (temp_buffer_length < ESCAPED_LENGTH) temp_buffer_length = ESCAPED_LENGTH;
     char * temp_buffer = (char *) malloc(temp_buffer_length);
     if (!temp_buffer) return buff;
 
     size_t length = 0;
-    if (element->value_type == JSONValueType_NameValuePair) {
-        length += sprintf(temp_buffer, "\"%s\":", (char *) element->data.namevaluepair[0]);
-        element = element->data.namevaluepair[1];
+    if (name) {
+        length += _JSONWriteEscapedString(temp_buffer, name);
+        temp_buffer[length++] = ':';
+        element = value;
     }
 
     switch (element->value_type) {
         case JSONValueType_String : {
-            length += sprintf(temp_buffer + length, "\"%s\"", element->data.string);
+            length += _JSONWriteEscapedString(temp_buffer + length, element->data.string);
         } break;
         case JSONValueType_Number : {
-            if ((int) element->data.number == element->data.number) {
+            if ((long int) element->data.number == element->data.number) {
                 length += sprintf(temp_buffer + length, "%li", (long int) element->data.number);
             } else {
                 length += sprintf(temp_buffer + length, "%f", element->data.number);
@@ -434,11 +483,26 @@ JSONOutputBuffer * _JSONWriteElementToBuffer(JSONElement * element, JSONOutputBu
             JSONOutputBuffer * tob = NULL;
             for (size_t i = 0; i < element->length; i++) {
                 tob = _JSONWriteElementToBuffer(element->data.array[i], tob, buff->tab_pos + 1);
+                // The children's buffer belongs to this container, so the remaining children are appended to it.
+                if (tob && !tob->top_level_element) tob->top_level_element = element;
+            }
+            if (!tob) {
+                // An empty container is written on one line.
+                temp_buffer[length++] = element->value_type == JSONValueType_Array ? '[' : '{';
+                temp_buffer[length++] = element->value_type == JSONValueType_Array ? ']' : '}';
+                break;
             }
-            if (!tob) return buff;
-            if (temp_buffer_length < length + tob->wp) {
-                temp_buffer = (char *) realloc(temp_buffer, length + tob->wp);
-                if (!temp_buffer) return buff;
+            // Room for the children, the brackets, two new lines, the closing bracket's indentation and the terminator.
+            const size_t REQUIRED_LENGTH = length + tob->wp + buff->tab_pos + 5;
+            if (temp_buffer_length < REQUIRED_LENGTH) {
+                char * new_temp_buffer = (char *) realloc(temp_buffer, REQUIRED_LENGTH);
+                if (!new_temp_buffer) {
+                    free(temp_buffer);
+                    _JSONFreeBuffer(tob);
+                    return buff;
+                }
+                temp_buffer = new_temp_buffer;
+                temp_buffer_length = REQUIRED_LENGTH;
             }
             size_t t = length;
             temp_buffer[t++] = element->value_type == JSONValueType_Array ? '[' : '{';
@@ -478,6 +542,7 @@ bool _JSONWriteBufferToFile(JSONOutputBuffer * buff, char * filename)
 {
     if (!buff || buff->id != JSON_ELEMENT_ID || !buff->top_level_element || !filename || filename[0] == 0) return false;
     FILE * outfile = fopen(filename,"w");
+    if (!outfile) return false;
     fwrite(buff->data, 1, buff->wp, outfile);
     fclose(outfile);
     return true;
@@ -487,7 +552,11 @@ bool JSONWriteElementToFile(JSONElement * e, char * filename)
 {
     if (!_JSONElementIsValid(e)) return false;
     JSONOutputBuffer * ob = _JSONWriteElementToBuffer(e, NULL, 0);
-    return ob ? _JSONWriteBufferToFile(ob, filename) : false;
+    if (!ob) return false;
+    ob->top_level_element = e;
+    const bool WRITTEN = _JSONWriteBufferToFile(ob, filename);
+    _JSONFreeBuffer(ob);
+    return WRITTEN;
 }
 
 bool _JSONCharIsValid(char * string, size_t offset, size_t search_start_offset, char petc) {